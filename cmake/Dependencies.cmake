@@ -81,6 +81,11 @@ if(USE_LEVELDB)
   list(APPEND Caffe_LINKER_LIBS PRIVATE ${Snappy_LIBRARIES})
 endif()
 
+# ---[ perf_event
+if(USE_PERF_EVENT)
+  list(APPEND Caffe_DEFINITIONS PRIVATE -DUSE_PERF_EVENT)
+endif()
+
 # ---[ CUDA
 include(cmake/Cuda.cmake)
 if(NOT HAVE_CUDA)
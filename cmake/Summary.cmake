@@ -119,6 +119,7 @@ function(caffe_print_configuration_summary)
   caffe_status("  USE_LMDB          :   ${USE_LMDB}")
   caffe_status("  USE_NCCL          :   ${USE_NCCL}")
   caffe_status("  ALLOW_LMDB_NOLOCK :   ${ALLOW_LMDB_NOLOCK}")
+  caffe_status("  USE_PERF_EVENT    :   ${USE_PERF_EVENT}")
   # This code is taken from https://github.com/sh1r0/caffe-android-lib
   caffe_status("  USE_HDF5          :   ${USE_HDF5}")
   caffe_status("")
@@ -0,0 +1,192 @@
+// A loopback HTTP server answering single-example requests to a Caffe net,
+// batched on the fly with RequestBatcher.
+// Usage:
+//    batching_server [FLAGS] deploy.prototxt network.caffemodel
+//
+//    POST /predict  body: the input_dim values of one example, separated by
+//                   white space; reply: one line of values per net output
+//    GET /info      reply: "input_dim <n>"
+//
+// Connections are kept alive. See load_generator for a benchmark client.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "caffe/caffe.hpp"
+#include "caffe/request_batcher.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+using std::string;
+
+DEFINE_int32(port, 8080, "The loopback port to listen on.");
+DEFINE_int32(gpu, -1, "The GPU to run on, or -1 for the CPU.");
+DEFINE_int32(max_batch, 32, "The largest batch to run.");
+DEFINE_int32(max_delay_us, 2000,
+    "How long a request may wait for a batch to fill, in microseconds.");
+DEFINE_int32(workers, 1,
+    "The number of batchers, each running batches on its own thread.");
+
+// Reads one HTTP request from fd, using and keeping leftovers in buffer.
+// Returns false once the client has closed the connection.
+static bool ReadRequest(int fd, string* buffer, string* method, string* path,
+    string* body, bool* keep_alive) {
+  size_t header_end;
+  char chunk[4096];
+  while ((header_end = buffer->find("\r\n\r\n")) == string::npos) {
+    const ssize_t n = read(fd, chunk, sizeof(chunk));
+    if (n <= 0) { return false; }
+    buffer->append(chunk, n);
+  }
+  std::istringstream header(buffer->substr(0, header_end));
+  string line;
+  std::getline(header, line);
+  std::istringstream request_line(line);
+  request_line >> *method >> *path;
+  size_t content_length = 0;
+  *keep_alive = true;
+  while (std::getline(header, line)) {
+    const size_t colon = line.find(':');
+    if (colon == string::npos) { continue; }
+    string name = line.substr(0, colon);
+    for (int i = 0; i < name.size(); ++i) { name[i] = tolower(name[i]); }
+    const string value = line.substr(colon + 1);
+    if (name == "content-length") {
+      content_length = strtoul(value.c_str(), NULL, 10);
+    } else if (name == "connection" &&
+               value.find("close") != string::npos) {
+      *keep_alive = false;
+    }
+  }
+  const size_t body_start = header_end + 4;
+  while (buffer->size() < body_start + content_length) {
+    const ssize_t n = read(fd, chunk, sizeof(chunk));
+    if (n <= 0) { return false; }
+    buffer->append(chunk, n);
+  }
+  *body = buffer->substr(body_start, content_length);
+  buffer->erase(0, body_start + content_length);
+  return true;
+}
+
+static bool WriteResponse(int fd, int status, const string& body) {
+  std::ostringstream response;
+  response << "HTTP/1.1 " << status << (status == 200 ? " OK" : " Error")
+           << "\r\nContent-Type: text/plain\r\nContent-Length: "
+           << body.size() << "\r\n\r\n" << body;
+  const string data = response.str();
+  for (size_t written = 0; written < data.size(); ) {
+    const ssize_t n = write(fd, data.data() + written, data.size() - written);
+    if (n <= 0) { return false; }
+    written += n;
+  }
+  return true;
+}
+
+static void ServeConnection(int fd, RequestBatcher<float>* batcher) {
+  string buffer, method, path, body;
+  bool keep_alive = true;
+  while (keep_alive &&
+         ReadRequest(fd, &buffer, &method, &path, &body, &keep_alive)) {
+    std::ostringstream reply;
+    int status = 200;
+    if (method == "GET" && path == "/info") {
+      reply << "input_dim " << batcher->input_dim() << "\n";
+    } else if (method == "POST" && path == "/predict") {
+      std::istringstream values(body);
+      vector<float> input;
+      float value;
+      while (values >> value) { input.push_back(value); }
+      if (input.size() != batcher->input_dim()) {
+        status = 400;
+        reply << "expected " << batcher->input_dim() << " values\n";
+      } else {
+        shared_ptr<RequestBatcher<float>::Future> future =
+            batcher->Submit(input);
+        const vector<vector<float> >& outputs = future->Get();
+        for (int i = 0; i < outputs.size(); ++i) {
+          for (int j = 0; j < outputs[i].size(); ++j) {
+            reply << (j ? " " : "") << outputs[i][j];
+          }
+          reply << "\n";
+        }
+      }
+    } else {
+      status = 404;
+      reply << "unknown request " << method << " " << path << "\n";
+    }
+    if (!WriteResponse(fd, status, reply.str())) { break; }
+  }
+  close(fd);
+}
+
+int main(int argc, char** argv) {
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Serve a Caffe net over loopback HTTP, batching\n"
+        "concurrent requests.\n"
+        "Usage:\n"
+        "    batching_server [FLAGS] deploy.prototxt network.caffemodel\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  if (argc != 3) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0],
+        "examples/batching_server/batching_server");
+    return 1;
+  }
+  google::InitGoogleLogging(argv[0]);
+
+  if (FLAGS_gpu >= 0) {
+    Caffe::SetDevice(FLAGS_gpu);
+    Caffe::set_mode(Caffe::GPU);
+  } else {
+    Caffe::set_mode(Caffe::CPU);
+  }
+  InferenceEngine<float> engine(argv[1], argv[2]);
+  vector<shared_ptr<RequestBatcher<float> > > batchers;
+  for (int i = 0; i < FLAGS_workers; ++i) {
+    batchers.push_back(shared_ptr<RequestBatcher<float> >(
+        new RequestBatcher<float>(&engine, FLAGS_max_batch,
+            FLAGS_max_delay_us)));
+  }
+
+  const int server = socket(AF_INET, SOCK_STREAM, 0);
+  CHECK_GE(server, 0) << "Failed to create a socket.";
+  const int reuse = 1;
+  setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  sockaddr_in address = sockaddr_in();
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(FLAGS_port);
+  CHECK_EQ(bind(server, reinterpret_cast<sockaddr*>(&address),
+      sizeof(address)), 0) << "Failed to bind port " << FLAGS_port;
+  CHECK_EQ(listen(server, 128), 0);
+  LOG(INFO) << "Listening on 127.0.0.1:" << FLAGS_port;
+
+  // Connections are spread over the batchers in turn.
+  for (int connection = 0; ; ++connection) {
+    const int fd = accept(server, NULL, NULL);
+    if (fd < 0) { continue; }
+    const int no_delay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+    boost::thread(boost::bind(&ServeConnection, fd,
+        batchers[connection % batchers.size()].get())).detach();
+  }
+  return 0;
+}
@@ -0,0 +1,154 @@
+// A closed-loop load generator for batching_server: each connection sends
+// its next request as soon as the previous reply arrives, for a fixed time,
+// then the throughput and latency percentiles are reported.
+// Usage:
+//    load_generator [FLAGS]
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using boost::posix_time::microsec_clock;
+using boost::posix_time::ptime;
+using std::string;
+using std::vector;
+
+DEFINE_int32(port, 8080, "The loopback port of batching_server.");
+DEFINE_int32(connections, 16, "The number of concurrent connections.");
+DEFINE_int32(seconds, 10, "How long to send requests for.");
+
+// Sends one request over fd and returns the body of the reply.
+static string Request(int fd, const string& method, const string& path,
+    const string& body) {
+  std::ostringstream request;
+  request << method << " " << path << " HTTP/1.1\r\nHost: localhost\r\n"
+          << "Content-Length: " << body.size() << "\r\n\r\n" << body;
+  const string data = request.str();
+  for (size_t written = 0; written < data.size(); ) {
+    const ssize_t n = write(fd, data.data() + written, data.size() - written);
+    CHECK_GT(n, 0) << "Lost the connection to the server.";
+    written += n;
+  }
+  string reply;
+  char chunk[4096];
+  size_t header_end, content_length = 0;
+  while ((header_end = reply.find("\r\n\r\n")) == string::npos) {
+    const ssize_t n = read(fd, chunk, sizeof(chunk));
+    CHECK_GT(n, 0) << "Lost the connection to the server.";
+    reply.append(chunk, n);
+  }
+  CHECK_EQ(reply.compare(0, 12, "HTTP/1.1 200"), 0)
+      << "Request failed: " << reply;
+  const size_t length = reply.find("Content-Length: ");
+  if (length != string::npos && length < header_end) {
+    content_length = strtoul(reply.c_str() + length + 16, NULL, 10);
+  }
+  while (reply.size() < header_end + 4 + content_length) {
+    const ssize_t n = read(fd, chunk, sizeof(chunk));
+    CHECK_GT(n, 0) << "Lost the connection to the server.";
+    reply.append(chunk, n);
+  }
+  return reply.substr(header_end + 4, content_length);
+}
+
+static int Connect() {
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  CHECK_GE(fd, 0) << "Failed to create a socket.";
+  sockaddr_in address = sockaddr_in();
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(FLAGS_port);
+  CHECK_EQ(connect(fd, reinterpret_cast<sockaddr*>(&address),
+      sizeof(address)), 0) << "Failed to connect to port " << FLAGS_port;
+  const int no_delay = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+  return fd;
+}
+
+// Sends requests until the time is up, recording their latencies in ms.
+static void RunConnection(const string& body, vector<float>* latencies) {
+  const int fd = Connect();
+  const ptime end = microsec_clock::universal_time() +
+      boost::posix_time::seconds(FLAGS_seconds);
+  for (ptime start = microsec_clock::universal_time(); start < end; ) {
+    Request(fd, "POST", "/predict", body);
+    const ptime stop = microsec_clock::universal_time();
+    latencies->push_back((stop - start).total_microseconds() / 1000.f);
+    start = stop;
+  }
+  close(fd);
+}
+
+static float Percentile(const vector<float>& sorted, float p) {
+  const int index = static_cast<int>(std::ceil(p / 100 * sorted.size())) - 1;
+  return sorted[std::max(index, 0)];
+}
+
+int main(int argc, char** argv) {
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Measure the throughput and latency of\n"
+        "batching_server.\n"
+        "Usage:\n"
+        "    load_generator [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  // Every request sends the same example, of the size the net expects.
+  int input_dim = 0;
+  {
+    const int fd = Connect();
+    std::istringstream info(Request(fd, "GET", "/info", ""));
+    string key;
+    info >> key >> input_dim;
+    close(fd);
+  }
+  CHECK_GT(input_dim, 0) << "Unexpected reply to GET /info.";
+  std::ostringstream body;
+  for (int i = 0; i < input_dim; ++i) {
+    body << (i ? " " : "") << static_cast<float>(i % 255) / 255;
+  }
+
+  vector<vector<float> > latencies(FLAGS_connections);
+  boost::thread_group threads;
+  for (int i = 0; i < FLAGS_connections; ++i) {
+    threads.create_thread(boost::bind(&RunConnection, body.str(),
+        &latencies[i]));
+  }
+  threads.join_all();
+
+  vector<float> all;
+  for (int i = 0; i < latencies.size(); ++i) {
+    all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+  }
+  CHECK(!all.empty()) << "No request completed.";
+  std::sort(all.begin(), all.end());
+  LOG(INFO) << all.size() << " requests over " << FLAGS_connections
+            << " connections in " << FLAGS_seconds << " s: "
+            << all.size() / static_cast<float>(FLAGS_seconds)
+            << " requests/s";
+  LOG(INFO) << "Latency p50 " << Percentile(all, 50) << " ms, p90 "
+            << Percentile(all, 90) << " ms, p99 " << Percentile(all, 99)
+            << " ms, p99.9 " << Percentile(all, 99.9) << " ms, max "
+            << all.back() << " ms";
+  return 0;
+}
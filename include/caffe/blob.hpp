@@ -13,6 +13,37 @@ const int kMaxBlobAxes = 32;
 
 namespace caffe {
 
+/**
+ * @brief The rows of a row-sparse diff that may be nonzero, in the order in
+ *        which they were marked; see Blob::set_row_sparse_diff.
+ */
+class DiffRows {
+ public:
+  explicit DiffRows(int num_rows) : marked_(num_rows, false) {}
+
+  inline void Mark(int row) {
+    DCHECK_GE(row, 0);
+    DCHECK_LT(row, marked_.size());
+    if (!marked_[row]) {
+      marked_[row] = true;
+      rows_.push_back(row);
+    }
+  }
+  /// @brief Unmarks the rows, in O(marked rows).
+  inline void Clear() {
+    for (int i = 0; i < rows_.size(); ++i) {
+      marked_[rows_[i]] = false;
+    }
+    rows_.clear();
+  }
+  inline const vector<int>& rows() const { return rows_; }
+  inline int num_rows() const { return marked_.size(); }
+
+ private:
+  vector<bool> marked_;
+  vector<int> rows_;
+};
+
 /**
  * @brief A wrapper around SyncedMemory holders serving as the basic
  *        computational unit through which Layer%s, Net%s, and Solver%s
@@ -24,7 +55,7 @@ template <typename Dtype>
 class Blob {
  public:
   Blob()
-       : data_(), diff_(), count_(0), capacity_(0) {}
+       : data_(), diff_(), count_(0), capacity_(0), layout_(NCHW) {}
 
   /// @brief Deprecated; use <code>Blob(const vector<int>& shape)</code>.
   explicit Blob(const int num, const int channels, const int height,
@@ -170,11 +201,21 @@ class Blob {
     CHECK_LE(h, height());
     CHECK_GE(width(), 0);
     CHECK_LE(w, width());
+    if (layout_ != NCHW) {
+      const int block = layout_block();
+      return (n * channels() + c / block * block) * height() * width()
+          + (h * width() + w) * block + c % block;
+    }
     return ((n * channels() + c) * height() + h) * width() + w;
   }
   // 计算偏移
   inline int offset(const vector<int>& indices) const {
     CHECK_LE(indices.size(), num_axes());
+    if (layout_ != NCHW) {
+      vector<int> nchw(indices);
+      nchw.resize(4, 0);
+      return offset(nchw[0], nchw[1], nchw[2], nchw[3]);
+    }
     int offset = 0;
     for (int i = 0; i < num_axes(); ++i) {
       offset *= shape(i);
@@ -240,6 +281,11 @@ class Blob {
   Dtype* mutable_cpu_diff();
   Dtype* mutable_gpu_diff();
   void Update();
+  /**
+   * @brief Reads the shape, data and diff of proto. The data of a sparse
+   *        proto (see BlobProto.sparse_index) is kept in that form, its
+   *        memory released until it is read (see SyncedMemory::Release).
+   */
   void FromProto(const BlobProto& proto, bool reshape = true);
   void ToProto(BlobProto* proto, bool write_diff = false) const;
 
@@ -276,15 +322,93 @@ class Blob {
    */
   void ShareDiff(const Blob& other);
 
+  /**
+   * @brief Makes the data of this Blob a view of that of Blob other, from its
+   *        offset-th value: writes to either are seen by both, with no copy,
+   *        as Concat and Slice use to place their bottoms or tops in one
+   *        another.
+   *
+   * The view lasts until this Blob grows past its count, shares or sets other
+   * data, or views other data.
+   */
+  void ViewData(const Blob& other, int offset);
+  /// @brief Makes the diff of this Blob a view of that of other; see ViewData.
+  void ViewDiff(const Blob& other, int offset);
+  /// @brief Whether the data is a view of that of other from its offset-th
+  ///        value, as ViewData made it.
+  bool DataViews(const Blob& other, int offset) const;
+  /// @brief Whether the diff is a view of that of other; see DataViews.
+  bool DiffViews(const Blob& other, int offset) const;
+  /**
+   * @brief Whether the data is shared with another Blob, as Split, Flatten
+   *        and Reshape share their tops with their bottom in every Reshape.
+   *        A view made of such data would not last past the next pass.
+   */
+  bool DataShared() const { return data_ && data_.use_count() > 1; }
+
   bool ShapeEquals(const BlobProto& other);
 
+  /**
+   * @brief The order of the values in memory: NCHW, as the shape reads, or
+   *        for blobs of 4 axes NHWC or channel-blocked NCHW8C or NCHW16C.
+   *
+   * The shape is always that of NCHW, and offset(n, c, h, w) follows the
+   * layout; the other accessors see the values in memory order. Only the
+   * layers that handle a layout take bottoms in it, as Net arranges with
+   * ReorderLayer%s (see NetParameter.layout). The layout is kept across
+   * Reshape, and is not shared by ShareData.
+   */
+  inline BlobLayout layout() const { return layout_; }
+  /// @brief Sets the layout, which the shape must fit; see LayoutFits.
+  void set_layout(BlobLayout layout);
+  /// @brief Whether the shape can take the layout: NCHW always, the others
+  ///        with 4 axes, and the blocked ones if the blocks fill the channels.
+  bool LayoutFits(BlobLayout layout) const;
+  /**
+   * @brief The channels stored together per spatial position: 1 for NCHW,
+   *        all of them for NHWC, or the block. The value at (n, c, s), for s
+   *        the spatial index h * width + w, is then at
+   *        ((n * channels + c / block * block) * spatial + s) * block
+   *        + c % block.
+   */
+  inline int layout_block() const { return LayoutBlock(layout_, channels()); }
+  static int LayoutBlock(BlobLayout layout, int channels);
+
+  /**
+   * @brief Track the rows of the diff -- the indices of its first axis --
+   *        that may be nonzero, for params whose gradient touches few rows,
+   *        such as the weights of an EmbedLayer.
+   *
+   * The layers mark the rows they accumulate into with MarkDiffRow. On the
+   * CPU, Update then only updates the marked rows, so the diff of the others
+   * must be zero, as the solvers with SolverParameter.sparse_update keep it.
+   * ShareDiff shares the marked rows along with the diff.
+   */
+  void set_row_sparse_diff(bool row_sparse);
+  inline bool row_sparse_diff() const { return diff_rows_.get() != NULL; }
+  /// @brief Mark a row of the diff as touched, if the rows are tracked.
+  inline void MarkDiffRow(int row) {
+    if (diff_rows_) { diff_rows_->Mark(row); }
+  }
+  /// @brief The marked rows of a row-sparse diff.
+  inline const vector<int>& diff_rows() const {
+    CHECK(diff_rows_) << "The diff is not row-sparse.";
+    return diff_rows_->rows();
+  }
+  /// @brief Unmark the rows, which leaves the diff as it is.
+  inline void UnmarkDiffRows() {
+    if (diff_rows_) { diff_rows_->Clear(); }
+  }
+
  protected:
   shared_ptr<SyncedMemory> data_;         //前向传播数据
   shared_ptr<SyncedMemory> diff_;         //反向传播梯度
+  shared_ptr<DiffRows> diff_rows_;        //row-sparse diff的非零行
   shared_ptr<SyncedMemory> shape_data_;   //参数维度
   vector<int> shape_;                     //参数维度
   int count_;                             //Blob中元素的个数(shape乘积)
   int capacity_;                          //当前元素个数
+  BlobLayout layout_;                     //数据在内存中的排列
 
   DISABLE_COPY_AND_ASSIGN(Blob);
 };  // class Blob
@@ -7,11 +7,17 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/inference_engine.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/layer_factory.hpp"
+#include "caffe/memory_report.hpp"
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
+#include "caffe/profiler.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/recurrent_session.hpp"
+#include "caffe/request_batcher.hpp"
+#include "caffe/shape_bucket_cache.hpp"
 #include "caffe/solver.hpp"
 #include "caffe/solver_factory.hpp"
 #include "caffe/util/benchmark.hpp"
@@ -0,0 +1,80 @@
+#ifndef CAFFE_INFERENCE_ENGINE_HPP_
+#define CAFFE_INFERENCE_ENGINE_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief A trained Net compiled once for concurrent inference: the weights
+ *        are shared by any number of Context%s, each owning only its own
+ *        activations and layer scratch (col_buffer_, max_idx_ and the like).
+ *
+ * The engine builds the TEST-phase net once and keeps its parameter blobs,
+ * which must not be modified afterwards, together with the filtered,
+ * split-inserted NetParameter. A Context is a Net built from that parameter
+ * whose layers take the engine's parameter blobs instead of allocating and
+ * filling their own, so creating one costs only the layer setup.
+ *
+ * CreateContext may be called from any thread. A Context may be used by one
+ * thread at a time; it applies the Caffe mode and device of the thread that
+ * created the engine, as Caffe::Get() is thread-local.
+ */
+template <typename Dtype>
+class InferenceEngine {
+ public:
+  InferenceEngine(const string& param_file, const string& trained_filename);
+  /// @brief Uses the weights in the layers' blobs of param, if any.
+  explicit InferenceEngine(const NetParameter& param);
+
+  class Context {
+   public:
+    /// @brief Run the net on its current input blobs.
+    const vector<Blob<Dtype>*>& Forward(Dtype* loss = NULL);
+    inline Net<Dtype>* net() { return net_.get(); }
+    inline const vector<Blob<Dtype>*>& input_blobs() const {
+      return net_->input_blobs();
+    }
+    inline const vector<Blob<Dtype>*>& output_blobs() const {
+      return net_->output_blobs();
+    }
+
+   protected:
+    explicit Context(const InferenceEngine* engine);
+
+    const InferenceEngine* engine_;
+    shared_ptr<Net<Dtype> > net_;
+
+    friend class InferenceEngine;
+    DISABLE_COPY_AND_ASSIGN(Context);
+  };
+
+  /// @brief Create an execution context sharing the weights of the engine.
+  shared_ptr<Context> CreateContext() const;
+
+  /// @brief The net holding the shared weights; it is never run.
+  inline const Net<Dtype>& net() const { return *net_; }
+
+ protected:
+  void Init(const NetParameter& param, const string& trained_filename);
+  /// @brief Apply the mode and device of the engine to the calling thread.
+  void SetUpThread() const;
+
+  /// The parameter the contexts are built from, without any weights.
+  NetParameter param_;
+  shared_ptr<Net<Dtype> > net_;
+  Caffe::Brew mode_;
+  int device_;
+
+  DISABLE_COPY_AND_ASSIGN(InferenceEngine);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INFERENCE_ENGINE_HPP_
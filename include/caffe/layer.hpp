@@ -44,6 +44,7 @@ class Layer {
       // Set phase and copy blobs (if there are any).
       // 设置状态TRAIN或者TEST
       phase_ = param.phase();
+      blob_views_ = true;
       // 拷贝blobs
       if (layer_param_.blobs_size() > 0) {
 		// 设置vector大小，每次拷贝一个blobs
@@ -279,6 +280,18 @@ class Layer {
     return true;
   }
 
+  /**
+   * @brief Return whether the gradient of a param blob touches only some of
+   *        its rows, the indices of its first axis.
+   *
+   * If RowSparseParamGradient(i) == true, Backward marks the rows of blob i
+   * it accumulates into with Blob::MarkDiffRow, which the Net has the blob
+   * track for solvers with sparse_update.
+   */
+  virtual inline bool RowSparseParamGradient(const int param_id) const {
+    return false;
+  }
+
   /**
    * @brief Specifies whether the layer should compute gradients w.r.t. a
    *        parameter at a particular index given by param_id.
@@ -301,6 +314,17 @@ class Layer {
     param_propagate_down_[param_id] = value;
   }
 
+  /**
+   * @brief Returns whether the layer may make its bottoms and tops views of
+   *        one another (see Blob::ViewData) instead of copying between them,
+   *        as Concat and Slice do when the copied parts are contiguous.
+   *
+   * Net disallows it when a later layer works in place on a top, which would
+   * overwrite the bottoms too.
+   */
+  inline bool blob_views() const { return blob_views_; }
+  inline void set_blob_views(bool blob_views) { blob_views_ = blob_views; }
+
 
  protected:
   /** The protobuf that stores the layer parameters */
@@ -311,6 +335,8 @@ class Layer {
   vector<shared_ptr<Blob<Dtype> > > blobs_;
   /** Vector indicating whether to compute the diff of each param blob. */
   vector<bool> param_propagate_down_;
+  /** Whether the bottoms and tops may be views of one another. */
+  bool blob_views_;
 
   /** The vector that indicates whether each top blob has a non-zero weight in
    *  the objective function. */
@@ -1,6 +1,7 @@
 #ifndef CAFFE_ARGMAX_LAYER_HPP_
 #define CAFFE_ARGMAX_LAYER_HPP_
 
+#include <utility>
 #include <vector>
 
 #include "caffe/blob.hpp"
@@ -70,6 +71,8 @@ class ArgMaxLayer : public Layer<Dtype> {
   size_t top_k_;
   bool has_axis_;
   int axis_;
+  /// The top k of an instance, kept to not allocate them on each Forward.
+  vector<std::pair<Dtype, int> > top_buffer_;
 };
 
 }  // namespace caffe
@@ -7,6 +7,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/im2col.hpp"
+#include "caffe/util/sparse_matrix.hpp"
 
 namespace caffe {
 
@@ -34,7 +35,17 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   // we just called weight_cpu_gemm with the same input.
   void forward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output, bool skip_im2col = false);
+  // Multiplies by the sparse form of the weights instead.
+  void forward_cpu_gemm(const Dtype* input, const SparseWeights<Dtype>& weights,
+      Dtype* output);
   void forward_cpu_bias(Dtype* output, const Dtype* bias);
+  // The same for an input and output stored with the channel blocks
+  // input_block and output_block (see Blob::layout_block), and the weights
+  // in the order of the rows of im2row_blocked_cpu, for 2D and one group.
+  void forward_cpu_blocked_gemm(const Dtype* input, int input_block,
+      const Dtype* weights, Dtype* output, int output_block);
+  void forward_cpu_blocked_bias(Dtype* output, int output_block,
+      const Dtype* bias);
   void backward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output);
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype*
@@ -92,6 +103,8 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool bias_term_;
   bool is_1x1_;
   bool force_nd_im2col_;
+  /// The weights in CSR form, for the TEST phase once they are sparse enough.
+  SparseWeights<Dtype> sparse_weights_;
 
  private:
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
@@ -9,6 +9,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/metrics.hpp"
 
 namespace caffe {
 
@@ -68,11 +69,16 @@ class BasePrefetchingDataLayer :
  protected:
   virtual void InternalThreadEntry();
   virtual void load_batch(Batch<Dtype>* batch) = 0;
+  // Returns the current batch to the prefetch thread and waits for the
+  // next, recording the wait and the batches left in the Metrics.
+  void NextBatch();
 
   vector<shared_ptr<Batch<Dtype> > > prefetch_;
   BlockingQueue<Batch<Dtype>*> prefetch_free_;
   BlockingQueue<Batch<Dtype>*> prefetch_full_;
   Batch<Dtype>* prefetch_current_;
+  Metrics::Histogram* data_wait_;
+  Metrics::Gauge* queue_depth_;
 
   Blob<Dtype> transformed_data_;
 };
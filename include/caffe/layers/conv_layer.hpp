@@ -26,6 +26,14 @@ namespace caffe {
  *   inputs so that the im2col matrix has a column for each input region to
  *   be filtered. col2im restores the output spatial structure by rolling up
  *   the output channel N' columns of the output matrix.
+ *
+ *   Bottoms in the NHWC or blocked layouts (see Blob::layout) are unrolled
+ *   into rows instead, with the channels innermost, and multiplied by the
+ *   weights reordered to match; the top takes the layout of the bottom, or
+ *   ConvolutionParameter.top_layout if set, or NHWC if its channels do not
+ *   fill the blocks. An NCHW bottom with a top in another layout, as the
+ *   3-channel images at the input of a net, is unrolled the same way with
+ *   blocks of one channel.
  */
 template <typename Dtype>
 class ConvolutionLayer : public BaseConvolutionLayer<Dtype> {
@@ -62,7 +70,10 @@ class ConvolutionLayer : public BaseConvolutionLayer<Dtype> {
    *    kernels + stream parallelism) engines.
    */
   explicit ConvolutionLayer(const LayerParameter& param)
-      : BaseConvolutionLayer<Dtype>(param) {}
+      : BaseConvolutionLayer<Dtype>(param), blocked_weights_version_(0),
+        blocked_weights_block_(0) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "Convolution"; }
 
@@ -77,6 +88,17 @@ class ConvolutionLayer : public BaseConvolutionLayer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual inline bool reverse_dimensions() { return false; }
   virtual void compute_output_shape();
+  // Convolves bottoms or tops in a layout other than NCHW, in the TEST
+  // phase.
+  void ForwardBlocked_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  /// The weights reordered for the block of the bottoms, rebuilt when the
+  /// weights or the block change.
+  Blob<Dtype> blocked_weights_;
+  boost::weak_ptr<SyncedMemory> blocked_weights_memory_;
+  uint64_t blocked_weights_version_;
+  int blocked_weights_block_;
 };
 
 }  // namespace caffe
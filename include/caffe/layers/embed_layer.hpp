@@ -29,6 +29,10 @@ class EmbedLayer : public Layer<Dtype> {
   virtual inline const char* type() const { return "Embed"; }
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
+  /// The weights get a gradient only in the rows of the input indices.
+  virtual inline bool RowSparseParamGradient(const int param_id) const {
+    return param_id == 0;
+  }
 
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
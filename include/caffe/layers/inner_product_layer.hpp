@@ -6,6 +6,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/sparse_matrix.hpp"
 
 namespace caffe {
 
@@ -45,6 +46,8 @@ class InnerProductLayer : public Layer<Dtype> {
   bool bias_term_;              // 是否添加偏置
   Blob<Dtype> bias_multiplier_; // 偏置乘子
   bool transpose_;  ///< if true, assume transposed weights
+  /// The weights in CSR form, for the TEST phase once they are sparse enough.
+  SparseWeights<Dtype> sparse_weights_;
 };
 
 }  // namespace caffe
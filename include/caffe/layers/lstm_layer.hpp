@@ -32,6 +32,11 @@ template <typename Dtype> class RecurrentLayer;
  * In the implementation, the i, f, o, and g computations are performed as a
  * single inner product.
  *
+ * On the CPU the recurrence runs natively unless recurrent_param.fused is
+ * false: the input is projected for all timesteps in a single GEMM, then each
+ * timestep takes one GEMM of the hidden state and the nonlinearities of the
+ * LSTMUnit in one pass. The unrolled net still holds the parameters.
+ *
  * Notably, this implementation lacks the "diagonal" gates, as used in the
  * LSTM architectures described by Alex Graves [3] and others.
  *
@@ -49,6 +54,8 @@ class LSTMLayer : public RecurrentLayer<Dtype> {
  public:
   explicit LSTMLayer(const LayerParameter& param)
       : RecurrentLayer<Dtype>(param) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "LSTM"; }
 
@@ -58,6 +65,29 @@ class LSTMLayer : public RecurrentLayer<Dtype> {
   virtual void RecurrentOutputBlobNames(vector<string>* names) const;
   virtual void RecurrentInputShapes(vector<BlobShape>* shapes) const;
   virtual void OutputBlobNames(vector<string>* names) const;
+
+  virtual inline bool HasFusedImplementation() const { return true; }
+  virtual void FusedForward_cpu();
+  virtual void FusedBackward_cpu(const vector<bool>& propagate_down);
+  virtual void FusedStep_cpu(int T, int num, const Dtype* x,
+      const vector<Dtype*>& states, Dtype* y);
+
+  /// @brief The activated gates (i, f, o, g) of all timesteps, and in the diff
+  ///        the gradient of the gate inputs.
+  Blob<Dtype> gates_;
+  /// @brief The cell states c_t of all timesteps.
+  Blob<Dtype> cell_;
+  /// @brief The hidden states h_t of all timesteps.
+  Blob<Dtype> hidden_;
+  /// @brief The previous hidden states as multiplied by cont_t.
+  Blob<Dtype> hidden_conted_;
+  /// @brief The projection of the static input, and its gradient.
+  Blob<Dtype> static_gates_;
+  /// @brief The gradient of the previous hidden state of a timestep.
+  Blob<Dtype> hidden_prev_diff_;
+  Blob<Dtype> bias_multiplier_;
+  /// @brief The gates of Step.
+  Blob<Dtype> step_gates_;
 };
 
 /**
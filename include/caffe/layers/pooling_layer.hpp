@@ -43,6 +43,22 @@ class PoolingLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  // Max or average pools a bottom in a layout other than NCHW, without a
+  // mask, over the channels of each block at once.
+  void ForwardBlocked_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  // Max or average pools an NCHW bottom without a mask: down the rows of
+  // each window first, along contiguous memory, then across its columns.
+  void ForwardUnmasked_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  // Max pools Backward with the argmax of each window found again.
+  void BackwardUnmasked_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<Blob<Dtype>*>& bottom);
+  // Whether max pooling records the argmax of each window for Backward, as
+  // in TRAIN or into top[1]. Otherwise Backward recomputes it.
+  inline bool RecordsMask(const vector<Blob<Dtype>*>& top) const {
+    return top.size() > 1 || this->phase_ == TRAIN;
+  }
 
   int kernel_h_, kernel_w_;
   int stride_h_, stride_w_;
@@ -54,6 +70,8 @@ class PoolingLayer : public Layer<Dtype> {
   PoolingParameter_RoundMode round_mode_;
   Blob<Dtype> rand_idx_;
   Blob<int> max_idx_;
+  // Ones over the image, to average it with a gemv when pooled globally.
+  Blob<Dtype> spatial_sum_multiplier_;
 };
 
 }  // namespace caffe
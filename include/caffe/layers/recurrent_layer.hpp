@@ -59,6 +59,29 @@ class RecurrentLayer : public Layer<Dtype> {
     return bottom_index != 1;
   }
 
+  /**
+   * @brief Runs T timesteps of num streams on the CPU, apart from the batch of
+   *        the layer, which is neither reshaped nor touched.
+   *
+   * The streams continue from their recurrent states, which are updated in
+   * place; a zero state begins a sequence.  Used by RecurrentSession.  Needs
+   * a fused implementation, and a layer without static input.
+   *
+   * @param x the input, @f$ (T \times num \times input\_dim) @f$
+   * @param states the recurrent states, in the order of the recurrent inputs,
+   *        each @f$ (num \times state\_dim(i)) @f$
+   * @param y the output, @f$ (T \times num \times num\_output) @f$
+   */
+  void Step(int T, int num, const Dtype* x, const vector<Dtype*>& states,
+      Dtype* y);
+  /// @brief The size of the input of a timestep of a stream.
+  inline int input_dim() const { return x_input_blob_->count(2); }
+  /// @brief The number of recurrent states, and the size of each.
+  inline int num_states() const { return recur_input_blobs_.size(); }
+  inline int state_dim(int i) const {
+    return recur_input_blobs_[i]->count(2);
+  }
+
  protected:
   /**
    * @brief Fills net_param with the recurrent network architecture.  Subclasses
@@ -95,6 +118,65 @@ class RecurrentLayer : public Layer<Dtype> {
    */
   virtual void OutputBlobNames(vector<string>* names) const = 0;
 
+  /// @brief Whether the subclass implements FusedForward_cpu and
+  ///        FusedBackward_cpu.
+  virtual inline bool HasFusedImplementation() const { return false; }
+
+  /**
+   * @brief Runs the recurrence on the CPU without the unrolled net.  Reads
+   *        the inputs and the recurrent inputs of the unrolled net, and writes
+   *        its outputs and recurrent outputs, as ForwardTo would.  Subclasses
+   *        that have a fused implementation should define this.
+   */
+  virtual void FusedForward_cpu() { NOT_IMPLEMENTED; }
+
+  /**
+   * @brief Backpropagates the FusedForward_cpu pass to the inputs of the
+   *        unrolled net and accumulates the gradients of the parameters.
+   */
+  virtual void FusedBackward_cpu(const vector<bool>& propagate_down) {
+    NOT_IMPLEMENTED;
+  }
+
+  /// @brief Implements Step with the fused kernels.
+  virtual void FusedStep_cpu(int T, int num, const Dtype* x,
+      const vector<Dtype*>& states, Dtype* y) {
+    NOT_IMPLEMENTED;
+  }
+
+  /**
+   * @brief Packs the batch for the fused pass from the sequence continuation
+   *        indicators.  With variable_length, a stream ends at its first
+   *        negative indicator; the streams are ordered by decreasing length,
+   *        so that the batch_sizes_[t] streams active at timestep t are the
+   *        first ones, and the rows of the active streams of all timesteps
+   *        are packed one after the other.  Otherwise, or when no stream
+   *        ends early, the packed rows are the rows of the batch.
+   */
+  void PackBatch();
+  /// @brief Copies the rows of a (T x N x dim) array in packed order.
+  void PackRows(const Dtype* rows, int dim, Dtype* packed) const;
+  /// @brief Copies packed rows back to a (T x N x dim) array, with zeros for
+  ///        the padding.
+  void UnpackRows(const Dtype* packed, int dim, Dtype* rows) const;
+  /// @brief The packed rows of the input x, packed by PackBatch.
+  const Dtype* packed_input() const;
+  /// @brief The i-th recurrent input, with its streams in packed order.
+  const Dtype* PackedRecurrentInput(int i);
+  /**
+   * @brief Masks the packed previous states of the streams active at
+   *        timestep t by their continuation indicators, in one pass over the
+   *        timestep: conted := cont_t * rows.  The streams that continue,
+   *        usually all of them, are copied at once.
+   */
+  void ContRows(int t, int dim, const Dtype* rows, Dtype* conted) const;
+  /**
+   * @brief Sets the i-th recurrent output to the state of each stream after
+   *        its last timestep, from the packed rows of the states of all
+   *        timesteps, or to its recurrent input if it had no timestep.
+   */
+  void UnpackRecurrentOutput(int i, const Dtype* packed);
+
   /**
    * @param bottom input Blob vector (length 2-3)
    *
@@ -117,7 +199,10 @@ class RecurrentLayer : public Layer<Dtype> {
    *      a value of @f$ \delta_{t,n} = 1 @f$ means that timestep @f$ t @f$ of
    *      stream @f$ n @f$ is a continuation from the previous timestep
    *      @f$ t-1 @f$, and the previous hidden state @f$ h_{t-1} @f$ affects the
-   *      updated hidden state and output.
+   *      updated hidden state and output.  With
+   *      <code>recurrent_param.variable_length</code>, a negative indicator
+   *      marks padding past the end of the sequence of stream @f$ n @f$,
+   *      which is skipped.
    *
    *   -# @f$ (N \times ...) @f$ (optional)
    *      the static (non-time-varying) input @f$ x_{static} @f$.
@@ -150,6 +235,28 @@ class RecurrentLayer : public Layer<Dtype> {
   /// @brief A Net to implement the Recurrent functionality.
   shared_ptr<Net<Dtype> > unrolled_net_;
 
+  /**
+   * @brief Whether the CPU passes run FusedForward_cpu and FusedBackward_cpu
+   *        rather than the unrolled net, which then only holds the
+   *        parameters and serves the GPU. With variable_length_, the GPU
+   *        passes run the fused ones as well.
+   */
+  bool fused_;
+
+  /// @brief Whether streams may end before the last timestep.
+  bool variable_length_;
+  /// @brief Whether the batch has padding, and so is packed.
+  bool packed_;
+  /// @brief The streams by decreasing length, and their lengths.
+  vector<int> order_;
+  vector<int> lengths_;
+  /// @brief The number of active streams at each timestep, and the first
+  ///        packed row of each timestep (and the number of rows, last).
+  vector<int> batch_sizes_;
+  vector<int> batch_offsets_;
+  Blob<Dtype> packed_input_;
+  vector<shared_ptr<Blob<Dtype> > > packed_recur_inputs_;
+
   /// @brief The number of independent streams to process simultaneously.
   int N_;
 
@@ -0,0 +1,49 @@
+#ifndef CAFFE_REORDER_LAYER_HPP_
+#define CAFFE_REORDER_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Converts the input Blob to another memory layout (see
+ *        Blob::layout), keeping its shape.
+ *
+ * Net inserts these between the layers that run in NetParameter.layout and
+ * those that take NCHW. A bottom that cannot take the layout is converted
+ * to NCHW instead.
+ */
+template <typename Dtype>
+class ReorderLayer : public Layer<Dtype> {
+ public:
+  explicit ReorderLayer(const LayerParameter& param)
+      : Layer<Dtype>(param) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "Reorder"; }
+  virtual inline int ExactNumBottomBlobs() const { return 1; }
+  virtual inline int ExactNumTopBlobs() const { return 1; }
+
+ protected:
+  /**
+   * @param bottom input Blob vector (length 1)
+   *   -# @f$ (N \times C \times H \times W) @f$
+   *      the inputs, in any layout
+   * @param top output Blob vector (length 1)
+   *   -# @f$ (N \times C \times H \times W) @f$
+   *      the same values, in ReorderParameter.layout where they fit it
+   */
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_REORDER_LAYER_HPP_
@@ -25,12 +25,19 @@ template <typename Dtype> class RecurrentLayer;
  * @f$, and outputs @f$
  *     o_t := \tanh[ W_{ho} h_t + b_o ]
  * @f$.
+ *
+ * On the CPU the recurrence runs natively unless recurrent_param.fused is
+ * false: the input and output projections of all timesteps are each a single
+ * GEMM, leaving one GEMM of the hidden state per timestep. The unrolled net
+ * still holds the parameters.
  */
 template <typename Dtype>
 class RNNLayer : public RecurrentLayer<Dtype> {
  public:
   explicit RNNLayer(const LayerParameter& param)
       : RecurrentLayer<Dtype>(param) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "RNN"; }
 
@@ -40,6 +47,28 @@ class RNNLayer : public RecurrentLayer<Dtype> {
   virtual void RecurrentOutputBlobNames(vector<string>* names) const;
   virtual void RecurrentInputShapes(vector<BlobShape>* shapes) const;
   virtual void OutputBlobNames(vector<string>* names) const;
+
+  virtual inline bool HasFusedImplementation() const { return true; }
+  virtual void FusedForward_cpu();
+  virtual void FusedBackward_cpu(const vector<bool>& propagate_down);
+  virtual void FusedStep_cpu(int T, int num, const Dtype* x,
+      const vector<Dtype*>& states, Dtype* y);
+
+  /// @brief The hidden states h_t of all timesteps, and in the diff the
+  ///        gradient of their inputs.
+  Blob<Dtype> hidden_;
+  /// @brief The previous hidden states as multiplied by cont_t.
+  Blob<Dtype> hidden_conted_;
+  /// @brief The outputs o_t of all timesteps, and in the diff the gradient of
+  ///        their inputs.
+  Blob<Dtype> output_;
+  /// @brief The projection of the static input, and its gradient.
+  Blob<Dtype> static_hidden_;
+  /// @brief The gradient of the previous hidden state of a timestep.
+  Blob<Dtype> hidden_prev_diff_;
+  Blob<Dtype> bias_multiplier_;
+  /// @brief The hidden states of Step.
+  Blob<Dtype> step_hidden_;
 };
 
 }  // namespace caffe
@@ -111,6 +111,11 @@ class SoftmaxWithLossLayer : public LossLayer<Dtype> {
   shared_ptr<Layer<Dtype> > softmax_layer_;
   /// prob stores the output probability predictions from the SoftmaxLayer.
   Blob<Dtype> prob_;
+  /// Whether Forward_cpu computed prob_, which it skips if no Backward needs
+  /// it.
+  bool prob_computed_;
+  /// log_norm stores the log of the softmax normalizer of each position.
+  Blob<Dtype> log_norm_;
   /// bottom vector holder used in call to the underlying SoftmaxLayer::Forward
   vector<Blob<Dtype>*> softmax_bottom_vec_;
   /// top vector holder used in call to the underlying SoftmaxLayer::Forward
@@ -0,0 +1,66 @@
+#ifndef CAFFE_MEMORY_REPORT_HPP_
+#define CAFFE_MEMORY_REPORT_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+
+namespace caffe {
+
+/**
+ * @brief The memory of a Net as accounted by the MemoryTracker, broken down
+ *        by layer and by blob.
+ *
+ * The bytes of a layer are split into its params, the activations of its
+ * tops (data and diff, on host and device), and the scratch buffers it keeps
+ * to itself (col_buffer_, max_idx_ and the like), which are the allocations
+ * made in its scope that belong to no blob of the net, the shapes of blobs
+ * included. A memory shared by several blobs, as by in-place layers, Split
+ * and shared params, is counted once, for the first. The peak of a layer is
+ * the most bytes allocated in its scope that were live at once.
+ *
+ * Only what was allocated while tracking was on is seen, so turn it on with
+ * MemoryTracker::set_enabled before creating the net, and take the report
+ * after its passes.
+ */
+template <typename Dtype>
+class MemoryReport {
+ public:
+  struct LayerMemory {
+    string name, type;
+    size_t params, activations, scratch, peak;
+    int allocations;
+    size_t total() const { return params + activations + scratch; }
+  };
+  struct BlobMemory {
+    string name;
+    size_t bytes;
+  };
+
+  /// @brief Take the report of the memory the net holds now.
+  explicit MemoryReport(const Net<Dtype>& net);
+
+  /// @brief The layers, the largest first.
+  inline const vector<LayerMemory>& layers() const { return layers_; }
+  /// @brief The blobs and params, named as <tt>layer[i]</tt>, the largest
+  ///        first.
+  inline const vector<BlobMemory>& blobs() const { return blobs_; }
+  inline size_t params() const { return params_; }
+  inline size_t activations() const { return activations_; }
+  inline size_t scratch() const { return scratch_; }
+
+  /// @brief The report as a table, of the layers then of the blobs.
+  string Text() const;
+
+ protected:
+  vector<LayerMemory> layers_;
+  vector<BlobMemory> blobs_;
+  size_t params_, activations_, scratch_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_MEMORY_REPORT_HPP_
@@ -0,0 +1,74 @@
+#ifndef CAFFE_MIXED_PRECISION_HPP_
+#define CAFFE_MIXED_PRECISION_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/solver.hpp"
+
+namespace caffe {
+
+/**
+ * @brief bfloat16 mixed-precision training of a Net with full-precision
+ *        master weights and dynamic loss scaling.
+ *
+ * Used by the SGD-family solvers when SolverParameter.mixed_precision is set.
+ * Before each forward/backward pass the learnable params are saved as master
+ * weights and rounded to bfloat16. The outputs of layers that take part in
+ * the backward pass are rounded after Forward, and the gradients they
+ * propagate to their bottoms after Backward. The loss gradient is multiplied
+ * by loss_scale() (see Net::set_loss_gradient_scale) so that small gradients
+ * survive the rounding. After the pass
+ * the master weights are restored; the param gradients accumulate in Dtype and
+ * the solver applies them, unscaled, to the master weights.
+ *
+ * Blobs keep their Dtype storage, as Blob and the math routines have no 16-bit
+ * type: this reproduces the numerics of bfloat16 training on the CPU, not its
+ * memory savings.
+ */
+template <typename Dtype>
+class MixedPrecision : public Solver<Dtype>::Callback {
+ public:
+  MixedPrecision(const SolverParameter& param,
+      const shared_ptr<Net<Dtype> >& net);
+
+  inline Dtype loss_scale() const { return loss_scale_; }
+  /**
+   * @brief Divide the param gradients of the finished pass by the loss scale,
+   *        and adapt the loss scale.
+   *
+   * Returns false, leaving the gradients untouched, if any of them overflowed
+   * to inf or NaN; the update of the iteration must then be skipped.
+   */
+  bool UnscaleGradients();
+
+ protected:
+  virtual void on_start();
+  virtual void on_gradients_ready();
+
+  // Rounds the outputs of a layer.
+  void AfterForward(int layer_id);
+  // Rounds the bottom gradients of a layer.
+  void AfterBackward(int layer_id);
+
+  // Forwards a Net callback to one of the hooks above.
+  typedef typename Net<Dtype>::template MemberCallback<MixedPrecision> LayerHook;
+
+  shared_ptr<Net<Dtype> > net_;
+  Dtype loss_scale_;
+  // The loss gradient scale of the net outside of mixed-precision passes.
+  Dtype base_gradient_scale_;
+  const int loss_scale_window_;
+  int iters_since_overflow_;
+  vector<shared_ptr<Blob<Dtype> > > master_params_;
+  LayerHook after_forward_, after_backward_;
+
+  DISABLE_COPY_AND_ASSIGN(MixedPrecision);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_MIXED_PRECISION_HPP_
@@ -14,6 +14,8 @@
 
 namespace caffe {
 
+class ChunkStore;
+
 /**
  * @brief Connects Layer%s together into a directed acyclic graph (DAG)
  *        specified by a NetParameter.
@@ -27,12 +29,18 @@ class Net {
   explicit Net(const NetParameter& param);
   explicit Net(const string& param_file, Phase phase,
       const int level = 0, const vector<string>* stages = NULL);
+  /**
+   * @brief Builds a net whose layers use the parameter blobs of the
+   *        same-named layers of weights, which must outlive it, instead of
+   *        allocating and filling their own. See InferenceEngine.
+   */
+  Net(const NetParameter& param, const Net* weights);
   // 析构函数     
   virtual ~Net() {}
 
   /// @brief Initialize a network with a NetParameter.
   // 初始化网络
-  void Init(const NetParameter& param);
+  void Init(const NetParameter& param, const Net* weights = NULL);
 
   /**
    * @brief Run Forward and return the result.
@@ -109,12 +117,27 @@ class Net {
    */
   // 权值共享 
   void ShareWeights();
+  /**
+   * @brief Has the learnable params that every layer using them reports as
+   *        Layer::RowSparseParamGradient track the rows their gradient
+   *        touches (Blob::set_row_sparse_diff), so that ClearParamDiffs and
+   *        Update only visit those rows on the CPU.
+   *
+   * Note: this is called by solvers with sparse_update, which keep the other
+   * rows of the diffs zero.
+   */
+  void EnableRowSparseParams();
 
   /**
    * @brief For an already initialized net, implicitly copies (i.e., using no
    *        additional memory) the pre-trained layers from another Net.
    */
   void ShareTrainedLayersWith(const Net* other);
+  /**
+   * @brief For an already initialized net, explicitly copies the pre-trained
+   *        layers from another Net into its own parameter memory.
+   */
+  void CopyTrainedLayersFrom(const Net* other);
   // For an already initialized net, CopyTrainedLayersFrom() copies the already
   // trained layers from another net parameter instance.
   /**
@@ -125,12 +148,19 @@ class Net {
   void CopyTrainedLayersFrom(const string& trained_filename);
   void CopyTrainedLayersFromBinaryProto(const string& trained_filename);
   void CopyTrainedLayersFromHDF5(const string& trained_filename);
+  /// @brief Copies the layers from a ChunkedNetProto manifest (see ToChunks).
+  void CopyTrainedLayersFromChunks(const string& manifest_filename);
   /// @brief Writes the net to a proto.
   // 输出Net参数到NetParameter
   void ToProto(NetParameter* param, bool write_diff = false) const;
   /// @brief Writes the net to an HDF5 file.
   // 输出Net参数到HDF5文件
   void ToHDF5(const string& filename, bool write_diff = false) const;
+  /**
+   * @brief Writes the learned parameters to store, only adding the chunks
+   *        that store does not have yet, and describes them in manifest.
+   */
+  void ToChunks(ChunkStore* store, ChunkedNetProto* manifest) const;
 
   /// @brief returns the network name.
   // 获取 网络名
@@ -238,6 +268,18 @@ class Net {
   const shared_ptr<Layer<Dtype> > layer_by_name(const string& layer_name) const;
   //是否显示debug信息
   void set_debug_info(const bool value) { debug_info_ = value; }
+  /**
+   * @brief Scale the gradient that Backward propagates from the losses.
+   *
+   * The param gradients accumulated by Backward are multiplied by scale, as if
+   * every loss_weight were; the losses computed by Forward are unaffected.
+   * Solvers use this to normalize gradients accumulated over iter_size
+   * passes, and to scale the loss for mixed-precision training.
+   */
+  void set_loss_gradient_scale(const Dtype scale) {
+    loss_gradient_scale_ = scale;
+  }
+  Dtype loss_gradient_scale() const { return loss_gradient_scale_; }
 
   // Helpers for Init.
   /**
@@ -259,6 +301,18 @@ class Net {
     template <typename T>
     friend class Net;
   };
+  /// @brief A Callback calling a member function of owner, as the layer
+  ///        hooks of Profiler and MixedPrecision do.
+  template <typename T>
+  class MemberCallback : public Callback {
+   public:
+    MemberCallback(T* owner, void (T::*hook)(int))
+        : owner_(owner), hook_(hook) {}
+   protected:
+    virtual void run(int layer) { (owner_->*hook_)(layer); }
+    T* owner_;
+    void (T::*hook_)(int);
+  };
   const vector<Callback*>& before_forward() const { return before_forward_; }
   void add_before_forward(Callback* value) {
     before_forward_.push_back(value);
@@ -299,6 +353,9 @@ class Net {
   void BackwardDebugInfo(const int layer_id);
   /// @brief Helper for displaying debug info in Update.
   void UpdateDebugInfo(const int param_id);
+  /// @brief Helper for Backward: set the loss gradients of a layer's tops to
+  ///        their loss weights times scale.
+  void SetLossGradients(const int layer_id, const Dtype scale);
 
   /// @brief The network name
   // Net名称
@@ -371,6 +428,10 @@ class Net {
   size_t memory_used_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
+  /// @brief Whether Init logs the construction of the net.
+  bool log_setup_;
+  /// The factor applied to the loss gradients in Backward.
+  Dtype loss_gradient_scale_;
   // Callbacks
   vector<Callback*> before_forward_;
   vector<Callback*> after_forward_;
@@ -0,0 +1,163 @@
+#ifndef CAFFE_PROFILER_HPP_
+#define CAFFE_PROFILER_HPP_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/perf_event.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Per-layer profile of the passes of a Net, attached through its
+ *        before/after forward and backward callbacks.
+ *
+ * Every layer invocation is recorded as an event with its wall time and the
+ * analytic FLOPs and bytes of the layer at its current shapes (see
+ * ForwardFlops and ForwardBytes). In GPU mode the device is synchronized
+ * around each layer so that the wall time is that of the layer's kernels;
+ * this serializes the passes, so profile apart from throughput runs. After
+ * each pass the memory held by the blobs and params of the net is sampled,
+ * and its high-water mark kept. The scratch buffers layers keep to
+ * themselves (col_buffer_ and the like) are not seen.
+ *
+ * In builds with USE_PERF_EVENT the cycles, instructions and last-level
+ * cache misses of each layer are counted too (see HardwareCounters), giving
+ * its IPC and the DRAM traffic of its misses. Given the peaks of the machine
+ * (set_peak_gflops and set_peak_bandwidth), each layer is then placed on the
+ * roofline: memory-bound if its arithmetic intensity, FLOPs per byte of DRAM
+ * traffic (or per analytic byte, without counters), is below the ridge
+ * point peak_gflops / peak_bandwidth, and compute-bound otherwise.
+ *
+ * The events export as a Chrome trace (chrome://tracing, Perfetto) and the
+ * per-layer totals as CSV, where the achieved GFLOP/s of each layer is also
+ * given as a fraction of the machine peak.
+ *
+ * A net keeps the callbacks it is given, so the profiler must outlive the
+ * passes of its net.
+ */
+template <typename Dtype>
+class Profiler {
+ public:
+  explicit Profiler(Net<Dtype>* net);
+
+  /// @brief Totals of the forward or backward calls of a layer.
+  struct PassStats {
+    PassStats();
+    void Add(const PassStats& other);
+
+    int calls;
+    double us, flops, bytes;
+    // Zero without hardware counters.
+    double cycles, instructions, llc_misses;
+  };
+  /// @brief Totals of one layer over the recorded passes.
+  struct LayerStats {
+    PassStats forward, backward;
+  };
+
+  /// @brief Drop the events and totals recorded so far.
+  void Reset();
+  /// @brief Pause or resume recording; the callbacks stay attached.
+  inline void set_enabled(bool enabled) { enabled_ = enabled; }
+  inline bool enabled() const { return enabled_; }
+  /// @brief The peak GFLOP/s of the machine, against which the achieved
+  ///        rate of each layer is reported; 0 if unknown.
+  inline void set_peak_gflops(double peak) { peak_gflops_ = peak; }
+  inline double peak_gflops() const { return peak_gflops_; }
+  /// @brief The peak DRAM bandwidth of the machine in GB/s; 0 if unknown.
+  inline void set_peak_bandwidth(double peak) { peak_bandwidth_ = peak; }
+  inline double peak_bandwidth() const { return peak_bandwidth_; }
+
+  inline const vector<LayerStats>& stats() const { return stats_; }
+  /// @brief The most bytes held by the blobs and params of the net at the
+  ///        end of a recorded pass.
+  inline size_t peak_memory() const { return peak_memory_; }
+  /// @brief Whether the recorded calls carry hardware counts.
+  inline bool hardware_counters() const {
+    return counters_ && counters_->available();
+  }
+
+  /**
+   * @brief The analytic number of floating-point operations of a forward
+   *        pass of the layer, counting a multiply-add as two.
+   *
+   * Convolution, Deconvolution and InnerProduct count their products and
+   * bias; Pooling counts a window of inputs per output; LRN, softmax and the
+   * losses count a few operations per element; other layers that compute
+   * count one per output element. Layers that only move data (Input, Data,
+   * Split, Concat, Slice, Reshape and the like) count none. The backward pass
+   * is counted as twice the forward, for gradients of the inputs and of the
+   * params.
+   */
+  static double ForwardFlops(const Layer<Dtype>& layer,
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top);
+  /// @brief The bytes a forward pass of the layer reads and writes at least:
+  ///        its bottoms, tops and params, each once.
+  static double ForwardBytes(const Layer<Dtype>& layer,
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top);
+
+  /// @brief FLOPs per byte of DRAM traffic, as measured by the LLC misses
+  ///        with hardware counters, else per analytic byte.
+  double ArithmeticIntensity(const PassStats& stats) const;
+  /// @brief "memory" or "compute", the roofline bound of the calls; empty
+  ///        without both peaks of the machine, or for calls without FLOPs.
+  string Bound(const PassStats& stats) const;
+
+  /// @brief Log the per-layer totals and those of each layer type.
+  void LogSummary() const;
+  /// @brief Write the events in the Chrome trace_event JSON format.
+  void WriteChromeTrace(const string& filename) const;
+  /// @brief Write the per-layer totals as CSV, a row per layer and pass.
+  void WriteCSV(const string& filename) const;
+
+ protected:
+  struct Event {
+    int layer;
+    bool backward;
+    double start_us;
+    // The totals of this single call.
+    PassStats stats;
+  };
+
+  void BeforeLayer(int layer_id);
+  void AfterForward(int layer_id);
+  void AfterBackward(int layer_id);
+  // Records the event of the layer that just ran.
+  void Record(int layer_id, bool backward);
+  // Samples the memory held by the net at the end of a pass.
+  void SampleMemory();
+  // Microseconds since the profiler was created or reset.
+  double Now() const;
+
+  // Forwards a Net callback to one of the hooks above.
+  typedef typename Net<Dtype>::template MemberCallback<Profiler> LayerHook;
+
+  Net<Dtype>* net_;
+  bool enabled_;
+  double peak_gflops_, peak_bandwidth_;
+  // The wall clock of Now() is relative to, in microseconds since the epoch.
+  double origin_us_;
+  double start_us_;
+  // Opened on the first recorded call, as the counters count the thread
+  // that opens them.
+  shared_ptr<HardwareCounters> counters_;
+  vector<Event> events_;
+  vector<LayerStats> stats_;
+  // Memory samples, as (time, bytes), and their maximum.
+  vector<std::pair<double, size_t> > memory_;
+  size_t peak_memory_;
+  LayerHook before_forward_, after_forward_;
+  LayerHook before_backward_, after_backward_;
+
+  DISABLE_COPY_AND_ASSIGN(Profiler);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_PROFILER_HPP_
@@ -0,0 +1,79 @@
+#ifndef CAFFE_RECURRENT_SESSION_HPP_
+#define CAFFE_RECURRENT_SESSION_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/layers/recurrent_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Runs a trained LSTMLayer or RNNLayer a few timesteps at a time over
+ *        many independent streams, such as the utterances of a speech
+ *        recognizer, keeping the recurrent state of each stream between calls.
+ *
+ * A stream is opened with a zero state, which begins a sequence, and keeps
+ * its state until it is reset or closed; the ids of closed streams are
+ * reused. Step advances any open streams together, in one batch, by one or
+ * more timesteps: their states are gathered into the batch (in place when the
+ * streams are consecutive ids, in order) and run through RecurrentLayer::Step,
+ * which uses the fused kernels and the weights of the layer directly, with no
+ * reshape of the layer and no unrolled net.
+ *
+ * The session shares the layer, which must be set up, as by its Net. It runs
+ * on the CPU. Step uses scratch of the layer, so the sessions of a layer must
+ * be used by one thread at a time.
+ */
+template <typename Dtype>
+class RecurrentSession {
+ public:
+  explicit RecurrentSession(const shared_ptr<Layer<Dtype> >& layer);
+
+  /// @brief Opens a stream with a zero state, and returns its id.
+  int Open();
+  void Close(int stream);
+  /// @brief Zeroes the state of a stream, to begin a new sequence.
+  void Reset(int stream);
+
+  /**
+   * @brief Advances streams by T timesteps.
+   *
+   * @param streams the ids of open streams, each at most once
+   * @param x the input, @f$ (T \times streams.size() \times input\_dim) @f$
+   * @param y the output, @f$ (T \times streams.size() \times num\_output) @f$
+   */
+  void Step(const vector<int>& streams, int T, const Dtype* x, Dtype* y);
+  /// @brief Step with the input and output in blobs, y reshaped to the output.
+  void Step(const vector<int>& streams, const Blob<Dtype>& x, Blob<Dtype>* y);
+
+  /// @brief The i-th recurrent state of a stream (h, then c for an LSTM).
+  const Dtype* state(int stream, int i) const;
+  inline int num_open() const { return num_open_; }
+  inline int num_states() const { return layer_->num_states(); }
+  inline int input_dim() const { return layer_->input_dim(); }
+  inline int num_output() const { return num_output_; }
+
+ protected:
+  inline bool is_open(int stream) const {
+    return stream >= 0 && stream < open_.size() && open_[stream];
+  }
+
+  shared_ptr<RecurrentLayer<Dtype> > layer_;
+  int num_output_;
+  /// The states of all streams, open or not, as one array per recurrent state.
+  vector<vector<Dtype> > states_;
+  vector<bool> open_;
+  vector<int> closed_;
+  int num_open_;
+  /// The states gathered for Step.
+  vector<vector<Dtype> > batch_states_;
+
+  DISABLE_COPY_AND_ASSIGN(RecurrentSession);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_RECURRENT_SESSION_HPP_
@@ -0,0 +1,95 @@
+#ifndef CAFFE_REQUEST_BATCHER_HPP_
+#define CAFFE_REQUEST_BATCHER_HPP_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/inference_engine.hpp"
+#include "caffe/shape_bucket_cache.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Groups single-example requests into batches for an InferenceEngine
+ *        net with one input blob.
+ *
+ * Submit() queues the input of one example and returns a Future at once. A
+ * worker thread takes up to max_batch queued requests; once the oldest has
+ * waited max_delay_us it runs whatever has arrived instead of waiting for a
+ * full batch. A batch runs at the next power of two at or above its size,
+ * capped at max_batch, on the InferenceEngine::Context a ShapeBucketCache
+ * planned for that batch size, so no batch reshapes the net; unused rows are
+ * zeroed. Every output blob must have the batch as its first axis; each
+ * Future receives its row of each of them.
+ *
+ * Several batchers may share one engine to run batches concurrently.
+ */
+template <typename Dtype>
+class RequestBatcher {
+  /**
+   Move the thread and synchronization fields out instead of including
+   boost/thread.hpp to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+   */
+  class sync;
+
+ public:
+  /// @brief The result of a submitted request.
+  class Future {
+   public:
+    /// @brief Whether the request has run.
+    bool ready() const;
+    /**
+     * @brief Block until the request has run, and return its row of each
+     *        output blob of the net. They are empty if the batcher was
+     *        destroyed before running the request.
+     */
+    const vector<vector<Dtype> >& Get();
+
+   protected:
+    Future(const vector<Dtype>& input, const shared_ptr<sync>& sync);
+
+    vector<Dtype> input_;
+    vector<vector<Dtype> > outputs_;
+    bool ready_;
+    // Shared with the batcher, so that waiting outlives it.
+    shared_ptr<sync> sync_;
+
+    friend class RequestBatcher;
+    DISABLE_COPY_AND_ASSIGN(Future);
+  };
+
+  RequestBatcher(const InferenceEngine<Dtype>* engine, int max_batch,
+      int max_delay_us);
+  ~RequestBatcher();
+
+  /// @brief Queue one example, of input_dim() values, for the net.
+  shared_ptr<Future> Submit(const vector<Dtype>& input);
+
+  /// @brief The number of values of one example of the input blob.
+  inline int input_dim() const { return input_dim_; }
+  /// @brief The number of batches run so far.
+  int batches() const;
+  /// @brief The number of requests run so far.
+  int requests() const;
+
+ private:
+  void entry();
+  void RunBatch(const ShapeBucketCache<Dtype>& cache,
+      const vector<shared_ptr<Future> >& batch);
+  /// @brief The batch size the input blob is reshaped to for n requests.
+  int BucketSize(int n) const;
+
+  const InferenceEngine<Dtype>* engine_;
+  const int max_batch_;
+  const int max_delay_us_;
+  int input_dim_;
+  int batches_;
+  int requests_;
+  shared_ptr<sync> sync_;
+
+  DISABLE_COPY_AND_ASSIGN(RequestBatcher);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_REQUEST_BATCHER_HPP_
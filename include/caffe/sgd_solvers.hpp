@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 
+#include "caffe/mixed_precision.hpp"
 #include "caffe/solver.hpp"
 
 namespace caffe {
@@ -16,21 +17,55 @@ template <typename Dtype>
 class SGDSolver : public Solver<Dtype> {
  public:
   explicit SGDSolver(const SolverParameter& param)
-      : Solver<Dtype>(param) { PreSolve(); }
+      : Solver<Dtype>(param) { PreSolve(); CheckSparseUpdate(); }
   explicit SGDSolver(const string& param_file)
-      : Solver<Dtype>(param_file) { PreSolve(); }
+      : Solver<Dtype>(param_file) { PreSolve(); CheckSparseUpdate(); }
   virtual inline const char* type() const { return "SGD"; }
 
   const vector<shared_ptr<Blob<Dtype> > >& history() { return history_; }
+  // Set iff mixed_precision is enabled.
+  const shared_ptr<MixedPrecision<Dtype> >& mixed_precision() {
+    return mixed_precision_;
+  }
 
   virtual void ApplyUpdate();
   Dtype GetLearningRate();
 
  protected:
   void PreSolve();
-  virtual void Normalize(int param_id);
+  /**
+   * @deprecated The param diffs already hold the mean over iter_size, as Net
+   *             scales the loss gradients by 1 / iter_size in Backward (see
+   *             Net::set_loss_gradient_scale). Normalize does nothing, and is
+   *             only still called for each param before its update, for the
+   *             solvers that override it.
+   */
+  virtual void Normalize(int param_id) {}
   virtual void Regularize(int param_id);
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  /**
+   * @brief With sparse_update, the Regularize and ComputeUpdateValue of a
+   *        row-sparse param on the CPU, which only visit the rows its
+   *        gradient touched (Blob::diff_rows).
+   *
+   * Each solver overrides HasRowSparseUpdate to tell whether it has them;
+   * those that override ComputeUpdateValue override ComputeRowUpdateValue
+   * as well, or return false.
+   */
+  virtual void RegularizeRows(int param_id, Dtype rate);
+  virtual void ComputeRowUpdateValue(int param_id, Dtype rate);
+  virtual inline bool HasRowSparseUpdate() const { return true; }
+  // Fails at setup rather than at the first update if sparse_update is set
+  // for a solver without it. Each solver calls it as it is constructed, when
+  // HasRowSparseUpdate is its own.
+  void CheckSparseUpdate() const {
+    CHECK(!this->param_.sparse_update() || HasRowSparseUpdate())
+        << "The " << this->type() << " solver has no sparse_update.";
+  }
+  inline bool RowSparseUpdate(int param_id) const {
+    return Caffe::mode() == Caffe::CPU &&
+        this->net_->learnable_params()[param_id]->row_sparse_diff();
+  }
   virtual void ClipGradients();
   virtual void SnapshotSolverState(const string& model_filename);
   virtual void SnapshotSolverStateToBinaryProto(const string& model_filename);
@@ -42,6 +77,10 @@ class SGDSolver : public Solver<Dtype> {
   // temp maintains other information that might be needed in computation
   //   of gradients/updates and is not needed in snapshots
   vector<shared_ptr<Blob<Dtype> > > history_, update_, temp_;
+  shared_ptr<MixedPrecision<Dtype> > mixed_precision_;
+  // With sparse_update, the iteration each row of the row-sparse params was
+  // last updated at, from which their lazy weight decay is caught up.
+  vector<vector<int> > row_iters_;
 
   DISABLE_COPY_AND_ASSIGN(SGDSolver);
 };
@@ -50,13 +89,14 @@ template <typename Dtype>
 class NesterovSolver : public SGDSolver<Dtype> {
  public:
   explicit NesterovSolver(const SolverParameter& param)
-      : SGDSolver<Dtype>(param) {}
+      : SGDSolver<Dtype>(param) { this->CheckSparseUpdate(); }
   explicit NesterovSolver(const string& param_file)
-      : SGDSolver<Dtype>(param_file) {}
+      : SGDSolver<Dtype>(param_file) { this->CheckSparseUpdate(); }
   virtual inline const char* type() const { return "Nesterov"; }
 
  protected:
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual inline bool HasRowSparseUpdate() const { return false; }
 
   DISABLE_COPY_AND_ASSIGN(NesterovSolver);
 };
@@ -72,9 +112,12 @@ class AdaGradSolver : public SGDSolver<Dtype> {
 
  protected:
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void ComputeRowUpdateValue(int param_id, Dtype rate);
+  virtual inline bool HasRowSparseUpdate() const { return true; }
   void constructor_sanity_check() {
     CHECK_EQ(0, this->param_.momentum())
         << "Momentum cannot be used with AdaGrad.";
+    this->CheckSparseUpdate();
   }
 
   DISABLE_COPY_AND_ASSIGN(AdaGradSolver);
@@ -92,6 +135,7 @@ class RMSPropSolver : public SGDSolver<Dtype> {
 
  protected:
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual inline bool HasRowSparseUpdate() const { return false; }
   void constructor_sanity_check() {
     CHECK_EQ(0, this->param_.momentum())
         << "Momentum cannot be used with RMSProp.";
@@ -99,6 +143,7 @@ class RMSPropSolver : public SGDSolver<Dtype> {
         << "rms_decay should lie between 0 and 1.";
     CHECK_LT(this->param_.rms_decay(), 1)
         << "rms_decay should lie between 0 and 1.";
+    this->CheckSparseUpdate();
   }
 
   DISABLE_COPY_AND_ASSIGN(RMSPropSolver);
@@ -116,6 +161,7 @@ class AdaDeltaSolver : public SGDSolver<Dtype> {
  protected:
   void AdaDeltaPreSolve();
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual inline bool HasRowSparseUpdate() const { return false; }
 
   DISABLE_COPY_AND_ASSIGN(AdaDeltaSolver);
 };
@@ -140,10 +186,70 @@ class AdamSolver : public SGDSolver<Dtype> {
  protected:
   void AdamPreSolve();
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void ComputeRowUpdateValue(int param_id, Dtype rate);
+  virtual inline bool HasRowSparseUpdate() const { return true; }
 
   DISABLE_COPY_AND_ASSIGN(AdamSolver);
 };
 
+/**
+ * @brief LARSSolver, SGD with momentum and layer-wise adaptive rate scaling
+ *        for large-batch training, described in [1]. The learning rate of
+ *        each param blob is scaled by its trust ratio
+ *        lars_eta * ||w|| / ||dw||, where dw includes the weight decay.
+ *
+ * [1] Y. You, I. Gitman and B. Ginsburg, "Large Batch Training of
+ *     Convolutional Networks." arXiv preprint arXiv:1708.03888 (2017).
+ */
+template <typename Dtype>
+class LARSSolver : public SGDSolver<Dtype> {
+ public:
+  explicit LARSSolver(const SolverParameter& param)
+      : SGDSolver<Dtype>(param) { constructor_sanity_check(); }
+  explicit LARSSolver(const string& param_file)
+      : SGDSolver<Dtype>(param_file) { constructor_sanity_check(); }
+  virtual inline const char* type() const { return "LARS"; }
+
+ protected:
+  virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual inline bool HasRowSparseUpdate() const { return false; }
+  void constructor_sanity_check() {
+    CHECK_GT(this->param_.lars_eta(), 0) << "lars_eta must be positive.";
+    this->CheckSparseUpdate();
+  }
+
+  DISABLE_COPY_AND_ASSIGN(LARSSolver);
+};
+
+/**
+ * @brief LAMBSolver, the layer-wise adaptive large-batch variant of Adam
+ *        described in [1]. The Adam step of each param blob, plus the weight
+ *        decay (decoupled from the moments), is scaled by the trust ratio
+ *        ||w|| / ||step||.
+ *
+ * [1] Y. You, J. Li, S. Reddi et al., "Large Batch Optimization for Deep
+ *     Learning: Training BERT in 76 minutes." arXiv preprint
+ *     arXiv:1904.00962 (2019).
+ */
+template <typename Dtype>
+class LAMBSolver : public SGDSolver<Dtype> {
+ public:
+  explicit LAMBSolver(const SolverParameter& param)
+      : SGDSolver<Dtype>(param) { LAMBPreSolve(); }
+  explicit LAMBSolver(const string& param_file)
+      : SGDSolver<Dtype>(param_file) { LAMBPreSolve(); }
+  virtual inline const char* type() const { return "LAMB"; }
+
+ protected:
+  void LAMBPreSolve();
+  // The weight decay is part of the step computed by ComputeUpdateValue.
+  virtual void Regularize(int param_id) {}
+  virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual inline bool HasRowSparseUpdate() const { return false; }
+
+  DISABLE_COPY_AND_ASSIGN(LAMBSolver);
+};
+
 }  // namespace caffe
 
 #endif  // CAFFE_SGD_SOLVERS_HPP_
@@ -0,0 +1,57 @@
+#ifndef CAFFE_SHAPE_BUCKET_CACHE_HPP_
+#define CAFFE_SHAPE_BUCKET_CACHE_HPP_
+
+#include <map>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/inference_engine.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Contexts of an InferenceEngine planned ahead for a fixed set of
+ *        input shapes, so that switching between them never reshapes a net.
+ *
+ * Each bucket lists the shape of every input blob of the net. At
+ * construction every bucket gets its own Context, reshaped to the bucket and
+ * run once on zeroed inputs, so that its blobs and layer scratch (conv
+ * geometry, col_buffer_ and the like) are laid out and allocated. Running a
+ * given shape then takes a lookup of its context instead of Net::Reshape.
+ * The weights are shared; each bucket costs the memory of its activations.
+ */
+template <typename Dtype>
+class ShapeBucketCache {
+ public:
+  typedef typename InferenceEngine<Dtype>::Context Context;
+
+  ShapeBucketCache(const InferenceEngine<Dtype>* engine,
+      const vector<vector<vector<int> > >& buckets);
+
+  /// @brief The context of the bucket with exactly these input shapes, or
+  ///        NULL if there is none.
+  Context* Find(const vector<vector<int> >& shapes) const;
+  /// @brief Find() for a net with a single input.
+  Context* Find(const vector<int>& shape) const;
+  /**
+   * @brief The context of the smallest bucket, by input size, whose inputs
+   *        have the same number of axes as shapes and are at least as large
+   *        along every axis, or NULL if there is none. Inputs are then to be
+   *        padded to the bucket.
+   */
+  Context* Fit(const vector<vector<int> >& shapes) const;
+
+  inline int size() const { return contexts_.size(); }
+  inline Context* bucket(int i) const { return contexts_[i].get(); }
+
+ private:
+  vector<shared_ptr<Context> > contexts_;
+  vector<vector<vector<int> > > shapes_;
+  map<vector<vector<int> >, int> index_;
+
+  DISABLE_COPY_AND_ASSIGN(ShapeBucketCache);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_SHAPE_BUCKET_CACHE_HPP_
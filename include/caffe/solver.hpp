@@ -7,6 +7,8 @@
 #include "caffe/net.hpp"
 #include "caffe/solver_factory.hpp"
 #include "caffe/util/benchmark.hpp"
+#include "caffe/util/chunk_store.hpp"
+#include "caffe/util/snapshot_writer.hpp"
 
 namespace caffe {
 
@@ -65,7 +67,14 @@ class Solver {
   // that stores the learned net. You should implement the SnapshotSolverState()
   // function that produces a SolverState protocol buffer that needs to be
   // written to disk together with the learned net.
+  // With snapshot_async set, the learned net and solver state are staged in
+  // memory and written by a background thread; WaitForSnapshots() blocks
+  // until every staged snapshot has been written to disk.
   void Snapshot();
+  void WaitForSnapshots();
+  // With test_async set, TestAll() evaluates the test nets on a background
+  // thread; WaitForTests() blocks until that evaluation has been logged.
+  void WaitForTests();
   virtual ~Solver() {}
   inline const SolverParameter& param() const { return param_; }
   inline shared_ptr<Net<Dtype> > net() { return net_; }
@@ -101,9 +110,23 @@ class Solver {
   string SnapshotFilename(const string& extension);
   string SnapshotToBinaryProto();
   string SnapshotToHDF5();
+  string SnapshotToChunks();
+  // The content-addressed store of the CHUNKED snapshot format, shared by the
+  // learned net and the solver state.
+  ChunkStore* snapshot_chunk_store();
+  // Writes proto to filename, or stages it for the background snapshot writer
+  // when snapshot_async is set. The caller must not modify proto afterwards.
+  void WriteSnapshotProto(
+      const shared_ptr< ::google::protobuf::Message>& proto,
+      const string& filename);
   // The test routine
   void TestAll();
   void Test(const int test_net_id = 0);
+  // Runs test_iter forward passes of a test net with its current weights and
+  // logs the mean outputs. Client action requests are only honored if
+  // check_actions is set, as they may snapshot or stop the solver.
+  void EvaluateTestNet(const int test_net_id, const int iter,
+      const bool check_actions);
   virtual void SnapshotSolverState(const string& model_filename) = 0;
   virtual void RestoreSolverStateFromHDF5(const string& state_file) = 0;
   virtual void RestoreSolverStateFromBinaryProto(const string& state_file) = 0;
@@ -126,6 +149,16 @@ class Solver {
   // True iff a request to stop early was received.
   bool requested_early_exit_;
 
+  // Background writer for snapshot_async, and the files staged by the
+  // snapshot currently being taken.
+  shared_ptr<SnapshotWriter> snapshot_writer_;
+  vector<SnapshotWriter::File> staged_snapshot_;
+  shared_ptr<ChunkStore> snapshot_chunk_store_;
+
+  // Background evaluation of the test nets for test_async.
+  class AsyncTester;
+  shared_ptr<AsyncTester> async_tester_;
+
   // Timing information, handy to tune e.g. nbr of GPUs
   Timer iteration_timer_;
   float iterations_last_;
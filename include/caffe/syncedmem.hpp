@@ -1,6 +1,8 @@
 #ifndef CAFFE_SYNCEDMEM_HPP_
 #define CAFFE_SYNCEDMEM_HPP_
 
+#include <boost/function.hpp>
+
 #include <cstdlib>
 
 #ifdef USE_MKL
@@ -62,6 +64,13 @@ class SyncedMemory {
  public:
   SyncedMemory();
   explicit SyncedMemory(size_t size);
+  /**
+   * @brief Makes a view of size bytes of parent, from offset bytes: its data
+   *        is that of parent, with no memory or head of its own, until it is
+   *        set to other data.
+   */
+  SyncedMemory(const shared_ptr<SyncedMemory>& parent, size_t offset,
+      size_t size);
   ~SyncedMemory();
   const void* cpu_data();
   void set_cpu_data(void* data);
@@ -70,8 +79,28 @@ class SyncedMemory {
   void* mutable_cpu_data();
   void* mutable_gpu_data();
   enum SyncedHead { UNINITIALIZED, HEAD_AT_CPU, HEAD_AT_GPU, SYNCED };
-  SyncedHead head() const { return head_; }
+  SyncedHead head() const { return parent_ ? parent_->head() : head_; }
   size_t size() const { return size_; }
+  // Counts the mutable accesses and sets of the data, so that forms derived
+  // from it, such as the sparse weights of a layer, know to rebuild. Writes
+  // through a pointer taken by an earlier mutable access are not counted,
+  // as with a numpy array of a blob kept in pycaffe.
+  uint64_t version() const {
+    return parent_ ? parent_->version() : version_;
+  }
+  /**
+   * @brief Frees the data, which restore(ptr) writes back on its next use
+   *        instead of zeros, for data that is also held in a smaller form,
+   *        such as the weights of a sparse caffemodel.
+   *
+   * Pointers to the freed data become invalid.
+   */
+  void Release(const boost::function<void(void*)>& restore);
+  // The function that writes the released data, until it is written back.
+  const boost::function<void(void*)>& restore() const { return restore_; }
+  // The memory this is a view of, if any, and the offset in it in bytes.
+  const SyncedMemory* parent() const { return parent_.get(); }
+  size_t offset() const { return offset_; }
 
 #ifndef CPU_ONLY
   void async_gpu_push(const cudaStream_t& stream);
@@ -79,6 +108,10 @@ class SyncedMemory {
 
  private:
   void check_device();
+  // Makes a view memory of its own, as set_cpu_data and set_gpu_data do.
+  void Detach();
+  // Records an allocation with the MemoryTracker, when it is on.
+  void Track(bool gpu);
 
   void to_cpu();
   void to_gpu();
@@ -94,6 +127,12 @@ class SyncedMemory {
   bool cpu_malloc_use_cuda_;
   bool own_gpu_data_;
   int device_;
+  // Whether an allocation was recorded, to be released on free.
+  bool tracked_;
+  uint64_t version_;
+  boost::function<void(void*)> restore_;
+  shared_ptr<SyncedMemory> parent_;
+  size_t offset_;
 
   DISABLE_COPY_AND_ASSIGN(SyncedMemory);
 };  // class SyncedMemory
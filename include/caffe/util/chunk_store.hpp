@@ -0,0 +1,69 @@
+#ifndef CAFFE_UTIL_CHUNK_STORE_HPP_
+#define CAFFE_UTIL_CHUNK_STORE_HPP_
+
+#include <set>
+#include <string>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief A content-addressed store of Blob data in a directory.
+ *
+ * Put() splits the data of a Blob into chunks of at most chunk_bytes, names
+ * each chunk by a hash of its content and writes only the chunks that are not
+ * in the directory yet. Snapshots that share most of their parameters with an
+ * earlier snapshot -- frozen layers while fine-tuning, or weight-shared
+ * params -- therefore cost only the I/O of the chunks that changed. Chunks
+ * are written under a temporary name and renamed, so a chunk that exists is
+ * always complete. The directory is made when the first chunk is written.
+ *
+ * Chunks are never deleted: any number of manifests may refer to a chunk, and
+ * removing a snapshot does not remove its chunks, so the directory grows by
+ * the changed chunks of every snapshot. To reclaim the space, remove the
+ * directory along with all the snapshots that refer to it.
+ */
+class ChunkStore {
+ public:
+  explicit ChunkStore(const string& directory, int chunk_bytes = 1 << 20);
+
+  /// @brief Store the data of blob and describe its chunks in proto.
+  template <typename Dtype>
+  void Put(const Blob<Dtype>& blob, ChunkedBlobProto* proto);
+  /**
+   * @brief Load the data described by proto into blob, converting between
+   *        float and double if needed.
+   *
+   * @param reshape if false, require blob to already have the shape of proto
+   *        (and die otherwise); if true, Reshape blob to that shape.
+   */
+  template <typename Dtype>
+  void Get(const ChunkedBlobProto& proto, Blob<Dtype>* blob,
+      bool reshape = true);
+
+  inline const string& directory() const { return directory_; }
+  /// @brief The number of chunks written (not deduplicated) so far.
+  inline int chunks_written() const { return chunks_written_; }
+
+  /// @brief The key a chunk holding size bytes of data is stored under.
+  static string ChunkKey(const char* data, size_t size);
+
+ protected:
+  string ChunkPath(const string& key) const;
+  void WriteChunk(const string& key, const char* data, size_t size);
+
+  string directory_;
+  int chunk_bytes_;
+  // Chunks known to be present in directory_.
+  set<string> known_chunks_;
+  int chunks_written_;
+
+  DISABLE_COPY_AND_ASSIGN(ChunkStore);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_CHUNK_STORE_HPP_
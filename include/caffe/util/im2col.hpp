@@ -22,6 +22,18 @@ void col2im_nd_cpu(const Dtype* data_col, const int num_spatial_axes,
     const int* kernel_shape, const int* pad, const int* stride,
     const int* dilation, Dtype* data_im);
 
+// Like im2col_cpu for an image stored with the channel block `block` (see
+// Blob::layout_block), but transposed: a row of the channels * kernel_h *
+// kernel_w values of each output position, ordered by channel block, kernel
+// row, kernel column, and channel in the block, so that each block of
+// channels is copied contiguously.
+template <typename Dtype>
+void im2row_blocked_cpu(const Dtype* data_im, const int channels,
+    const int block, const int height, const int width, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    Dtype* data_row);
+
 template <typename Dtype>
 void col2im_cpu(const Dtype* data_col, const int channels,
     const int height, const int width, const int kernel_h, const int kernel_w,
@@ -0,0 +1,27 @@
+#ifndef _CAFFE_UTIL_INSERT_REORDERS_HPP_
+#define _CAFFE_UTIL_INSERT_REORDERS_HPP_
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// Copy NetParameters with ReorderLayers added to run the layers that prefer
+// it in NetParameter.layout: Convolution, Pooling, BatchNorm and Scale. The
+// element-wise layers (ReLU, Eltwise, ...) take any layout; the others take
+// NCHW. Convolution takes its bottoms in the layout they have and is set to
+// write its top in NetParameter.layout (ConvolutionParameter.top_layout).
+// The blobs in another layout are renamed with its name as suffix, and the
+// outputs of the net are converted back to NCHW under their own names.
+void InsertReorders(const NetParameter& param, NetParameter* param_reorder);
+
+// Whether the layer has kernels for the layouts other than NCHW, and so is
+// run in NetParameter.layout.
+bool LayerPrefersLayout(const LayerParameter& layer_param);
+
+// Whether the layer computes each value from the one at its index only, so
+// that it can run in the layout of its bottoms, which must all have one.
+bool LayerTakesAnyLayout(const LayerParameter& layer_param);
+
+}  // namespace caffe
+
+#endif  // _CAFFE_UTIL_INSERT_REORDERS_HPP_
@@ -145,6 +145,46 @@ DEFINE_CAFFE_CPU_UNARY_FUNC(fabs, y[i] = std::fabs(x[i]))
 template <typename Dtype>
 void caffe_cpu_scale(const int n, const Dtype alpha, const Dtype *x, Dtype* y);
 
+// Rounds x in place to the nearest bfloat16 values (round half to even),
+// keeping Dtype storage. Magnitudes beyond the bfloat16 range become inf.
+template <typename Dtype>
+void caffe_cpu_round_bf16(const int n, Dtype* x);
+
+// Computes y = softmax(x) over the channels of each of the outer_num x
+// inner_num positions of an (outer_num x channels x inner_num) array, and/or
+// the log of the normalizer of each position, lse = log(sum_c exp(x_c)), in
+// an (outer_num x inner_num) array. Either output may be NULL, and y may be
+// x. The positions are taken in blocks whose inputs stay in cache, so x is
+// read from memory once.
+template <typename Dtype>
+void caffe_cpu_softmax(const int outer_num, const int channels,
+    const int inner_num, const Dtype* x, Dtype* y, Dtype* lse);
+
+// Selects the k largest of the n values x[0], x[incx], ..., x[(n - 1) * incx]
+// into the first k elements of top, as (value, index) pairs in descending
+// order, with ties in descending order of index (as std::partial_sort with
+// std::greater would leave them). A min-heap of the k best so far selects
+// them in one pass for small k, and quickselect for large k. top is resized
+// as needed, so passing the same vector each call does not allocate.
+template <typename Dtype>
+void caffe_cpu_top_k(const int n, const Dtype* x, const int incx, const int k,
+    vector<std::pair<Dtype, int> >* top);
+
+// Copies the (num x channels x spatial) values of x, stored with the channel
+// block from_block (1 for NCHW, channels for NHWC; see Blob::layout_block),
+// into y stored with the block to_block. y may not be x.
+template <typename Dtype>
+void caffe_cpu_reorder(const int num, const int channels, const int spatial,
+    const int from_block, const int to_block, const Dtype* x, Dtype* y);
+
+// Computes y = scale[c] * x + shift[c] over the (num x channels x spatial)
+// values of x stored with the channel block `block`. shift may be NULL, and
+// y may be x.
+template <typename Dtype>
+void caffe_cpu_scale_channels(const int num, const int channels,
+    const int spatial, const int block, const Dtype* scale,
+    const Dtype* shift, const Dtype* x, Dtype* y);
+
 #ifndef CPU_ONLY  // GPU
 
 // Decaf gpu gemm provides an interface that is almost the same as the cpu
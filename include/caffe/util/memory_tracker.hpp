@@ -0,0 +1,78 @@
+#ifndef CAFFE_UTIL_MEMORY_TRACKER_HPP_
+#define CAFFE_UTIL_MEMORY_TRACKER_HPP_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+class SyncedMemory;
+
+/**
+ * @brief Accounts the host and device memory SyncedMemory allocates, and
+ *        attributes it to the owner in scope when it is allocated.
+ *
+ * Tracking is off by default. Once turned on, every allocation is recorded
+ * with the owner of the innermost Scope of the allocating thread, which Net
+ * sets to the layer it sets up, reshapes or runs; allocations outside of any
+ * scope have a NULL owner. Since blobs allocate lazily, the tops of a layer
+ * are usually attributed to it, and their diffs to the layer whose backward
+ * pass writes them first. An allocation is released with its SyncedMemory,
+ * so the reallocations of a growing Reshape show as frees and allocations.
+ *
+ * Memory that is not allocated by SyncedMemory (cuDNN workspaces, BLAS
+ * buffers) is not seen. See MemoryReport for the breakdown of a Net.
+ */
+class MemoryTracker {
+ public:
+  /// @brief Bytes of the live allocations of an owner, the most there were
+  ///        since ResetPeaks, and the allocations made.
+  struct Usage {
+    Usage() : current(0), peak(0), allocations(0) {}
+    size_t current, peak;
+    int allocations;
+  };
+  /// @brief A live allocation of a SyncedMemory, on the host or device.
+  struct Allocation {
+    const SyncedMemory* memory;
+    bool gpu;
+    size_t bytes;
+    const void* owner;
+  };
+
+  static void set_enabled(bool enabled);
+  inline static bool enabled() { return enabled_; }
+
+  // Called by SyncedMemory.
+  static void Allocate(const SyncedMemory* memory, size_t bytes, bool gpu);
+  static void Free(const SyncedMemory* memory, bool gpu);
+
+  static Usage usage(const void* owner);
+  /// @brief The usage of all owners together.
+  static Usage total();
+  static vector<Allocation> allocations();
+  /// @brief Restart the peaks from the current usage, and the allocation
+  ///        counts from zero.
+  static void ResetPeaks();
+
+  /// @brief Attributes the allocations of the thread to an owner while in
+  ///        scope; scopes nest. Does nothing while tracking is off.
+  class Scope {
+   public:
+    explicit Scope(const void* owner);
+    ~Scope();
+   private:
+    bool active_;
+    const void* previous_;
+
+    DISABLE_COPY_AND_ASSIGN(Scope);
+  };
+
+ private:
+  static bool enabled_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_MEMORY_TRACKER_HPP_
@@ -0,0 +1,161 @@
+#ifndef CAFFE_UTIL_METRICS_HPP_
+#define CAFFE_UTIL_METRICS_HPP_
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/internal_thread.hpp"
+
+/**
+ Forward declare boost::mutex instead of including boost/thread.hpp
+ to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+ */
+namespace boost { class mutex; }
+
+namespace caffe {
+
+/**
+ * @brief A process-wide registry of counters, gauges and histograms,
+ *        exported in the Prometheus text format.
+ *
+ * A metric is identified by its name and labels, the latter given already
+ * formatted, as in <tt>layer="data"</tt> (see Label). The metrics are
+ * created on first use and live as long as the process, so the pointers
+ * returned may be kept; updating them is thread-safe.
+ *
+ * The solver and the prefetching data layers record:
+ *  - caffe_iterations_total, caffe_examples_total and
+ *    caffe_examples_per_second, of the root solver (times the solver count
+ *    for the examples);
+ *  - caffe_iteration_seconds, and its phases caffe_forward_seconds,
+ *    caffe_backward_seconds and caffe_update_seconds, as histograms;
+ *  - caffe_data_wait_seconds and caffe_prefetch_queue_depth, by layer, the
+ *    time the data layer waited for a batch and the prefetched batches left;
+ *  - caffe_snapshot_seconds.
+ * In GPU mode the phases are wall times on the host, so kernels are counted
+ * in the phase that waits for them.
+ */
+class Metrics {
+ public:
+  class Counter {
+   public:
+    void Increment(double value = 1);
+    double value() const;
+   private:
+    friend class Metrics;
+    explicit Counter(boost::mutex* mutex) : mutex_(mutex), value_(0) {}
+    boost::mutex* mutex_;
+    double value_;
+  };
+
+  class Gauge {
+   public:
+    void Set(double value);
+    double value() const;
+   private:
+    friend class Metrics;
+    explicit Gauge(boost::mutex* mutex) : mutex_(mutex), value_(0) {}
+    boost::mutex* mutex_;
+    double value_;
+  };
+
+  class Histogram {
+   public:
+    void Observe(double value);
+    int count() const;
+    double sum() const;
+   private:
+    friend class Metrics;
+    Histogram(boost::mutex* mutex, const vector<double>& bounds);
+    boost::mutex* mutex_;
+    // The upper bounds of the buckets, and the observations of each, the
+    // last bucket being that above every bound.
+    vector<double> bounds_;
+    vector<int> counts_;
+    double sum_;
+  };
+
+  /// @brief The registry of the process.
+  static Metrics& Get();
+  /// @brief A label of a metric, as name="value" with the value escaped.
+  static string Label(const string& name, const string& value);
+
+  Counter* counter(const string& name, const string& help,
+      const string& labels = "");
+  Gauge* gauge(const string& name, const string& help,
+      const string& labels = "");
+  /// @brief A histogram with the given bucket bounds, by default from a
+  ///        millisecond to a minute, for durations in seconds.
+  Histogram* histogram(const string& name, const string& help,
+      const string& labels = "",
+      const vector<double>& bounds = vector<double>());
+
+  /// @brief The metrics in the Prometheus text exposition format.
+  string Text() const;
+  /// @brief Write Text() to the file, replacing it at once so that readers,
+  ///        such as the textfile collector of node_exporter, see it whole.
+  void WriteTextFile(const string& filename) const;
+
+ private:
+  enum Type { COUNTER, GAUGE, HISTOGRAM };
+  struct Family {
+    Type type;
+    string help;
+    // By labels.
+    map<string, shared_ptr<Counter> > counters;
+    map<string, shared_ptr<Gauge> > gauges;
+    map<string, shared_ptr<Histogram> > histograms;
+  };
+
+  Metrics();
+  Family* family(const string& name, const string& help, Type type);
+
+  // Guards the families and, through the pointers the metrics keep, their
+  // values.
+  shared_ptr<boost::mutex> mutex_;
+  map<string, Family> families_;
+
+  DISABLE_COPY_AND_ASSIGN(Metrics);
+};
+
+/**
+ * @brief Exports the Metrics of the process from a thread of its own: serves
+ *        them over HTTP on a local port, and writes them to a file at an
+ *        interval, for the Prometheus scraper or the textfile collector of
+ *        node_exporter.
+ */
+class MetricsExporter : public InternalThread {
+ public:
+  /**
+   * @param port the TCP port to serve GET requests of any path on; 0 for one
+   *        chosen by the system, or -1 to serve none.
+   * @param filename the file to write the metrics to; empty to write none.
+   * @param interval the seconds between writes of the file.
+   * @param address the IPv4 address to bind the port to: the loopback
+   *        interface by default, or "0.0.0.0" for all interfaces.
+   */
+  MetricsExporter(int port, const string& filename, double interval,
+      const string& address = "127.0.0.1");
+  virtual ~MetricsExporter();
+
+  /// @brief The port served, or -1.
+  inline int port() const { return port_; }
+
+ protected:
+  virtual void InternalThreadEntry();
+  void Serve(int client);
+
+  int port_;
+  string filename_;
+  double interval_;
+  int socket_;
+
+  DISABLE_COPY_AND_ASSIGN(MetricsExporter);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_METRICS_HPP_
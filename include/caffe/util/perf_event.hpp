@@ -0,0 +1,48 @@
+#ifndef CAFFE_UTIL_PERF_EVENT_HPP_
+#define CAFFE_UTIL_PERF_EVENT_HPP_
+
+#include <stdint.h>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Hardware event counters of the calling thread, read through Linux
+ *        perf_event: cycles, instructions and last-level cache misses.
+ *
+ * The counters exist only in builds with USE_PERF_EVENT. Otherwise, or when
+ * the kernel refuses them (see /proc/sys/kernel/perf_event_paranoid) or the
+ * machine exposes none, as in many virtual machines, available() is false
+ * and every count is zero. Only the user-space events of the thread that
+ * created the counters are counted, so the worker threads of a multithreaded
+ * BLAS are not.
+ */
+class HardwareCounters {
+ public:
+  struct Counts {
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t llc_misses;
+  };
+
+  HardwareCounters();
+  ~HardwareCounters();
+
+  inline bool available() const { return fds_[0] >= 0; }
+  /// @brief Reset the counters and start counting.
+  void Start();
+  /// @brief Stop counting and return the counts since Start, scaled up for
+  ///        the time the kernel multiplexed the counters out.
+  Counts Stop();
+
+ private:
+  // The group leader counts cycles, then instructions and LLC misses.
+  int fds_[3];
+
+  DISABLE_COPY_AND_ASSIGN(HardwareCounters);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_PERF_EVENT_HPP_
@@ -0,0 +1,66 @@
+#ifndef CAFFE_UTIL_SNAPSHOT_WRITER_HPP_
+#define CAFFE_UTIL_SNAPSHOT_WRITER_HPP_
+
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "google/protobuf/message.h"
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Writes staged snapshot protos to disk on a background thread.
+ *
+ * The caller hands over already populated protos (e.g. the NetParameter
+ * produced by Net::ToProto, which holds a private copy of the weights) and
+ * returns immediately. Serialization and file I/O happen on the writer
+ * thread. Each file is first written to "<filename>.tmp" and then renamed
+ * into place, so a reader never observes a partially written snapshot.
+ * Snapshots complete in the order they were queued, and the files of one
+ * snapshot are written in the order given.
+ *
+ * The writer thread is started by the constructor. Unlike InternalThread it
+ * does not draw from the Caffe RNG, so enabling asynchronous snapshots leaves
+ * the random stream seen by the solver unchanged.
+ */
+class SnapshotWriter {
+ public:
+  /// @brief A staged proto and the filename it is written to.
+  typedef pair<shared_ptr< ::google::protobuf::Message>, string> File;
+
+  explicit SnapshotWriter(int max_pending);
+  ~SnapshotWriter();
+
+  /**
+   * @brief Queue the files of one snapshot for writing. Blocks while
+   *        max_pending snapshots are already in flight.
+   */
+  void Write(const vector<File>& files);
+  /// @brief Block until every queued snapshot has reached the disk.
+  void Flush();
+  /// @brief The number of snapshots queued or being written.
+  int pending() const;
+
+ private:
+  void entry();
+
+  /**
+   Move the thread and synchronization fields out instead of including
+   boost/thread.hpp to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+   */
+  class sync;
+
+  const int max_pending_;
+  std::deque<vector<File> > jobs_;
+  shared_ptr<sync> sync_;
+
+  DISABLE_COPY_AND_ASSIGN(SnapshotWriter);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SNAPSHOT_WRITER_HPP_
@@ -0,0 +1,144 @@
+#ifndef CAFFE_UTIL_SPARSE_MATRIX_HPP_
+#define CAFFE_UTIL_SPARSE_MATRIX_HPP_
+
+#include <boost/weak_ptr.hpp>
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A row-major matrix in compressed sparse row (CSR) form: the nonzeros
+ *        of row i are values()[j] in column col_index()[j], for j from
+ *        row_ptr()[i] to row_ptr()[i + 1].
+ */
+template <typename Dtype>
+class SparseMatrix {
+ public:
+  SparseMatrix() : rows_(0), cols_(0), row_ptr_(1, 0) {}
+
+  /// @brief Packs the nonzeros of a dense rows x cols matrix.
+  void FromDense(int rows, int cols, const Dtype* dense);
+  /// @brief Unpacks the matrix into a dense rows x cols one.
+  void ToDense(Dtype* dense) const;
+
+  inline int rows() const { return rows_; }
+  inline int cols() const { return cols_; }
+  inline int nnz() const { return values_.size(); }
+  inline const Dtype* values() const {
+    return values_.empty() ? NULL : &values_[0];
+  }
+  inline const int* col_index() const {
+    return col_index_.empty() ? NULL : &col_index_[0];
+  }
+  inline const int* row_ptr() const { return &row_ptr_[0]; }
+  /// @brief The bytes of the values and indices.
+  size_t bytes() const;
+
+ protected:
+  int rows_, cols_;
+  vector<Dtype> values_;
+  vector<int> col_index_;
+  vector<int> row_ptr_;
+};
+
+/**
+ * @brief The weights of a layer in CSR form, in one matrix per group of rows
+ *        (the output channels of a grouped convolution), for the layers that
+ *        multiply by their weights sparsely once enough of them are zero, as
+ *        pruned models have them.
+ *
+ * The matrices are rebuilt when the weights change, as told by the version of
+ * their SyncedMemory, so they cost a pass over the weights after each
+ * update; layers only use them in the TEST phase. The version counts the
+ * mutable accesses of the weights, not the writes through a pointer kept
+ * from one: code that writes the weights that way, as pycaffe does through
+ * a numpy array of net.params kept across a forward pass, must access them
+ * mutably again afterwards, say with net.params[k][0].data[...] = W, for the
+ * sparse form to be rebuilt.
+ *
+ * Weights read from a sparse BlobProto are not written out densely for it
+ * (see Blob::FromProto), so that only the sparse forms stay in memory until
+ * something else reads the weights.
+ */
+template <typename Dtype>
+class SparseWeights {
+ public:
+  SparseWeights()
+      : threshold_(0), groups_(1), sparse_(false), sparsity_(0),
+        version_(0) {}
+
+  /**
+   * @param threshold the fraction of zero weights from which to multiply by
+   *        the sparse form; 0 to never
+   * @param groups the number of groups the rows of the weights split into
+   */
+  void Init(float threshold, int groups);
+  /**
+   * @brief Rebuilds the sparse form if the weights changed, and returns
+   *        whether to multiply by it.
+   *
+   * The weights are a matrix of their first axis by the others.
+   */
+  bool Update(const Blob<Dtype>& weights);
+
+  /// @brief The sparse form of the rows of group g.
+  inline const SparseMatrix<Dtype>& matrix(int g) const {
+    return matrices_[g];
+  }
+  /// @brief The fraction of zero weights, as of the last Update.
+  inline float sparsity() const { return sparsity_; }
+
+ protected:
+  float threshold_;
+  int groups_;
+  bool sparse_;
+  float sparsity_;
+  vector<SparseMatrix<Dtype> > matrices_;
+  // The memory and version of the weights the form was built from.
+  boost::weak_ptr<SyncedMemory> memory_;
+  uint64_t version_;
+};
+
+/**
+ * @brief C = alpha * A * B + beta * C, where A is a sparse M x K matrix, B a
+ *        dense K x N matrix and C a dense M x N matrix.
+ */
+template <typename Dtype>
+void caffe_cpu_csrmm(const SparseMatrix<Dtype>& A, const int N,
+    const Dtype alpha, const Dtype* B, const Dtype beta, Dtype* C);
+
+/**
+ * @brief C = alpha * A * op(B) + beta * C, where A is a dense M x K matrix,
+ *        op(B) a sparse K x N matrix (B is N x K if TransB == CblasTrans) and
+ *        C a dense M x N matrix.
+ */
+template <typename Dtype>
+void caffe_cpu_gemm_csr(const CBLAS_TRANSPOSE TransB, const int M,
+    const Dtype alpha, const Dtype* A, const SparseMatrix<Dtype>& B,
+    const Dtype beta, Dtype* C);
+
+/**
+ * @brief Zeroes the fraction sparsity of the n values of x smallest in
+ *        magnitude, for magnitude pruning, and returns how many are zero.
+ */
+template <typename Dtype>
+int caffe_prune_by_magnitude(const int n, const float sparsity, Dtype* x);
+
+/**
+ * @brief Stores the data of a BlobProto sparsely, as its nonzero values and
+ *        their indices in sparse_index, if that is smaller.
+ *
+ * Blob::FromProto reads either form.
+ */
+void SparsifyBlobProto(BlobProto* proto);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SPARSE_MATRIX_HPP_
@@ -18,6 +18,7 @@
 #include "caffe/layers/memory_data_layer.hpp"
 #include "caffe/layers/python_layer.hpp"
 #include "caffe/sgd_solvers.hpp"
+#include "caffe/util/memory_tracker.hpp"
 
 // Temporary solution for numpy < 1.7 versions: old macro, no promises.
 // You're strongly advised to upgrade to >= 1.7.
@@ -164,6 +165,28 @@ void Net_LoadHDF5(Net<Dtype>* net, string filename) {
   net->CopyTrainedLayersFromHDF5(filename.c_str());
 }
 
+// The memory report of the net, as lists of (name, type, params,
+// activations, scratch, peak, allocations) by layer and (name, bytes) by
+// blob, both largest first.
+bp::tuple Net_MemoryReport(const Net<Dtype>& net) {
+  MemoryReport<Dtype> report(net);
+  bp::list layers, blobs;
+  for (int i = 0; i < report.layers().size(); ++i) {
+    const MemoryReport<Dtype>::LayerMemory& layer = report.layers()[i];
+    layers.append(bp::make_tuple(layer.name, layer.type, layer.params,
+        layer.activations, layer.scratch, layer.peak, layer.allocations));
+  }
+  for (int i = 0; i < report.blobs().size(); ++i) {
+    blobs.append(bp::make_tuple(report.blobs()[i].name,
+        report.blobs()[i].bytes));
+  }
+  return bp::make_tuple(layers, blobs);
+}
+
+string Net_MemoryReportText(const Net<Dtype>& net) {
+  return MemoryReport<Dtype>(net).Text();
+}
+
 void Net_SetInputArrays(Net<Dtype>* net, bp::object data_obj,
     bp::object labels_obj) {
   // check that this network has an input MemoryDataLayer
@@ -399,6 +422,7 @@ BOOST_PYTHON_MODULE(_caffe) {
   bp::def("solver_rank", &Caffe::solver_rank);
   bp::def("set_solver_rank", &Caffe::set_solver_rank);
   bp::def("set_multiprocess", &Caffe::set_multiprocess);
+  bp::def("set_memory_tracking", &MemoryTracker::set_enabled);
 
   bp::def("layer_type_list", &LayerRegistry<Dtype>::LayerTypeList);
 
@@ -443,6 +467,8 @@ BOOST_PYTHON_MODULE(_caffe) {
     .def("save", &Net_Save)
     .def("save_hdf5", &Net_SaveHDF5)
     .def("load_hdf5", &Net_LoadHDF5)
+    .def("_memory_report", &Net_MemoryReport)
+    .def("memory_report_text", &Net_MemoryReportText)
     .def("before_forward", &Net_before_forward)
     .def("after_forward", &Net_after_forward)
     .def("before_backward", &Net_before_backward)
@@ -533,6 +559,12 @@ BOOST_PYTHON_MODULE(_caffe) {
   bp::class_<AdamSolver<Dtype>, bp::bases<SGDSolver<Dtype> >,
     shared_ptr<AdamSolver<Dtype> >, boost::noncopyable>(
         "AdamSolver", bp::init<string>());
+  bp::class_<LARSSolver<Dtype>, bp::bases<SGDSolver<Dtype> >,
+    shared_ptr<LARSSolver<Dtype> >, boost::noncopyable>(
+        "LARSSolver", bp::init<string>());
+  bp::class_<LAMBSolver<Dtype>, bp::bases<SGDSolver<Dtype> >,
+    shared_ptr<LAMBSolver<Dtype> >, boost::noncopyable>(
+        "LAMBSolver", bp::init<string>());
 
   bp::def("get_solver", &GetSolverFromFile,
       bp::return_value_policy<bp::manage_new_object>());
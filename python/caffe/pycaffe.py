@@ -11,7 +11,8 @@ except:
 import numpy as np
 
 from ._caffe import Net, SGDSolver, NesterovSolver, AdaGradSolver, \
-        RMSPropSolver, AdaDeltaSolver, AdamSolver, NCCL, Timer
+        RMSPropSolver, AdaDeltaSolver, AdamSolver, LARSSolver, LAMBSolver, \
+        NCCL, Timer
 import caffe.io
 
 import six
@@ -302,6 +303,27 @@ def _Net_batch(self, blobs):
                                                  padding])
         yield padded_batch
 
+def _Net_memory_report(self):
+    """
+    The memory the net holds, as accounted by the memory tracker, which
+    caffe.set_memory_tracking(True) turns on before the net is created.
+
+    Returns
+    -------
+    layers: OrderedDict of layer name to a dict of its 'type', the bytes of
+        its 'params', 'activations' and 'scratch' buffers, the 'peak' bytes
+        allocated by it and its number of 'allocations', largest first.
+    blobs: OrderedDict of blob name, or layer[i] for params, to bytes,
+        largest first.
+    """
+    layers, blobs = self._memory_report()
+    keys = ['type', 'params', 'activations', 'scratch', 'peak',
+            'allocations']
+    return (OrderedDict([(layer[0], dict(zip(keys, layer[1:])))
+                         for layer in layers]),
+            OrderedDict(blobs))
+
+
 def _Net_get_id_name(func, field):
     """
     Generic property that maps func to the layer names into an OrderedDict.
@@ -339,6 +361,7 @@ Net.forward_all = _Net_forward_all
 Net.forward_backward_all = _Net_forward_backward_all
 Net.set_input_arrays = _Net_set_input_arrays
 Net._batch = _Net_batch
+Net.memory_report = _Net_memory_report
 Net.inputs = _Net_inputs
 Net.outputs = _Net_outputs
 Net.top_names = _Net_get_id_name(Net._top_ids, "_top_names")
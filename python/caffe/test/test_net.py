@@ -152,6 +152,27 @@ class TestNet(unittest.TestCase):
                 self.assertEqual(abs(self.net.params[name][i].data
                     - net2.params[name][i].data).sum(), 0)
 
+    def test_memory_report(self):
+        caffe.set_memory_tracking(True)
+        try:
+            net_file = simple_net_file(self.num_output)
+            net = caffe.Net(net_file, caffe.TRAIN)
+            os.remove(net_file)
+            net.forward()
+            net.backward()
+            layers, blobs = net.memory_report()
+        finally:
+            caffe.set_memory_tracking(False)
+        self.assertEqual(set(layers.keys()), set(net._layer_names))
+        # conv weights of 11 x 2 x 2 x 2 and a bias of 11, data and diff
+        self.assertEqual(layers['conv']['params'], 2 * (88 + 11) * 4)
+        self.assertEqual(blobs['conv[0]'], 2 * 88 * 4)
+        self.assertEqual(blobs['ip_blob'], 2 * 5 * self.num_output * 4)
+        totals = [l['params'] + l['activations'] + l['scratch']
+                  for l in layers.values()]
+        self.assertEqual(totals, sorted(totals, reverse=True))
+        self.assertIn('Memory by layer', net.memory_report_text())
+
     def test_save_hdf5(self):
         f = tempfile.NamedTemporaryFile(mode='w+', delete=False)
         f.close()
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <climits>
 #include <vector>
 
@@ -8,6 +9,27 @@
 
 namespace caffe {
 
+namespace {
+
+// The data of a blob read from a sparse BlobProto, written out densely when
+// the released data is read.
+template <typename Dtype>
+struct SparseData {
+  size_t count;
+  vector<int> index;
+  vector<Dtype> values;
+
+  void operator()(void* ptr) const {
+    Dtype* data = static_cast<Dtype*>(ptr);
+    std::fill(data, data + count, Dtype(0));
+    for (int i = 0; i < index.size(); ++i) {
+      data[index[i]] = values[i];
+    }
+  }
+};
+
+}  // namespace
+
 //设置维度
 template <typename Dtype>
 void Blob<Dtype>::Reshape(const int num, const int channels, const int height,
@@ -67,14 +89,14 @@ template <typename Dtype>
 Blob<Dtype>::Blob(const int num, const int channels, const int height,
     const int width)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : capacity_(0), layout_(NCHW) {
   Reshape(num, channels, height, width);
 }
 
 template <typename Dtype>
 Blob<Dtype>::Blob(const vector<int>& shape)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : capacity_(0), layout_(NCHW) {
   Reshape(shape);
 }
 
@@ -168,6 +190,48 @@ template <typename Dtype>
 void Blob<Dtype>::ShareDiff(const Blob& other) {
   CHECK_EQ(count_, other.count());
   diff_ = other.diff();
+  diff_rows_ = other.diff_rows_;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::ViewData(const Blob& other, int offset) {
+  CHECK_GE(offset, 0);
+  CHECK_LE(offset + count_, other.count());
+  data_.reset(new SyncedMemory(other.data(), offset * sizeof(Dtype),
+      count_ * sizeof(Dtype)));
+  // The view has no room to grow into.
+  capacity_ = count_;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::ViewDiff(const Blob& other, int offset) {
+  CHECK_GE(offset, 0);
+  CHECK_LE(offset + count_, other.count());
+  diff_.reset(new SyncedMemory(other.diff(), offset * sizeof(Dtype),
+      count_ * sizeof(Dtype)));
+  capacity_ = count_;
+}
+
+template <typename Dtype>
+bool Blob<Dtype>::DataViews(const Blob& other, int offset) const {
+  return data_ && other.data_ && data_->parent() == other.data_.get() &&
+      data_->offset() == offset * sizeof(Dtype);
+}
+
+template <typename Dtype>
+bool Blob<Dtype>::DiffViews(const Blob& other, int offset) const {
+  return diff_ && other.diff_ && diff_->parent() == other.diff_.get() &&
+      diff_->offset() == offset * sizeof(Dtype);
+}
+
+template <typename Dtype>
+void Blob<Dtype>::set_row_sparse_diff(bool row_sparse) {
+  if (!row_sparse) {
+    diff_rows_.reset();
+  } else if (!diff_rows_) {
+    CHECK_GE(num_axes(), 1) << "A row-sparse diff needs rows.";
+    diff_rows_.reset(new DiffRows(shape(0)));
+  }
 }
 
 // The "update" method is used for parameter blobs in a Net, which are stored
@@ -183,6 +247,18 @@ void Blob<Dtype>::Update() {
   switch (data_->head()) {
   case SyncedMemory::HEAD_AT_CPU:
     // perform computation on CPU
+    if (diff_rows_) {
+      // Only the marked rows of a row-sparse diff are nonzero.
+      const int dim = count(1);
+      const vector<int>& rows = diff_rows_->rows();
+      const Dtype* diff = static_cast<const Dtype*>(diff_->cpu_data());
+      Dtype* data = static_cast<Dtype*>(data_->mutable_cpu_data());
+      for (int i = 0; i < rows.size(); ++i) {
+        caffe_axpy<Dtype>(dim, Dtype(-1), diff + rows[i] * dim,
+            data + rows[i] * dim);
+      }
+      break;
+    }
     caffe_axpy<Dtype>(count_, Dtype(-1),
         static_cast<const Dtype*>(diff_->cpu_data()),
         static_cast<Dtype*>(data_->mutable_cpu_data()));
@@ -419,6 +495,38 @@ void Blob<Dtype>::scale_diff(Dtype scale_factor) {
   }
 }
 
+template <typename Dtype>
+int Blob<Dtype>::LayoutBlock(BlobLayout layout, int channels) {
+  switch (layout) {
+  case NCHW:
+    return 1;
+  case NHWC:
+    return channels;
+  case NCHW8C:
+    return 8;
+  case NCHW16C:
+    return 16;
+  default:
+    LOG(FATAL) << "Unknown layout " << layout;
+  }
+  return 1;
+}
+
+template <typename Dtype>
+bool Blob<Dtype>::LayoutFits(BlobLayout layout) const {
+  if (layout == NCHW) {
+    return true;
+  }
+  return num_axes() == 4 && channels() % LayoutBlock(layout, channels()) == 0;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::set_layout(BlobLayout layout) {
+  CHECK(LayoutFits(layout)) << "A blob of shape " << shape_string()
+      << " cannot take the layout " << BlobLayout_Name(layout) << ".";
+  layout_ = layout;
+}
+
 template <typename Dtype>
 bool Blob<Dtype>::ShapeEquals(const BlobProto& other) {
   if (other.has_num() || other.has_channels() ||
@@ -452,6 +560,8 @@ void Blob<Dtype>::CopyFrom(const Blob& source, bool copy_diff, bool reshape) {
       LOG(FATAL) << "Trying to copy blobs of different sizes.";
     }
   }
+  // The values are copied in the order of the source.
+  layout_ = source.layout();
   switch (Caffe::mode()) {
   case Caffe::GPU:
     if (copy_diff) {
@@ -502,14 +612,37 @@ void Blob<Dtype>::FromProto(const BlobProto& proto, bool reshape) {
     CHECK(ShapeEquals(proto)) << "shape mismatch (reshape not set)";
   }
   // copy data
-  Dtype* data_vec = mutable_cpu_data();
-  if (proto.double_data_size() > 0) {
+  if (proto.sparse_index_size() > 0) {
+    // Only the values at sparse_index are stored; the rest are zero. They
+    // are kept as they are, and the data released until it is read, so that
+    // the layers that multiply by pruned weights sparsely never hold them
+    // densely.
+    const bool double_data = proto.double_data_size() > 0;
+    CHECK_EQ(proto.sparse_index_size(),
+        double_data ? proto.double_data_size() : proto.data_size());
+    SparseData<Dtype> sparse;
+    sparse.count = data_->size() / sizeof(Dtype);
+    sparse.index.assign(proto.sparse_index().begin(),
+        proto.sparse_index().end());
+    sparse.values.resize(proto.sparse_index_size());
+    for (int i = 0; i < proto.sparse_index_size(); ++i) {
+      CHECK_LT(sparse.index[i], count_);
+      sparse.values[i] = double_data ? proto.double_data(i) : proto.data(i);
+    }
+    if (data_->parent()) {
+      sparse(mutable_cpu_data());
+    } else {
+      data_->Release(sparse);
+    }
+  } else if (proto.double_data_size() > 0) {
     CHECK_EQ(count_, proto.double_data_size());
+    Dtype* data_vec = mutable_cpu_data();
     for (int i = 0; i < count_; ++i) {
       data_vec[i] = proto.double_data(i);
     }
   } else {
     CHECK_EQ(count_, proto.data_size());
+    Dtype* data_vec = mutable_cpu_data();
     for (int i = 0; i < count_; ++i) {
       data_vec[i] = proto.data(i);
     }
@@ -538,6 +671,7 @@ void Blob<double>::ToProto(BlobProto* proto, bool write_diff) const {
   }
   proto->clear_double_data();
   proto->clear_double_diff();
+  proto->clear_sparse_index();
   const double* data_vec = cpu_data();
   for (int i = 0; i < count_; ++i) {
     proto->add_double_data(data_vec[i]);
@@ -558,6 +692,7 @@ void Blob<float>::ToProto(BlobProto* proto, bool write_diff) const {
   }
   proto->clear_data();
   proto->clear_diff();
+  proto->clear_sparse_index();
   const float* data_vec = cpu_data();
   for (int i = 0; i < count_; ++i) {
     proto->add_data(data_vec[i]);
@@ -0,0 +1,102 @@
+#include <string>
+#include <vector>
+
+#include "caffe/inference_engine.hpp"
+#include "caffe/util/insert_splits.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+InferenceEngine<Dtype>::InferenceEngine(const string& param_file,
+    const string& trained_filename) {
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(param_file, &param);
+  Init(param, trained_filename);
+}
+
+template <typename Dtype>
+InferenceEngine<Dtype>::InferenceEngine(const NetParameter& param) {
+  Init(param, "");
+}
+
+template <typename Dtype>
+void InferenceEngine<Dtype>::Init(const NetParameter& in_param,
+    const string& trained_filename) {
+  mode_ = Caffe::mode();
+  device_ = -1;
+#ifndef CPU_ONLY
+  if (mode_ == Caffe::GPU) {
+    CUDA_CHECK(cudaGetDevice(&device_));
+  }
+#endif
+  NetParameter param(in_param);
+  param.mutable_state()->set_phase(TEST);
+  net_.reset(new Net<Dtype>(param));
+  if (!trained_filename.empty()) {
+    net_->CopyTrainedLayersFrom(trained_filename);
+  }
+  // Filter and split once here, so that doing it again for each context
+  // is a plain copy, and drop the weights the contexts take from net_.
+  NetParameter filtered_param;
+  Net<Dtype>::FilterNet(param, &filtered_param);
+  InsertSplits(filtered_param, &param_);
+  for (int i = 0; i < param_.layer_size(); ++i) {
+    param_.mutable_layer(i)->clear_blobs();
+  }
+  // Bring the weights up to date on the device of the engine, after which
+  // reading them from the contexts does not modify their SyncedMemory.
+  const vector<shared_ptr<Blob<Dtype> > >& params = net_->params();
+  for (int i = 0; i < params.size(); ++i) {
+    switch (mode_) {
+    case Caffe::CPU:
+      params[i]->cpu_data();
+      break;
+    case Caffe::GPU:
+#ifndef CPU_ONLY
+      params[i]->gpu_data();
+#else
+      NO_GPU;
+#endif
+      break;
+    }
+  }
+}
+
+template <typename Dtype>
+void InferenceEngine<Dtype>::SetUpThread() const {
+  Caffe::set_mode(mode_);
+#ifndef CPU_ONLY
+  if (mode_ == Caffe::GPU) {
+    int device;
+    CUDA_CHECK(cudaGetDevice(&device));
+    if (device != device_) {
+      Caffe::SetDevice(device_);
+    }
+  }
+#endif
+}
+
+template <typename Dtype>
+shared_ptr<typename InferenceEngine<Dtype>::Context>
+InferenceEngine<Dtype>::CreateContext() const {
+  return shared_ptr<Context>(new Context(this));
+}
+
+template <typename Dtype>
+InferenceEngine<Dtype>::Context::Context(const InferenceEngine* engine)
+    : engine_(engine) {
+  engine_->SetUpThread();
+  net_.reset(new Net<Dtype>(engine_->param_, engine_->net_.get()));
+}
+
+template <typename Dtype>
+const vector<Blob<Dtype>*>& InferenceEngine<Dtype>::Context::Forward(
+    Dtype* loss) {
+  engine_->SetUpThread();
+  return net_->Forward(loss);
+}
+
+INSTANTIATE_CLASS(InferenceEngine);
+
+}  // namespace caffe
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <functional>
 #include <utility>
 #include <vector>
@@ -52,6 +53,7 @@ void AccuracyLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_label = bottom[1]->cpu_data();
   const int dim = bottom[0]->count() / outer_num_;
   const int num_labels = bottom[0]->shape(label_axis_);
+  const int kCountChunk = 256;
   if (top.size() > 1) {
     caffe_set(nums_buffer_.count(), Dtype(0), nums_buffer_.mutable_cpu_data());
     caffe_set(top[1]->count(), Dtype(0), top[1]->mutable_cpu_data());
@@ -71,10 +73,16 @@ void AccuracyLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                                    + label_value * inner_num_
                                                    + j];
       int num_better_predictions = -1;  // true_class also counts as "better"
-      // Top-k accuracy
-      for (int k = 0; k < num_labels && num_better_predictions < top_k_; ++k) {
-        num_better_predictions +=
-          (bottom_data[i * dim + k * inner_num_ + j] >= prob_of_true_class);
+      // Top-k accuracy. The classes are counted in chunks, which vectorize,
+      // checking whether there are top_k_ better ones after each.
+      const Dtype* prob = bottom_data + i * dim + j;
+      for (int k0 = 0; k0 < num_labels && num_better_predictions < top_k_;
+           k0 += kCountChunk) {
+        const int k_end = std::min(k0 + kCountChunk, num_labels);
+        for (int k = k0; k < k_end; ++k) {
+          num_better_predictions +=
+            (prob[k * inner_num_] >= prob_of_true_class);
+        }
       }
       // check if there are less than top_k_ predictions
       if (num_better_predictions < top_k_) {
@@ -1,9 +1,8 @@
-#include <algorithm>
-#include <functional>
 #include <utility>
 #include <vector>
 
 #include "caffe/layers/argmax_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
@@ -66,30 +65,26 @@ void ArgMaxLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     axis_dist = 1;
   }
   int num = bottom[0]->count() / dim;
-  std::vector<std::pair<Dtype, int> > bottom_data_vector(dim);
   for (int i = 0; i < num; ++i) {
-    for (int j = 0; j < dim; ++j) {
-      bottom_data_vector[j] = std::make_pair(
-        bottom_data[(i / axis_dist * dim + j) * axis_dist + i % axis_dist], j);
-    }
-    std::partial_sort(
-        bottom_data_vector.begin(), bottom_data_vector.begin() + top_k_,
-        bottom_data_vector.end(), std::greater<std::pair<Dtype, int> >());
+    caffe_cpu_top_k(dim,
+        bottom_data + i / axis_dist * dim * axis_dist + i % axis_dist,
+        axis_dist, static_cast<int>(top_k_), &top_buffer_);
+    const std::pair<Dtype, int>* top_pairs = &top_buffer_[0];
     for (int j = 0; j < top_k_; ++j) {
       if (out_max_val_) {
         if (has_axis_) {
           // Produces max_val per axis
           top_data[(i / axis_dist * top_k_ + j) * axis_dist + i % axis_dist]
-            = bottom_data_vector[j].first;
+            = top_pairs[j].first;
         } else {
           // Produces max_ind and max_val
-          top_data[2 * i * top_k_ + j] = bottom_data_vector[j].second;
-          top_data[2 * i * top_k_ + top_k_ + j] = bottom_data_vector[j].first;
+          top_data[2 * i * top_k_ + j] = top_pairs[j].second;
+          top_data[2 * i * top_k_ + top_k_ + j] = top_pairs[j].first;
         }
       } else {
         // Produces max_ind per axis
         top_data[(i / axis_dist * top_k_ + j) * axis_dist + i % axis_dist]
-          = bottom_data_vector[j].second;
+          = top_pairs[j].second;
       }
     }
   }
@@ -177,6 +177,8 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   }
   kernel_dim_ = this->blobs_[0]->count(1);
   weight_offset_ = conv_out_channels_ * kernel_dim_ / group_;
+  sparse_weights_.Init(
+      this->layer_param_.convolution_param().sparse_threshold(), group_);
   // Propagate gradients to the parameters (as directed by backward pass).
   this->param_propagate_down_.resize(this->blobs_.size(), true);
 }
@@ -272,6 +274,21 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
   }
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
+    const SparseWeights<Dtype>& weights, Dtype* output) {
+  const Dtype* col_buff = input;
+  if (!is_1x1_) {
+    conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
+    col_buff = col_buffer_.cpu_data();
+  }
+  for (int g = 0; g < group_; ++g) {
+    caffe_cpu_csrmm<Dtype>(weights.matrix(g), conv_out_spatial_dim_,
+        (Dtype)1., col_buff + col_offset_ * g, (Dtype)0.,
+        output + output_offset_ * g);
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
     const Dtype* bias) {
@@ -280,6 +297,44 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
       (Dtype)1., output);
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_blocked_gemm(const Dtype* input,
+    int input_block, const Dtype* weights, Dtype* output, int output_block) {
+  CHECK(group_ == 1 && num_spatial_axes_ == 2);
+  // The rows of each output position, times the weights of each block of
+  // output channels, are the contiguous values of that block.
+  const Dtype* row_buff = input;
+  if (!is_1x1_ || input_block != conv_in_channels_) {
+    im2row_blocked_cpu(input, conv_in_channels_, input_block,
+        conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+        kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+        pad_.cpu_data()[0], pad_.cpu_data()[1],
+        stride_.cpu_data()[0], stride_.cpu_data()[1],
+        dilation_.cpu_data()[0], dilation_.cpu_data()[1],
+        col_buffer_.mutable_cpu_data());
+    row_buff = col_buffer_.cpu_data();
+  }
+  for (int c = 0; c < conv_out_channels_; c += output_block) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, conv_out_spatial_dim_,
+        output_block, kernel_dim_, (Dtype)1., row_buff,
+        weights + c * kernel_dim_, (Dtype)0.,
+        output + c * conv_out_spatial_dim_);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_blocked_bias(Dtype* output,
+    int output_block, const Dtype* bias) {
+  for (int c = 0; c < num_output_; c += output_block) {
+    for (int s = 0; s < out_spatial_dim_; ++s) {
+      for (int i = 0; i < output_block; ++i) {
+        output[i] += bias[c + i];
+      }
+      output += output_block;
+    }
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
     const Dtype* weights, Dtype* input) {
@@ -7,6 +7,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
 #include "caffe/util/blocking_queue.hpp"
 
 namespace caffe {
@@ -37,7 +38,8 @@ BasePrefetchingDataLayer<Dtype>::BasePrefetchingDataLayer(
     const LayerParameter& param)
     : BaseDataLayer<Dtype>(param),
       prefetch_(param.data_param().prefetch()),
-      prefetch_free_(), prefetch_full_(), prefetch_current_() {
+      prefetch_free_(), prefetch_full_(), prefetch_current_(),
+      data_wait_(), queue_depth_() {
   for (int i = 0; i < prefetch_.size(); ++i) {
     prefetch_[i].reset(new Batch<Dtype>());
     prefetch_free_.push(prefetch_[i].get());
@@ -48,6 +50,12 @@ template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::LayerSetUp(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
   BaseDataLayer<Dtype>::LayerSetUp(bottom, top);
+  const string labels = Metrics::Label("layer", this->layer_param_.name()) +
+      "," + Metrics::Label("phase", Phase_Name(this->phase_));
+  data_wait_ = Metrics::Get().histogram("caffe_data_wait_seconds",
+      "Time a data layer waited for a prefetched batch.", labels);
+  queue_depth_ = Metrics::Get().gauge("caffe_prefetch_queue_depth",
+      "Prefetched batches left to a data layer after taking one.", labels);
 
   // Before starting the prefetch thread, we make cpu_data and gpu_data
   // calls so that the prefetch thread does not accidentally make simultaneous
@@ -110,12 +118,21 @@ void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
 }
 
 template <typename Dtype>
-void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
-    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+void BasePrefetchingDataLayer<Dtype>::NextBatch() {
   if (prefetch_current_) {
     prefetch_free_.push(prefetch_current_);
   }
+  CPUTimer timer;
+  timer.Start();
   prefetch_current_ = prefetch_full_.pop("Waiting for data");
+  data_wait_->Observe(timer.MicroSeconds() / 1e6);
+  queue_depth_->Set(prefetch_full_.size());
+}
+
+template <typename Dtype>
+void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  NextBatch();
   // Reshape to loaded data.
   top[0]->ReshapeLike(prefetch_current_->data_);
   top[0]->set_cpu_data(prefetch_current_->data_.mutable_cpu_data());
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/batch_norm_layer.hpp"
@@ -54,6 +55,9 @@ void BatchNormLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   if (bottom[0]->num_axes() >= 1)
     CHECK_EQ(bottom[0]->shape(1), channels_);
   top[0]->ReshapeLike(*bottom[0]);
+  CHECK(use_global_stats_ || bottom[0]->layout() == NCHW)
+      << "Only NCHW bottoms are normalized by the statistics of the batch.";
+  top[0]->set_layout(bottom[0]->layout());
 
   vector<int> sz;
   sz.push_back(channels_);
@@ -91,6 +95,25 @@ void BatchNormLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   int num = bottom[0]->shape(0);
   int spatial_dim = bottom[0]->count()/(bottom[0]->shape(0)*channels_);
 
+  if (bottom[0]->layout() != NCHW) {
+    // y = x / std + (-mean / std) for each channel, in one pass over the
+    // blocks of channels; the statistics are global, so x_norm_ is unused.
+    const Dtype scale_factor = this->blobs_[2]->cpu_data()[0] == 0 ?
+        0 : 1 / this->blobs_[2]->cpu_data()[0];
+    const Dtype* mean = this->blobs_[0]->cpu_data();
+    const Dtype* variance = this->blobs_[1]->cpu_data();
+    Dtype* scale = variance_.mutable_cpu_data();
+    Dtype* shift = mean_.mutable_cpu_data();
+    for (int c = 0; c < channels_; ++c) {
+      scale[c] = 1 / std::sqrt(scale_factor * variance[c] + eps_);
+      shift[c] = -scale_factor * mean[c] * scale[c];
+    }
+    caffe_cpu_scale_channels(num, channels_, spatial_dim,
+        bottom[0]->layout_block(), variance_.cpu_data(), mean_.cpu_data(),
+        bottom_data, top_data);
+    return;
+  }
+
   if (bottom[0] != top[0]) {
     caffe_copy(bottom[0]->count(), bottom_data, top_data);
   }
@@ -169,6 +192,8 @@ template <typename Dtype>
 void BatchNormLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
+  CHECK_EQ(bottom[0]->layout(), NCHW)
+      << "Only NCHW bottoms are normalized in Backward.";
   const Dtype* top_diff;
   if (bottom[0] != top[0]) {
     top_diff = top[0]->cpu_diff();
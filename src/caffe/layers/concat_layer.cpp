@@ -50,6 +50,35 @@ void ConcatLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   if (bottom.size() == 1) {
     top[0]->ShareData(*bottom[0]);
     top[0]->ShareDiff(*bottom[0]);
+  } else if (num_concats_ == 1 && this->blob_views()) {
+    // Each bottom is one contiguous part of the top, so the bottoms are made
+    // views of the top: the layers before write into it directly, and the
+    // copies of Forward and Backward are skipped. Reshape also runs in
+    // Forward, after the bottoms were computed, so a bottom keeps its data
+    // when it becomes a view. A bottom sharing its data with another blob,
+    // e.g. a Split top, is shared again in every pass, so it is copied in
+    // Forward rather than made a view anew each time.
+    int offset = 0;
+    for (int i = 0; i < bottom.size(); ++i) {
+      const int count = bottom[i]->count();
+      if (!bottom[i]->DataViews(*top[0], offset) &&
+          !bottom[i]->DataShared()) {
+        if (bottom[i]->data()->head() != SyncedMemory::UNINITIALIZED) {
+          if (Caffe::mode() == Caffe::CPU) {
+            caffe_copy(count, bottom[i]->cpu_data(),
+                top[0]->mutable_cpu_data() + offset);
+          } else {
+            caffe_copy(count, bottom[i]->gpu_data(),
+                top[0]->mutable_gpu_data() + offset);
+          }
+        }
+        bottom[i]->ViewData(*top[0], offset);
+      }
+      if (!bottom[i]->DiffViews(*top[0], offset)) {
+        bottom[i]->ViewDiff(*top[0], offset);
+      }
+      offset += count;
+    }
   }
 }
 
@@ -61,8 +90,14 @@ void ConcatLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   int offset_concat_axis = 0;
   const int top_concat_axis = top[0]->shape(concat_axis_);
   for (int i = 0; i < bottom.size(); ++i) {
-    const Dtype* bottom_data = bottom[i]->cpu_data();
     const int bottom_concat_axis = bottom[i]->shape(concat_axis_);
+    if (bottom[i]->DataViews(*top[0],
+        offset_concat_axis * concat_input_size_)) {
+      // The bottom is in the top already.
+      offset_concat_axis += bottom_concat_axis;
+      continue;
+    }
+    const Dtype* bottom_data = bottom[i]->cpu_data();
     for (int n = 0; n < num_concats_; ++n) {
       caffe_copy(bottom_concat_axis * concat_input_size_,
           bottom_data + n * bottom_concat_axis * concat_input_size_,
@@ -82,7 +117,8 @@ void ConcatLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   const int top_concat_axis = top[0]->shape(concat_axis_);
   for (int i = 0; i < bottom.size(); ++i) {
     const int bottom_concat_axis = bottom[i]->shape(concat_axis_);
-    if (propagate_down[i]) {
+    if (propagate_down[i] && !bottom[i]->DiffViews(*top[0],
+        offset_concat_axis * concat_input_size_)) {
       Dtype* bottom_diff = bottom[i]->mutable_cpu_diff();
       for (int n = 0; n < num_concats_; ++n) {
         caffe_copy(bottom_concat_axis * concat_input_size_, top_diff +
@@ -1,6 +1,7 @@
 #include <vector>
 
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
@@ -21,16 +22,50 @@ void ConvolutionLayer<Dtype>::compute_output_shape() {
   }
 }
 
+template <typename Dtype>
+void ConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  BaseConvolutionLayer<Dtype>::Reshape(bottom, top);
+  const ConvolutionParameter& conv_param =
+      this->layer_param_.convolution_param();
+  const BlobLayout layout = bottom[0]->layout();
+  const BlobLayout top_layout = conv_param.has_top_layout() ?
+      conv_param.top_layout() : layout;
+  if (layout != NCHW || top_layout != NCHW) {
+    CHECK(this->group_ == 1 && this->num_spatial_axes_ == 2 &&
+        !this->force_nd_im2col_) << "Only NCHW bottoms and tops are "
+        << "convolved in groups or over other than 2 spatial axes.";
+  }
+  for (int i = 0; i < top.size(); ++i) {
+    CHECK_EQ(layout, bottom[i]->layout())
+        << "The bottoms of a Convolution layer must have one layout.";
+    top[i]->set_layout(top[i]->LayoutFits(top_layout) ? top_layout : NHWC);
+  }
+}
+
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
-  const Dtype* weight = this->blobs_[0]->cpu_data();
+  if (bottom[0]->layout() != NCHW || top[0]->layout() != NCHW) {
+    ForwardBlocked_cpu(bottom, top);
+    return;
+  }
+  // Pruned weights are multiplied by their nonzeros only, and those read
+  // from a sparse caffemodel are not written out densely.
+  const bool sparse = this->phase_ == TEST &&
+      this->sparse_weights_.Update(*this->blobs_[0]);
+  const Dtype* weight = sparse ? NULL : this->blobs_[0]->cpu_data();
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
     for (int n = 0; n < this->num_; ++n) {
-      this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
-          top_data + n * this->top_dim_);
+      if (sparse) {
+        this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_,
+            this->sparse_weights_, top_data + n * this->top_dim_);
+      } else {
+        this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
+            top_data + n * this->top_dim_);
+      }
       if (this->bias_term_) {
         const Dtype* bias = this->blobs_[1]->cpu_data();
         this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
@@ -39,9 +74,44 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+void ConvolutionLayer<Dtype>::ForwardBlocked_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const Blob<Dtype>& weights = *this->blobs_[0];
+  const int block = bottom[0]->layout_block();
+  const shared_ptr<SyncedMemory>& memory = weights.data();
+  if (blocked_weights_memory_.lock() != memory ||
+      blocked_weights_version_ != memory->version() ||
+      blocked_weights_block_ != block) {
+    // The values of each output channel, as the rows of im2row_blocked_cpu.
+    blocked_weights_.ReshapeLike(weights);
+    caffe_cpu_reorder(weights.shape(0), weights.shape(1), weights.count(2),
+        1, block, weights.cpu_data(), blocked_weights_.mutable_cpu_data());
+    blocked_weights_memory_ = memory;
+    blocked_weights_version_ = memory->version();
+    blocked_weights_block_ = block;
+  }
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    const int top_block = top[i]->layout_block();
+    for (int n = 0; n < this->num_; ++n) {
+      this->forward_cpu_blocked_gemm(bottom_data + n * this->bottom_dim_,
+          block, blocked_weights_.cpu_data(), top_data + n * this->top_dim_,
+          top_block);
+      if (this->bias_term_) {
+        this->forward_cpu_blocked_bias(top_data + n * this->top_dim_,
+            top_block, this->blobs_[1]->cpu_data());
+      }
+    }
+  }
+}
+
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  CHECK(bottom[0]->layout() == NCHW && top[0]->layout() == NCHW)
+      << "Only NCHW bottoms and tops are convolved in Backward.";
   const Dtype* weight = this->blobs_[0]->cpu_data();
   Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
   for (int i = 0; i < top.size(); ++i) {
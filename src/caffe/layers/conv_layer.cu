@@ -7,6 +7,11 @@ namespace caffe {
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  // The other layouts are convolved on the CPU.
+  if (bottom[0]->layout() != NCHW || top[0]->layout() != NCHW) {
+    this->Forward_cpu(bottom, top);
+    return;
+  }
   const Dtype* weight = this->blobs_[0]->gpu_data();
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->gpu_data();
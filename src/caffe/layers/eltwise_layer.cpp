@@ -34,8 +34,11 @@ void EltwiseLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     CHECK(bottom[0]->shape() == bottom[i]->shape())
         << "bottom[0]: " << bottom[0]->shape_string()
         << ", bottom[" << i << "]: " << bottom[i]->shape_string();
+    CHECK_EQ(bottom[0]->layout(), bottom[i]->layout())
+        << "The bottoms of an Eltwise layer must have one layout.";
   }
   top[0]->ReshapeLike(*bottom[0]);
+  top[0]->set_layout(bottom[0]->layout());
   // If max operation, we will initialize the vector index part.
   if (this->layer_param_.eltwise_param().operation() ==
       EltwiseParameter_EltwiseOp_MAX && top.size() == 1) {
@@ -99,6 +99,7 @@ void EmbedLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       DCHECK_EQ(static_cast<Dtype>(index), bottom_data[n])
           << "non-integer input";
       caffe_axpy(N_, Dtype(1), top_diff + n * N_, weight_diff + index * N_);
+      this->blobs_[0]->MarkDiffRow(index);
     }
   }
   if (bias_term_ && this->param_propagate_down_[1]) {
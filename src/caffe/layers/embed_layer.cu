@@ -72,6 +72,12 @@ void EmbedLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
     EmbedBackward<Dtype>  // NOLINT_NEXT_LINE(whitespace/operators)
         <<<CAFFE_GET_BLOCKS(top_count), CAFFE_CUDA_NUM_THREADS>>>(
         top_count, bottom_data, top_diff, M_, N_, K_, weight_diff);
+    if (this->blobs_[0]->row_sparse_diff()) {
+      const Dtype* indices = bottom[0]->cpu_data();
+      for (int n = 0; n < M_; ++n) {
+        this->blobs_[0]->MarkDiffRow(static_cast<int>(indices[n]));
+      }
+    }
   }
   if (bias_term_ && this->param_propagate_down_[1]) {
     const Dtype* top_diff = top[0]->gpu_diff();
@@ -15,6 +15,8 @@ void InnerProductLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   bias_term_ = this->layer_param_.inner_product_param().bias_term();
   // 是否转置
   transpose_ = this->layer_param_.inner_product_param().transpose();
+  sparse_weights_.Init(
+      this->layer_param_.inner_product_param().sparse_threshold(), 1);
   N_ = num_output;
   const int axis = bottom[0]->CanonicalAxisIndex(
       this->layer_param_.inner_product_param().axis());
@@ -96,12 +98,19 @@ void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   // 输出指针
   Dtype* top_data = top[0]->mutable_cpu_data();
-  // 权重指针
-  const Dtype* weight = this->blobs_[0]->cpu_data();
-  // C = alhpa * A * B + beta * C
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
-      M_, N_, K_, (Dtype)1.,
-      bottom_data, weight, (Dtype)0., top_data);
+  if (this->phase_ == TEST && sparse_weights_.Update(*this->blobs_[0])) {
+    // 剪枝后的稀疏权重: 只乘非零权重
+    caffe_cpu_gemm_csr<Dtype>(transpose_ ? CblasNoTrans : CblasTrans, M_,
+        (Dtype)1., bottom_data, sparse_weights_.matrix(0), (Dtype)0.,
+        top_data);
+  } else {
+    // 权重指针
+    const Dtype* weight = this->blobs_[0]->cpu_data();
+    // C = alhpa * A * B + beta * C
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
+        M_, N_, K_, (Dtype)1.,
+        bottom_data, weight, (Dtype)0., top_data);
+  }
   if (bias_term_) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, (Dtype)1.,
         bias_multiplier_.cpu_data(),
@@ -1,3 +1,4 @@
+#include <cmath>
 #include <string>
 #include <vector>
 
@@ -10,6 +11,42 @@
 
 namespace caffe {
 
+namespace {
+
+// The nonlinearities of LSTMUnitLayer, for the fused pass to match it, but
+// computed in Dtype rather than promoted to double.
+template <typename Dtype>
+inline Dtype sigmoid(Dtype x) {
+  return Dtype(1) / (Dtype(1) + std::exp(-x));
+}
+
+template <typename Dtype>
+inline Dtype tanh(Dtype x) {
+  return Dtype(2) * sigmoid(Dtype(2) * x) - Dtype(1);
+}
+
+// The LSTMUnit of a stream: activates its gate inputs X in place, and computes
+// its cell and hidden states, C and H, from the previous cell state.
+template <typename Dtype>
+void LSTMUnitForward(int dim, Dtype cont, Dtype* X, const Dtype* C_prev,
+    Dtype* C, Dtype* H) {
+  for (int d = 0; d < dim; ++d) {
+    const Dtype i = sigmoid(X[d]);
+    const Dtype f = (cont == 0) ? 0 : (cont * sigmoid(X[1 * dim + d]));
+    const Dtype o = sigmoid(X[2 * dim + d]);
+    const Dtype g = tanh(X[3 * dim + d]);
+    X[d] = i;
+    X[1 * dim + d] = f;
+    X[2 * dim + d] = o;
+    X[3 * dim + d] = g;
+    const Dtype c = f * C_prev[d] + i * g;
+    C[d] = c;
+    H[d] = o * tanh(c);
+  }
+}
+
+}  // namespace
+
 template <typename Dtype>
 void LSTMLayer<Dtype>::RecurrentInputBlobNames(vector<string>* names) const {
   names->resize(2);
@@ -238,6 +275,246 @@ void LSTMLayer<Dtype>::FillUnrolledNet(NetParameter* net_param) const {
   net_param->add_layer()->CopyFrom(output_concat_layer);
 }
 
+template <typename Dtype>
+void LSTMLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  RecurrentLayer<Dtype>::Reshape(bottom, top);
+  if (!this->fused_) { return; }
+  const int num_output = this->layer_param_.recurrent_param().num_output();
+  vector<int> shape(3);
+  shape[0] = this->T_;
+  shape[1] = this->N_;
+  shape[2] = 4 * num_output;
+  gates_.Reshape(shape);
+  shape[2] = num_output;
+  cell_.Reshape(shape);
+  hidden_.Reshape(shape);
+  hidden_conted_.Reshape(shape);
+  shape[0] = 1;
+  hidden_prev_diff_.Reshape(shape);
+  if (this->static_input_) {
+    shape[2] = 4 * num_output;
+    static_gates_.Reshape(shape);
+  }
+  vector<int> bias_shape(1, this->T_ * this->N_);
+  bias_multiplier_.Reshape(bias_shape);
+  caffe_set(bias_multiplier_.count(), Dtype(1),
+      bias_multiplier_.mutable_cpu_data());
+}
+
+template <typename Dtype>
+void LSTMLayer<Dtype>::FusedForward_cpu() {
+  const int T = this->T_;
+  const int N = this->N_;
+  const int hidden_dim = this->layer_param_.recurrent_param().num_output();
+  const int gate_dim = 4 * hidden_dim;
+  const int input_dim = this->x_input_blob_->count(2);
+  const int rows = this->batch_offsets_[T];
+  const Dtype* W_hc = this->blobs_[2 + this->static_input_]->cpu_data();
+  Dtype* gates = gates_.mutable_cpu_data();
+
+  // Project the input of all timesteps at once.
+  //     gate_input := W_xc * x + b_c + W_xc_static * x_static
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, rows, gate_dim, input_dim,
+      (Dtype)1., this->packed_input(), this->blobs_[0]->cpu_data(),
+      (Dtype)0., gates);
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, rows, gate_dim, 1,
+      (Dtype)1., bias_multiplier_.cpu_data(), this->blobs_[1]->cpu_data(),
+      (Dtype)1., gates);
+  if (this->static_input_) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, N, gate_dim,
+        this->x_static_input_blob_->count(1), (Dtype)1.,
+        this->x_static_input_blob_->cpu_data(), this->blobs_[2]->cpu_data(),
+        (Dtype)0., static_gates_.mutable_cpu_data());
+    for (int t = 0; t < T; ++t) {
+      for (int j = 0; j < this->batch_sizes_[t]; ++j) {
+        caffe_axpy<Dtype>(gate_dim, 1,
+            static_gates_.cpu_data() + this->order_[j] * gate_dim,
+            gates + (this->batch_offsets_[t] + j) * gate_dim);
+      }
+    }
+  }
+
+  // The streams active at a timestep are the first ones of the previous.
+  const Dtype* H_prev = this->PackedRecurrentInput(0);
+  const Dtype* C_prev = this->PackedRecurrentInput(1);
+  for (int t = 0; t < T && this->batch_sizes_[t]; ++t) {
+    const int batch = this->batch_sizes_[t];
+    const int row = this->batch_offsets_[t];
+    const Dtype* cont = this->cont_input_blob_->cpu_data() + t * N;
+    Dtype* X_t = gates + row * gate_dim;
+    Dtype* C = cell_.mutable_cpu_data() + row * hidden_dim;
+    Dtype* H = hidden_.mutable_cpu_data() + row * hidden_dim;
+    Dtype* H_conted = hidden_conted_.mutable_cpu_data() + row * hidden_dim;
+    //     h_conted_{t-1} := cont_t * h_{t-1}
+    //     gate_input_t += W_hc * h_conted_{t-1}
+    this->ContRows(t, hidden_dim, H_prev, H_conted);
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, batch, gate_dim,
+        hidden_dim, (Dtype)1., H_conted, W_hc, (Dtype)1., X_t);
+    // The LSTMUnit, keeping the activated gates for the backward pass.
+    for (int j = 0; j < batch; ++j) {
+      const int offset = j * hidden_dim;
+      LSTMUnitForward(hidden_dim, cont[this->order_[j]],
+          X_t + j * gate_dim, C_prev + offset, C + offset, H + offset);
+    }
+    H_prev = H;
+    C_prev = C;
+  }
+
+  this->UnpackRows(hidden_.cpu_data(), hidden_dim,
+      this->output_blobs_[0]->mutable_cpu_data());
+  this->UnpackRecurrentOutput(0, hidden_.cpu_data());
+  this->UnpackRecurrentOutput(1, cell_.cpu_data());
+}
+
+template <typename Dtype>
+void LSTMLayer<Dtype>::FusedBackward_cpu(const vector<bool>& propagate_down) {
+  const int T = this->T_;
+  const int N = this->N_;
+  const int hidden_dim = this->layer_param_.recurrent_param().num_output();
+  const int gate_dim = 4 * hidden_dim;
+  const int input_dim = this->x_input_blob_->count(2);
+  const int rows = this->batch_offsets_[T];
+  Blob<Dtype>* W_hc = this->blobs_[2 + this->static_input_].get();
+  const Dtype* gates = gates_.cpu_data();
+  const Dtype* cells = cell_.cpu_data();
+  Dtype* gates_diff = gates_.mutable_cpu_diff();
+  Dtype* cell_diff = cell_.mutable_cpu_diff();
+  Dtype* hidden_diff = hidden_.mutable_cpu_diff();
+  Dtype* prev_diff = hidden_prev_diff_.mutable_cpu_diff();
+
+  // The diffs of h_T and c_T are not backpropagated across batches, so the
+  // cell diff after the last timestep of each stream is zero.
+  this->PackRows(this->output_blobs_[0]->cpu_diff(), hidden_dim,
+      hidden_diff);
+  caffe_set(rows * hidden_dim, Dtype(0), cell_diff);
+  const Dtype* C_0 = this->PackedRecurrentInput(1);
+  for (int t = T - 1; t >= 0; --t) {
+    const int batch = this->batch_sizes_[t];
+    if (!batch) { continue; }
+    const int row = this->batch_offsets_[t];
+    const int prev_row = t ? this->batch_offsets_[t - 1] : 0;
+    const Dtype* cont = this->cont_input_blob_->cpu_data() + t * N;
+    const Dtype* C_prev = t ? cells + prev_row * hidden_dim : C_0;
+    const Dtype* C = cells + row * hidden_dim;
+    const Dtype* C_diff = cell_diff + row * hidden_dim;
+    const Dtype* H_diff = hidden_diff + row * hidden_dim;
+    for (int j = 0; j < batch; ++j) {
+      const Dtype* X = gates + (row + j) * gate_dim;
+      Dtype* X_diff = gates_diff + (row + j) * gate_dim;
+      const int offset = j * hidden_dim;
+      for (int d = 0; d < hidden_dim; ++d) {
+        const Dtype i = X[d];
+        const Dtype f = X[1 * hidden_dim + d];
+        const Dtype o = X[2 * hidden_dim + d];
+        const Dtype g = X[3 * hidden_dim + d];
+        const Dtype c_prev = C_prev[offset + d];
+        const Dtype tanh_c = tanh(C[offset + d]);
+        const Dtype h_diff = H_diff[offset + d];
+        const Dtype c_term_diff =
+            C_diff[offset + d] + h_diff * o * (1 - tanh_c * tanh_c);
+        if (t) {
+          cell_diff[prev_row * hidden_dim + offset + d] = c_term_diff * f;
+        }
+        X_diff[d] = c_term_diff * g * i * (1 - i);
+        X_diff[1 * hidden_dim + d] = c_term_diff * c_prev * f * (1 - f);
+        X_diff[2 * hidden_dim + d] = h_diff * tanh_c * o * (1 - o);
+        X_diff[3 * hidden_dim + d] = c_term_diff * i * (1 - g * g);
+      }
+    }
+    if (t) {
+      //     diff h_{t-1} += cont_t * W_hc' * diff gate_input_t
+      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, batch, hidden_dim,
+          gate_dim, (Dtype)1., gates_diff + row * gate_dim,
+          W_hc->cpu_data(), (Dtype)0., prev_diff);
+      for (int j = 0; j < batch; ++j) {
+        caffe_axpy(hidden_dim, cont[this->order_[j]],
+            prev_diff + j * hidden_dim,
+            hidden_diff + (prev_row + j) * hidden_dim);
+      }
+    }
+  }
+
+  // The gradients of the weights, over all timesteps at once.
+  caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, gate_dim, hidden_dim,
+      rows, (Dtype)1., gates_diff, hidden_conted_.cpu_data(), (Dtype)1.,
+      W_hc->mutable_cpu_diff());
+  caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, gate_dim, input_dim, rows,
+      (Dtype)1., gates_diff, this->packed_input(), (Dtype)1.,
+      this->blobs_[0]->mutable_cpu_diff());
+  caffe_cpu_gemv<Dtype>(CblasTrans, rows, gate_dim, (Dtype)1., gates_diff,
+      bias_multiplier_.cpu_data(), (Dtype)1.,
+      this->blobs_[1]->mutable_cpu_diff());
+  if (propagate_down[0]) {
+    Dtype* x_diff = this->packed_ ? this->packed_input_.mutable_cpu_diff() :
+        this->x_input_blob_->mutable_cpu_diff();
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, rows, input_dim,
+        gate_dim, (Dtype)1., gates_diff, this->blobs_[0]->cpu_data(),
+        (Dtype)0., x_diff);
+    if (this->packed_) {
+      this->UnpackRows(x_diff, input_dim,
+          this->x_input_blob_->mutable_cpu_diff());
+    }
+  }
+  if (this->static_input_) {
+    const int static_dim = this->x_static_input_blob_->count(1);
+    Dtype* static_diff = static_gates_.mutable_cpu_diff();
+    caffe_set(N * gate_dim, Dtype(0), static_diff);
+    for (int t = 0; t < T; ++t) {
+      for (int j = 0; j < this->batch_sizes_[t]; ++j) {
+        caffe_axpy<Dtype>(gate_dim, 1,
+            gates_diff + (this->batch_offsets_[t] + j) * gate_dim,
+            static_diff + this->order_[j] * gate_dim);
+      }
+    }
+    caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, gate_dim, static_dim, N,
+        (Dtype)1., static_diff, this->x_static_input_blob_->cpu_data(),
+        (Dtype)1., this->blobs_[2]->mutable_cpu_diff());
+    if (propagate_down[2]) {
+      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, N, static_dim,
+          gate_dim, (Dtype)1., static_diff, this->blobs_[2]->cpu_data(),
+          (Dtype)0., this->x_static_input_blob_->mutable_cpu_diff());
+    }
+  }
+}
+
+template <typename Dtype>
+void LSTMLayer<Dtype>::FusedStep_cpu(int T, int num, const Dtype* x,
+    const vector<Dtype*>& states, Dtype* y) {
+  const int hidden_dim = this->layer_param_.recurrent_param().num_output();
+  const int gate_dim = 4 * hidden_dim;
+  const Dtype* W_hc = this->blobs_[2]->cpu_data();
+  vector<int> shape(2, T * num);
+  shape[1] = gate_dim;
+  step_gates_.Reshape(shape);
+  Dtype* gates = step_gates_.mutable_cpu_data();
+
+  //     gate_input := W_xc * x + b_c
+  for (int i = 0; i < T * num; ++i) {
+    caffe_copy(gate_dim, this->blobs_[1]->cpu_data(), gates + i * gate_dim);
+  }
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, T * num, gate_dim,
+      this->input_dim(), (Dtype)1., x, this->blobs_[0]->cpu_data(),
+      (Dtype)1., gates);
+  // The hidden states go straight to the output, and the cell states are
+  // updated in place.
+  const Dtype* H_prev = states[0];
+  Dtype* C = states[1];
+  for (int t = 0; t < T; ++t) {
+    Dtype* X_t = gates + t * num * gate_dim;
+    Dtype* H = y + t * num * hidden_dim;
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, num, gate_dim,
+        hidden_dim, (Dtype)1., H_prev, W_hc, (Dtype)1., X_t);
+    for (int n = 0; n < num; ++n) {
+      const int offset = n * hidden_dim;
+      LSTMUnitForward(hidden_dim, Dtype(1), X_t + n * gate_dim, C + offset,
+          C + offset, H + offset);
+    }
+    H_prev = H;
+  }
+  caffe_copy(num * hidden_dim, H_prev, states[0]);
+}
+
 INSTANTIATE_CLASS(LSTMLayer);
 REGISTER_LAYER_CLASS(LSTM);
 
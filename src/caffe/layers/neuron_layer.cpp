@@ -9,6 +9,8 @@ void NeuronLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   //bottom 、top的shape相同
   top[0]->ReshapeLike(*bottom[0]);
+  // Element-wise, in whatever layout the bottom is in.
+  top[0]->set_layout(bottom[0]->layout());
 }
 
 INSTANTIATE_CLASS(NeuronLayer);
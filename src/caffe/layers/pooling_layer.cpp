@@ -10,6 +10,72 @@ namespace caffe {
 using std::min;
 using std::max;
 
+namespace {
+
+template <typename Dtype, bool kMax>
+inline Dtype Pool(Dtype a, Dtype b) {
+  return kMax ? (a > b ? a : b) : a + b;
+}
+
+// Pools a row across the columns of each window into top_row, with the
+// windows of kKernel columns (2 or 3, as the common 2x2 and 3x3 pooling, or
+// 0 for any) that lie inside the row unrolled.
+template <typename Dtype, bool kMax, int kKernel>
+void PoolColumns(const Dtype* row, int width, int kernel_w, int stride_w,
+    int pad_w, int pooled_width, Dtype* top_row) {
+  for (int pw = 0; pw < pooled_width; ++pw) {
+    const int wstart = pw * stride_w - pad_w;
+    if (kKernel > 0 && wstart >= 0 && wstart + kKernel <= width) {
+      const Dtype* window = row + wstart;
+      Dtype value = Pool<Dtype, kMax>(window[0], window[1]);
+      if (kKernel > 2) {
+        value = Pool<Dtype, kMax>(value, window[2]);
+      }
+      top_row[pw] = value;
+      continue;
+    }
+    const int wend = min(wstart + kernel_w, width);
+    Dtype value = kMax ? Dtype(-FLT_MAX) : Dtype(0);
+    for (int w = max(wstart, 0); w < wend; ++w) {
+      value = Pool<Dtype, kMax>(value, row[w]);
+    }
+    top_row[pw] = value;
+  }
+}
+
+// Pools one channel of an image, through a row buffer of its width.
+template <typename Dtype, bool kMax>
+void PoolImage(const Dtype* bottom, int height, int width, int kernel_h,
+    int kernel_w, int stride_h, int stride_w, int pad_h, int pad_w,
+    int pooled_height, int pooled_width, Dtype* buffer, Dtype* top) {
+  void (*pool_columns)(const Dtype*, int, int, int, int, int, Dtype*) =
+      kernel_w == 2 ? &PoolColumns<Dtype, kMax, 2> :
+      kernel_w == 3 ? &PoolColumns<Dtype, kMax, 3> :
+      &PoolColumns<Dtype, kMax, 0>;
+  for (int ph = 0; ph < pooled_height; ++ph) {
+    const int hstart = max(ph * stride_h - pad_h, 0);
+    const int hend = min(ph * stride_h - pad_h + kernel_h, height);
+    const Dtype* row = bottom + hstart * width;
+    if (hend - hstart > 1) {
+      const Dtype* next = row + width;
+      for (int w = 0; w < width; ++w) {
+        buffer[w] = Pool<Dtype, kMax>(row[w], next[w]);
+      }
+      for (int h = hstart + 2; h < hend; ++h) {
+        next = bottom + h * width;
+        for (int w = 0; w < width; ++w) {
+          buffer[w] = Pool<Dtype, kMax>(buffer[w], next[w]);
+        }
+      }
+      row = buffer;
+    }
+    pool_columns(row, width, kernel_w, stride_w, pad_w, pooled_width,
+        top + ph * pooled_width);
+  }
+}
+
+}  // namespace
+
 template <typename Dtype>
 void PoolingLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -118,6 +184,13 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
   top[0]->Reshape(bottom[0]->num(), channels_, pooled_height_,
       pooled_width_);
+  if (bottom[0]->layout() != NCHW) {
+    CHECK_EQ(top.size(), 1) << "Only NCHW bottoms are pooled with a mask.";
+    CHECK(this->layer_param_.pooling_param().pool() !=
+        PoolingParameter_PoolMethod_STOCHASTIC)
+        << "Only NCHW bottoms are pooled stochastically.";
+  }
+  top[0]->set_layout(bottom[0]->layout());
   if (top.size() > 1) {
     top[1]->ReshapeLike(*top[0]);
   }
@@ -127,6 +200,15 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     max_idx_.Reshape(bottom[0]->num(), channels_, pooled_height_,
         pooled_width_);
   }
+  // If average pooling over the whole image, sum it with a gemv.
+  if (this->layer_param_.pooling_param().pool() ==
+      PoolingParameter_PoolMethod_AVE && kernel_h_ == height_ &&
+      kernel_w_ == width_ && pad_h_ == 0 && pad_w_ == 0) {
+    vector<int> multiplier_shape(1, height_ * width_);
+    spatial_sum_multiplier_.Reshape(multiplier_shape);
+    caffe_set(spatial_sum_multiplier_.count(), Dtype(1),
+        spatial_sum_multiplier_.mutable_cpu_data());
+  }
   // If stochastic pooling, we will initialize the random index part.
   if (this->layer_param_.pooling_param().pool() ==
       PoolingParameter_PoolMethod_STOCHASTIC) {
@@ -140,6 +222,17 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  if (bottom[0]->layout() != NCHW) {
+    ForwardBlocked_cpu(bottom, top);
+    return;
+  }
+  const PoolingParameter_PoolMethod pool =
+      this->layer_param_.pooling_param().pool();
+  if (pool == PoolingParameter_PoolMethod_AVE ||
+      (pool == PoolingParameter_PoolMethod_MAX && !RecordsMask(top))) {
+    ForwardUnmasked_cpu(bottom, top);
+    return;
+  }
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int top_count = top[0]->count();
@@ -147,9 +240,12 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const bool use_top_mask = top.size() > 1;
   int* mask = NULL;  // suppress warnings about uninitialized variables
   Dtype* top_mask = NULL;
+  const int num_images = bottom[0]->num() * channels_;
+  const int bottom_dim = height_ * width_;
+  const int top_dim = pooled_height_ * pooled_width_;
   // Different pooling methods. We explicitly do the switch outside the for
   // loop to save time, although this results in more code.
-  switch (this->layer_param_.pooling_param().pool()) {
+  switch (pool) {
   case PoolingParameter_PoolMethod_MAX:
     // Initialize
     if (use_top_mask) {
@@ -160,82 +256,157 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       caffe_set(top_count, -1, mask);
     }
     caffe_set(top_count, Dtype(-FLT_MAX), top_data);
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_);
-            int wend = min(wstart + kernel_w_, width_);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            const int pool_index = ph * pooled_width_ + pw;
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                const int index = h * width_ + w;
-                if (bottom_data[index] > top_data[pool_index]) {
-                  top_data[pool_index] = bottom_data[index];
-                  if (use_top_mask) {
-                    top_mask[pool_index] = static_cast<Dtype>(index);
-                  } else {
-                    mask[pool_index] = index;
-                  }
+    // The main loop, over the channels of all images
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (int i = 0; i < num_images; ++i) {
+      const Dtype* image = bottom_data + i * bottom_dim;
+      Dtype* top_image = top_data + i * top_dim;
+      for (int ph = 0; ph < pooled_height_; ++ph) {
+        for (int pw = 0; pw < pooled_width_; ++pw) {
+          int hstart = ph * stride_h_ - pad_h_;
+          int wstart = pw * stride_w_ - pad_w_;
+          int hend = min(hstart + kernel_h_, height_);
+          int wend = min(wstart + kernel_w_, width_);
+          hstart = max(hstart, 0);
+          wstart = max(wstart, 0);
+          const int pool_index = ph * pooled_width_ + pw;
+          for (int h = hstart; h < hend; ++h) {
+            for (int w = wstart; w < wend; ++w) {
+              const int index = h * width_ + w;
+              if (image[index] > top_image[pool_index]) {
+                top_image[pool_index] = image[index];
+                if (use_top_mask) {
+                  top_mask[i * top_dim + pool_index] =
+                      static_cast<Dtype>(index);
+                } else {
+                  mask[i * top_dim + pool_index] = index;
                 }
               }
             }
           }
         }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
-        }
       }
     }
     break;
-  case PoolingParameter_PoolMethod_AVE:
-    for (int i = 0; i < top_count; ++i) {
-      top_data[i] = 0;
+  case PoolingParameter_PoolMethod_STOCHASTIC:
+    NOT_IMPLEMENTED;
+    break;
+  default:
+    LOG(FATAL) << "Unknown pooling method.";
+  }
+}
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::ForwardUnmasked_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const bool max_pool = this->layer_param_.pooling_param().pool() ==
+      PoolingParameter_PoolMethod_MAX;
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  const int num_images = bottom[0]->num() * channels_;
+  const int bottom_dim = height_ * width_;
+  const int top_dim = pooled_height_ * pooled_width_;
+  if (!max_pool && spatial_sum_multiplier_.count() == bottom_dim &&
+      kernel_h_ == height_ && kernel_w_ == width_ && pad_h_ == 0 &&
+      pad_w_ == 0) {
+    // Global average pooling: the mean of each row of the bottom.
+    caffe_cpu_gemv<Dtype>(CblasNoTrans, num_images, bottom_dim,
+        Dtype(1) / bottom_dim, bottom_data,
+        spatial_sum_multiplier_.cpu_data(), Dtype(0), top_data);
+    return;
+  }
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+  {
+    // A row of the windows pooled down, for each thread.
+    vector<Dtype> buffer(width_);
+#ifdef _OPENMP
+#pragma omp for
+#endif
+    for (int i = 0; i < num_images; ++i) {
+      const Dtype* image = bottom_data + i * bottom_dim;
+      Dtype* top_image = top_data + i * top_dim;
+      if (max_pool) {
+        PoolImage<Dtype, true>(image, height_, width_, kernel_h_, kernel_w_,
+            stride_h_, stride_w_, pad_h_, pad_w_, pooled_height_,
+            pooled_width_, &buffer[0], top_image);
+        continue;
+      }
+      PoolImage<Dtype, false>(image, height_, width_, kernel_h_, kernel_w_,
+          stride_h_, stride_w_, pad_h_, pad_w_, pooled_height_,
+          pooled_width_, &buffer[0], top_image);
+      // The windows are averaged over their padding too.
+      for (int ph = 0; ph < pooled_height_; ++ph) {
+        const int hstart = ph * stride_h_ - pad_h_;
+        const int pool_h = min(hstart + kernel_h_, height_ + pad_h_) - hstart;
+        for (int pw = 0; pw < pooled_width_; ++pw) {
+          const int wstart = pw * stride_w_ - pad_w_;
+          const int pool_w =
+              min(wstart + kernel_w_, width_ + pad_w_) - wstart;
+          top_image[ph * pooled_width_ + pw] /= pool_h * pool_w;
+        }
+      }
     }
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_ + pad_h_);
-            int wend = min(wstart + kernel_w_, width_ + pad_w_);
-            int pool_size = (hend - hstart) * (wend - wstart);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            hend = min(hend, height_);
-            wend = min(wend, width_);
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                top_data[ph * pooled_width_ + pw] +=
-                    bottom_data[h * width_ + w];
+  }
+}
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::ForwardBlocked_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const bool max_pool = this->layer_param_.pooling_param().pool() ==
+      PoolingParameter_PoolMethod_MAX;
+  const int block = bottom[0]->layout_block();
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  // The channels of a block are contiguous at each position, and each block
+  // of each image is contiguous, so the inner loops run over the channels.
+  const int num_blocks = bottom[0]->num() * channels_ / block;
+  const int bottom_dim = height_ * width_ * block;
+  const int top_dim = pooled_height_ * pooled_width_ * block;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (int b = 0; b < num_blocks; ++b) {
+    const Dtype* bottom_image = bottom_data + b * bottom_dim;
+    Dtype* top_image = top_data + b * top_dim;
+    for (int ph = 0; ph < pooled_height_; ++ph) {
+      for (int pw = 0; pw < pooled_width_; ++pw) {
+        int hstart = ph * stride_h_ - pad_h_;
+        int wstart = pw * stride_w_ - pad_w_;
+        int hend = min(hstart + kernel_h_, height_ + pad_h_);
+        int wend = min(wstart + kernel_w_, width_ + pad_w_);
+        const int pool_size = (hend - hstart) * (wend - wstart);
+        hstart = max(hstart, 0);
+        wstart = max(wstart, 0);
+        hend = min(hend, height_);
+        wend = min(wend, width_);
+        Dtype* top_block = top_image + (ph * pooled_width_ + pw) * block;
+        caffe_set(block, max_pool ? Dtype(-FLT_MAX) : Dtype(0), top_block);
+        for (int h = hstart; h < hend; ++h) {
+          for (int w = wstart; w < wend; ++w) {
+            const Dtype* bottom_block =
+                bottom_image + (h * width_ + w) * block;
+            if (max_pool) {
+              for (int i = 0; i < block; ++i) {
+                top_block[i] = max(top_block[i], bottom_block[i]);
+              }
+            } else {
+              for (int i = 0; i < block; ++i) {
+                top_block[i] += bottom_block[i];
               }
             }
-            top_data[ph * pooled_width_ + pw] /= pool_size;
           }
         }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
+        if (!max_pool) {
+          for (int i = 0; i < block; ++i) {
+            top_block[i] /= pool_size;
+          }
+        }
       }
     }
-    break;
-  case PoolingParameter_PoolMethod_STOCHASTIC:
-    NOT_IMPLEMENTED;
-    break;
-  default:
-    LOG(FATAL) << "Unknown pooling method.";
   }
 }
 
@@ -245,6 +416,8 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   if (!propagate_down[0]) {
     return;
   }
+  CHECK_EQ(bottom[0]->layout(), NCHW)
+      << "Only NCHW bottoms are pooled in Backward.";
   const Dtype* top_diff = top[0]->cpu_diff();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
   // Different pooling methods. We explicitly do the switch outside the for
@@ -256,6 +429,10 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   const Dtype* top_mask = NULL;
   switch (this->layer_param_.pooling_param().pool()) {
   case PoolingParameter_PoolMethod_MAX:
+    if (!RecordsMask(top)) {
+      BackwardUnmasked_cpu(top, bottom);
+      break;
+    }
     // The main loop
     if (use_top_mask) {
       top_mask = top[1]->cpu_data();
@@ -319,6 +496,44 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
 }
 
+template <typename Dtype>
+void PoolingLayer<Dtype>::BackwardUnmasked_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<Blob<Dtype>*>& bottom) {
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  const Dtype* top_diff = top[0]->cpu_diff();
+  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  const int num_images = bottom[0]->num() * channels_;
+  const int bottom_dim = height_ * width_;
+  const int top_dim = pooled_height_ * pooled_width_;
+  // Find the argmax of each window again, as the masked Forward does.
+  for (int i = 0; i < num_images; ++i) {
+    const Dtype* image = bottom_data + i * bottom_dim;
+    for (int ph = 0; ph < pooled_height_; ++ph) {
+      for (int pw = 0; pw < pooled_width_; ++pw) {
+        int hstart = ph * stride_h_ - pad_h_;
+        int wstart = pw * stride_w_ - pad_w_;
+        const int hend = min(hstart + kernel_h_, height_);
+        const int wend = min(wstart + kernel_w_, width_);
+        hstart = max(hstart, 0);
+        wstart = max(wstart, 0);
+        Dtype max_value = -FLT_MAX;
+        int max_index = -1;
+        for (int h = hstart; h < hend; ++h) {
+          for (int w = wstart; w < wend; ++w) {
+            if (image[h * width_ + w] > max_value) {
+              max_value = image[h * width_ + w];
+              max_index = h * width_ + w;
+            }
+          }
+        }
+        if (max_index >= 0) {
+          bottom_diff[i * bottom_dim + max_index] +=
+              top_diff[i * top_dim + ph * pooled_width_ + pw];
+        }
+      }
+    }
+  }
+}
 
 #ifdef CPU_ONLY
 STUB_GPU(PoolingLayer);
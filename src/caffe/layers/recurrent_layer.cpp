@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -10,6 +11,17 @@
 
 namespace caffe {
 
+namespace {
+
+// Orders the streams by decreasing length, keeping the order of equals.
+struct LongerStream {
+  explicit LongerStream(const vector<int>& lengths) : lengths_(lengths) {}
+  bool operator()(int a, int b) const { return lengths_[a] > lengths_[b]; }
+  const vector<int>& lengths_;
+};
+
+}  // namespace
+
 template <typename Dtype>
 void RecurrentLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -28,6 +40,12 @@ void RecurrentLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // If expose_hidden is set, we take as input and produce as output
   // the hidden state blobs at the first and last timesteps.
   expose_hidden_ = this->layer_param_.recurrent_param().expose_hidden();
+  fused_ = this->layer_param_.recurrent_param().fused() &&
+      HasFusedImplementation();
+  variable_length_ = this->layer_param_.recurrent_param().variable_length();
+  CHECK(!variable_length_ || fused_) << type()
+      << " layers need the fused implementation for variable_length.";
+  packed_ = false;
 
   // Get (recurrent) input/output names.
   vector<string> output_names;
@@ -104,6 +122,10 @@ void RecurrentLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     layer->add_loss_weight(1);
   }
 
+  // The fused pass writes the outputs and states of the unrolled net itself,
+  // which must then not be views of one another.
+  net_param.set_blob_views(false);
+
   // Create the unrolled net.
   unrolled_net_.reset(new Net<Dtype>(net_param));
   unrolled_net_->set_debug_info(
@@ -249,7 +271,8 @@ void RecurrentLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   // currently point to a stale owner blob that was dropped when Solver::Test
   // called test_net->ShareTrainedLayersWith(net_.get()).
   // TODO: somehow make this work non-hackily.
-  if (this->phase_ == TEST) {
+  // (The fused pass uses only the owned parameters, which are shared.)
+  if (this->phase_ == TEST && !fused_) {
     unrolled_net_->ShareWeights();
   }
 
@@ -264,7 +287,12 @@ void RecurrentLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     }
   }
 
-  unrolled_net_->ForwardTo(last_layer_index_);
+  if (fused_) {
+    PackBatch();
+    FusedForward_cpu();
+  } else {
+    unrolled_net_->ForwardTo(last_layer_index_);
+  }
 
   if (expose_hidden_) {
     const int top_offset = output_blobs_.size();
@@ -284,7 +312,161 @@ void RecurrentLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   // backprop to inputs and parameters unconditionally, as either the inputs or
   // the parameters do need backward (or Net would have set
   // layer_needs_backward_[i] == false for this layer).
-  unrolled_net_->BackwardFrom(last_layer_index_);
+  // In GPU mode this follows Forward_gpu, which ran the unrolled net unless
+  // the batch has variable lengths.
+  if (fused_ && (Caffe::mode() == Caffe::CPU || variable_length_)) {
+    FusedBackward_cpu(propagate_down);
+  } else {
+    unrolled_net_->BackwardFrom(last_layer_index_);
+  }
+}
+
+template <typename Dtype>
+void RecurrentLayer<Dtype>::Step(int T, int num, const Dtype* x,
+    const vector<Dtype*>& states, Dtype* y) {
+  CHECK(HasFusedImplementation()) << type()
+      << " layers have no fused implementation to step.";
+  CHECK(!static_input_) << "Cannot step a layer with a static input.";
+  CHECK_EQ(num_states(), states.size());
+  if (T == 0 || num == 0) { return; }
+  FusedStep_cpu(T, num, x, states, y);
+}
+
+template <typename Dtype>
+void RecurrentLayer<Dtype>::PackBatch() {
+  const Dtype* cont = cont_input_blob_->cpu_data();
+  lengths_.assign(N_, T_);
+  if (variable_length_) {
+    for (int n = 0; n < N_; ++n) {
+      for (int t = 0; t < T_; ++t) {
+        if (cont[t * N_ + n] < 0) {
+          lengths_[n] = t;
+          break;
+        }
+      }
+      for (int t = lengths_[n]; t < T_; ++t) {
+        CHECK_LT(cont[t * N_ + n], 0) << "Stream " << n
+            << " continues after the end of its sequence at timestep "
+            << lengths_[n] << ".";
+      }
+    }
+  }
+  order_.resize(N_);
+  for (int n = 0; n < N_; ++n) {
+    order_[n] = n;
+  }
+  std::stable_sort(order_.begin(), order_.end(), LongerStream(lengths_));
+  batch_sizes_.assign(T_, 0);
+  batch_offsets_.assign(T_ + 1, 0);
+  for (int t = 0; t < T_; ++t) {
+    while (batch_sizes_[t] < N_ && lengths_[order_[batch_sizes_[t]]] > t) {
+      ++batch_sizes_[t];
+    }
+    batch_offsets_[t + 1] = batch_offsets_[t] + batch_sizes_[t];
+  }
+  packed_ = batch_offsets_[T_] < T_ * N_;
+  if (packed_) {
+    packed_input_.ReshapeLike(*x_input_blob_);
+    PackRows(x_input_blob_->cpu_data(), x_input_blob_->count(2),
+        packed_input_.mutable_cpu_data());
+  }
+}
+
+template <typename Dtype>
+void RecurrentLayer<Dtype>::PackRows(const Dtype* rows, int dim,
+    Dtype* packed) const {
+  if (!packed_) {
+    caffe_copy(T_ * N_ * dim, rows, packed);
+    return;
+  }
+  for (int t = 0; t < T_; ++t) {
+    for (int j = 0; j < batch_sizes_[t]; ++j) {
+      caffe_copy(dim, rows + (t * N_ + order_[j]) * dim,
+          packed + (batch_offsets_[t] + j) * dim);
+    }
+  }
+}
+
+template <typename Dtype>
+void RecurrentLayer<Dtype>::UnpackRows(const Dtype* packed, int dim,
+    Dtype* rows) const {
+  if (!packed_) {
+    caffe_copy(T_ * N_ * dim, packed, rows);
+    return;
+  }
+  for (int t = 0; t < T_; ++t) {
+    for (int j = 0; j < N_; ++j) {
+      Dtype* row = rows + (t * N_ + order_[j]) * dim;
+      if (j < batch_sizes_[t]) {
+        caffe_copy(dim, packed + (batch_offsets_[t] + j) * dim, row);
+      } else {
+        caffe_set(dim, Dtype(0), row);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+const Dtype* RecurrentLayer<Dtype>::packed_input() const {
+  return packed_ ? packed_input_.cpu_data() : x_input_blob_->cpu_data();
+}
+
+template <typename Dtype>
+const Dtype* RecurrentLayer<Dtype>::PackedRecurrentInput(int i) {
+  const Blob<Dtype>& input = *recur_input_blobs_[i];
+  if (!packed_) {
+    return input.cpu_data();
+  }
+  packed_recur_inputs_.resize(recur_input_blobs_.size());
+  if (!packed_recur_inputs_[i]) {
+    packed_recur_inputs_[i].reset(new Blob<Dtype>());
+  }
+  Blob<Dtype>* packed = packed_recur_inputs_[i].get();
+  packed->ReshapeLike(input);
+  const int dim = input.count() / N_;
+  for (int j = 0; j < N_; ++j) {
+    caffe_copy(dim, input.cpu_data() + order_[j] * dim,
+        packed->mutable_cpu_data() + j * dim);
+  }
+  return packed->cpu_data();
+}
+
+template <typename Dtype>
+void RecurrentLayer<Dtype>::ContRows(int t, int dim, const Dtype* rows,
+    Dtype* conted) const {
+  const int batch = batch_sizes_[t];
+  const Dtype* cont = cont_input_blob_->cpu_data() + t * N_;
+  int j = 0;
+  while (j < batch && cont[order_[j]] == 1) { ++j; }
+  caffe_copy(j * dim, rows, conted);
+  for (; j < batch; ++j) {
+    const Dtype c = cont[order_[j]];
+    if (c == 1) {
+      caffe_copy(dim, rows + j * dim, conted + j * dim);
+    } else if (c == 0) {
+      caffe_set(dim, Dtype(0), conted + j * dim);
+    } else {
+      caffe_cpu_scale(dim, c, rows + j * dim, conted + j * dim);
+    }
+  }
+}
+
+template <typename Dtype>
+void RecurrentLayer<Dtype>::UnpackRecurrentOutput(int i,
+    const Dtype* packed) {
+  const int dim = recur_output_blobs_[i]->count() / N_;
+  Dtype* output = recur_output_blobs_[i]->mutable_cpu_data();
+  if (!packed_) {
+    caffe_copy(N_ * dim, packed + batch_offsets_[T_ - 1] * dim, output);
+    return;
+  }
+  const Dtype* input = recur_input_blobs_[i]->cpu_data();
+  for (int j = 0; j < N_; ++j) {
+    const int n = order_[j];
+    const int length = lengths_[n];
+    caffe_copy(dim, length ? packed + (batch_offsets_[length - 1] + j) * dim :
+        input + n * dim, output + n * dim);
+  }
 }
 
 #ifdef CPU_ONLY
@@ -0,0 +1,52 @@
+#include <vector>
+
+#include "caffe/layers/reorder_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void ReorderLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  CHECK_NE(top[0], bottom[0]) << this->type() << " Layer does not "
+      "allow in-place computation.";
+  BlobLayout layout = this->layer_param_.reorder_param().layout();
+  if (!bottom[0]->LayoutFits(layout)) {
+    layout = NCHW;
+  }
+  top[0]->set_layout(NCHW);
+  top[0]->ReshapeLike(*bottom[0]);
+  top[0]->set_layout(layout);
+}
+
+template <typename Dtype>
+void ReorderLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  if (top[0]->layout() == bottom[0]->layout()) {
+    caffe_copy(bottom[0]->count(), bottom[0]->cpu_data(),
+        top[0]->mutable_cpu_data());
+    return;
+  }
+  caffe_cpu_reorder(bottom[0]->num(), bottom[0]->channels(),
+      bottom[0]->count(2), bottom[0]->layout_block(), top[0]->layout_block(),
+      bottom[0]->cpu_data(), top[0]->mutable_cpu_data());
+}
+
+template <typename Dtype>
+void ReorderLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  if (!propagate_down[0]) { return; }
+  if (top[0]->layout() == bottom[0]->layout()) {
+    caffe_copy(top[0]->count(), top[0]->cpu_diff(),
+        bottom[0]->mutable_cpu_diff());
+    return;
+  }
+  caffe_cpu_reorder(top[0]->num(), top[0]->channels(), top[0]->count(2),
+      top[0]->layout_block(), bottom[0]->layout_block(), top[0]->cpu_diff(),
+      bottom[0]->mutable_cpu_diff());
+}
+
+INSTANTIATE_CLASS(ReorderLayer);
+REGISTER_LAYER_CLASS(Reorder);
+
+}  // namespace caffe
@@ -1,3 +1,4 @@
+#include <cmath>
 #include <string>
 #include <vector>
 
@@ -230,6 +231,234 @@ void RNNLayer<Dtype>::FillUnrolledNet(NetParameter* net_param) const {
   net_param->add_layer()->CopyFrom(output_concat_layer);
 }
 
+template <typename Dtype>
+void RNNLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  RecurrentLayer<Dtype>::Reshape(bottom, top);
+  if (!this->fused_) { return; }
+  const int num_output = this->layer_param_.recurrent_param().num_output();
+  vector<int> shape(3);
+  shape[0] = this->T_;
+  shape[1] = this->N_;
+  shape[2] = num_output;
+  hidden_.Reshape(shape);
+  hidden_conted_.Reshape(shape);
+  output_.Reshape(shape);
+  shape[0] = 1;
+  hidden_prev_diff_.Reshape(shape);
+  if (this->static_input_) {
+    static_hidden_.Reshape(shape);
+  }
+  vector<int> bias_shape(1, this->T_ * this->N_);
+  bias_multiplier_.Reshape(bias_shape);
+  caffe_set(bias_multiplier_.count(), Dtype(1),
+      bias_multiplier_.mutable_cpu_data());
+}
+
+template <typename Dtype>
+void RNNLayer<Dtype>::FusedForward_cpu() {
+  const int T = this->T_;
+  const int N = this->N_;
+  const int hidden_dim = this->layer_param_.recurrent_param().num_output();
+  const int input_dim = this->x_input_blob_->count(2);
+  const int rows = this->batch_offsets_[T];
+  const Dtype* W_hh = this->blobs_[2 + this->static_input_]->cpu_data();
+  const Dtype* W_ho = this->blobs_[3 + this->static_input_]->cpu_data();
+  const Dtype* b_o = this->blobs_[4 + this->static_input_]->cpu_data();
+  Dtype* hidden = hidden_.mutable_cpu_data();
+
+  // Project the input of all timesteps at once.
+  //     h_neuron_input := W_xh * x + b_h + W_xh_static * x_static
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, rows, hidden_dim,
+      input_dim, (Dtype)1., this->packed_input(),
+      this->blobs_[0]->cpu_data(), (Dtype)0., hidden);
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, rows, hidden_dim, 1,
+      (Dtype)1., bias_multiplier_.cpu_data(), this->blobs_[1]->cpu_data(),
+      (Dtype)1., hidden);
+  if (this->static_input_) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, N, hidden_dim,
+        this->x_static_input_blob_->count(1), (Dtype)1.,
+        this->x_static_input_blob_->cpu_data(), this->blobs_[2]->cpu_data(),
+        (Dtype)0., static_hidden_.mutable_cpu_data());
+    for (int t = 0; t < T; ++t) {
+      for (int j = 0; j < this->batch_sizes_[t]; ++j) {
+        caffe_axpy<Dtype>(hidden_dim, 1,
+            static_hidden_.cpu_data() + this->order_[j] * hidden_dim,
+            hidden + (this->batch_offsets_[t] + j) * hidden_dim);
+      }
+    }
+  }
+
+  // The streams active at a timestep are the first ones of the previous.
+  const Dtype* H_prev = this->PackedRecurrentInput(0);
+  for (int t = 0; t < T && this->batch_sizes_[t]; ++t) {
+    const int batch = this->batch_sizes_[t];
+    const int row = this->batch_offsets_[t];
+    Dtype* H = hidden + row * hidden_dim;
+    Dtype* H_conted = hidden_conted_.mutable_cpu_data() + row * hidden_dim;
+    //     h_conted_{t-1} := cont_t * h_{t-1}
+    //     h_t := \tanh( W_hh * h_conted_{t-1} + h_neuron_input_t )
+    this->ContRows(t, hidden_dim, H_prev, H_conted);
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, batch, hidden_dim,
+        hidden_dim, (Dtype)1., H_conted, W_hh, (Dtype)1., H);
+    for (int i = 0; i < batch * hidden_dim; ++i) {
+      H[i] = std::tanh(H[i]);
+    }
+    H_prev = H;
+  }
+
+  // Project the output of all timesteps at once.
+  //     o := \tanh( W_ho * h + b_o )
+  Dtype* O = output_.mutable_cpu_data();
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, rows, hidden_dim,
+      hidden_dim, (Dtype)1., hidden_.cpu_data(), W_ho, (Dtype)0., O);
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, rows, hidden_dim, 1,
+      (Dtype)1., bias_multiplier_.cpu_data(), b_o, (Dtype)1., O);
+  for (int i = 0; i < rows * hidden_dim; ++i) {
+    O[i] = std::tanh(O[i]);
+  }
+
+  this->UnpackRows(output_.cpu_data(), hidden_dim,
+      this->output_blobs_[0]->mutable_cpu_data());
+  this->UnpackRecurrentOutput(0, hidden_.cpu_data());
+}
+
+template <typename Dtype>
+void RNNLayer<Dtype>::FusedBackward_cpu(const vector<bool>& propagate_down) {
+  const int T = this->T_;
+  const int N = this->N_;
+  const int hidden_dim = this->layer_param_.recurrent_param().num_output();
+  const int input_dim = this->x_input_blob_->count(2);
+  const int rows = this->batch_offsets_[T];
+  Blob<Dtype>* W_hh = this->blobs_[2 + this->static_input_].get();
+  Blob<Dtype>* W_ho = this->blobs_[3 + this->static_input_].get();
+  Blob<Dtype>* b_o = this->blobs_[4 + this->static_input_].get();
+  const Dtype* H = hidden_.cpu_data();
+  Dtype* H_diff = hidden_.mutable_cpu_diff();
+
+  // Backpropagate the output of all timesteps at once.
+  const Dtype* O = output_.cpu_data();
+  Dtype* O_diff = output_.mutable_cpu_diff();
+  this->PackRows(this->output_blobs_[0]->cpu_diff(), hidden_dim, O_diff);
+  for (int i = 0; i < rows * hidden_dim; ++i) {
+    O_diff[i] *= 1 - O[i] * O[i];
+  }
+  caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, hidden_dim, hidden_dim,
+      rows, (Dtype)1., O_diff, H, (Dtype)1., W_ho->mutable_cpu_diff());
+  caffe_cpu_gemv<Dtype>(CblasTrans, rows, hidden_dim, (Dtype)1., O_diff,
+      bias_multiplier_.cpu_data(), (Dtype)1., b_o->mutable_cpu_diff());
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, rows, hidden_dim,
+      hidden_dim, (Dtype)1., O_diff, W_ho->cpu_data(), (Dtype)0., H_diff);
+
+  // The diff of h_T is not backpropagated across batches.
+  Dtype* prev_diff = hidden_prev_diff_.mutable_cpu_diff();
+  for (int t = T - 1; t >= 0; --t) {
+    const int batch = this->batch_sizes_[t];
+    const int row = this->batch_offsets_[t];
+    for (int i = row * hidden_dim; i < (row + batch) * hidden_dim; ++i) {
+      H_diff[i] *= 1 - H[i] * H[i];
+    }
+    if (t && batch) {
+      //     diff h_{t-1} += cont_t * W_hh' * diff h_neuron_input_t
+      const Dtype* cont = this->cont_input_blob_->cpu_data() + t * N;
+      const int prev_row = this->batch_offsets_[t - 1];
+      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, batch, hidden_dim,
+          hidden_dim, (Dtype)1., H_diff + row * hidden_dim, W_hh->cpu_data(),
+          (Dtype)0., prev_diff);
+      for (int j = 0; j < batch; ++j) {
+        caffe_axpy(hidden_dim, cont[this->order_[j]],
+            prev_diff + j * hidden_dim,
+            H_diff + (prev_row + j) * hidden_dim);
+      }
+    }
+  }
+
+  // The gradients of the weights, over all timesteps at once.
+  caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, hidden_dim, hidden_dim,
+      rows, (Dtype)1., H_diff, hidden_conted_.cpu_data(), (Dtype)1.,
+      W_hh->mutable_cpu_diff());
+  caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, hidden_dim, input_dim,
+      rows, (Dtype)1., H_diff, this->packed_input(), (Dtype)1.,
+      this->blobs_[0]->mutable_cpu_diff());
+  caffe_cpu_gemv<Dtype>(CblasTrans, rows, hidden_dim, (Dtype)1., H_diff,
+      bias_multiplier_.cpu_data(), (Dtype)1.,
+      this->blobs_[1]->mutable_cpu_diff());
+  if (propagate_down[0]) {
+    Dtype* x_diff = this->packed_ ? this->packed_input_.mutable_cpu_diff() :
+        this->x_input_blob_->mutable_cpu_diff();
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, rows, input_dim,
+        hidden_dim, (Dtype)1., H_diff, this->blobs_[0]->cpu_data(),
+        (Dtype)0., x_diff);
+    if (this->packed_) {
+      this->UnpackRows(x_diff, input_dim,
+          this->x_input_blob_->mutable_cpu_diff());
+    }
+  }
+  if (this->static_input_) {
+    const int static_dim = this->x_static_input_blob_->count(1);
+    Dtype* static_diff = static_hidden_.mutable_cpu_diff();
+    caffe_set(N * hidden_dim, Dtype(0), static_diff);
+    for (int t = 0; t < T; ++t) {
+      for (int j = 0; j < this->batch_sizes_[t]; ++j) {
+        caffe_axpy<Dtype>(hidden_dim, 1,
+            H_diff + (this->batch_offsets_[t] + j) * hidden_dim,
+            static_diff + this->order_[j] * hidden_dim);
+      }
+    }
+    caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, hidden_dim, static_dim,
+        N, (Dtype)1., static_diff, this->x_static_input_blob_->cpu_data(),
+        (Dtype)1., this->blobs_[2]->mutable_cpu_diff());
+    if (propagate_down[2]) {
+      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, N, static_dim,
+          hidden_dim, (Dtype)1., static_diff, this->blobs_[2]->cpu_data(),
+          (Dtype)0., this->x_static_input_blob_->mutable_cpu_diff());
+    }
+  }
+}
+
+template <typename Dtype>
+void RNNLayer<Dtype>::FusedStep_cpu(int T, int num, const Dtype* x,
+    const vector<Dtype*>& states, Dtype* y) {
+  const int hidden_dim = this->layer_param_.recurrent_param().num_output();
+  const int rows = T * num;
+  const Dtype* W_hh = this->blobs_[2]->cpu_data();
+  vector<int> shape(2, rows);
+  shape[1] = hidden_dim;
+  step_hidden_.Reshape(shape);
+  Dtype* hidden = step_hidden_.mutable_cpu_data();
+
+  //     h_neuron_input := W_xh * x + b_h
+  for (int i = 0; i < rows; ++i) {
+    caffe_copy(hidden_dim, this->blobs_[1]->cpu_data(),
+        hidden + i * hidden_dim);
+  }
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, rows, hidden_dim,
+      this->input_dim(), (Dtype)1., x, this->blobs_[0]->cpu_data(),
+      (Dtype)1., hidden);
+  const Dtype* H_prev = states[0];
+  for (int t = 0; t < T; ++t) {
+    Dtype* H = hidden + t * num * hidden_dim;
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, num, hidden_dim,
+        hidden_dim, (Dtype)1., H_prev, W_hh, (Dtype)1., H);
+    for (int i = 0; i < num * hidden_dim; ++i) {
+      H[i] = std::tanh(H[i]);
+    }
+    H_prev = H;
+  }
+  caffe_copy(num * hidden_dim, H_prev, states[0]);
+
+  //     o := \tanh( W_ho * h + b_o )
+  for (int i = 0; i < rows; ++i) {
+    caffe_copy(hidden_dim, this->blobs_[4]->cpu_data(), y + i * hidden_dim);
+  }
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, rows, hidden_dim,
+      hidden_dim, (Dtype)1., hidden, this->blobs_[3]->cpu_data(), (Dtype)1.,
+      y);
+  for (int i = 0; i < rows * hidden_dim; ++i) {
+    y[i] = std::tanh(y[i]);
+  }
+}
+
 INSTANTIATE_CLASS(RNNLayer);
 REGISTER_LAYER_CLASS(RNN);
 
@@ -101,6 +101,9 @@ void ScaleLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   } else {
     top[0]->ReshapeLike(*bottom[0]);
   }
+  CHECK(bottom[0]->layout() == NCHW || (axis_ == 1 && scale->num_axes() == 1))
+      << "Only NCHW bottoms are scaled other than by channel.";
+  top[0]->set_layout(bottom[0]->layout());
   sum_result_.Reshape(vector<int>(1, outer_dim_ * scale_dim_));
   const int sum_mult_size = std::max(outer_dim_, inner_dim_);
   sum_multiplier_.Reshape(vector<int>(1, sum_mult_size));
@@ -117,6 +120,18 @@ template <typename Dtype>
 void ScaleLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
+  if (bottom[0]->layout() != NCHW) {
+    // Scales and biases each block of channels in one pass, which keeps no
+    // copy of the bottom for Backward.
+    const Dtype* scale_data =
+        ((bottom.size() > 1) ? bottom[1] : this->blobs_[0].get())->cpu_data();
+    const Dtype* bias_data = bias_layer_ ?
+        this->blobs_[bias_param_id_]->cpu_data() : NULL;
+    caffe_cpu_scale_channels(outer_dim_, scale_dim_, inner_dim_,
+        bottom[0]->layout_block(), scale_data, bias_data, bottom_data,
+        top[0]->mutable_cpu_data());
+    return;
+  }
   if (bottom[0] == top[0]) {
     // In-place computation; need to store bottom data before overwriting it.
     // Note that this is only necessary for Backward; we could skip this if not
@@ -144,6 +159,8 @@ void ScaleLayer<Dtype>::Forward_cpu(
 template <typename Dtype>
 void ScaleLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  CHECK_EQ(bottom[0]->layout(), NCHW)
+      << "Only NCHW bottoms are scaled in Backward.";
   if (bias_layer_ &&
       this->param_propagate_down_[this->param_propagate_down_.size() - 1]) {
     bias_layer_->Backward(top, bias_propagate_down_, bias_bottom_vec_);
@@ -29,6 +29,11 @@ __global__ void ScaleBiasForward(const int n, const Dtype* in,
 template <typename Dtype>
 void ScaleLayer<Dtype>::Forward_gpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  // The other layouts are scaled on the CPU.
+  if (bottom[0]->layout() != NCHW) {
+    Forward_cpu(bottom, top);
+    return;
+  }
   const int count = top[0]->count();
   const Dtype* bottom_data = bottom[0]->gpu_data();
   if (bottom[0] == top[0]) {
@@ -19,6 +19,7 @@ void SoftmaxWithLossLayer<Dtype>::LayerSetUp(
   softmax_top_vec_.clear();
   softmax_top_vec_.push_back(&prob_);
   softmax_layer_->SetUp(softmax_bottom_vec_, softmax_top_vec_);
+  prob_computed_ = false;
 
   has_ignore_label_ =
     this->layer_param_.loss_param().has_ignore_label();
@@ -49,6 +50,9 @@ void SoftmaxWithLossLayer<Dtype>::Reshape(
       << "e.g., if softmax axis == 1 and prediction shape is (N, C, H, W), "
       << "label count (number of labels) must be N*H*W, "
       << "with integer values in {0, 1, ..., C-1}.";
+  vector<int> log_norm_dims = bottom[0]->shape();
+  log_norm_dims[softmax_axis_] = 1;
+  log_norm_.Reshape(log_norm_dims);
   if (top.size() >= 2) {
     // softmax output
     top[1]->ReshapeLike(*bottom[0]);
@@ -88,11 +92,21 @@ Dtype SoftmaxWithLossLayer<Dtype>::get_normalizer(
 template <typename Dtype>
 void SoftmaxWithLossLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  // The forward pass computes the softmax prob values.
-  softmax_layer_->Forward(softmax_bottom_vec_, softmax_top_vec_);
-  const Dtype* prob_data = prob_.cpu_data();
+  // The loss is computed from the log of the softmax normalizer, in the same
+  // pass over the predictions as the probabilities. Only Backward and the
+  // second top need those, so the TEST phase skips them without that top, and
+  // Backward computes them if it runs after all.
+  const Dtype* bottom_data = bottom[0]->cpu_data();
   const Dtype* label = bottom[1]->cpu_data();
-  int dim = prob_.count() / outer_num_;
+  const int channels = bottom[0]->shape(softmax_axis_);
+  prob_computed_ = this->phase_ == TRAIN || top.size() >= 2;
+  caffe_cpu_softmax(outer_num_, channels, inner_num_, bottom_data,
+      prob_computed_ ? prob_.mutable_cpu_data() : static_cast<Dtype*>(NULL),
+      log_norm_.mutable_cpu_data());
+  const Dtype* log_norm = log_norm_.cpu_data();
+  // log(FLT_MIN) bounds the loss of a position, as the prob is clamped to it.
+  const Dtype min_log_prob = log(Dtype(FLT_MIN));
+  int dim = bottom[0]->count() / outer_num_;
   int count = 0;
   Dtype loss = 0;
   for (int i = 0; i < outer_num_; ++i) {
@@ -102,9 +116,9 @@ void SoftmaxWithLossLayer<Dtype>::Forward_cpu(
         continue;
       }
       DCHECK_GE(label_value, 0);
-      DCHECK_LT(label_value, prob_.shape(softmax_axis_));
-      loss -= log(std::max(prob_data[i * dim + label_value * inner_num_ + j],
-                           Dtype(FLT_MIN)));
+      DCHECK_LT(label_value, channels);
+      loss -= std::max(bottom_data[i * dim + label_value * inner_num_ + j] -
+          log_norm[i * inner_num_ + j], min_log_prob);
       ++count;
     }
   }
@@ -122,12 +136,27 @@ void SoftmaxWithLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                << " Layer cannot backpropagate to label inputs.";
   }
   if (propagate_down[0]) {
-    Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-    const Dtype* prob_data = prob_.cpu_data();
-    caffe_copy(prob_.count(), prob_data, bottom_diff);
+    if (!prob_computed_) {
+      caffe_cpu_softmax(outer_num_, bottom[0]->shape(softmax_axis_),
+          inner_num_, bottom[0]->cpu_data(), prob_.mutable_cpu_data(),
+          static_cast<Dtype*>(NULL));
+      prob_computed_ = true;
+    }
     const Dtype* label = bottom[1]->cpu_data();
-    int dim = prob_.count() / outer_num_;
     int count = 0;
+    for (int i = 0; i < outer_num_ * inner_num_; ++i) {
+      if (!has_ignore_label_ ||
+          static_cast<int>(label[i]) != ignore_label_) {
+        ++count;
+      }
+    }
+    // The gradient is the scaled prob, less the scale at the label.
+    const Dtype loss_weight = top[0]->cpu_diff()[0] /
+                              get_normalizer(normalization_, count);
+    Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+    caffe_cpu_scale(prob_.count(), loss_weight, prob_.cpu_data(),
+        bottom_diff);
+    int dim = prob_.count() / outer_num_;
     for (int i = 0; i < outer_num_; ++i) {
       for (int j = 0; j < inner_num_; ++j) {
         const int label_value = static_cast<int>(label[i * inner_num_ + j]);
@@ -136,15 +165,10 @@ void SoftmaxWithLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
             bottom_diff[i * dim + c * inner_num_ + j] = 0;
           }
         } else {
-          bottom_diff[i * dim + label_value * inner_num_ + j] -= 1;
-          ++count;
+          bottom_diff[i * dim + label_value * inner_num_ + j] -= loss_weight;
         }
       }
     }
-    // Scale gradient
-    Dtype loss_weight = top[0]->cpu_diff()[0] /
-                        get_normalizer(normalization_, count);
-    caffe_scal(prob_.count(), loss_weight, bottom_diff);
   }
 }
 
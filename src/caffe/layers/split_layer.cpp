@@ -18,6 +18,7 @@ void SplitLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     CHECK_NE(top[i], bottom[0]) << this->type() << " Layer does not "
         "allow in-place computation.";
     top[i]->ReshapeLike(*bottom[0]);
+    top[i]->set_layout(bottom[0]->layout());
     CHECK_EQ(count_, top[i]->count());
   }
 }
@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "caffe/memory_report.hpp"
+#include "caffe/util/memory_tracker.hpp"
+
+namespace caffe {
+
+namespace {
+
+template <typename Dtype>
+bool LargerLayer(const typename MemoryReport<Dtype>::LayerMemory& a,
+    const typename MemoryReport<Dtype>::LayerMemory& b) {
+  return a.total() > b.total();
+}
+
+template <typename Dtype>
+bool LargerBlob(const typename MemoryReport<Dtype>::BlobMemory& a,
+    const typename MemoryReport<Dtype>::BlobMemory& b) {
+  return a.bytes > b.bytes;
+}
+
+string MB(size_t bytes) {
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(2) << bytes / 1048576.0;
+  return out.str();
+}
+
+}  // namespace
+
+template <typename Dtype>
+MemoryReport<Dtype>::MemoryReport(const Net<Dtype>& net)
+    : params_(0), activations_(0), scratch_(0) {
+  LOG_IF(WARNING, !MemoryTracker::enabled())
+      << "Memory tracking is off; only memory allocated while it was on is "
+      << "reported.";
+  // The bytes of each tracked memory, on host and device together.
+  map<const SyncedMemory*, size_t> tracked;
+  const vector<MemoryTracker::Allocation> allocations =
+      MemoryTracker::allocations();
+  for (int i = 0; i < allocations.size(); ++i) {
+    tracked[allocations[i].memory] += allocations[i].bytes;
+  }
+  // The memories of the blobs of the net, each counted for its first blob.
+  std::set<const SyncedMemory*> seen;
+  const vector<shared_ptr<Layer<Dtype> > >& layers = net.layers();
+  map<const void*, int> layer_ids;
+  layers_.resize(layers.size());
+  for (int i = 0; i < layers.size(); ++i) {
+    layer_ids[layers[i].get()] = i;
+    LayerMemory& layer = layers_[i];
+    layer.name = net.layer_names()[i];
+    layer.type = layers[i]->type();
+    layer.params = layer.activations = layer.scratch = 0;
+    const MemoryTracker::Usage usage = MemoryTracker::usage(layers[i].get());
+    layer.peak = usage.peak;
+    layer.allocations = usage.allocations;
+    // Layer has no const accessor of its blobs.
+    const vector<shared_ptr<Blob<Dtype> > >& params =
+        const_cast<Layer<Dtype>&>(*layers[i]).blobs();
+    for (int j = 0; j < params.size() + net.top_ids(i).size(); ++j) {
+      const bool param = j < params.size();
+      const Blob<Dtype>& blob = param ? *params[j] :
+          *net.blobs()[net.top_ids(i)[j - params.size()]];
+      if (blob.count() == 0) { continue; }
+      BlobMemory memory;
+      std::ostringstream name;
+      if (param) {
+        name << layer.name << "[" << j << "]";
+      } else {
+        name << net.blob_names()[net.top_ids(i)[j - params.size()]];
+      }
+      memory.name = name.str();
+      memory.bytes = 0;
+      const SyncedMemory* memories[] = { blob.data().get(),
+          blob.diff().get() };
+      for (int k = 0; k < 2; ++k) {
+        if (seen.insert(memories[k]).second && tracked.count(memories[k])) {
+          memory.bytes += tracked[memories[k]];
+        }
+      }
+      (param ? layer.params : layer.activations) += memory.bytes;
+      if (memory.bytes) {
+        blobs_.push_back(memory);
+      }
+    }
+    params_ += layer.params;
+    activations_ += layer.activations;
+  }
+  // What remains of the allocations of each layer is its own.
+  for (int i = 0; i < allocations.size(); ++i) {
+    map<const void*, int>::const_iterator layer =
+        layer_ids.find(allocations[i].owner);
+    if (layer != layer_ids.end() && !seen.count(allocations[i].memory)) {
+      layers_[layer->second].scratch += allocations[i].bytes;
+      scratch_ += allocations[i].bytes;
+    }
+  }
+  std::stable_sort(layers_.begin(), layers_.end(), LargerLayer<Dtype>);
+  std::stable_sort(blobs_.begin(), blobs_.end(), LargerBlob<Dtype>);
+}
+
+template <typename Dtype>
+string MemoryReport<Dtype>::Text() const {
+  std::ostringstream out;
+  out << "Memory by layer (MB):\n" << std::setw(20) << "layer"
+      << std::setw(16) << "type" << std::setw(10) << "params"
+      << std::setw(12) << "activations" << std::setw(10) << "scratch"
+      << std::setw(10) << "peak" << std::setw(8) << "allocs" << "\n";
+  for (int i = 0; i < layers_.size(); ++i) {
+    const LayerMemory& layer = layers_[i];
+    out << std::setw(20) << layer.name << std::setw(16) << layer.type
+        << std::setw(10) << MB(layer.params)
+        << std::setw(12) << MB(layer.activations)
+        << std::setw(10) << MB(layer.scratch) << std::setw(10)
+        << MB(layer.peak) << std::setw(8) << layer.allocations << "\n";
+  }
+  out << std::setw(36) << "total" << std::setw(10) << MB(params_)
+      << std::setw(12) << MB(activations_) << std::setw(10) << MB(scratch_)
+      << "\n";
+  out << "Memory by blob (MB):\n";
+  for (int i = 0; i < blobs_.size(); ++i) {
+    out << std::setw(20) << blobs_[i].name << std::setw(10)
+        << MB(blobs_[i].bytes) << "\n";
+  }
+  return out.str();
+}
+
+INSTANTIATE_CLASS(MemoryReport);
+
+}  // namespace caffe
@@ -0,0 +1,97 @@
+#include <cmath>
+#include <vector>
+
+#include "caffe/mixed_precision.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+MixedPrecision<Dtype>::MixedPrecision(const SolverParameter& param,
+    const shared_ptr<Net<Dtype> >& net)
+    : net_(net), loss_scale_(param.loss_scale()), base_gradient_scale_(1),
+      loss_scale_window_(param.loss_scale_window()),
+      iters_since_overflow_(0),
+      after_forward_(this, &MixedPrecision::AfterForward),
+      after_backward_(this, &MixedPrecision::AfterBackward) {
+  CHECK_GT(loss_scale_, 0) << "loss_scale must be positive.";
+  CHECK_GE(loss_scale_window_, 0) << "loss_scale_window must be non-negative.";
+  const vector<Blob<Dtype>*>& params = net_->learnable_params();
+  for (int i = 0; i < params.size(); ++i) {
+    master_params_.push_back(
+        shared_ptr<Blob<Dtype> >(new Blob<Dtype>(params[i]->shape())));
+  }
+  net_->add_after_forward(&after_forward_);
+  net_->add_after_backward(&after_backward_);
+}
+
+template <typename Dtype>
+void MixedPrecision<Dtype>::on_start() {
+  const vector<Blob<Dtype>*>& params = net_->learnable_params();
+  for (int i = 0; i < params.size(); ++i) {
+    master_params_[i]->CopyFrom(*params[i], false, true);
+    caffe_cpu_round_bf16(params[i]->count(), params[i]->mutable_cpu_data());
+  }
+  base_gradient_scale_ = net_->loss_gradient_scale();
+  net_->set_loss_gradient_scale(base_gradient_scale_ * loss_scale_);
+}
+
+template <typename Dtype>
+void MixedPrecision<Dtype>::on_gradients_ready() {
+  const vector<Blob<Dtype>*>& params = net_->learnable_params();
+  for (int i = 0; i < params.size(); ++i) {
+    params[i]->CopyFrom(*master_params_[i]);
+  }
+  net_->set_loss_gradient_scale(base_gradient_scale_);
+}
+
+template <typename Dtype>
+void MixedPrecision<Dtype>::AfterForward(int layer_id) {
+  // Only activations on the backward path are rounded; this leaves labels
+  // and other integer-valued blobs, which bfloat16 cannot hold exactly, alone.
+  if (!net_->layer_need_backward()[layer_id]) { return; }
+  const vector<Blob<Dtype>*>& top = net_->top_vecs()[layer_id];
+  const vector<int>& top_ids = net_->top_ids(layer_id);
+  for (int i = 0; i < top.size(); ++i) {
+    if (net_->blob_loss_weights()[top_ids[i]] != Dtype(0)) { continue; }
+    caffe_cpu_round_bf16(top[i]->count(), top[i]->mutable_cpu_data());
+  }
+}
+
+template <typename Dtype>
+void MixedPrecision<Dtype>::AfterBackward(int layer_id) {
+  const vector<Blob<Dtype>*>& bottom = net_->bottom_vecs()[layer_id];
+  for (int i = 0; i < bottom.size(); ++i) {
+    if (!net_->bottom_need_backward()[layer_id][i]) { continue; }
+    caffe_cpu_round_bf16(bottom[i]->count(), bottom[i]->mutable_cpu_diff());
+  }
+}
+
+template <typename Dtype>
+bool MixedPrecision<Dtype>::UnscaleGradients() {
+  const vector<Blob<Dtype>*>& params = net_->learnable_params();
+  bool overflow = false;
+  for (int i = 0; i < params.size() && !overflow; ++i) {
+    // The sum of magnitudes is inf or NaN iff one of the gradients is.
+    overflow = !std::isfinite(static_cast<double>(params[i]->asum_diff()));
+  }
+  if (overflow) {
+    if (loss_scale_window_ > 0) {
+      loss_scale_ /= 2;
+    }
+    iters_since_overflow_ = 0;
+    return false;
+  }
+  for (int i = 0; i < params.size(); ++i) {
+    params[i]->scale_diff(Dtype(1) / loss_scale_);
+  }
+  if (loss_scale_window_ > 0 && ++iters_since_overflow_ >= loss_scale_window_) {
+    loss_scale_ *= 2;
+    iters_since_overflow_ = 0;
+  }
+  return true;
+}
+
+INSTANTIATE_CLASS(MixedPrecision);
+
+}  // namespace caffe
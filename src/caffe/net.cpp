@@ -1,3 +1,6 @@
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem.hpp>
+
 #include <algorithm>
 #include <map>
 #include <set>
@@ -14,9 +17,13 @@
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/chunk_store.hpp"
 #include "caffe/util/hdf5.hpp"
+#include "caffe/util/insert_reorders.hpp"
 #include "caffe/util/insert_splits.hpp"
+#include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/memory_tracker.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 namespace caffe {
@@ -45,7 +52,15 @@ Net<Dtype>::Net(const string& param_file, Phase phase,
 }
 
 template <typename Dtype>
-void Net<Dtype>::Init(const NetParameter& in_param) {
+Net<Dtype>::Net(const NetParameter& param, const Net* weights) {
+  CHECK(weights != NULL);
+  Init(param, weights);
+}
+
+template <typename Dtype>
+void Net<Dtype>::Init(const NetParameter& in_param, const Net* weights) {
+  // Nets built on the weights of another are replicas of it, set up quietly.
+  log_setup_ = Caffe::root_solver() && weights == NULL;
   // Set phase from the state.
   // 读取训练状态
   phase_ = in_param.state().phase();
@@ -55,19 +70,45 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   // 将in_param中不符合规则的层去掉
   FilterNet(in_param, &filtered_param);
   // 打印过滤后的网络结构
-  LOG_IF(INFO, Caffe::root_solver())
+  LOG_IF(INFO, log_setup_)
       << "Initializing net from parameters: " << std::endl
       << filtered_param.DebugString();
+  // Run the layers that have kernels for it in the layout of the net, with
+  // Reorder layers between them and the others.
+  if (filtered_param.layout() != NCHW) {
+    if (phase_ == TEST) {
+      NetParameter reorder_param;
+      InsertReorders(filtered_param, &reorder_param);
+      filtered_param.Swap(&reorder_param);
+    } else {
+      LOG(WARNING) << "The layout " << BlobLayout_Name(filtered_param.layout())
+          << " applies to TEST nets only; running NCHW.";
+    }
+  }
   // Create a copy of filtered_param with splits added where necessary.
   NetParameter param;
   // 将一个输出blob对应多个输入的情况，加入分裂层
   InsertSplits(filtered_param, &param);
   
   // 打印filter后的网络
-  //LOG_IF(INFO, Caffe::root_solver())
+  //LOG_IF(INFO, log_setup_)
   //    << "Initializing net from parameters: " << std::endl
   //    << param.DebugString();
   
+  // The last layer working in place on each blob, to not let the layers
+  // before make it a view (see Layer::blob_views).
+  map<string, int> last_in_place;
+  for (int layer_id = 0; layer_id < param.layer_size(); ++layer_id) {
+    const LayerParameter& layer_param = param.layer(layer_id);
+    for (int top_id = 0; top_id < layer_param.top_size(); ++top_id) {
+      for (int bottom_id = 0; bottom_id < layer_param.bottom_size();
+           ++bottom_id) {
+        if (layer_param.top(top_id) == layer_param.bottom(bottom_id)) {
+          last_in_place[layer_param.top(top_id)] = layer_id;
+        }
+      }
+    }
+  }
   // Basically, build all the layers and set up their connections.
   name_ = param.name();
   map<string, int> blob_name_to_idx;
@@ -104,7 +145,7 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     // 根据层参数创建层，并压入layers_中
     layers_.push_back(LayerRegistry<Dtype>::CreateLayer(layer_param));
     layer_names_.push_back(layer_param.name());
-    LOG_IF(INFO, Caffe::root_solver())
+    LOG_IF(INFO, log_setup_)
         << "Creating Layer " << layer_param.name();
     bool need_backward = false;
 
@@ -143,26 +184,62 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
         AppendTop(param, layer_id, num_top, NULL, NULL);
       }
     }
+    // Layers given parameter blobs skip their own allocation and filling.
+    shared_ptr<Layer<Dtype> > source_layer;
+    if (weights != NULL && weights->has_layer(layer_param.name())) {
+      source_layer = weights->layer_by_name(layer_param.name());
+      layer->blobs() = source_layer->blobs();
+    }
+    // A layer whose top a later layer works in place on must not view its
+    // bottoms and tops in one another, or that layer would overwrite both.
+    if (!param.blob_views()) {
+      layer->set_blob_views(false);
+    }
+    for (int top_id = 0; top_id < layer_param.top_size(); ++top_id) {
+      map<string, int>::const_iterator in_place =
+          last_in_place.find(layer_param.top(top_id));
+      if (in_place != last_in_place.end() && in_place->second > layer_id) {
+        layer->set_blob_views(false);
+      }
+    }
     // After this layer is connected, set it up.
     // 为Blob分配内存空间
-    layers_[layer_id]->SetUp(bottom_vecs_[layer_id], top_vecs_[layer_id]);
-    LOG_IF(INFO, Caffe::root_solver())
+    {
+      MemoryTracker::Scope scope(layer);
+      layers_[layer_id]->SetUp(bottom_vecs_[layer_id], top_vecs_[layer_id]);
+    }
+    if (source_layer) {
+      // Some layers, e.g. RecurrentLayer, make blobs of their own in SetUp;
+      // point those at the shared data as ShareTrainedLayersWith does.
+      const vector<shared_ptr<Blob<Dtype> > >& source_blobs =
+          source_layer->blobs();
+      CHECK_EQ(layer->blobs().size(), source_blobs.size())
+          << "Incompatible number of blobs for layer " << layer_param.name();
+      for (int i = 0; i < source_blobs.size(); ++i) {
+        if (layer->blobs()[i] == source_blobs[i]) { continue; }
+        CHECK(layer->blobs()[i]->shape() == source_blobs[i]->shape())
+            << "Cannot share param " << i << " of layer "
+            << layer_param.name() << "; shape mismatch.";
+        layer->blobs()[i]->ShareData(*source_blobs[i]);
+      }
+    }
+    LOG_IF(INFO, log_setup_)
         << "Setting up " << layer_names_[layer_id];
     for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
       if (blob_loss_weights_.size() <= top_id_vecs_[layer_id][top_id]) {
         blob_loss_weights_.resize(top_id_vecs_[layer_id][top_id] + 1, Dtype(0));
       }
       blob_loss_weights_[top_id_vecs_[layer_id][top_id]] = layer->loss(top_id);
-      LOG_IF(INFO, Caffe::root_solver())
+      LOG_IF(INFO, log_setup_)
           << "Top shape: " << top_vecs_[layer_id][top_id]->shape_string();
       if (layer->loss(top_id)) {
-        LOG_IF(INFO, Caffe::root_solver())
+        LOG_IF(INFO, log_setup_)
             << "    with loss weight " << layer->loss(top_id);
       }
       // 计算所需的内存
       memory_used_ += top_vecs_[layer_id][top_id]->count();
     }
-    LOG_IF(INFO, Caffe::root_solver())
+    LOG_IF(INFO, log_setup_)
         << "Memory required for data: " << memory_used_ * sizeof(Dtype);
     // Layermeter 类型对象layer_param 中ParamSpec param 成员的个数 
     // 表示层内blob_数量，即该层有几个权重参数 
@@ -232,7 +309,7 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     }
     // 
     if (!layer_contributes_loss) { layer_need_backward_[layer_id] = false; }
-    if (Caffe::root_solver()) {
+    if (log_setup_) {
       if (layer_need_backward_[layer_id]) {
         LOG(INFO) << layer_names_[layer_id] << " needs backward computation.";
       } else {
@@ -278,7 +355,7 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   // In the end, all remaining blobs are considered output blobs.
   for (set<string>::iterator it = available_blobs.begin();
       it != available_blobs.end(); ++it) {
-    LOG_IF(INFO, Caffe::root_solver())
+    LOG_IF(INFO, log_setup_)
         << "This network produces output " << *it;
     net_output_blobs_.push_back(blobs_[blob_name_to_idx[*it]].get());
     net_output_blob_indices_.push_back(blob_name_to_idx[*it]);
@@ -289,9 +366,13 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   for (size_t layer_id = 0; layer_id < layer_names_.size(); ++layer_id) {
     layer_names_index_[layer_names_[layer_id]] = layer_id;
   }
-  ShareWeights();
+  // Shared parameter blobs were already tied together in weights.
+  if (weights == NULL) {
+    ShareWeights();
+  }
   debug_info_ = param.debug_info();
-  LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
+  loss_gradient_scale_ = 1;
+  LOG_IF(INFO, log_setup_) << "Network initialization done.";
 }
 
 /*
@@ -413,7 +494,7 @@ void Net<Dtype>::AppendTop(const NetParameter& param, const int layer_id,
   if (blob_name_to_idx && layer_param->bottom_size() > top_id &&
       blob_name == layer_param->bottom(top_id)) {
     // In-place computation
-    LOG_IF(INFO, Caffe::root_solver())
+    LOG_IF(INFO, log_setup_)
         << layer_param->name() << " -> " << blob_name << " (in-place)";
     top_vecs_[layer_id].push_back(blobs_[(*blob_name_to_idx)[blob_name]].get());
     top_id_vecs_[layer_id].push_back((*blob_name_to_idx)[blob_name]);
@@ -425,7 +506,7 @@ void Net<Dtype>::AppendTop(const NetParameter& param, const int layer_id,
                << "' produced by multiple sources.";
   } else {
     // Normal output.
-    if (Caffe::root_solver()) {
+    if (log_setup_) {
       LOG(INFO) << layer_param->name() << " -> " << blob_name;
     }
     shared_ptr<Blob<Dtype> > blob_pointer(new Blob<Dtype>());
@@ -453,7 +534,7 @@ int Net<Dtype>::AppendBottom(const NetParameter& param, const int layer_id,
                << layer_param.name() << "', bottom index " << bottom_id << ")";
   }
   const int blob_id = (*blob_name_to_idx)[blob_name];
-  LOG_IF(INFO, Caffe::root_solver())
+  LOG_IF(INFO, log_setup_)
       << layer_names_[layer_id] << " <- " << blob_name;
   bottom_vecs_[layer_id].push_back(blobs_[blob_id].get());
   bottom_id_vecs_[layer_id].push_back(blob_id);
@@ -512,7 +593,7 @@ void Net<Dtype>::AppendParam(const NetParameter& param, const int layer_id,
         param_layer_indices_[owner_net_param_id];
     const int owner_layer_id = owner_index.first;
     const int owner_param_id = owner_index.second;
-    LOG_IF(INFO, Caffe::root_solver()) << "Sharing parameters '" << param_name
+    LOG_IF(INFO, log_setup_) << "Sharing parameters '" << param_name
         << "' owned by "
         << "layer '" << layer_names_[owner_layer_id] << "', param "
         << "index " << owner_param_id;
@@ -571,6 +652,7 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
     for (int c = 0; c < before_forward_.size(); ++c) {
       before_forward_[c]->run(i);
     }
+    MemoryTracker::Scope scope(layers_[i].get());
     Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
     loss += layer_loss;
     if (debug_info_) { ForwardDebugInfo(i); }
@@ -622,8 +704,13 @@ void Net<Dtype>::BackwardFromTo(int start, int end) {
       before_backward_[c]->run(i);
     }
     if (layer_need_backward_[i]) {
+      MemoryTracker::Scope scope(layers_[i].get());
+      const bool scale_loss = (loss_gradient_scale_ != Dtype(1));
+      if (scale_loss) { SetLossGradients(i, loss_gradient_scale_); }
       layers_[i]->Backward(
           top_vecs_[i], bottom_need_backward_[i], bottom_vecs_[i]);
+      // Forward weighs the losses by the same diffs; restore them.
+      if (scale_loss) { SetLossGradients(i, 1); }
       if (debug_info_) { BackwardDebugInfo(i); }
     }
     for (int c = 0; c < after_backward_.size(); ++c) {
@@ -632,6 +719,31 @@ void Net<Dtype>::BackwardFromTo(int start, int end) {
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::SetLossGradients(const int layer_id, const Dtype scale) {
+  for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
+    const Dtype loss_weight =
+        blob_loss_weights_[top_id_vecs_[layer_id][top_id]];
+    if (loss_weight == Dtype(0)) { continue; }
+    Blob<Dtype>* top = top_vecs_[layer_id][top_id];
+    switch (Caffe::mode()) {
+    case Caffe::CPU:
+      caffe_set(top->count(), loss_weight * scale, top->mutable_cpu_diff());
+      break;
+    case Caffe::GPU:
+#ifndef CPU_ONLY
+      caffe_gpu_set(top->count(), loss_weight * scale,
+          top->mutable_gpu_diff());
+#else
+      NO_GPU;
+#endif
+      break;
+    default:
+      LOG(FATAL) << "Unknown caffe mode: " << Caffe::mode();
+    }
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::ForwardDebugInfo(const int layer_id) {
   for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
@@ -743,6 +855,37 @@ void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::CopyTrainedLayersFrom(const Net* other) {
+  int num_source_layers = other->layers().size();
+  for (int i = 0; i < num_source_layers; ++i) {
+    Layer<Dtype>* source_layer = other->layers()[i].get();
+    const string& source_layer_name = other->layer_names()[i];
+    int target_layer_id = 0;
+    while (target_layer_id != layer_names_.size() &&
+        layer_names_[target_layer_id] != source_layer_name) {
+      ++target_layer_id;
+    }
+    if (target_layer_id == layer_names_.size()) {
+      DLOG(INFO) << "Ignoring source layer " << source_layer_name;
+      continue;
+    }
+    vector<shared_ptr<Blob<Dtype> > >& target_blobs =
+        layers_[target_layer_id]->blobs();
+    CHECK_EQ(target_blobs.size(), source_layer->blobs().size())
+        << "Incompatible number of blobs for layer " << source_layer_name;
+    for (int j = 0; j < target_blobs.size(); ++j) {
+      Blob<Dtype>* source_blob = source_layer->blobs()[j].get();
+      CHECK(target_blobs[j]->shape() == source_blob->shape())
+          << "Cannot copy param " << j << " weights from layer '"
+          << source_layer_name << "'; shape mismatch.  Source param shape is "
+          << source_blob->shape_string() << "; target param shape is "
+          << target_blobs[j]->shape_string();
+      target_blobs[j]->CopyFrom(*source_blob);
+    }
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::BackwardFrom(int start) {
   BackwardFromTo(start, 0);
@@ -775,6 +918,7 @@ void Net<Dtype>::Backward() {
 template <typename Dtype>
 void Net<Dtype>::Reshape() {
   for (int i = 0; i < layers_.size(); ++i) {
+    MemoryTracker::Scope scope(layers_[i].get());
     layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
   }
 }
@@ -819,7 +963,9 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFrom(const string& trained_filename) {
-  if (H5Fis_hdf5(trained_filename.c_str())) {
+  if (boost::algorithm::ends_with(trained_filename, ".manifest")) {
+    CopyTrainedLayersFromChunks(trained_filename);
+  } else if (H5Fis_hdf5(trained_filename.c_str())) {
     CopyTrainedLayersFromHDF5(trained_filename);
   } else {
     CopyTrainedLayersFromBinaryProto(trained_filename);
@@ -889,6 +1035,43 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string& trained_filename) {
 #endif  // USE_HDF5
 }
 
+template <typename Dtype>
+void Net<Dtype>::CopyTrainedLayersFromChunks(const string& manifest_filename) {
+  ChunkedNetProto manifest;
+  CHECK(ReadProtoFromBinaryFile(manifest_filename, &manifest))
+      << "Failed to parse chunked net manifest " << manifest_filename;
+  const boost::filesystem::path chunk_dir =
+      boost::filesystem::path(manifest_filename).parent_path() /
+      manifest.chunk_dir();
+  ChunkStore store(chunk_dir.string());
+  for (int i = 0; i < manifest.layer_size(); ++i) {
+    const ChunkedNetProto::Layer& source_layer = manifest.layer(i);
+    const string& source_layer_name = source_layer.name();
+    if (!layer_names_index_.count(source_layer_name)) {
+      LOG(INFO) << "Ignoring source layer " << source_layer_name;
+      continue;
+    }
+    int target_layer_id = layer_names_index_[source_layer_name];
+    DLOG(INFO) << "Copying source layer " << source_layer_name;
+    vector<shared_ptr<Blob<Dtype> > >& target_blobs =
+        layers_[target_layer_id]->blobs();
+    CHECK_EQ(target_blobs.size(), source_layer.blobs_size())
+        << "Incompatible number of blobs for layer " << source_layer_name;
+    for (int j = 0; j < target_blobs.size(); ++j) {
+      const BlobShape& source_shape = source_layer.blobs(j).shape();
+      vector<int> shape(source_shape.dim().begin(), source_shape.dim().end());
+      CHECK(target_blobs[j]->shape() == shape)
+          << "Cannot copy param " << j << " weights from layer '"
+          << source_layer_name << "'; shape mismatch.  Target param shape is "
+          << target_blobs[j]->shape_string() << ". "
+          << "To learn this layer's parameters from scratch rather than "
+          << "copying from a saved net, rename the layer.";
+      const bool kReshape = false;
+      store.Get(source_layer.blobs(j), target_blobs[j].get(), kReshape);
+    }
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::ToProto(NetParameter* param, bool write_diff) const {
   param->Clear();
@@ -964,6 +1147,25 @@ void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
 #endif  // USE_HDF5
 }
 
+template <typename Dtype>
+void Net<Dtype>::ToChunks(ChunkStore* store,
+    ChunkedNetProto* manifest) const {
+  manifest->Clear();
+  manifest->set_name(name_);
+  manifest->set_chunk_dir(
+      boost::filesystem::path(store->directory()).filename().string());
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    const vector<shared_ptr<Blob<Dtype> > >& blobs =
+        layers_[layer_id]->blobs();
+    ChunkedNetProto::Layer* layer = manifest->add_layer();
+    layer->set_name(layer_names_[layer_id]);
+    // Weight-shared params are stored once: their chunks are identical.
+    for (int param_id = 0; param_id < blobs.size(); ++param_id) {
+      store->Put(*blobs[param_id], layer->add_blobs());
+    }
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::Update() {
   for (int i = 0; i < learnable_params_.size(); ++i) {
@@ -977,6 +1179,15 @@ void Net<Dtype>::ClearParamDiffs() {
     Blob<Dtype>* blob = learnable_params_[i];
     switch (Caffe::mode()) {
     case Caffe::CPU:
+      if (blob->row_sparse_diff()) {
+        const int dim = blob->count(1);
+        const vector<int>& rows = blob->diff_rows();
+        Dtype* diff = blob->mutable_cpu_diff();
+        for (int j = 0; j < rows.size(); ++j) {
+          caffe_set(dim, static_cast<Dtype>(0), diff + rows[j] * dim);
+        }
+        break;
+      }
       caffe_set(blob->count(), static_cast<Dtype>(0),
                 blob->mutable_cpu_diff());
       break;
@@ -989,7 +1200,35 @@ void Net<Dtype>::ClearParamDiffs() {
 #endif
       break;
     }
+    blob->UnmarkDiffRows();
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::EnableRowSparseParams() {
+  // A param is row-sparse if every layer using it says so, and its sharers
+  // accumulate into the diff of its owner.
+  vector<bool> row_sparse(learnable_params_.size(), true);
+  for (int i = 0; i < params_.size(); ++i) {
+    const int learnable_id = learnable_param_ids_[i];
+    const pair<int, int>& index = param_layer_indices_[i];
+    row_sparse[learnable_id] = row_sparse[learnable_id] &&
+        layers_[index.first]->RowSparseParamGradient(index.second) &&
+        params_[i]->diff() == learnable_params_[learnable_id]->diff();
+  }
+  int num_row_sparse = 0;
+  for (int i = 0; i < learnable_params_.size(); ++i) {
+    learnable_params_[i]->set_row_sparse_diff(row_sparse[i]);
+    num_row_sparse += row_sparse[i];
+  }
+  for (int i = 0; i < params_.size(); ++i) {
+    Blob<Dtype>* owner = learnable_params_[learnable_param_ids_[i]];
+    if (owner != params_[i].get() && owner->row_sparse_diff()) {
+      params_[i]->ShareDiff(*owner);
+    }
   }
+  LOG_IF(INFO, log_setup_) << "Tracking the touched rows of "
+      << num_row_sparse << " row-sparse params.";
 }
 
 template <typename Dtype>
@@ -0,0 +1,411 @@
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
+#include <iomanip>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caffe/profiler.hpp"
+#include "caffe/syncedmem.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Waits for the kernels of the layer, so that the wall time covers them.
+void SynchronizeDevice() {
+#ifndef CPU_ONLY
+  if (Caffe::mode() == Caffe::GPU) {
+    CUDA_CHECK(cudaDeviceSynchronize());
+  }
+#endif
+}
+
+string JSONEscape(const string& s) {
+  string escaped;
+  for (int i = 0; i < s.size(); ++i) {
+    if (s[i] == '"' || s[i] == '\\') {
+      escaped += '\\';
+    }
+    escaped += (static_cast<unsigned char>(s[i]) < 0x20) ? ' ' : s[i];
+  }
+  return escaped;
+}
+
+string CSVQuote(const string& s) {
+  string quoted = "\"";
+  for (int i = 0; i < s.size(); ++i) {
+    quoted += (s[i] == '"') ? "\"\"" : string(1, s[i]);
+  }
+  return quoted + "\"";
+}
+
+// GFLOP/s and GB/s from totals in operations, bytes and microseconds.
+double Rate(double total, double us) {
+  return us > 0 ? total / us / 1e3 : 0;
+}
+
+// The bytes a last-level cache miss moves from DRAM.
+const double kCacheLineBytes = 64;
+
+}  // namespace
+
+template <typename Dtype>
+Profiler<Dtype>::PassStats::PassStats()
+    : calls(0), us(0), flops(0), bytes(0), cycles(0), instructions(0),
+      llc_misses(0) {
+}
+
+template <typename Dtype>
+void Profiler<Dtype>::PassStats::Add(const PassStats& other) {
+  calls += other.calls;
+  us += other.us;
+  flops += other.flops;
+  bytes += other.bytes;
+  cycles += other.cycles;
+  instructions += other.instructions;
+  llc_misses += other.llc_misses;
+}
+
+template <typename Dtype>
+Profiler<Dtype>::Profiler(Net<Dtype>* net)
+    : net_(net), enabled_(true), peak_gflops_(0), peak_bandwidth_(0),
+      before_forward_(this, &Profiler::BeforeLayer),
+      after_forward_(this, &Profiler::AfterForward),
+      before_backward_(this, &Profiler::BeforeLayer),
+      after_backward_(this, &Profiler::AfterBackward) {
+  CHECK(net_ != NULL);
+  Reset();
+  net_->add_before_forward(&before_forward_);
+  net_->add_after_forward(&after_forward_);
+  net_->add_before_backward(&before_backward_);
+  net_->add_after_backward(&after_backward_);
+}
+
+template <typename Dtype>
+void Profiler<Dtype>::Reset() {
+  const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+  origin_us_ = (boost::posix_time::microsec_clock::universal_time() - epoch)
+      .total_microseconds();
+  start_us_ = 0;
+  events_.clear();
+  stats_.assign(net_->layers().size(), LayerStats());
+  memory_.clear();
+  peak_memory_ = 0;
+}
+
+template <typename Dtype>
+double Profiler<Dtype>::Now() const {
+  const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+  return (boost::posix_time::microsec_clock::universal_time() - epoch)
+      .total_microseconds() - origin_us_;
+}
+
+template <typename Dtype>
+void Profiler<Dtype>::BeforeLayer(int layer_id) {
+  if (!enabled_) { return; }
+  if (!counters_) {
+    counters_.reset(new HardwareCounters());
+  }
+  SynchronizeDevice();
+  start_us_ = Now();
+  counters_->Start();
+}
+
+template <typename Dtype>
+void Profiler<Dtype>::AfterForward(int layer_id) {
+  if (!enabled_) { return; }
+  Record(layer_id, false);
+  if (layer_id + 1 == net_->layers().size()) {
+    SampleMemory();
+  }
+}
+
+template <typename Dtype>
+void Profiler<Dtype>::AfterBackward(int layer_id) {
+  if (!enabled_) { return; }
+  if (net_->layer_need_backward()[layer_id]) {
+    Record(layer_id, true);
+  }
+  if (layer_id == 0) {
+    SampleMemory();
+  }
+}
+
+template <typename Dtype>
+void Profiler<Dtype>::Record(int layer_id, bool backward) {
+  const HardwareCounters::Counts counts = counters_->Stop();
+  SynchronizeDevice();
+  const double end_us = Now();
+  const Layer<Dtype>& layer = *net_->layers()[layer_id];
+  const vector<Blob<Dtype>*>& bottom = net_->bottom_vecs()[layer_id];
+  const vector<Blob<Dtype>*>& top = net_->top_vecs()[layer_id];
+  Event event;
+  event.layer = layer_id;
+  event.backward = backward;
+  event.start_us = start_us_;
+  PassStats& stats = event.stats;
+  stats.calls = 1;
+  stats.us = end_us - start_us_;
+  stats.flops = ForwardFlops(layer, bottom, top) * (backward ? 2 : 1);
+  stats.bytes = ForwardBytes(layer, bottom, top) * (backward ? 2 : 1);
+  stats.cycles = counts.cycles;
+  stats.instructions = counts.instructions;
+  stats.llc_misses = counts.llc_misses;
+  if (backward) {
+    stats_[layer_id].backward.Add(stats);
+  } else {
+    stats_[layer_id].forward.Add(stats);
+  }
+  events_.push_back(event);
+}
+
+template <typename Dtype>
+void Profiler<Dtype>::SampleMemory() {
+  // Shared blobs are counted once.
+  std::set<const SyncedMemory*> seen;
+  size_t bytes = 0;
+  const vector<shared_ptr<Blob<Dtype> > >* sets[] =
+      { &net_->blobs(), &net_->params() };
+  for (int s = 0; s < 2; ++s) {
+    for (int i = 0; i < sets[s]->size(); ++i) {
+      const Blob<Dtype>& blob = *(*sets[s])[i];
+      const SyncedMemory* memory[] = { blob.data().get(), blob.diff().get() };
+      for (int j = 0; j < 2; ++j) {
+        if (memory[j] && memory[j]->head() != SyncedMemory::UNINITIALIZED &&
+            seen.insert(memory[j]).second) {
+          bytes += memory[j]->size();
+        }
+      }
+    }
+  }
+  memory_.push_back(std::make_pair(Now(), bytes));
+  peak_memory_ = std::max(peak_memory_, bytes);
+}
+
+template <typename Dtype>
+double Profiler<Dtype>::ForwardFlops(const Layer<Dtype>& layer,
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const string type = layer.type();
+  const LayerParameter& param = layer.layer_param();
+  // Layer has no const accessor of its blobs.
+  const vector<shared_ptr<Blob<Dtype> > >& blobs =
+      const_cast<Layer<Dtype>&>(layer).blobs();
+  double top_count = 0;
+  for (int i = 0; i < top.size(); ++i) {
+    top_count += top[i]->count();
+  }
+  if (type == "Convolution" || type == "Deconvolution") {
+    CHECK(!blobs.empty());
+    // Each output of a convolution, and each input of a deconvolution,
+    // takes the products with one filter of the group.
+    double flops = 0;
+    const vector<Blob<Dtype>*>& products =
+        (type == "Convolution") ? top : bottom;
+    for (int i = 0; i < products.size(); ++i) {
+      flops += 2.0 * products[i]->count() * blobs[0]->count(1);
+    }
+    return flops + (blobs.size() > 1 ? top_count : 0);
+  }
+  if (type == "InnerProduct") {
+    CHECK(!blobs.empty());
+    const int num_output = param.inner_product_param().num_output();
+    return 2.0 * top_count * blobs[0]->count() / num_output +
+        (blobs.size() > 1 ? top_count : 0);
+  }
+  if (type == "Pooling") {
+    const PoolingParameter& pooling = param.pooling_param();
+    double window;
+    if (pooling.global_pooling()) {
+      window = bottom[0]->count(2);
+    } else if (pooling.has_kernel_size()) {
+      window = pooling.kernel_size() * pooling.kernel_size();
+    } else {
+      window = pooling.kernel_h() * pooling.kernel_w();
+    }
+    return top[0]->count() * window;
+  }
+  if (type == "LRN") {
+    const LRNParameter& lrn = param.lrn_param();
+    const int size = lrn.local_size();
+    // Squares and sums over the window, then the scale and its power.
+    return bottom[0]->count() * (lrn.norm_region() ==
+        LRNParameter_NormRegion_ACROSS_CHANNELS ? 2.0 * size + 4 :
+        2.0 * size * size + 4);
+  }
+  if (type == "Softmax" || type == "SoftmaxWithLoss" ||
+      type == "SigmoidCrossEntropyLoss") {
+    // The max, the shift, the exponential, the sum and the division.
+    return 5.0 * bottom[0]->count();
+  }
+  if (type == "EuclideanLoss") {
+    return 3.0 * bottom[0]->count();
+  }
+  if (type == "Input" || type == "Data" || type == "ImageData" ||
+      type == "HDF5Data" || type == "MemoryData" || type == "WindowData" ||
+      type == "DummyData" || type == "Split" || type == "Concat" ||
+      type == "Slice" || type == "Reshape" || type == "Flatten" ||
+      type == "Silence" || type == "Crop" || type == "Tile" ||
+      type == "Embed" || type == "Filter" || type == "BatchReindex") {
+    return 0;
+  }
+  return top_count;
+}
+
+template <typename Dtype>
+double Profiler<Dtype>::ForwardBytes(const Layer<Dtype>& layer,
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  double count = 0;
+  for (int i = 0; i < bottom.size(); ++i) {
+    count += bottom[i]->count();
+  }
+  for (int i = 0; i < top.size(); ++i) {
+    count += top[i]->count();
+  }
+  const vector<shared_ptr<Blob<Dtype> > >& blobs =
+      const_cast<Layer<Dtype>&>(layer).blobs();
+  for (int i = 0; i < blobs.size(); ++i) {
+    count += blobs[i]->count();
+  }
+  return count * sizeof(Dtype);
+}
+
+template <typename Dtype>
+double Profiler<Dtype>::ArithmeticIntensity(const PassStats& stats) const {
+  const double bytes = hardware_counters() ?
+      stats.llc_misses * kCacheLineBytes : stats.bytes;
+  return bytes > 0 ? stats.flops / bytes : 0;
+}
+
+template <typename Dtype>
+string Profiler<Dtype>::Bound(const PassStats& stats) const {
+  if (peak_gflops_ <= 0 || peak_bandwidth_ <= 0 || stats.flops == 0) {
+    return "";
+  }
+  const double ridge = peak_gflops_ / peak_bandwidth_;
+  return ArithmeticIntensity(stats) < ridge ? "memory" : "compute";
+}
+
+template <typename Dtype>
+void Profiler<Dtype>::LogSummary() const {
+  const vector<shared_ptr<Layer<Dtype> > >& layers = net_->layers();
+  // The totals of each layer type, in the order the types first appear.
+  vector<string> types;
+  map<string, PassStats> type_stats;
+  for (int i = 0; i < layers.size(); ++i) {
+    const string type = layers[i]->type();
+    if (type_stats.find(type) == type_stats.end()) {
+      types.push_back(type);
+    }
+    for (int backward = 0; backward < 2; ++backward) {
+      const PassStats& stats =
+          backward ? stats_[i].backward : stats_[i].forward;
+      type_stats[type].Add(stats);
+      if (stats.calls == 0) { continue; }
+      std::ostringstream line;
+      line << std::setw(10) << net_->layer_names()[i]
+          << (backward ? "\tbackward: " : "\tforward: ")
+          << stats.us / 1000 / stats.calls << " ms, "
+          << Rate(stats.flops, stats.us) << " GFLOP/s, "
+          << Rate(stats.bytes, stats.us) << " GB/s";
+      if (hardware_counters()) {
+        line << ", IPC " << (stats.cycles > 0 ?
+            stats.instructions / stats.cycles : 0) << ", DRAM "
+            << Rate(stats.llc_misses * kCacheLineBytes, stats.us) << " GB/s";
+      }
+      const string bound = Bound(stats);
+      if (!bound.empty()) {
+        line << ", " << ArithmeticIntensity(stats) << " FLOP/B, "
+            << bound << "-bound";
+      }
+      LOG(INFO) << line.str();
+    }
+  }
+  LOG(INFO) << "Total time per layer type:";
+  for (int i = 0; i < types.size(); ++i) {
+    const PassStats& total = type_stats.find(types[i])->second;
+    LOG(INFO) << std::setw(10) << types[i] << "\t" << total.us / 1000
+        << " ms, " << Rate(total.flops, total.us) << " GFLOP/s";
+  }
+  LOG(INFO) << "Peak memory of blobs and params: "
+      << peak_memory_ / 1048576.0 << " MB";
+}
+
+template <typename Dtype>
+void Profiler<Dtype>::WriteChromeTrace(const string& filename) const {
+  std::ofstream out(filename.c_str());
+  CHECK(out.is_open()) << "Failed to open " << filename;
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  for (int i = 0; i < events_.size(); ++i) {
+    const Event& event = events_[i];
+    const PassStats& stats = event.stats;
+    const Layer<Dtype>& layer = *net_->layers()[event.layer];
+    out << "{\"name\": \"" << JSONEscape(net_->layer_names()[event.layer])
+        << "\", \"cat\": \"" << (event.backward ? "backward" : "forward")
+        << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": 0, \"ts\": "
+        << event.start_us << ", \"dur\": " << stats.us
+        << ", \"args\": {\"type\": \"" << JSONEscape(layer.type())
+        << "\", \"flops\": " << stats.flops << ", \"bytes\": " << stats.bytes;
+    if (hardware_counters()) {
+      out << ", \"cycles\": " << stats.cycles << ", \"instructions\": "
+          << stats.instructions << ", \"llc_misses\": " << stats.llc_misses;
+    }
+    out << "}},\n";
+  }
+  for (int i = 0; i < memory_.size(); ++i) {
+    out << "{\"name\": \"memory\", \"ph\": \"C\", \"pid\": 0, \"ts\": "
+        << memory_[i].first << ", \"args\": {\"bytes\": "
+        << memory_[i].second << "}},\n";
+  }
+  // The trace_event format takes no trailing comma; close with metadata.
+  out << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 0, "
+      << "\"args\": {\"name\": \"" << JSONEscape(net_->name()) << "\"}}\n";
+  out << "]}\n";
+}
+
+template <typename Dtype>
+void Profiler<Dtype>::WriteCSV(const string& filename) const {
+  std::ofstream out(filename.c_str());
+  CHECK(out.is_open()) << "Failed to open " << filename;
+  out << "layer,type,pass,calls,ms_per_call,flops_per_call,bytes_per_call,"
+      << "gflops_per_s,gbytes_per_s,fraction_of_peak,cycles_per_call,"
+      << "instructions_per_call,llc_misses_per_call,ipc,"
+      << "arithmetic_intensity,bound\n";
+  for (int i = 0; i < stats_.size(); ++i) {
+    for (int backward = 0; backward < 2; ++backward) {
+      const PassStats& stats =
+          backward ? stats_[i].backward : stats_[i].forward;
+      const int calls = stats.calls;
+      if (calls == 0) { continue; }
+      const double gflops = Rate(stats.flops, stats.us);
+      out << CSVQuote(net_->layer_names()[i]) << ","
+          << net_->layers()[i]->type() << ","
+          << (backward ? "backward" : "forward") << "," << calls << ","
+          << stats.us / 1000 / calls << "," << stats.flops / calls << ","
+          << stats.bytes / calls << "," << gflops << ","
+          << Rate(stats.bytes, stats.us) << ",";
+      if (peak_gflops_ > 0) {
+        out << gflops / peak_gflops_;
+      }
+      out << ",";
+      if (hardware_counters()) {
+        out << stats.cycles / calls << "," << stats.instructions / calls
+            << "," << stats.llc_misses / calls << ","
+            << (stats.cycles > 0 ? stats.instructions / stats.cycles : 0);
+      } else {
+        out << ",,,";
+      }
+      out << "," << ArithmeticIntensity(stats) << "," << Bound(stats)
+          << "\n";
+    }
+  }
+}
+
+INSTANTIATE_CLASS(Profiler);
+
+}  // namespace caffe
@@ -0,0 +1,115 @@
+#include <vector>
+
+#include "caffe/recurrent_session.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+RecurrentSession<Dtype>::RecurrentSession(
+    const shared_ptr<Layer<Dtype> >& layer)
+    : layer_(boost::dynamic_pointer_cast<RecurrentLayer<Dtype> >(layer)),
+      num_open_(0) {
+  CHECK(layer_) << "A RecurrentSession needs a recurrent layer, not a "
+      << layer->type() << " layer.";
+  num_output_ = layer_->layer_param().recurrent_param().num_output();
+  states_.resize(layer_->num_states());
+  batch_states_.resize(layer_->num_states());
+}
+
+template <typename Dtype>
+int RecurrentSession<Dtype>::Open() {
+  int stream;
+  if (closed_.empty()) {
+    stream = open_.size();
+    open_.push_back(true);
+    for (int i = 0; i < states_.size(); ++i) {
+      states_[i].resize(open_.size() * layer_->state_dim(i));
+    }
+  } else {
+    stream = closed_.back();
+    closed_.pop_back();
+    open_[stream] = true;
+  }
+  ++num_open_;
+  Reset(stream);
+  return stream;
+}
+
+template <typename Dtype>
+void RecurrentSession<Dtype>::Close(int stream) {
+  CHECK(is_open(stream)) << "Stream " << stream << " is not open.";
+  open_[stream] = false;
+  closed_.push_back(stream);
+  --num_open_;
+}
+
+template <typename Dtype>
+void RecurrentSession<Dtype>::Reset(int stream) {
+  CHECK(is_open(stream)) << "Stream " << stream << " is not open.";
+  for (int i = 0; i < states_.size(); ++i) {
+    const int dim = layer_->state_dim(i);
+    caffe_set(dim, Dtype(0), &states_[i][stream * dim]);
+  }
+}
+
+template <typename Dtype>
+const Dtype* RecurrentSession<Dtype>::state(int stream, int i) const {
+  CHECK(is_open(stream)) << "Stream " << stream << " is not open.";
+  return &states_[i][stream * layer_->state_dim(i)];
+}
+
+template <typename Dtype>
+void RecurrentSession<Dtype>::Step(const vector<int>& streams, int T,
+    const Dtype* x, Dtype* y) {
+  const int num = streams.size();
+  if (num == 0) { return; }
+  // Consecutive streams are stepped in place.
+  bool consecutive = true;
+  vector<bool> seen(open_.size(), false);
+  for (int j = 0; j < num; ++j) {
+    CHECK(is_open(streams[j])) << "Stream " << streams[j] << " is not open.";
+    CHECK(!seen[streams[j]]) << "Stream " << streams[j] << " is stepped twice.";
+    seen[streams[j]] = true;
+    consecutive &= streams[j] == streams[0] + j;
+  }
+  vector<Dtype*> states(states_.size());
+  for (int i = 0; i < states_.size(); ++i) {
+    const int dim = layer_->state_dim(i);
+    if (consecutive) {
+      states[i] = &states_[i][streams[0] * dim];
+      continue;
+    }
+    batch_states_[i].resize(num * dim);
+    states[i] = &batch_states_[i][0];
+    for (int j = 0; j < num; ++j) {
+      caffe_copy(dim, &states_[i][streams[j] * dim], states[i] + j * dim);
+    }
+  }
+  layer_->Step(T, num, x, states, y);
+  if (consecutive) { return; }
+  for (int i = 0; i < states_.size(); ++i) {
+    const int dim = layer_->state_dim(i);
+    for (int j = 0; j < num; ++j) {
+      caffe_copy(dim, states[i] + j * dim, &states_[i][streams[j] * dim]);
+    }
+  }
+}
+
+template <typename Dtype>
+void RecurrentSession<Dtype>::Step(const vector<int>& streams,
+    const Blob<Dtype>& x, Blob<Dtype>* y) {
+  CHECK_GE(x.num_axes(), 2) << "x must be (#timesteps, #streams, ...)";
+  CHECK_EQ(streams.size(), x.shape(1));
+  CHECK_EQ(input_dim(), x.count(2));
+  vector<int> shape(3);
+  shape[0] = x.shape(0);
+  shape[1] = streams.size();
+  shape[2] = num_output_;
+  y->Reshape(shape);
+  Step(streams, x.shape(0), x.cpu_data(), y->mutable_cpu_data());
+}
+
+INSTANTIATE_CLASS(RecurrentSession);
+
+}  // namespace caffe
@@ -0,0 +1,195 @@
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "caffe/request_batcher.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class RequestBatcher<Dtype>::sync {
+ public:
+  mutable boost::mutex mutex_;
+  boost::condition_variable queued_;
+  boost::condition_variable done_;
+  // The pending requests with the time they were submitted.
+  std::deque<std::pair<boost::system_time, shared_ptr<Future> > > queue_;
+  shared_ptr<boost::thread> thread_;
+};
+
+template <typename Dtype>
+RequestBatcher<Dtype>::Future::Future(const vector<Dtype>& input,
+    const shared_ptr<sync>& sync)
+    : input_(input), ready_(false), sync_(sync) {
+}
+
+template <typename Dtype>
+bool RequestBatcher<Dtype>::Future::ready() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return ready_;
+}
+
+template <typename Dtype>
+const vector<vector<Dtype> >& RequestBatcher<Dtype>::Future::Get() {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (!ready_) {
+    sync_->done_.wait(lock);
+  }
+  return outputs_;
+}
+
+template <typename Dtype>
+RequestBatcher<Dtype>::RequestBatcher(const InferenceEngine<Dtype>* engine,
+    int max_batch, int max_delay_us)
+    : engine_(engine), max_batch_(max_batch), max_delay_us_(max_delay_us),
+      batches_(0), requests_(0), sync_(new sync()) {
+  CHECK_GE(max_batch_, 1) << "max_batch must be positive.";
+  CHECK_GE(max_delay_us_, 0) << "max_delay_us must be non-negative.";
+  const vector<Blob<Dtype>*>& inputs = engine_->net().input_blobs();
+  CHECK_EQ(inputs.size(), 1) << "RequestBatcher needs a net with one input.";
+  CHECK_GE(inputs[0]->num_axes(), 1);
+  input_dim_ = inputs[0]->count(1);
+  try {
+    sync_->thread_.reset(new boost::thread(&RequestBatcher::entry, this));
+  } catch (std::exception& e) {
+    LOG(FATAL) << "Thread exception: " << e.what();
+  }
+}
+
+template <typename Dtype>
+RequestBatcher<Dtype>::~RequestBatcher() {
+  sync_->thread_->interrupt();
+  try {
+    sync_->thread_->join();
+  } catch (boost::thread_interrupted&) {
+  } catch (std::exception& e) {
+    LOG(FATAL) << "Thread exception: " << e.what();
+  }
+  // Release the waiters of the requests that did not run.
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  for (int i = 0; i < sync_->queue_.size(); ++i) {
+    sync_->queue_[i].second->ready_ = true;
+  }
+  sync_->queue_.clear();
+  lock.unlock();
+  sync_->done_.notify_all();
+}
+
+template <typename Dtype>
+shared_ptr<typename RequestBatcher<Dtype>::Future>
+RequestBatcher<Dtype>::Submit(const vector<Dtype>& input) {
+  CHECK_EQ(input.size(), input_dim_)
+      << "Each request must hold one example of the input blob.";
+  shared_ptr<Future> future(new Future(input, sync_));
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  sync_->queue_.push_back(std::make_pair(boost::get_system_time(), future));
+  lock.unlock();
+  sync_->queued_.notify_one();
+  return future;
+}
+
+template <typename Dtype>
+int RequestBatcher<Dtype>::batches() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return batches_;
+}
+
+template <typename Dtype>
+int RequestBatcher<Dtype>::requests() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return requests_;
+}
+
+template <typename Dtype>
+int RequestBatcher<Dtype>::BucketSize(int n) const {
+  int bucket = 1;
+  while (bucket < n) {
+    bucket *= 2;
+  }
+  return std::min(bucket, max_batch_);
+}
+
+template <typename Dtype>
+void RequestBatcher<Dtype>::entry() {
+  try {
+    // A bucket for each batch size BucketSize() returns.
+    vector<vector<vector<int> > > buckets;
+    vector<int> shape = engine_->net().input_blobs()[0]->shape();
+    for (int size = 1; ; size *= 2) {
+      shape[0] = BucketSize(size);
+      buckets.push_back(vector<vector<int> >(1, shape));
+      if (shape[0] == max_batch_) { break; }
+    }
+    ShapeBucketCache<Dtype> cache(engine_, buckets);
+    while (true) {
+      vector<shared_ptr<Future> > batch;
+      {
+        boost::mutex::scoped_lock lock(sync_->mutex_);
+        while (sync_->queue_.empty()) {
+          sync_->queued_.wait(lock);
+        }
+        // Wait for a full batch until the oldest request is due.
+        const boost::system_time deadline = sync_->queue_.front().first +
+            boost::posix_time::microseconds(max_delay_us_);
+        while (sync_->queue_.size() < max_batch_ &&
+               sync_->queued_.timed_wait(lock, deadline)) {
+        }
+        const int size = std::min<int>(sync_->queue_.size(), max_batch_);
+        for (int i = 0; i < size; ++i) {
+          batch.push_back(sync_->queue_.front().second);
+          sync_->queue_.pop_front();
+        }
+      }
+      RunBatch(cache, batch);
+      {
+        boost::mutex::scoped_lock lock(sync_->mutex_);
+        for (int i = 0; i < batch.size(); ++i) {
+          batch[i]->ready_ = true;
+        }
+        ++batches_;
+        requests_ += batch.size();
+      }
+      sync_->done_.notify_all();
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
+}
+
+template <typename Dtype>
+void RequestBatcher<Dtype>::RunBatch(const ShapeBucketCache<Dtype>& cache,
+    const vector<shared_ptr<Future> >& batch) {
+  const int size = batch.size();
+  const int bucket = BucketSize(size);
+  vector<int> shape = engine_->net().input_blobs()[0]->shape();
+  shape[0] = bucket;
+  typename InferenceEngine<Dtype>::Context* context = cache.Find(shape);
+  Blob<Dtype>* input = context->input_blobs()[0];
+  Dtype* input_data = input->mutable_cpu_data();
+  for (int i = 0; i < size; ++i) {
+    caffe_copy(input_dim_, &batch[i]->input_[0], input_data + i * input_dim_);
+  }
+  caffe_set((bucket - size) * input_dim_, Dtype(0),
+      input_data + size * input_dim_);
+  const vector<Blob<Dtype>*>& outputs = context->Forward();
+  for (int i = 0; i < size; ++i) {
+    batch[i]->outputs_.resize(outputs.size());
+  }
+  for (int j = 0; j < outputs.size(); ++j) {
+    CHECK(outputs[j]->num_axes() >= 1 && outputs[j]->shape(0) == bucket)
+        << "Every output of the net must have the batch as its first axis.";
+    const int dim = outputs[j]->count(1);
+    const Dtype* output_data = outputs[j]->cpu_data();
+    for (int i = 0; i < size; ++i) {
+      batch[i]->outputs_[j].assign(output_data + i * dim,
+          output_data + (i + 1) * dim);
+    }
+  }
+}
+
+INSTANTIATE_CLASS(RequestBatcher);
+
+}  // namespace caffe
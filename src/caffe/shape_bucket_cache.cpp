@@ -0,0 +1,77 @@
+#include <map>
+#include <vector>
+
+#include "caffe/shape_bucket_cache.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+ShapeBucketCache<Dtype>::ShapeBucketCache(
+    const InferenceEngine<Dtype>* engine,
+    const vector<vector<vector<int> > >& buckets)
+    : shapes_(buckets) {
+  CHECK(!buckets.empty()) << "Give at least one shape bucket.";
+  for (int i = 0; i < buckets.size(); ++i) {
+    CHECK(index_.find(buckets[i]) == index_.end())
+        << "Shape bucket " << i << " is listed twice.";
+    index_[buckets[i]] = i;
+    shared_ptr<Context> context = engine->CreateContext();
+    const vector<Blob<Dtype>*>& inputs = context->input_blobs();
+    CHECK_EQ(inputs.size(), buckets[i].size())
+        << "Shape bucket " << i << " must give the shape of every input.";
+    for (int j = 0; j < inputs.size(); ++j) {
+      inputs[j]->Reshape(buckets[i][j]);
+    }
+    context->net()->Reshape();
+    // Run once so that every blob and layer buffer of the bucket is
+    // allocated now rather than by its first request.
+    for (int j = 0; j < inputs.size(); ++j) {
+      caffe_set(inputs[j]->count(), Dtype(0), inputs[j]->mutable_cpu_data());
+    }
+    context->Forward();
+    contexts_.push_back(context);
+  }
+}
+
+template <typename Dtype>
+typename ShapeBucketCache<Dtype>::Context* ShapeBucketCache<Dtype>::Find(
+    const vector<vector<int> >& shapes) const {
+  typename map<vector<vector<int> >, int>::const_iterator it =
+      index_.find(shapes);
+  return it == index_.end() ? NULL : contexts_[it->second].get();
+}
+
+template <typename Dtype>
+typename ShapeBucketCache<Dtype>::Context* ShapeBucketCache<Dtype>::Find(
+    const vector<int>& shape) const {
+  return Find(vector<vector<int> >(1, shape));
+}
+
+template <typename Dtype>
+typename ShapeBucketCache<Dtype>::Context* ShapeBucketCache<Dtype>::Fit(
+    const vector<vector<int> >& shapes) const {
+  int best = -1;
+  int best_count = 0;
+  for (int i = 0; i < shapes_.size(); ++i) {
+    if (shapes_[i].size() != shapes.size()) { continue; }
+    bool fits = true;
+    int count = 0;
+    for (int j = 0; fits && j < shapes.size(); ++j) {
+      fits = (shapes_[i][j].size() == shapes[j].size());
+      for (int k = 0; fits && k < shapes[j].size(); ++k) {
+        fits = (shapes_[i][j][k] >= shapes[j][k]);
+      }
+      count += contexts_[i]->input_blobs()[j]->count();
+    }
+    if (fits && (best < 0 || count < best_count)) {
+      best = i;
+      best_count = count;
+    }
+  }
+  return best < 0 ? NULL : contexts_[best].get();
+}
+
+INSTANTIATE_CLASS(ShapeBucketCache);
+
+}  // namespace caffe
@@ -1,17 +1,84 @@
+#include <boost/thread.hpp>
 #include <cstdio>
 
 #include <string>
 #include <vector>
 
 #include "boost/algorithm/string.hpp"
+#include "caffe/internal_thread.hpp"
 #include "caffe/solver.hpp"
+#include "caffe/util/benchmark.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/metrics.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 namespace caffe {
 
+// Evaluates the test nets of a solver on its own thread. The thread persists
+// for the lifetime of the solver and waits for Start() between evaluations.
+template <typename Dtype>
+class Solver<Dtype>::AsyncTester : public InternalThread {
+ public:
+  explicit AsyncTester(Solver* solver)
+      : solver_(solver), iter_(0), busy_(false) {
+    StartInternalThread();
+  }
+  virtual ~AsyncTester() {
+    Wait();
+    StopInternalThread();
+  }
+
+  // Evaluates all test nets with their current weights, logged as iter.
+  void Start(int iter) {
+    boost::mutex::scoped_lock lock(mutex_);
+    CHECK(!busy_) << "A test evaluation is already running.";
+    iter_ = iter;
+    busy_ = true;
+    lock.unlock();
+    cond_.notify_all();
+  }
+  void Wait() {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (busy_) {
+      cond_.wait(lock);
+    }
+  }
+
+ protected:
+  virtual void InternalThreadEntry() {
+    try {
+      while (!must_stop()) {
+        int iter;
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          while (!busy_) {
+            cond_.wait(lock);
+          }
+          iter = iter_;
+        }
+        for (int i = 0; i < solver_->test_nets_.size(); ++i) {
+          solver_->EvaluateTestNet(i, iter, false);
+        }
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          busy_ = false;
+        }
+        cond_.notify_all();
+      }
+    } catch (boost::thread_interrupted&) {
+      // Interrupted exception is expected on shutdown
+    }
+  }
+
+  Solver* solver_;
+  int iter_;
+  bool busy_;
+  boost::mutex mutex_;
+  boost::condition_variable cond_;
+};
+
 template<typename Dtype>
 void Solver<Dtype>::SetActionFunction(ActionCallback func) {
   action_request_function_ = func;
@@ -47,6 +114,17 @@ void Solver<Dtype>::Init(const SolverParameter& param) {
   param_ = param;
   CHECK_GE(param_.average_loss(), 1) << "average_loss should be non-negative.";
   CheckSnapshotWritePermissions();
+  if (param_.snapshot_async() && Caffe::root_solver()) {
+    LOG_IF(WARNING, param_.snapshot_format() !=
+        SolverParameter_SnapshotFormat_BINARYPROTO)
+        << "snapshot_async only applies to the BINARYPROTO snapshot format; "
+        << "HDF5 snapshots will be written synchronously.";
+    snapshot_writer_.reset(new SnapshotWriter(param_.snapshot_max_pending()));
+  }
+  if (param_.test_async() && Caffe::root_solver()) {
+    // Started before seeding, as starting a thread draws from the Caffe RNG.
+    async_tester_.reset(new AsyncTester(this));
+  }
   if (param_.random_seed() >= 0) {
     Caffe::set_random_seed(param_.random_seed() + Caffe::solver_rank());
   }
@@ -205,6 +283,27 @@ void Solver<Dtype>::Step(int iters) {
   losses_.clear();
   smoothed_loss_ = 0;
   iteration_timer_.Start();
+  Metrics& metrics = Metrics::Get();
+  Metrics::Counter* iterations = metrics.counter("caffe_iterations_total",
+      "Training iterations done.");
+  Metrics::Counter* examples = metrics.counter("caffe_examples_total",
+      "Training examples processed, by all solvers.");
+  Metrics::Gauge* examples_per_second = metrics.gauge(
+      "caffe_examples_per_second", "Training examples per second of the "
+      "last iteration, by all solvers.");
+  Metrics::Histogram* iteration_seconds = metrics.histogram(
+      "caffe_iteration_seconds", "Time of a training iteration, without "
+      "testing and snapshots.");
+  Metrics::Histogram* forward_seconds = metrics.histogram(
+      "caffe_forward_seconds", "Time of the forward passes of an iteration, "
+      "including the wait for data.");
+  Metrics::Histogram* backward_seconds = metrics.histogram(
+      "caffe_backward_seconds", "Time of the backward passes of an "
+      "iteration.");
+  Metrics::Histogram* update_seconds = metrics.histogram(
+      "caffe_update_seconds", "Time of the update of an iteration, "
+      "including the gradient exchange of the solvers.");
+  CPUTimer iteration_phase_timer, phase_timer;
 
   while (iter_ < stop_iter) {
     // zero-init the params
@@ -220,6 +319,7 @@ void Solver<Dtype>::Step(int iters) {
       }
     }
 
+    iteration_phase_timer.Start();
     for (int i = 0; i < callbacks_.size(); ++i) {
       callbacks_[i]->on_start();
     }
@@ -227,8 +327,16 @@ void Solver<Dtype>::Step(int iters) {
     net_->set_debug_info(display && param_.debug_info());
     // accumulate the loss and gradient
     Dtype loss = 0;
+    double forward_us = 0, backward_us = 0;
     for (int i = 0; i < param_.iter_size(); ++i) {
-      loss += net_->ForwardBackward();
+      Dtype iter_loss;
+      phase_timer.Start();
+      net_->Forward(&iter_loss);
+      forward_us += phase_timer.MicroSeconds();
+      phase_timer.Start();
+      net_->Backward();
+      backward_us += phase_timer.MicroSeconds();
+      loss += iter_loss;
     }
     loss /= param_.iter_size();
     // average the loss across iterations for smoothed reporting
@@ -261,10 +369,31 @@ void Solver<Dtype>::Step(int iters) {
         }
       }
     }
+    phase_timer.Start();
     for (int i = 0; i < callbacks_.size(); ++i) {
       callbacks_[i]->on_gradients_ready();
     }
     ApplyUpdate();
+    if (Caffe::root_solver()) {
+      const double update_us = phase_timer.MicroSeconds();
+      const double iteration_us = iteration_phase_timer.MicroSeconds();
+      // The examples of an iteration, as the batch of the first top of the
+      // net, usually that of its data layer.
+      const vector<Blob<Dtype>*>& data = net_->top_vecs()[0];
+      const int batch = (data.size() && data[0]->num_axes()) ?
+          data[0]->shape(0) : 0;
+      const double iteration_examples =
+          batch * param_.iter_size() * Caffe::solver_count();
+      iterations->Increment();
+      examples->Increment(iteration_examples);
+      if (iteration_us > 0) {
+        examples_per_second->Set(iteration_examples / iteration_us * 1e6);
+      }
+      iteration_seconds->Observe(iteration_us / 1e6);
+      forward_seconds->Observe(forward_us / 1e6);
+      backward_seconds->Observe(backward_us / 1e6);
+      update_seconds->Observe(update_us / 1e6);
+    }
 
     SolverAction::Enum request = GetRequestedAction();
 
@@ -307,7 +436,9 @@ void Solver<Dtype>::Solve(const char* resume_file) {
       && (!param_.snapshot() || iter_ % param_.snapshot() != 0)) {
     Snapshot();
   }
+  WaitForSnapshots();
   if (requested_early_exit_) {
+    WaitForTests();
     LOG(INFO) << "Optimization stopped early.";
     return;
   }
@@ -329,11 +460,23 @@ void Solver<Dtype>::Solve(const char* resume_file) {
   if (param_.test_interval() && iter_ % param_.test_interval() == 0) {
     TestAll();
   }
+  WaitForTests();
   LOG(INFO) << "Optimization Done.";
 }
 
 template <typename Dtype>
 void Solver<Dtype>::TestAll() {
+  if (async_tester_) {
+    // Copy the weights so that training can update its own while the
+    // previous values are evaluated.
+    WaitForTests();
+    for (int test_net_id = 0; test_net_id < test_nets_.size(); ++test_net_id) {
+      CHECK_NOTNULL(test_nets_[test_net_id].get())->
+          CopyTrainedLayersFrom(net_.get());
+    }
+    async_tester_->Start(iter_);
+    return;
+  }
   for (int test_net_id = 0;
        test_net_id < test_nets_.size() && !requested_early_exit_;
        ++test_net_id) {
@@ -344,16 +487,25 @@ void Solver<Dtype>::TestAll() {
 template <typename Dtype>
 void Solver<Dtype>::Test(const int test_net_id) {
   CHECK(Caffe::root_solver());
-  LOG(INFO) << "Iteration " << iter_
-            << ", Testing net (#" << test_net_id << ")";
   CHECK_NOTNULL(test_nets_[test_net_id].get())->
       ShareTrainedLayersWith(net_.get());
+  EvaluateTestNet(test_net_id, iter_, true);
+}
+
+template <typename Dtype>
+void Solver<Dtype>::EvaluateTestNet(const int test_net_id, const int iter,
+    const bool check_actions) {
+  CHECK(Caffe::root_solver());
+  LOG(INFO) << "Iteration " << iter
+            << ", Testing net (#" << test_net_id << ")";
   vector<Dtype> test_score;
   vector<int> test_score_output_id;
   const shared_ptr<Net<Dtype> >& test_net = test_nets_[test_net_id];
   Dtype loss = 0;
+  bool interrupted = false;
   for (int i = 0; i < param_.test_iter(test_net_id); ++i) {
-    SolverAction::Enum request = GetRequestedAction();
+    SolverAction::Enum request =
+        check_actions ? GetRequestedAction() : SolverAction::NONE;
     // Check to see if stoppage of testing/training has been requested.
     while (request != SolverAction::NONE) {
         if (SolverAction::SNAPSHOT == request) {
@@ -363,7 +515,8 @@ void Solver<Dtype>::Test(const int test_net_id) {
         }
         request = GetRequestedAction();
     }
-    if (requested_early_exit_) {
+    if (check_actions && requested_early_exit_) {
+      interrupted = true;
       // break out of test loop.
       break;
     }
@@ -392,7 +545,7 @@ void Solver<Dtype>::Test(const int test_net_id) {
       }
     }
   }
-  if (requested_early_exit_) {
+  if (interrupted) {
     LOG(INFO)     << "Test interrupted.";
     return;
   }
@@ -419,6 +572,8 @@ void Solver<Dtype>::Test(const int test_net_id) {
 template <typename Dtype>
 void Solver<Dtype>::Snapshot() {
   CHECK(Caffe::root_solver());
+  CPUTimer timer;
+  timer.Start();
   string model_filename;
   switch (param_.snapshot_format()) {
   case caffe::SolverParameter_SnapshotFormat_BINARYPROTO:
@@ -427,11 +582,46 @@ void Solver<Dtype>::Snapshot() {
   case caffe::SolverParameter_SnapshotFormat_HDF5:
     model_filename = SnapshotToHDF5();
     break;
+  case caffe::SolverParameter_SnapshotFormat_CHUNKED:
+    model_filename = SnapshotToChunks();
+    break;
   default:
     LOG(FATAL) << "Unsupported snapshot format.";
   }
 
   SnapshotSolverState(model_filename);
+  if (snapshot_writer_ && !staged_snapshot_.empty()) {
+    // Hand the staged copies over; training resumes while they are written.
+    snapshot_writer_->Write(staged_snapshot_);
+    staged_snapshot_.clear();
+  }
+  Metrics::Get().histogram("caffe_snapshot_seconds", "Time training was "
+      "held by a snapshot.")->Observe(timer.MicroSeconds() / 1e6);
+}
+
+template <typename Dtype>
+void Solver<Dtype>::WaitForSnapshots() {
+  if (snapshot_writer_) {
+    snapshot_writer_->Flush();
+  }
+}
+
+template <typename Dtype>
+void Solver<Dtype>::WaitForTests() {
+  if (async_tester_) {
+    async_tester_->Wait();
+  }
+}
+
+template <typename Dtype>
+void Solver<Dtype>::WriteSnapshotProto(
+    const shared_ptr< ::google::protobuf::Message>& proto,
+    const string& filename) {
+  if (snapshot_writer_) {
+    staged_snapshot_.push_back(SnapshotWriter::File(proto, filename));
+  } else {
+    WriteProtoToBinaryFile(*proto, filename);
+  }
 }
 
 template <typename Dtype>
@@ -462,9 +652,9 @@ template <typename Dtype>
 string Solver<Dtype>::SnapshotToBinaryProto() {
   string model_filename = SnapshotFilename(".caffemodel");
   LOG(INFO) << "Snapshotting to binary proto file " << model_filename;
-  NetParameter net_param;
-  net_->ToProto(&net_param, param_.snapshot_diff());
-  WriteProtoToBinaryFile(net_param, model_filename);
+  shared_ptr<NetParameter> net_param(new NetParameter());
+  net_->ToProto(net_param.get(), param_.snapshot_diff());
+  WriteSnapshotProto(net_param, model_filename);
   return model_filename;
 }
 
@@ -476,8 +666,33 @@ string Solver<Dtype>::SnapshotToHDF5() {
   return model_filename;
 }
 
+template <typename Dtype>
+ChunkStore* Solver<Dtype>::snapshot_chunk_store() {
+  if (!snapshot_chunk_store_) {
+    snapshot_chunk_store_.reset(new ChunkStore(
+        param_.snapshot_prefix() + "_chunks", param_.snapshot_chunk_bytes()));
+  }
+  return snapshot_chunk_store_.get();
+}
+
+template <typename Dtype>
+string Solver<Dtype>::SnapshotToChunks() {
+  string model_filename = SnapshotFilename(".caffemodel.manifest");
+  LOG(INFO) << "Snapshotting to chunked manifest " << model_filename;
+  ChunkStore* store = snapshot_chunk_store();
+  const int chunks_before = store->chunks_written();
+  shared_ptr<ChunkedNetProto> manifest(new ChunkedNetProto());
+  net_->ToChunks(store, manifest.get());
+  LOG(INFO) << "Wrote " << store->chunks_written() - chunks_before
+            << " new chunk(s) to " << store->directory();
+  WriteSnapshotProto(manifest, model_filename);
+  return model_filename;
+}
+
 template <typename Dtype>
 void Solver<Dtype>::Restore(const char* state_file) {
+  // The requested state may still be in flight.
+  WaitForSnapshots();
   string state_filename(state_file);
   if (state_filename.size() >= 3 &&
       state_filename.compare(state_filename.size() - 3, 3, ".h5") == 0) {
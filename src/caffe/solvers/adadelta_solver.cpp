@@ -6,6 +6,7 @@ namespace caffe {
 
 template <typename Dtype>
 void AdaDeltaSolver<Dtype>::AdaDeltaPreSolve() {
+  this->CheckSparseUpdate();
   // Add the extra history entries for AdaDelta after those from
   // SGDSolver::PreSolve
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
@@ -1,3 +1,4 @@
+#include <cmath>
 #include <vector>
 
 #include "caffe/sgd_solvers.hpp"
@@ -63,6 +64,24 @@ void AdaGradSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+void AdaGradSolver<Dtype>::ComputeRowUpdateValue(int param_id, Dtype rate) {
+  Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+  const Dtype delta = this->param_.delta();
+  const Dtype local_rate = rate * this->net_->params_lr()[param_id];
+  // The history of the rows the gradient did not touch does not change.
+  const int dim = param->count(1);
+  const vector<int>& rows = param->diff_rows();
+  Dtype* g = param->mutable_cpu_diff();
+  Dtype* h = this->history_[param_id]->mutable_cpu_data();
+  for (int i = 0; i < rows.size(); ++i) {
+    for (int k = rows[i] * dim; k < (rows[i] + 1) * dim; ++k) {
+      h[k] += g[k] * g[k];
+      g[k] = local_rate * g[k] / (std::sqrt(h[k]) + delta);
+    }
+  }
+}
+
 INSTANTIATE_CLASS(AdaGradSolver);
 REGISTER_SOLVER_CLASS(AdaGrad);
 
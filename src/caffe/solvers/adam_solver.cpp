@@ -6,6 +6,7 @@ namespace caffe {
 
 template <typename Dtype>
 void AdamSolver<Dtype>::AdamPreSolve() {
+  this->CheckSparseUpdate();
   // Add the extra history entries for Adam after those from
   // SGDSolver::PreSolve
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
@@ -88,6 +89,32 @@ void AdamSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+void AdamSolver<Dtype>::ComputeRowUpdateValue(int param_id, Dtype rate) {
+  const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
+  const Dtype local_rate = rate * this->net_->params_lr()[param_id];
+  const Dtype beta1 = this->param_.momentum();
+  const Dtype beta2 = this->param_.momentum2();
+  const int t = this->iter_ + 1;
+  const Dtype correction = std::sqrt(Dtype(1) - pow(beta2, t)) /
+      (Dtype(1.) - pow(beta1, t));
+  const Dtype eps_hat = this->param_.delta();
+  // The moments of the rows the gradient did not touch stand still.
+  Blob<Dtype>* param = net_params[param_id];
+  const int dim = param->count(1);
+  const vector<int>& rows = param->diff_rows();
+  Dtype* g = param->mutable_cpu_diff();
+  Dtype* m = this->history_[param_id]->mutable_cpu_data();
+  Dtype* v = this->history_[param_id + net_params.size()]->mutable_cpu_data();
+  for (int i = 0; i < rows.size(); ++i) {
+    for (int k = rows[i] * dim; k < (rows[i] + 1) * dim; ++k) {
+      m[k] = beta1 * m[k] + (1 - beta1) * g[k];
+      v[k] = beta2 * v[k] + (1 - beta2) * g[k] * g[k];
+      g[k] = local_rate * correction * m[k] / (std::sqrt(v[k]) + eps_hat);
+    }
+  }
+}
+
 INSTANTIATE_CLASS(AdamSolver);
 REGISTER_SOLVER_CLASS(Adam);
 
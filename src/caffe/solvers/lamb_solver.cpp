@@ -0,0 +1,102 @@
+#include <cmath>
+#include <vector>
+
+#include "caffe/sgd_solvers.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void LAMBSolver<Dtype>::LAMBPreSolve() {
+  this->CheckSparseUpdate();
+  CHECK_EQ(this->param_.regularization_type(), "L2")
+      << "LAMB only supports L2 weight decay.";
+  // Add the second moments after the first moments (the history entries from
+  // SGDSolver::PreSolve)
+  const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
+  for (int i = 0; i < net_params.size(); ++i) {
+    const vector<int>& shape = net_params[i]->shape();
+    this->history_.push_back(
+            shared_ptr<Blob<Dtype> >(new Blob<Dtype>(shape)));
+  }
+}
+
+#ifndef CPU_ONLY
+template <typename Dtype>
+void lamb_update_gpu(int N, Dtype* g, const Dtype* w, Dtype* m, Dtype* v,
+    Dtype beta1, Dtype beta2, Dtype eps, Dtype correction1,
+    Dtype correction2, Dtype local_decay);
+#endif
+
+template <typename Dtype>
+void LAMBSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
+  const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
+  Blob<Dtype>* param = net_params[param_id];
+  const Dtype local_rate = rate * this->net_->params_lr()[param_id];
+  const Dtype local_decay = this->param_.weight_decay() *
+      this->net_->params_weight_decay()[param_id];
+  const Dtype beta1 = this->param_.momentum();
+  const Dtype beta2 = this->param_.momentum2();
+  const Dtype eps = this->param_.delta();
+
+  // we create aliases for convenience
+  size_t update_history_offset = net_params.size();
+  Blob<Dtype>* val_m = this->history_[param_id].get();
+  Blob<Dtype>* val_v = this->history_[param_id + update_history_offset].get();
+
+  // Bias corrections of the moments.
+  const int t = this->iter_ + 1;
+  const Dtype correction1 = Dtype(1) / (Dtype(1) - pow(beta1, t));
+  const Dtype correction2 = Dtype(1) / (Dtype(1) - pow(beta2, t));
+  const int N = param->count();
+
+  Dtype weight_sumsq = 0;
+  Dtype step_sumsq = 0;
+  switch (Caffe::mode()) {
+  case Caffe::CPU: {
+    const Dtype* w = param->cpu_data();
+    Dtype* g = param->mutable_cpu_diff();
+    Dtype* m = val_m->mutable_cpu_data();
+    Dtype* v = val_v->mutable_cpu_data();
+    // A single pass updates the moments, computes the step into the diff and
+    // the norms of the weights and the step.
+    for (int i = 0; i < N; ++i) {
+      m[i] = beta1 * m[i] + (1 - beta1) * g[i];
+      v[i] = beta2 * v[i] + (1 - beta2) * g[i] * g[i];
+      g[i] = m[i] * correction1 / (std::sqrt(v[i] * correction2) + eps)
+          + local_decay * w[i];
+      weight_sumsq += w[i] * w[i];
+      step_sumsq += g[i] * g[i];
+    }
+    break;
+  }
+  case Caffe::GPU: {
+#ifndef CPU_ONLY
+    lamb_update_gpu(N, param->mutable_gpu_diff(), param->gpu_data(),
+        val_m->mutable_gpu_data(), val_v->mutable_gpu_data(), beta1, beta2,
+        eps, correction1, correction2, local_decay);
+    weight_sumsq = param->sumsq_data();
+    step_sumsq = param->sumsq_diff();
+#else
+    NO_GPU;
+#endif
+    break;
+  }
+  default:
+    LOG(FATAL) << "Unknown caffe mode: " << Caffe::mode();
+  }
+
+  const Dtype weight_norm = std::sqrt(weight_sumsq);
+  const Dtype step_norm = std::sqrt(step_sumsq);
+  // Blobs without weights yet (e.g. zero-initialized biases) or without a
+  // step keep the global learning rate.
+  Dtype trust_ratio = 1;
+  if (weight_norm > 0 && step_norm > 0) {
+    trust_ratio = weight_norm / step_norm;
+  }
+  param->scale_diff(local_rate * trust_ratio);
+}
+
+INSTANTIATE_CLASS(LAMBSolver);
+REGISTER_SOLVER_CLASS(LAMB);
+
+}  // namespace caffe
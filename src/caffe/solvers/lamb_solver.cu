@@ -0,0 +1,33 @@
+#include "caffe/util/math_functions.hpp"
+
+
+namespace caffe {
+
+template <typename Dtype>
+__global__ void LAMBUpdate(int N, Dtype* g, const Dtype* w, Dtype* m,
+    Dtype* v, Dtype beta1, Dtype beta2, Dtype eps, Dtype correction1,
+    Dtype correction2, Dtype local_decay) {
+  CUDA_KERNEL_LOOP(i, N) {
+    float gi = g[i];
+    float mi = m[i] = m[i]*beta1 + gi*(1-beta1);
+    float vi = v[i] = v[i]*beta2 + gi*gi*(1-beta2);
+    g[i] = mi * correction1 / (sqrt(vi * correction2) + eps)
+        + local_decay * w[i];
+  }
+}
+template <typename Dtype>
+void lamb_update_gpu(int N, Dtype* g, const Dtype* w, Dtype* m, Dtype* v,
+    Dtype beta1, Dtype beta2, Dtype eps, Dtype correction1,
+    Dtype correction2, Dtype local_decay) {
+  LAMBUpdate<Dtype>  // NOLINT_NEXT_LINE(whitespace/operators)
+      <<<CAFFE_GET_BLOCKS(N), CAFFE_CUDA_NUM_THREADS>>>(
+      N, g, w, m, v, beta1, beta2, eps, correction1, correction2,
+      local_decay);
+  CUDA_POST_KERNEL_CHECK;
+}
+template void lamb_update_gpu<float>(int, float*, const float*, float*,
+    float*, float, float, float, float, float, float);
+template void lamb_update_gpu<double>(int, double*, const double*, double*,
+    double*, double, double, double, double, double, double);
+
+}  // namespace caffe
@@ -0,0 +1,25 @@
+#include <cmath>
+#include <vector>
+
+#include "caffe/sgd_solvers.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void LARSSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
+  Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+  const Dtype weight_norm = std::sqrt(param->sumsq_data());
+  const Dtype diff_norm = std::sqrt(param->sumsq_diff());
+  // Blobs without weights yet (e.g. zero-initialized biases) or without a
+  // gradient keep the global learning rate.
+  Dtype trust_ratio = 1;
+  if (weight_norm > 0 && diff_norm > 0) {
+    trust_ratio = this->param_.lars_eta() * weight_norm / diff_norm;
+  }
+  SGDSolver<Dtype>::ComputeUpdateValue(param_id, rate * trust_ratio);
+}
+
+INSTANTIATE_CLASS(LARSSolver);
+REGISTER_SOLVER_CLASS(LARS);
+
+}  // namespace caffe
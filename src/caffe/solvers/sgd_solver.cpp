@@ -1,13 +1,52 @@
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cmath>
 #include <string>
 #include <vector>
 
 #include "caffe/sgd_solvers.hpp"
+#include "caffe/util/chunk_store.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 namespace caffe {
 
+namespace {
+
+// The sum of squares of the marked rows of a row-sparse diff.
+template <typename Dtype>
+Dtype sumsq_diff_rows(const Blob<Dtype>& blob) {
+  const int dim = blob.count(1);
+  const vector<int>& rows = blob.diff_rows();
+  const Dtype* diff = blob.cpu_diff();
+  Dtype sumsq = 0;
+  for (int i = 0; i < rows.size(); ++i) {
+    sumsq += caffe_cpu_dot(dim, diff + rows[i] * dim, diff + rows[i] * dim);
+  }
+  return sumsq;
+}
+
+template <typename Dtype>
+void scale_diff_rows(Dtype scale_factor, Blob<Dtype>* blob) {
+  const int dim = blob->count(1);
+  const vector<int>& rows = blob->diff_rows();
+  Dtype* diff = blob->mutable_cpu_diff();
+  for (int i = 0; i < rows.size(); ++i) {
+    caffe_scal(dim, scale_factor, diff + rows[i] * dim);
+  }
+}
+
+// Has the rows of the row-sparse params last been updated before iter.
+void reset_row_iters(int iter, vector<vector<int> >* row_iters) {
+  for (int i = 0; i < row_iters->size(); ++i) {
+    std::fill((*row_iters)[i].begin(), (*row_iters)[i].end(), iter - 1);
+  }
+}
+
+}  // namespace
+
 // Return the current learning rate. The currently implemented learning rate
 // policies are as follows:
 //    - fixed: always return base_lr.
@@ -82,16 +121,38 @@ void SGDSolver<Dtype>::PreSolve() {
     update_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>(shape)));
     temp_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>(shape)));
   }
+  // Average the gradients accumulated over iter_size passes as they are
+  // computed, rather than in a separate pass over the param diffs.
+  this->net_->set_loss_gradient_scale(Dtype(1) / this->param_.iter_size());
+  if (this->param_.mixed_precision()) {
+    mixed_precision_.reset(new MixedPrecision<Dtype>(this->param_, this->net_));
+    this->add_callback(mixed_precision_.get());
+  }
+  row_iters_.clear();
+  if (this->param_.sparse_update()) {
+    this->net_->EnableRowSparseParams();
+    row_iters_.resize(net_params.size());
+    for (int i = 0; i < net_params.size(); ++i) {
+      if (net_params[i]->row_sparse_diff()) {
+        row_iters_[i].resize(net_params[i]->shape(0));
+      }
+    }
+    reset_row_iters(this->iter_, &row_iters_);
+  }
 }
 
 template <typename Dtype>
 void SGDSolver<Dtype>::ClipGradients() {
-  const Dtype clip_gradients = this->param_.clip_gradients();
-  if (clip_gradients < 0) { return; }
+  if (this->param_.clip_gradients() < 0) { return; }
+  // clip_gradients bounds the norm of the gradients summed over iter_size;
+  // the param diffs hold their mean.
+  const Dtype clip_gradients =
+      this->param_.clip_gradients() / this->param_.iter_size();
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
   Dtype sumsq_diff = 0;
   for (int i = 0; i < net_params.size(); ++i) {
-    sumsq_diff += net_params[i]->sumsq_diff();
+    sumsq_diff += RowSparseUpdate(i) ? sumsq_diff_rows(*net_params[i]) :
+        net_params[i]->sumsq_diff();
   }
   const Dtype l2norm_diff = std::sqrt(sumsq_diff);
   if (l2norm_diff > clip_gradients) {
@@ -100,13 +161,24 @@ void SGDSolver<Dtype>::ClipGradients() {
         << l2norm_diff << " > " << clip_gradients << ") "
         << "by scale factor " << scale_factor;
     for (int i = 0; i < net_params.size(); ++i) {
-      net_params[i]->scale_diff(scale_factor);
+      if (RowSparseUpdate(i)) {
+        scale_diff_rows(scale_factor, net_params[i]);
+      } else {
+        net_params[i]->scale_diff(scale_factor);
+      }
     }
   }
 }
 
 template <typename Dtype>
 void SGDSolver<Dtype>::ApplyUpdate() {
+  if (mixed_precision_ && !mixed_precision_->UnscaleGradients()) {
+    LOG_IF(INFO, Caffe::root_solver()) << "Iteration " << this->iter_
+        << ", gradient overflow, skipping update; loss scale = "
+        << mixed_precision_->loss_scale();
+    ++this->iter_;
+    return;
+  }
   Dtype rate = GetLearningRate();
   if (this->param_.display() && this->iter_ % this->param_.display() == 0) {
     LOG_IF(INFO, Caffe::root_solver()) << "Iteration " << this->iter_
@@ -116,6 +188,11 @@ void SGDSolver<Dtype>::ApplyUpdate() {
   for (int param_id = 0; param_id < this->net_->learnable_params().size();
        ++param_id) {
     Normalize(param_id);
+    if (RowSparseUpdate(param_id)) {
+      RegularizeRows(param_id, rate);
+      ComputeRowUpdateValue(param_id, rate);
+      continue;
+    }
     Regularize(param_id);
     ComputeUpdateValue(param_id, rate);
   }
@@ -126,32 +203,6 @@ void SGDSolver<Dtype>::ApplyUpdate() {
   ++this->iter_;
 }
 
-template <typename Dtype>
-void SGDSolver<Dtype>::Normalize(int param_id) {
-  if (this->param_.iter_size() == 1) { return; }
-  // Scale gradient to counterbalance accumulation.
-  const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
-  const Dtype accum_normalization = Dtype(1.) / this->param_.iter_size();
-  switch (Caffe::mode()) {
-  case Caffe::CPU: {
-    caffe_scal(net_params[param_id]->count(), accum_normalization,
-        net_params[param_id]->mutable_cpu_diff());
-    break;
-  }
-  case Caffe::GPU: {
-#ifndef CPU_ONLY
-    caffe_gpu_scal(net_params[param_id]->count(), accum_normalization,
-        net_params[param_id]->mutable_gpu_diff());
-#else
-    NO_GPU;
-#endif
-    break;
-  }
-  default:
-    LOG(FATAL) << "Unknown caffe mode: " << Caffe::mode();
-  }
-}
-
 template <typename Dtype>
 void SGDSolver<Dtype>::Regularize(int param_id) {
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
@@ -214,6 +265,69 @@ void SGDSolver<Dtype>::Regularize(int param_id) {
   }
 }
 
+template <typename Dtype>
+void SGDSolver<Dtype>::RegularizeRows(int param_id, Dtype rate) {
+  Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+  const Dtype local_decay = this->param_.weight_decay() *
+      this->net_->params_weight_decay()[param_id];
+  const Dtype local_rate = rate * this->net_->params_lr()[param_id];
+  const string& regularization_type = this->param_.regularization_type();
+  const int dim = param->count(1);
+  const vector<int>& rows = param->diff_rows();
+  vector<int>& row_iters = row_iters_[param_id];
+  if (!local_decay) {
+    for (int i = 0; i < rows.size(); ++i) {
+      row_iters[rows[i]] = this->iter_;
+    }
+    return;
+  }
+  Dtype* data = param->mutable_cpu_data();
+  Dtype* diff = param->mutable_cpu_diff();
+  for (int i = 0; i < rows.size(); ++i) {
+    Dtype* w = data + rows[i] * dim;
+    Dtype* g = diff + rows[i] * dim;
+    // The iterations since the row was last updated, whose weight decay is
+    // applied now at the current rate: as plain SGD would have with a fixed
+    // learning rate, and an approximation when the rate changed meanwhile.
+    const int missed = this->iter_ - row_iters[rows[i]] - 1;
+    row_iters[rows[i]] = this->iter_;
+    if (regularization_type == "L2") {
+      if (missed > 0) {
+        caffe_scal(dim, Dtype(pow(1 - local_rate * local_decay, missed)), w);
+      }
+      caffe_axpy(dim, local_decay, w, g);
+    } else if (regularization_type == "L1") {
+      const Dtype shrink = local_rate * local_decay * missed;
+      for (int k = 0; k < dim; ++k) {
+        if (missed > 0) {
+          w[k] = caffe_sign(w[k]) * std::max(std::abs(w[k]) - shrink,
+              Dtype(0));
+        }
+        g[k] += local_decay * caffe_sign(w[k]);
+      }
+    } else {
+      LOG(FATAL) << "Unknown regularization type: " << regularization_type;
+    }
+  }
+}
+
+template <typename Dtype>
+void SGDSolver<Dtype>::ComputeRowUpdateValue(int param_id, Dtype rate) {
+  Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+  const Dtype momentum = this->param_.momentum();
+  const Dtype local_rate = rate * this->net_->params_lr()[param_id];
+  const int dim = param->count(1);
+  const vector<int>& rows = param->diff_rows();
+  Dtype* diff = param->mutable_cpu_diff();
+  Dtype* history = history_[param_id]->mutable_cpu_data();
+  for (int i = 0; i < rows.size(); ++i) {
+    const int offset = rows[i] * dim;
+    caffe_cpu_axpby(dim, local_rate, diff + offset, momentum,
+        history + offset);
+    caffe_copy(dim, history + offset, diff + offset);
+  }
+}
+
 #ifndef CPU_ONLY
 template <typename Dtype>
 void sgd_update_gpu(int N, Dtype* g, Dtype* h, Dtype momentum,
@@ -257,6 +371,7 @@ template <typename Dtype>
 void SGDSolver<Dtype>::SnapshotSolverState(const string& model_filename) {
   switch (this->param_.snapshot_format()) {
     case caffe::SolverParameter_SnapshotFormat_BINARYPROTO:
+    case caffe::SolverParameter_SnapshotFormat_CHUNKED:
       SnapshotSolverStateToBinaryProto(model_filename);
       break;
     case caffe::SolverParameter_SnapshotFormat_HDF5:
@@ -270,20 +385,31 @@ void SGDSolver<Dtype>::SnapshotSolverState(const string& model_filename) {
 template <typename Dtype>
 void SGDSolver<Dtype>::SnapshotSolverStateToBinaryProto(
     const string& model_filename) {
-  SolverState state;
-  state.set_iter(this->iter_);
-  state.set_learned_net(model_filename);
-  state.set_current_step(this->current_step_);
-  state.clear_history();
-  for (int i = 0; i < history_.size(); ++i) {
-    // Add history
-    BlobProto* history_blob = state.add_history();
-    history_[i]->ToProto(history_blob);
+  shared_ptr<SolverState> state(new SolverState());
+  state->set_iter(this->iter_);
+  state->set_learned_net(model_filename);
+  state->set_current_step(this->current_step_);
+  state->clear_history();
+  if (this->param_.snapshot_format() ==
+      caffe::SolverParameter_SnapshotFormat_CHUNKED) {
+    // History of frozen params stays zero, so most of its chunks dedupe.
+    ChunkStore* store = this->snapshot_chunk_store();
+    state->set_chunk_dir(
+        boost::filesystem::path(store->directory()).filename().string());
+    for (int i = 0; i < history_.size(); ++i) {
+      store->Put(*history_[i], state->add_chunked_history());
+    }
+  } else {
+    for (int i = 0; i < history_.size(); ++i) {
+      // Add history
+      BlobProto* history_blob = state->add_history();
+      history_[i]->ToProto(history_blob);
+    }
   }
   string snapshot_filename = Solver<Dtype>::SnapshotFilename(".solverstate");
   LOG(INFO)
     << "Snapshotting solver state to binary proto file " << snapshot_filename;
-  WriteProtoToBinaryFile(state, snapshot_filename.c_str());
+  this->WriteSnapshotProto(state, snapshot_filename);
 }
 
 template <typename Dtype>
@@ -325,17 +451,34 @@ void SGDSolver<Dtype>::RestoreSolverStateFromBinaryProto(
   SolverState state;
   ReadProtoFromBinaryFile(state_file, &state);
   this->iter_ = state.iter();
+  reset_row_iters(this->iter_, &row_iters_);
   if (state.has_learned_net()) {
-    NetParameter net_param;
-    ReadNetParamsFromBinaryFileOrDie(state.learned_net().c_str(), &net_param);
-    this->net_->CopyTrainedLayersFrom(net_param);
+    if (boost::filesystem::extension(state.learned_net()) == ".manifest") {
+      this->net_->CopyTrainedLayersFromChunks(state.learned_net());
+    } else {
+      NetParameter net_param;
+      ReadNetParamsFromBinaryFileOrDie(state.learned_net().c_str(),
+          &net_param);
+      this->net_->CopyTrainedLayersFrom(net_param);
+    }
   }
   this->current_step_ = state.current_step();
-  CHECK_EQ(state.history_size(), history_.size())
-      << "Incorrect length of history blobs.";
   LOG(INFO) << "SGDSolver: restoring history";
-  for (int i = 0; i < history_.size(); ++i) {
-    history_[i]->FromProto(state.history(i));
+  if (state.chunked_history_size() > 0) {
+    CHECK_EQ(state.chunked_history_size(), history_.size())
+        << "Incorrect length of history blobs.";
+    const boost::filesystem::path chunk_dir =
+        boost::filesystem::path(state_file).parent_path() / state.chunk_dir();
+    ChunkStore store(chunk_dir.string());
+    for (int i = 0; i < history_.size(); ++i) {
+      store.Get(state.chunked_history(i), history_[i].get());
+    }
+  } else {
+    CHECK_EQ(state.history_size(), history_.size())
+        << "Incorrect length of history blobs.";
+    for (int i = 0; i < history_.size(); ++i) {
+      history_[i]->FromProto(state.history(i));
+    }
   }
 }
 
@@ -345,6 +488,7 @@ void SGDSolver<Dtype>::RestoreSolverStateFromHDF5(const string& state_file) {
   hid_t file_hid = H5Fopen(state_file.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
   CHECK_GE(file_hid, 0) << "Couldn't open solver state file " << state_file;
   this->iter_ = hdf5_load_int(file_hid, "iter");
+  reset_row_iters(this->iter_, &row_iters_);
   if (H5LTfind_dataset(file_hid, "learned_net")) {
     string learned_net = hdf5_load_string(file_hid, "learned_net");
     this->net_->CopyTrainedLayersFrom(learned_net);
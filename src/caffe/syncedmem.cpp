@@ -1,11 +1,13 @@
 #include "caffe/common.hpp"
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/memory_tracker.hpp"
 
 namespace caffe {
 SyncedMemory::SyncedMemory()
   : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(0), head_(UNINITIALIZED),
-    own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false) {
+    own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false),
+    tracked_(false), version_(0), offset_(0) {
 #ifndef CPU_ONLY
 #ifdef DEBUG
   CUDA_CHECK(cudaGetDevice(&device_));
@@ -15,7 +17,22 @@ SyncedMemory::SyncedMemory()
 
 SyncedMemory::SyncedMemory(size_t size)
   : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(size), head_(UNINITIALIZED),
-    own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false) {
+    own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false),
+    tracked_(false), version_(0), offset_(0) {
+#ifndef CPU_ONLY
+#ifdef DEBUG
+  CUDA_CHECK(cudaGetDevice(&device_));
+#endif
+#endif
+}
+
+SyncedMemory::SyncedMemory(const shared_ptr<SyncedMemory>& parent,
+    size_t offset, size_t size)
+  : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(size), head_(UNINITIALIZED),
+    own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false),
+    tracked_(false), version_(0), parent_(parent), offset_(offset) {
+  CHECK(parent);
+  CHECK_LE(offset + size, parent->size()) << "The view is out of range.";
 #ifndef CPU_ONLY
 #ifdef DEBUG
   CUDA_CHECK(cudaGetDevice(&device_));
@@ -25,6 +42,10 @@ SyncedMemory::SyncedMemory(size_t size)
 
 SyncedMemory::~SyncedMemory() {
   check_device();
+  if (tracked_) {
+    MemoryTracker::Free(this, false);
+    MemoryTracker::Free(this, true);
+  }
   if (cpu_ptr_ && own_cpu_data_) {
     CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
   }
@@ -44,7 +65,13 @@ inline void SyncedMemory::to_cpu() {
   case UNINITIALIZED:
     //申请cpu内存空间
     CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
-    caffe_memset(size_, 0, cpu_ptr_);
+    Track(false);
+    if (restore_) {
+      restore_(cpu_ptr_);
+      restore_.clear();
+    } else {
+      caffe_memset(size_, 0, cpu_ptr_);
+    }
     //状态更新
     head_ = HEAD_AT_CPU;
     own_cpu_data_ = true;
@@ -54,6 +81,7 @@ inline void SyncedMemory::to_cpu() {
 #ifndef CPU_ONLY
     if (cpu_ptr_ == NULL) {
       CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
+      Track(false);
       own_cpu_data_ = true;
     }
     //从gpu_ptr_拷贝到cpu_ptr_
@@ -73,10 +101,15 @@ inline void SyncedMemory::to_cpu() {
 inline void SyncedMemory::to_gpu() {
   check_device();
 #ifndef CPU_ONLY
+  if (head_ == UNINITIALIZED && restore_) {
+    // Released data is written back on the CPU.
+    to_cpu();
+  }
   switch (head_) {
   case UNINITIALIZED:
     //申请gpu显存空间
     CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
+    Track(true);
     caffe_gpu_memset(size_, 0, gpu_ptr_);
     head_ = HEAD_AT_GPU;
     own_gpu_data_ = true;
@@ -85,6 +118,7 @@ inline void SyncedMemory::to_gpu() {
   case HEAD_AT_CPU:
     if (gpu_ptr_ == NULL) {
       CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
+      Track(true);
       own_gpu_data_ = true;
     }
     //从cpu_ptr_拷贝到gpu_ptr_
@@ -103,6 +137,9 @@ inline void SyncedMemory::to_gpu() {
 //获取内存指针
 const void* SyncedMemory::cpu_data() {
   check_device();
+  if (parent_) {
+    return static_cast<const char*>(parent_->cpu_data()) + offset_;
+  }
   to_cpu();
   return (const void*)cpu_ptr_;
 }
@@ -110,9 +147,16 @@ const void* SyncedMemory::cpu_data() {
 //设置cpu数据共享
 void SyncedMemory::set_cpu_data(void* data) {
   check_device();
+  // A view set to other data is no longer one.
+  Detach();
+  ++version_;
+  restore_.clear();
   CHECK(data);
   if (own_cpu_data_) {
     CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
+    if (tracked_) {
+      MemoryTracker::Free(this, false);
+    }
   }
   cpu_ptr_ = data;
   head_ = HEAD_AT_CPU;
@@ -123,6 +167,9 @@ void SyncedMemory::set_cpu_data(void* data) {
 const void* SyncedMemory::gpu_data() {
   check_device();
 #ifndef CPU_ONLY
+  if (parent_) {
+    return static_cast<const char*>(parent_->gpu_data()) + offset_;
+  }
   to_gpu();
   return (const void*)gpu_ptr_;
 #else
@@ -134,10 +181,16 @@ const void* SyncedMemory::gpu_data() {
 //显设置gpu数据共享
 void SyncedMemory::set_gpu_data(void* data) {
   check_device();
+  Detach();
+  ++version_;
+  restore_.clear();
 #ifndef CPU_ONLY
   CHECK(data);
   if (own_gpu_data_) {
     CUDA_CHECK(cudaFree(gpu_ptr_));
+    if (tracked_) {
+      MemoryTracker::Free(this, true);
+    }
   }
   gpu_ptr_ = data;
   head_ = HEAD_AT_GPU;
@@ -150,6 +203,10 @@ void SyncedMemory::set_gpu_data(void* data) {
 //获取可更改内存指针
 void* SyncedMemory::mutable_cpu_data() {
   check_device();
+  if (parent_) {
+    return static_cast<char*>(parent_->mutable_cpu_data()) + offset_;
+  }
+  ++version_;
   to_cpu();
   head_ = HEAD_AT_CPU;
   return cpu_ptr_;
@@ -158,6 +215,12 @@ void* SyncedMemory::mutable_cpu_data() {
 //获取可更改显存指针
 void* SyncedMemory::mutable_gpu_data() {
   check_device();
+#ifndef CPU_ONLY
+  if (parent_) {
+    return static_cast<char*>(parent_->mutable_gpu_data()) + offset_;
+  }
+#endif
+  ++version_;
 #ifndef CPU_ONLY
   to_gpu();
   head_ = HEAD_AT_GPU;
@@ -172,9 +235,14 @@ void* SyncedMemory::mutable_gpu_data() {
 //异步同步数据流
 void SyncedMemory::async_gpu_push(const cudaStream_t& stream) {
   check_device();
+  if (parent_) {
+    parent_->async_gpu_push(stream);
+    return;
+  }
   CHECK(head_ == HEAD_AT_CPU);
   if (gpu_ptr_ == NULL) {
     CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
+    Track(true);
     own_gpu_data_ = true;
   }
   const cudaMemcpyKind put = cudaMemcpyHostToDevice;
@@ -184,6 +252,48 @@ void SyncedMemory::async_gpu_push(const cudaStream_t& stream) {
 }
 #endif
 
+void SyncedMemory::Release(const boost::function<void(void*)>& restore) {
+  check_device();
+  CHECK(!parent_) << "A view cannot be released.";
+  CHECK(restore);
+  if (cpu_ptr_ && own_cpu_data_) {
+    CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
+    if (tracked_) {
+      MemoryTracker::Free(this, false);
+    }
+  }
+  cpu_ptr_ = NULL;
+  own_cpu_data_ = false;
+#ifndef CPU_ONLY
+  if (gpu_ptr_ && own_gpu_data_) {
+    CUDA_CHECK(cudaFree(gpu_ptr_));
+    if (tracked_) {
+      MemoryTracker::Free(this, true);
+    }
+  }
+  gpu_ptr_ = NULL;
+  own_gpu_data_ = false;
+#endif
+  head_ = UNINITIALIZED;
+  restore_ = restore;
+  ++version_;
+}
+
+void SyncedMemory::Detach() {
+  if (parent_) {
+    // Keep the version increasing, as it was the parent's.
+    version_ = parent_->version();
+    parent_.reset();
+  }
+}
+
+void SyncedMemory::Track(bool gpu) {
+  if (MemoryTracker::enabled()) {
+    MemoryTracker::Allocate(this, size_, gpu);
+    tracked_ = true;
+  }
+}
+
 void SyncedMemory::check_device() {
 #ifndef CPU_ONLY
 #ifdef DEBUG
@@ -8,6 +8,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/batch_norm_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -76,6 +77,50 @@ namespace caffe {
     }
   }
 
+  TYPED_TEST(BatchNormLayerTest, TestForwardLayouts) {
+    typedef typename TypeParam::Dtype Dtype;
+    LayerParameter layer_param;
+    layer_param.set_phase(TEST);
+    Blob<Dtype> bottom(2, 8, 3, 4);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&bottom);
+    vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+    BatchNormLayer<Dtype> layer(layer_param);
+    layer.SetUp(bottom_vec, this->blob_top_vec_);
+    // Some global statistics, with a moving average factor.
+    filler.Fill(layer.blobs()[0].get());
+    caffe_abs(8, layer.blobs()[0]->cpu_data(),
+        layer.blobs()[1]->mutable_cpu_data());
+    layer.blobs()[2]->mutable_cpu_data()[0] = 2;
+    layer.Forward(bottom_vec, this->blob_top_vec_);
+    Blob<Dtype> expected;
+    expected.CopyFrom(*this->blob_top_, false, true);
+
+    const BlobLayout layouts[] = { NHWC, NCHW8C };
+    for (int l = 0; l < 2; ++l) {
+      Blob<Dtype> blocked_bottom(bottom.shape());
+      blocked_bottom.set_layout(layouts[l]);
+      caffe_cpu_reorder(2, 8, 12, 1, blocked_bottom.layout_block(),
+          bottom.cpu_data(), blocked_bottom.mutable_cpu_data());
+      vector<Blob<Dtype>*> blocked_bottom_vec(1, &blocked_bottom);
+      // In place, as BatchNorm usually is.
+      layer.Reshape(blocked_bottom_vec, blocked_bottom_vec);
+      layer.Forward(blocked_bottom_vec, blocked_bottom_vec);
+      EXPECT_EQ(layouts[l], blocked_bottom.layout());
+      for (int n = 0; n < 2; ++n) {
+        for (int c = 0; c < 8; ++c) {
+          for (int h = 0; h < 3; ++h) {
+            for (int w = 0; w < 4; ++w) {
+              EXPECT_NEAR(expected.data_at(n, c, h, w),
+                  blocked_bottom.data_at(n, c, h, w), 1e-5);
+            }
+          }
+        }
+      }
+    }
+  }
+
   TYPED_TEST(BatchNormLayerTest, TestForwardInplace) {
     typedef typename TypeParam::Dtype Dtype;
     Blob<Dtype> blob_inplace(5, 2, 3, 4);
@@ -59,6 +59,35 @@ TYPED_TEST(BlobSimpleTest, TestReshapeZero) {
   EXPECT_EQ(this->blob_->count(), 0);
 }
 
+TYPED_TEST(BlobSimpleTest, TestViewData) {
+  this->blob_->Reshape(1, 2, 4, 5);
+  this->blob_->ViewData(*this->blob_preshaped_, 60);
+  this->blob_->ViewDiff(*this->blob_preshaped_, 20);
+  EXPECT_TRUE(this->blob_->DataViews(*this->blob_preshaped_, 60));
+  EXPECT_FALSE(this->blob_->DataViews(*this->blob_preshaped_, 20));
+  EXPECT_TRUE(this->blob_->DiffViews(*this->blob_preshaped_, 20));
+  EXPECT_EQ(this->blob_preshaped_->cpu_data() + 60, this->blob_->cpu_data());
+  EXPECT_EQ(this->blob_preshaped_->cpu_diff() + 20, this->blob_->cpu_diff());
+  // Writes to either are seen by both.
+  this->blob_->mutable_cpu_data()[3] = 7;
+  EXPECT_EQ(7, this->blob_preshaped_->cpu_data()[63]);
+  this->blob_preshaped_->mutable_cpu_diff()[21] = 5;
+  EXPECT_EQ(5, this->blob_->cpu_diff()[1]);
+  // Reshaping within the view keeps it; growing past it does not.
+  this->blob_->Reshape(1, 1, 4, 5);
+  EXPECT_TRUE(this->blob_->DataViews(*this->blob_preshaped_, 60));
+  this->blob_->Reshape(1, 3, 4, 5);
+  EXPECT_FALSE(this->blob_->DataViews(*this->blob_preshaped_, 60));
+  EXPECT_FALSE(this->blob_->DiffViews(*this->blob_preshaped_, 20));
+  // Neither does setting other data.
+  this->blob_->Reshape(1, 1, 4, 5);
+  this->blob_->ViewData(*this->blob_preshaped_, 100);
+  vector<TypeParam> data(20, 1);
+  this->blob_->set_cpu_data(&data[0]);
+  EXPECT_FALSE(this->blob_->DataViews(*this->blob_preshaped_, 100));
+  EXPECT_EQ(7, this->blob_preshaped_->cpu_data()[63]);
+}
+
 TYPED_TEST(BlobSimpleTest, TestLegacyBlobProtoShapeEquals) {
   BlobProto blob_proto;
 
@@ -0,0 +1,82 @@
+#include <boost/filesystem.hpp>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/chunk_store.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class ChunkStoreTest : public ::testing::Test {
+ protected:
+  ChunkStoreTest()
+      : blob_(new Blob<Dtype>(2, 3, 4, 5)) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_);
+    MakeTempDir(&directory_);
+  }
+  virtual ~ChunkStoreTest() { delete blob_; }
+  Blob<Dtype>* const blob_;
+  string directory_;
+};
+
+TYPED_TEST_CASE(ChunkStoreTest, TestDtypes);
+
+TYPED_TEST(ChunkStoreTest, TestRoundTrip) {
+  // 120 elements in chunks of 32 bytes.
+  ChunkStore store(this->directory_, 32);
+  ChunkedBlobProto proto;
+  store.Put(*this->blob_, &proto);
+  const int chunk_count = 32 / sizeof(TypeParam);
+  EXPECT_EQ((120 + chunk_count - 1) / chunk_count, proto.chunk_size());
+  Blob<TypeParam> loaded;
+  ChunkStore reader(this->directory_);
+  reader.Get(proto, &loaded);
+  EXPECT_TRUE(loaded.shape() == this->blob_->shape());
+  for (int i = 0; i < this->blob_->count(); ++i) {
+    EXPECT_EQ(this->blob_->cpu_data()[i], loaded.cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(ChunkStoreTest, TestMakesDirectoryOnWrite) {
+  const string directory = this->directory_ + "/chunks";
+  ChunkStore store(directory, 32);
+  EXPECT_FALSE(boost::filesystem::exists(directory));
+  ChunkedBlobProto proto;
+  store.Put(*this->blob_, &proto);
+  EXPECT_TRUE(boost::filesystem::is_directory(directory));
+}
+
+TYPED_TEST(ChunkStoreTest, TestWritesOnlyChangedChunks) {
+  ChunkStore store(this->directory_, 32);
+  ChunkedBlobProto proto;
+  store.Put(*this->blob_, &proto);
+  const int initial_chunks = store.chunks_written();
+  EXPECT_EQ(proto.chunk_size(), initial_chunks);
+  // Storing unchanged data writes nothing.
+  store.Put(*this->blob_, &proto);
+  EXPECT_EQ(initial_chunks, store.chunks_written());
+  // Changing one element rewrites only the chunk holding it.
+  this->blob_->mutable_cpu_data()[this->blob_->count() - 1] += 1;
+  ChunkedBlobProto changed_proto;
+  store.Put(*this->blob_, &changed_proto);
+  EXPECT_EQ(initial_chunks + 1, store.chunks_written());
+  ASSERT_EQ(proto.chunk_size(), changed_proto.chunk_size());
+  for (int i = 0; i < proto.chunk_size() - 1; ++i) {
+    EXPECT_EQ(proto.chunk(i), changed_proto.chunk(i));
+  }
+  EXPECT_NE(proto.chunk(proto.chunk_size() - 1),
+      changed_proto.chunk(changed_proto.chunk_size() - 1));
+}
+
+}  // namespace caffe
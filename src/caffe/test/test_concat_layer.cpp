@@ -6,6 +6,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/concat_layer.hpp"
+#include "caffe/layers/split_layer.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -166,6 +167,72 @@ TYPED_TEST(ConcatLayerTest, TestForwardChannels) {
   }
 }
 
+TYPED_TEST(ConcatLayerTest, TestForwardViews) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_concat_param()->set_axis(0);
+  for (int views = 0; views < 2; ++views) {
+    ConcatLayer<Dtype> layer(layer_param);
+    layer.set_blob_views(views);
+    layer.SetUp(this->blob_bottom_vec_1_, this->blob_top_vec_);
+    // Concatenating the nums, the bottoms are contiguous in the top.
+    const int offset = this->blob_bottom_0_->count();
+    EXPECT_EQ(views, this->blob_bottom_0_->DataViews(*this->blob_top_, 0));
+    EXPECT_EQ(views, this->blob_bottom_2_->DataViews(*this->blob_top_,
+        offset));
+    EXPECT_EQ(views, this->blob_bottom_2_->DiffViews(*this->blob_top_,
+        offset));
+    // The bottoms keep their data, and later writes to them are concatenated.
+    layer.Forward(this->blob_bottom_vec_1_, this->blob_top_vec_);
+    EXPECT_EQ(1, this->blob_top_->cpu_data()[0]);
+    EXPECT_EQ(3, this->blob_top_->cpu_data()[offset]);
+    this->blob_bottom_2_->mutable_cpu_data()[1] = 4;
+    layer.Forward(this->blob_bottom_vec_1_, this->blob_top_vec_);
+    EXPECT_EQ(4, this->blob_top_->cpu_data()[offset + 1]);
+    this->blob_bottom_2_->mutable_cpu_data()[1] = 3;
+    // As are the diffs of the top, in Backward.
+    this->blob_top_->mutable_cpu_diff()[offset + 2] = 5;
+    vector<bool> propagate_down(2, true);
+    layer.Backward(this->blob_top_vec_, propagate_down,
+        this->blob_bottom_vec_1_);
+    EXPECT_EQ(5, this->blob_bottom_2_->cpu_diff()[2]);
+  }
+}
+
+TYPED_TEST(ConcatLayerTest, TestForwardSplitViews) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Split -> Concat: the Split top shares the data of its bottom again in
+  // every pass, so only the other bottom is made a view of the top.
+  LayerParameter layer_param;
+  SplitLayer<Dtype> split_layer(layer_param);
+  Blob<Dtype> split_top_0, split_top_1;
+  vector<Blob<Dtype>*> split_bottom_vec(1, this->blob_bottom_0_);
+  vector<Blob<Dtype>*> split_top_vec;
+  split_top_vec.push_back(&split_top_0);
+  split_top_vec.push_back(&split_top_1);
+  split_layer.SetUp(split_bottom_vec, split_top_vec);
+  layer_param.mutable_concat_param()->set_axis(0);
+  ConcatLayer<Dtype> layer(layer_param);
+  vector<Blob<Dtype>*> bottom_vec;
+  bottom_vec.push_back(&split_top_0);
+  bottom_vec.push_back(this->blob_bottom_2_);
+  layer.SetUp(bottom_vec, this->blob_top_vec_);
+  const int offset = this->blob_bottom_0_->count();
+  const SyncedMemory* view = this->blob_bottom_2_->data().get();
+  for (int pass = 0; pass < 2; ++pass) {
+    this->blob_bottom_0_->mutable_cpu_data()[1] = 4 + pass;
+    split_layer.Forward(split_bottom_vec, split_top_vec);
+    layer.Forward(bottom_vec, this->blob_top_vec_);
+    EXPECT_FALSE(split_top_0.DataViews(*this->blob_top_, 0));
+    EXPECT_EQ(this->blob_bottom_0_->data(), split_top_0.data());
+    EXPECT_TRUE(this->blob_bottom_2_->DataViews(*this->blob_top_, offset));
+    EXPECT_EQ(view, this->blob_bottom_2_->data().get());
+    EXPECT_EQ(1, this->blob_top_->cpu_data()[0]);
+    EXPECT_EQ(4 + pass, this->blob_top_->cpu_data()[1]);
+    EXPECT_EQ(3, this->blob_top_->cpu_data()[offset]);
+  }
+}
+
 TYPED_TEST(ConcatLayerTest, TestGradientTrivial) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
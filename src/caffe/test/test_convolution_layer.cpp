@@ -6,6 +6,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/util/sparse_matrix.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_conv_layer.hpp"
@@ -495,6 +496,124 @@ TYPED_TEST(ConvolutionLayerTest, TestSimpleConvolutionGroup) {
   }
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestSparseConvolutionGroup) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(3);
+  convolution_param->set_sparse_threshold(0.8);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("constant");
+  convolution_param->mutable_bias_filler()->set_value(0.1);
+  shared_ptr<Layer<Dtype> > layer(
+      new ConvolutionLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Prune the weights, as prune_net does.
+  caffe_prune_by_magnitude(layer->blobs()[0]->count(), 0.85,
+      layer->blobs()[0]->mutable_cpu_data());
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Check against reference convolution.
+  caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+      this->MakeReferenceTop(this->blob_top_));
+  const Dtype* top_data = this->blob_top_->cpu_data();
+  const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestConvolutionLayouts) {
+  typedef typename TypeParam::Dtype Dtype;
+  Blob<Dtype> bottom(2, 8, 6, 5);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&bottom);
+  const BlobLayout layouts[] = { NHWC, NCHW8C };
+  for (int l = 0; l < 2; ++l) {
+    // 3x3 with stride and padding, 1x1, and outputs that fill no blocks.
+    for (int config = 0; config < 3; ++config) {
+      LayerParameter layer_param;
+      layer_param.set_phase(TEST);
+      ConvolutionParameter* convolution_param =
+          layer_param.mutable_convolution_param();
+      convolution_param->add_kernel_size(config == 1 ? 1 : 3);
+      convolution_param->add_stride(config == 1 ? 1 : 2);
+      convolution_param->add_pad(config == 1 ? 0 : 1);
+      convolution_param->set_num_output(config == 2 ? 6 : 16);
+      convolution_param->mutable_weight_filler()->set_type("gaussian");
+      convolution_param->mutable_bias_filler()->set_type("gaussian");
+      ConvolutionLayer<Dtype> layer(layer_param);
+      Blob<Dtype> blocked_bottom(bottom.shape());
+      blocked_bottom.set_layout(layouts[l]);
+      caffe_cpu_reorder(2, 8, 30, 1, blocked_bottom.layout_block(),
+          bottom.cpu_data(), blocked_bottom.mutable_cpu_data());
+      vector<Blob<Dtype>*> bottom_vec(1, &blocked_bottom);
+      layer.SetUp(bottom_vec, this->blob_top_vec_);
+      EXPECT_EQ(config == 2 ? NHWC : layouts[l], this->blob_top_->layout());
+      layer.Forward(bottom_vec, this->blob_top_vec_);
+      caffe_conv(&bottom, convolution_param, layer.blobs(),
+          this->MakeReferenceTop(this->blob_top_));
+      const Blob<Dtype>& ref_top = *this->ref_blob_top_;
+      for (int n = 0; n < ref_top.num(); ++n) {
+        for (int c = 0; c < ref_top.channels(); ++c) {
+          for (int h = 0; h < ref_top.height(); ++h) {
+            for (int w = 0; w < ref_top.width(); ++w) {
+              EXPECT_NEAR(ref_top.data_at(n, c, h, w),
+                  this->blob_top_->data_at(n, c, h, w), 1e-4);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestConvolutionTopLayout) {
+  typedef typename TypeParam::Dtype Dtype;
+  // NCHW bottoms of 3 channels, which fill no blocks, to blocked tops.
+  Blob<Dtype> bottom(2, 3, 6, 5);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&bottom);
+  vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+  const BlobLayout layouts[] = { NHWC, NCHW8C, NCHW16C };
+  for (int l = 0; l < 3; ++l) {
+    LayerParameter layer_param;
+    layer_param.set_phase(TEST);
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(3);
+    convolution_param->add_stride(2);
+    convolution_param->add_pad(1);
+    convolution_param->set_num_output(16);
+    convolution_param->set_top_layout(layouts[l]);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    ConvolutionLayer<Dtype> layer(layer_param);
+    layer.SetUp(bottom_vec, this->blob_top_vec_);
+    EXPECT_EQ(layouts[l], this->blob_top_->layout());
+    layer.Forward(bottom_vec, this->blob_top_vec_);
+    caffe_conv(&bottom, convolution_param, layer.blobs(),
+        this->MakeReferenceTop(this->blob_top_));
+    const Blob<Dtype>& ref_top = *this->ref_blob_top_;
+    for (int n = 0; n < ref_top.num(); ++n) {
+      for (int c = 0; c < ref_top.channels(); ++c) {
+        for (int h = 0; h < ref_top.height(); ++h) {
+          for (int w = 0; w < ref_top.width(); ++w) {
+            EXPECT_NEAR(ref_top.data_at(n, c, h, w),
+                this->blob_top_->data_at(n, c, h, w), 1e-4);
+          }
+        }
+      }
+    }
+  }
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestSobelConvolution) {
   // Test separable convolution by computing the Sobel operator
   // as a single filter then comparing the result
@@ -26,7 +26,8 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
  protected:
   GradientBasedSolverTest() :
       seed_(1701), num_(4), channels_(3), height_(10), width_(10),
-      share_(false) {
+      share_(false), snapshot_async_(false),
+      snapshot_format_("BINARYPROTO") {
         input_file_ = new string(
         ABS_TEST_DATA_DIR "/solver_data_list.txt");
       }
@@ -44,6 +45,8 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
   // TODO this is brittle and the hdf5 file should be checked instead.
   int num_, channels_, height_, width_;
   bool share_;
+  bool snapshot_async_;
+  string snapshot_format_;
   Dtype delta_;  // Stability constant for RMSProp, AdaGrad, AdaDelta and Adam
 
   // Test data: check out generate_sample_data.py in the same directory.
@@ -82,6 +85,8 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
 #endif
     proto <<
        "snapshot_after_train: " << snapshot << " "
+       "snapshot_async: " << snapshot_async_ << " "
+       "snapshot_format: " << snapshot_format_ << " "
        "max_iter: " << num_iters << " "
        "base_lr: " << learning_rate << " "
        "lr_policy: 'fixed' "
@@ -261,6 +266,7 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
     Blob<Dtype>& updated_bias = *(*updated_params)[1];
     updated_bias.ReshapeLike(bias);
 
+    vector<Dtype> grads(D + 1);
     for (int i = 0; i <= D; ++i) {
       // Compute the derivative with respect to the ith weight (i.e., the ith
       // element of the gradient).
@@ -286,17 +292,59 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
       }
       // Scale the gradient over the N samples.
       grad /= N;
-      // Add the weight decay to the gradient.
-      grad += weight_decay *
-          ((i == D) ? bias.cpu_data()[0] : weights.cpu_data()[i]);
-      // Finally, compute update.
-      const vector<shared_ptr<Blob<Dtype> > >& history = solver_->history();
-      if (solver_->type() != string("AdaDelta")
-          && solver_->type() != string("Adam")) {
-        ASSERT_EQ(2, history.size());  // 1 blob for weights, 1 for bias
-      } else {
-        ASSERT_EQ(4, history.size());  // additional blobs for update history
+      // Add the weight decay to the gradient (LAMB adds it to the step).
+      if (solver_->type() != string("LAMB")) {
+        grad += weight_decay *
+            ((i == D) ? bias.cpu_data()[0] : weights.cpu_data()[i]);
       }
+      grads[i] = grad;
+    }
+
+    const vector<shared_ptr<Blob<Dtype> > >& history = solver_->history();
+    if (solver_->type() != string("AdaDelta")
+        && solver_->type() != string("Adam")
+        && solver_->type() != string("LAMB")) {
+      ASSERT_EQ(2, history.size());  // 1 blob for weights, 1 for bias
+    } else {
+      ASSERT_EQ(4, history.size());  // additional blobs for update history
+    }
+    // LARS and LAMB scale the update of the weights and of the bias by a
+    // trust ratio computed from the norms of each blob.
+    vector<Dtype> steps(D + 1);
+    Dtype weight_sumsq[2] = {0, 0};
+    Dtype step_sumsq[2] = {0, 0};
+    for (int i = 0; i <= D; ++i) {
+      const int blob_id = (i == D) ? 1 : 0;
+      const Dtype weight =
+          (i == D) ? bias.cpu_data()[0] : weights.cpu_data()[i];
+      steps[i] = grads[i];
+      if (solver_->type() == string("LAMB")) {
+        const Dtype momentum2 = 0.999;
+        const Dtype m = history[blob_id]->cpu_data()[i - blob_id * D];
+        const Dtype v =
+            history[blob_id + num_param_blobs]->cpu_data()[i - blob_id * D];
+        const Dtype val_m = (1 - momentum) * grads[i] + momentum * m;
+        const Dtype val_v =
+            (1 - momentum2) * grads[i] * grads[i] + momentum2 * v;
+        steps[i] = val_m / (Dtype(1) - pow(momentum, num_iters)) /
+            (std::sqrt(val_v / (Dtype(1) - pow(momentum2, num_iters)))
+             + delta_) + weight_decay * weight;
+      }
+      weight_sumsq[blob_id] += weight * weight;
+      step_sumsq[blob_id] += steps[i] * steps[i];
+    }
+
+    for (int i = 0; i <= D; ++i) {
+      const Dtype grad = grads[i];
+      const int blob_id = (i == D) ? 1 : 0;
+      Dtype trust_ratio = 1;
+      if (weight_sumsq[blob_id] > 0 && step_sumsq[blob_id] > 0) {
+        trust_ratio = std::sqrt(weight_sumsq[blob_id] / step_sumsq[blob_id]);
+        if (solver_->type() == string("LARS")) {
+          trust_ratio *= solver_->param().lars_eta();
+        }
+      }
+      // Finally, compute update.
       Dtype update_value = learning_rate * grad;
       const Dtype history_value = (i == D) ?
             history[1]->cpu_data()[0] : history[0]->cpu_data()[i];
@@ -336,6 +384,10 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
             std::sqrt(Dtype(1) - pow(momentum2, num_iters)) /
             (Dtype(1.) - pow(momentum, num_iters));
         update_value = alpha_t * val_m / (std::sqrt(val_v) + delta_);
+      } else if (solver_->type() == string("LARS")) {
+        update_value = learning_rate * trust_ratio * grad + temp;
+      } else if (solver_->type() == string("LAMB")) {
+        update_value = learning_rate * trust_ratio * steps[i];
       } else {
         LOG(FATAL) << "Unknown solver type: " << solver_->type();
       }
@@ -706,6 +758,30 @@ TYPED_TEST(SGDSolverTest, TestSnapshot) {
   }
 }
 
+TYPED_TEST(SGDSolverTest, TestSnapshotAsync) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->snapshot_async_ = true;
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
+TYPED_TEST(SGDSolverTest, TestSnapshotChunked) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->snapshot_format_ = "CHUNKED";
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
 TYPED_TEST(SGDSolverTest, TestSnapshotShare) {
   typedef typename TypeParam::Dtype Dtype;
   const Dtype kLearningRate = 0.01;
@@ -1286,4 +1362,130 @@ TYPED_TEST(RMSPropSolverTest, TestSnapshotShare) {
   }
 }
 
+template <typename TypeParam>
+class LARSSolverTest : public GradientBasedSolverTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  virtual void InitSolver(const SolverParameter& param) {
+    SolverParameter new_param = param;
+    new_param.set_lars_eta(0.5);
+    this->solver_.reset(new LARSSolver<Dtype>(new_param));
+  }
+};
+
+TYPED_TEST_CASE(LARSSolverTest, TestDtypesAndDevices);
+
+TYPED_TEST(LARSSolverTest, TestLARSLeastSquaresUpdate) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0;
+  const Dtype kMomentum = 0.9;
+  this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum);
+}
+
+TYPED_TEST(LARSSolverTest, TestLARSLeastSquaresUpdateWithWeightDecay) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum);
+}
+
+TYPED_TEST(LARSSolverTest, TestLARSLeastSquaresUpdateWithEverything) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  for (int i = 0; i <= kNumIters; ++i) {
+    this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
+TYPED_TEST(LARSSolverTest, TestLeastSquaresUpdateWithEverythingAccum) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  const int kIterSize = 2;
+  this->CheckAccumulation(kLearningRate, kWeightDecay, kMomentum, kNumIters,
+      kIterSize);
+}
+
+TYPED_TEST(LARSSolverTest, TestSnapshot) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
+template <typename TypeParam>
+class LAMBSolverTest : public GradientBasedSolverTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  virtual void InitSolver(const SolverParameter& param) {
+    SolverParameter new_param = param;
+    new_param.set_momentum2(0.999);
+    this->solver_.reset(new LAMBSolver<Dtype>(new_param));
+  }
+};
+
+TYPED_TEST_CASE(LAMBSolverTest, TestDtypesAndDevices);
+
+TYPED_TEST(LAMBSolverTest, TestLAMBLeastSquaresUpdate) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0;
+  const Dtype kMomentum = 0.9;
+  this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum);
+}
+
+TYPED_TEST(LAMBSolverTest, TestLAMBLeastSquaresUpdateWithWeightDecay) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum);
+}
+
+TYPED_TEST(LAMBSolverTest, TestLAMBLeastSquaresUpdateWithEverything) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  for (int i = 0; i <= kNumIters; ++i) {
+    this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
+TYPED_TEST(LAMBSolverTest, TestLeastSquaresUpdateWithEverythingAccum) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  const int kIterSize = 2;
+  this->CheckAccumulation(kLearningRate, kWeightDecay, kMomentum, kNumIters,
+      kIterSize);
+}
+
+TYPED_TEST(LAMBSolverTest, TestSnapshot) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
 }  // namespace caffe
@@ -0,0 +1,186 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/inference_engine.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void RunContext(const InferenceEngine<Dtype>* engine,
+    const Blob<Dtype>* input, const int iters, Blob<Dtype>* output) {
+  shared_ptr<typename InferenceEngine<Dtype>::Context> context =
+      engine->CreateContext();
+  for (int i = 0; i < iters; ++i) {
+    context->input_blobs()[0]->CopyFrom(*input);
+    output->CopyFrom(*context->Forward()[0], false, true);
+  }
+}
+
+template <typename TypeParam>
+class InferenceEngineTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  void InitEngine(const string& proto) {
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    engine_.reset(new InferenceEngine<Dtype>(param));
+  }
+
+  void InitConvEngine() {
+    InitEngine(
+        "name: 'TestNetwork' "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { shape { dim: 2 dim: 3 dim: 6 dim: 6 } } "
+        "} "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "    bias_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'pool' "
+        "  type: 'Pooling' "
+        "  bottom: 'conv' "
+        "  top: 'pool' "
+        "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } "
+        "} "
+        "layer { "
+        "  name: 'norm' "
+        "  type: 'LRN' "
+        "  bottom: 'pool' "
+        "  top: 'norm' "
+        "  lrn_param { local_size: 3 } "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'norm' "
+        "  top: 'ip' "
+        "  inner_product_param { "
+        "    num_output: 5 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'prob' "
+        "  type: 'Softmax' "
+        "  bottom: 'ip' "
+        "  top: 'prob' "
+        "} ");
+  }
+
+  void ExpectSharedWeights(Net<Dtype>* net) {
+    const vector<string>& names = net->layer_names();
+    for (int i = 0; i < names.size(); ++i) {
+      const vector<shared_ptr<Blob<Dtype> > >& blobs =
+          net->layer_by_name(names[i])->blobs();
+      const vector<shared_ptr<Blob<Dtype> > >& engine_blobs =
+          engine_->net().layer_by_name(names[i])->blobs();
+      ASSERT_EQ(engine_blobs.size(), blobs.size());
+      for (int j = 0; j < blobs.size(); ++j) {
+        EXPECT_EQ(engine_blobs[j]->cpu_data(), blobs[j]->cpu_data());
+      }
+    }
+  }
+
+  shared_ptr<InferenceEngine<Dtype> > engine_;
+};
+
+TYPED_TEST_CASE(InferenceEngineTest, TestDtypesAndDevices);
+
+TYPED_TEST(InferenceEngineTest, TestContextsShareWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitConvEngine();
+  shared_ptr<typename InferenceEngine<Dtype>::Context> context =
+      this->engine_->CreateContext();
+  ASSERT_EQ(1, context->input_blobs().size());
+  ASSERT_EQ(1, context->output_blobs().size());
+  this->ExpectSharedWeights(context->net());
+  // The activations are the context's own.
+  EXPECT_NE(this->engine_->net().blob_by_name("conv").get(),
+      context->net()->blob_by_name("conv").get());
+}
+
+TYPED_TEST(InferenceEngineTest, TestRecurrentContextSharesWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitEngine(
+      "name: 'TestNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'x' "
+      "  top: 'cont' "
+      "  input_param { "
+      "    shape { dim: 2 dim: 1 dim: 3 } "
+      "    shape { dim: 2 dim: 1 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'rnn' "
+      "  type: 'RNN' "
+      "  bottom: 'x' "
+      "  bottom: 'cont' "
+      "  top: 'h' "
+      "  recurrent_param { "
+      "    num_output: 4 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "  } "
+      "} ");
+  shared_ptr<typename InferenceEngine<Dtype>::Context> context =
+      this->engine_->CreateContext();
+  this->ExpectSharedWeights(context->net());
+}
+
+TYPED_TEST(InferenceEngineTest, TestConcurrentForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitConvEngine();
+  const int kNumThreads = 4;
+  const int kIters = 5;
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  vector<shared_ptr<Blob<Dtype> > > inputs, expected, outputs;
+  for (int i = 0; i < kNumThreads; ++i) {
+    inputs.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>(2, 3, 6, 6)));
+    filler.Fill(inputs[i].get());
+    expected.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    outputs.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    RunContext(this->engine_.get(), inputs[i].get(), 1, expected[i].get());
+  }
+  boost::thread_group threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.create_thread(boost::bind(&RunContext<Dtype>,
+        this->engine_.get(), inputs[i].get(), kIters, outputs[i].get()));
+  }
+  threads.join_all();
+  for (int i = 0; i < kNumThreads; ++i) {
+    ASSERT_EQ(expected[i]->count(), outputs[i]->count());
+    for (int j = 0; j < expected[i]->count(); ++j) {
+      EXPECT_NEAR(expected[i]->cpu_data()[j], outputs[i]->cpu_data()[j],
+          1e-6);
+    }
+  }
+}
+
+}  // namespace caffe
@@ -6,6 +6,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/util/sparse_matrix.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -135,6 +136,92 @@ TYPED_TEST(InnerProductLayerTest, TestForward) {
   }
 }
 
+TYPED_TEST(InnerProductLayerTest, TestForwardSparse) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  for (int transpose = 0; transpose < 2; ++transpose) {
+    LayerParameter layer_param;
+    layer_param.set_phase(TEST);
+    InnerProductParameter* inner_product_param =
+        layer_param.mutable_inner_product_param();
+    inner_product_param->set_num_output(10);
+    inner_product_param->set_transpose(transpose);
+    inner_product_param->set_sparse_threshold(0.8);
+    inner_product_param->mutable_weight_filler()->set_type("gaussian");
+    inner_product_param->mutable_bias_filler()->set_type("gaussian");
+    InnerProductLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    // A dense layer sharing the weights.
+    inner_product_param->clear_sparse_threshold();
+    InnerProductLayer<Dtype> dense_layer(layer_param);
+    Blob<Dtype> dense_top;
+    vector<Blob<Dtype>*> dense_top_vec(1, &dense_top);
+    dense_layer.blobs() = layer.blobs();
+    dense_layer.SetUp(this->blob_bottom_vec_, dense_top_vec);
+    Blob<Dtype>* weights = layer.blobs()[0].get();
+    caffe_prune_by_magnitude(weights->count(), 0.9,
+        weights->mutable_cpu_data());
+    // The second pass follows a change of the weights.
+    for (int pass = 0; pass < 2; ++pass) {
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      dense_layer.Forward(this->blob_bottom_vec_, dense_top_vec);
+      for (int i = 0; i < dense_top.count(); ++i) {
+        EXPECT_NEAR(dense_top.cpu_data()[i], this->blob_top_->cpu_data()[i],
+            1e-5);
+      }
+      weights->mutable_cpu_data()[0] = 1;
+    }
+  }
+}
+
+TYPED_TEST(InnerProductLayerTest, TestForwardSparseLoaded) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->set_sparse_threshold(0.8);
+  inner_product_param->mutable_weight_filler()->set_type("gaussian");
+  inner_product_param->mutable_bias_filler()->set_type("gaussian");
+  InnerProductLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype>* weights = layer.blobs()[0].get();
+  caffe_prune_by_magnitude(weights->count(), 0.9,
+      weights->mutable_cpu_data());
+  Blob<Dtype> expected_weights;
+  expected_weights.CopyFrom(*weights, false, true);
+  // Load the weights from their sparse form, as from a pruned caffemodel.
+  BlobProto proto;
+  weights->ToProto(&proto);
+  SparsifyBlobProto(&proto);
+  ASSERT_GT(proto.sparse_index_size(), 0);
+  weights->FromProto(proto);
+  EXPECT_EQ(SyncedMemory::UNINITIALIZED, weights->data()->head());
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  if (Caffe::mode() == Caffe::CPU) {
+    // The sparse form alone was built; the dense weights were not written.
+    EXPECT_EQ(SyncedMemory::UNINITIALIZED, weights->data()->head());
+  }
+  Blob<Dtype> dense_top;
+  vector<Blob<Dtype>*> dense_top_vec(1, &dense_top);
+  inner_product_param->clear_sparse_threshold();
+  InnerProductLayer<Dtype> dense_layer(layer_param);
+  dense_layer.SetUp(this->blob_bottom_vec_, dense_top_vec);
+  dense_layer.blobs()[0]->CopyFrom(expected_weights);
+  dense_layer.blobs()[1]->CopyFrom(*layer.blobs()[1]);
+  dense_layer.Forward(this->blob_bottom_vec_, dense_top_vec);
+  for (int i = 0; i < dense_top.count(); ++i) {
+    EXPECT_NEAR(dense_top.cpu_data()[i], this->blob_top_->cpu_data()[i],
+        1e-5);
+  }
+  // Reading the weights writes them out.
+  for (int i = 0; i < weights->count(); ++i) {
+    EXPECT_EQ(expected_weights.cpu_data()[i], weights->cpu_data()[i]);
+  }
+}
+
 /**
  * @brief Init. an IP layer without transpose + random weights,
  * run Forward, save the result.
@@ -1,6 +1,11 @@
 #include <stdint.h>  // for uint32_t & uint64_t
 #include <time.h>
+#include <algorithm>
 #include <cmath>  // for std::fabs
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -119,6 +124,64 @@ TYPED_TEST(CPUMathFunctionsTest, TestCopy) {
   }
 }
 
+TYPED_TEST(CPUMathFunctionsTest, TestRoundBF16) {
+  const int n = this->blob_bottom_->count();
+  const TypeParam* x = this->blob_bottom_->cpu_data();
+  TypeParam* y = this->blob_top_->mutable_cpu_data();
+  caffe_copy(n, x, y);
+  caffe_cpu_round_bf16(n, y);
+  for (int i = 0; i < n; ++i) {
+    // 8 significant bits: the relative rounding error is at most 2^-8.
+    EXPECT_LE(std::fabs(y[i] - x[i]), std::fabs(x[i]) / 256);
+  }
+  // Rounding is idempotent.
+  caffe_copy(n, y, this->blob_bottom_->mutable_cpu_data());
+  caffe_cpu_round_bf16(n, y);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(this->blob_bottom_->cpu_data()[i], y[i]);
+  }
+  // Ties round to even, and values past the bfloat16 range overflow.
+  TypeParam values[5];
+  values[0] = 1 + 1. / 256;
+  values[1] = 1 + 3. / 256;
+  values[2] = 257;
+  values[3] = std::numeric_limits<TypeParam>::max();
+  values[4] = -std::numeric_limits<TypeParam>::max();
+  caffe_cpu_round_bf16(5, values);
+  EXPECT_EQ(1, values[0]);
+  EXPECT_EQ(1 + 4. / 256, values[1]);
+  EXPECT_EQ(256, values[2]);
+  EXPECT_TRUE(std::isinf(values[3]));
+  EXPECT_TRUE(std::isinf(values[4]));
+  EXPECT_LT(values[4], 0);
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestTopK) {
+  typedef std::pair<TypeParam, int> Pair;
+  // Every third of 3000 values, with ties.
+  const int n = 1000;
+  TypeParam* x = this->blob_bottom_->mutable_cpu_data();
+  for (int i = 0; i < 3 * n; ++i) {
+    x[i] = std::floor(x[i] * 4) / 4;
+  }
+  vector<Pair> expected(n);
+  for (int j = 0; j < n; ++j) {
+    expected[j] = Pair(x[3 * j], j);
+  }
+  std::sort(expected.begin(), expected.end(), std::greater<Pair>());
+  // Both the heap (k <= n / 16) and quickselect.
+  const int ks[] = { 1, 5, 62, 63, 500, 1000 };
+  vector<Pair> top;
+  for (int i = 0; i < 6; ++i) {
+    caffe_cpu_top_k(n, x, 3, ks[i], &top);
+    ASSERT_GE(top.size(), ks[i]);
+    for (int j = 0; j < ks[i]; ++j) {
+      EXPECT_EQ(expected[j].first, top[j].first);
+      EXPECT_EQ(expected[j].second, top[j].second);
+    }
+  }
+}
+
 #ifndef CPU_ONLY
 
 template <typename Dtype>
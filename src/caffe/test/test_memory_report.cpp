@@ -0,0 +1,161 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/memory_report.hpp"
+#include "caffe/net.hpp"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/memory_tracker.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class MemoryTrackerTest : public ::testing::Test {
+ protected:
+  virtual void TearDown() {
+    MemoryTracker::set_enabled(false);
+  }
+};
+
+TEST_F(MemoryTrackerTest, TestScope) {
+  MemoryTracker::set_enabled(true);
+  const MemoryTracker::Usage before = MemoryTracker::total();
+  int owner, inner;
+  {
+    MemoryTracker::Scope scope(&owner);
+    SyncedMemory memory(100);
+    memory.mutable_cpu_data();
+    {
+      MemoryTracker::Scope inner_scope(&inner);
+      SyncedMemory inner_memory(10);
+      inner_memory.cpu_data();
+      EXPECT_EQ(10, MemoryTracker::usage(&inner).current);
+    }
+    // The inner scope restored the outer.
+    SyncedMemory other(20);
+    other.cpu_data();
+    EXPECT_EQ(120, MemoryTracker::usage(&owner).current);
+    EXPECT_EQ(2, MemoryTracker::usage(&owner).allocations);
+    EXPECT_EQ(before.current + 120, MemoryTracker::total().current);
+  }
+  EXPECT_EQ(0, MemoryTracker::usage(&owner).current);
+  EXPECT_EQ(120, MemoryTracker::usage(&owner).peak);
+  EXPECT_EQ(0, MemoryTracker::usage(&inner).current);
+  EXPECT_EQ(before.current, MemoryTracker::total().current);
+  MemoryTracker::ResetPeaks();
+  EXPECT_EQ(0, MemoryTracker::usage(&owner).peak);
+  EXPECT_EQ(0, MemoryTracker::usage(&owner).allocations);
+}
+
+TEST_F(MemoryTrackerTest, TestDisabled) {
+  int owner;
+  MemoryTracker::Scope scope(&owner);
+  SyncedMemory memory(100);
+  memory.cpu_data();
+  EXPECT_EQ(0, MemoryTracker::usage(&owner).allocations);
+}
+
+template <typename Dtype>
+class MemoryReportTest : public ::testing::Test {
+ protected:
+  MemoryReportTest() {
+    const string proto =
+        "name: 'TestNetwork' "
+        "force_backward: true "
+        "state { phase: TRAIN } "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { shape { dim: 2 dim: 3 dim: 8 dim: 8 } } "
+        "} "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'pool' "
+        "  type: 'Pooling' "
+        "  bottom: 'conv' "
+        "  top: 'pool' "
+        "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } "
+        "} "
+        "layer { "
+        "  name: 'relu' "
+        "  type: 'ReLU' "
+        "  bottom: 'pool' "
+        "  top: 'pool' "
+        "} ";
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param_));
+  }
+  virtual void TearDown() {
+    MemoryTracker::set_enabled(false);
+  }
+
+  const typename MemoryReport<Dtype>::LayerMemory& Find(
+      const MemoryReport<Dtype>& report, const string& name) {
+    for (int i = 0; i < report.layers().size(); ++i) {
+      if (report.layers()[i].name == name) {
+        return report.layers()[i];
+      }
+    }
+    LOG(FATAL) << "No layer " << name;
+    return report.layers()[0];
+  }
+
+  NetParameter param_;
+};
+
+TYPED_TEST_CASE(MemoryReportTest, TestDtypes);
+
+TYPED_TEST(MemoryReportTest, TestReport) {
+  Caffe::set_mode(Caffe::CPU);
+  MemoryTracker::set_enabled(true);
+  Net<TypeParam> net(this->param_);
+  net.Forward();
+  net.Backward();
+  MemoryReport<TypeParam> report(net);
+  const size_t size = sizeof(TypeParam);
+  // Data and diff of the 4 x 3 x 3 x 3 weights and 4 biases.
+  const typename MemoryReport<TypeParam>::LayerMemory& conv =
+      this->Find(report, "conv");
+  EXPECT_EQ("Convolution", conv.type);
+  EXPECT_EQ(2 * (108 + 4) * size, conv.params);
+  EXPECT_EQ(2 * 2 * 4 * 6 * 6 * size, conv.activations);
+  // The column buffer and bias multiplier.
+  EXPECT_GT(conv.scratch, 0);
+  EXPECT_GE(conv.peak, conv.params + conv.activations);
+  // The max indices of the 2 x 4 x 3 x 3 outputs, recorded in TRAIN, and the
+  // few bytes of the shapes of its blobs, which SyncedMemory holds too.
+  const typename MemoryReport<TypeParam>::LayerMemory& pool =
+      this->Find(report, "pool");
+  EXPECT_EQ(0, pool.params);
+  EXPECT_GE(pool.scratch, 72 * sizeof(int));
+  EXPECT_LE(pool.scratch, 72 * sizeof(int) + 2 * 4 * sizeof(int));
+  // The in-place ReLU has no memory of its own.
+  EXPECT_EQ(0, this->Find(report, "relu").total());
+  for (int i = 1; i < report.layers().size(); ++i) {
+    EXPECT_GE(report.layers()[i - 1].total(), report.layers()[i].total());
+  }
+  // The blobs are the largest first: the input, then the convolution.
+  ASSERT_EQ(5, report.blobs().size());
+  EXPECT_EQ("data", report.blobs()[0].name);
+  EXPECT_EQ(2 * 384 * size, report.blobs()[0].bytes);
+  EXPECT_EQ("conv", report.blobs()[1].name);
+  EXPECT_EQ("conv[0]", report.blobs()[2].name);
+  EXPECT_EQ(2 * 108 * size, report.blobs()[2].bytes);
+  EXPECT_NE(string::npos, report.Text().find("Memory by layer"));
+}
+
+}  // namespace caffe
@@ -0,0 +1,120 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/util/io.hpp"
+#include "caffe/util/metrics.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// The registry is shared by the process, so each test uses metrics of its
+// own names.
+class MetricsTest : public ::testing::Test {
+ protected:
+  bool HasLine(const string& text, const string& line) {
+    return text.find("\n" + line + "\n") != string::npos ||
+        text.compare(0, line.size() + 1, line + "\n") == 0;
+  }
+};
+
+TEST_F(MetricsTest, TestCounterAndGauge) {
+  Metrics& metrics = Metrics::Get();
+  Metrics::Counter* counter = metrics.counter("test_counter_total",
+      "A counter.");
+  counter->Increment();
+  counter->Increment(2.5);
+  EXPECT_EQ(3.5, counter->value());
+  EXPECT_EQ(counter, metrics.counter("test_counter_total", "A counter."));
+  metrics.gauge("test_gauge", "A gauge.", Metrics::Label("layer", "a"))
+      ->Set(7);
+  metrics.gauge("test_gauge", "A gauge.", Metrics::Label("layer", "b"))
+      ->Set(-1);
+  const string text = metrics.Text();
+  EXPECT_TRUE(HasLine(text, "# HELP test_counter_total A counter."));
+  EXPECT_TRUE(HasLine(text, "# TYPE test_counter_total counter"));
+  EXPECT_TRUE(HasLine(text, "test_counter_total 3.5"));
+  EXPECT_TRUE(HasLine(text, "# TYPE test_gauge gauge"));
+  EXPECT_TRUE(HasLine(text, "test_gauge{layer=\"a\"} 7"));
+  EXPECT_TRUE(HasLine(text, "test_gauge{layer=\"b\"} -1"));
+}
+
+TEST_F(MetricsTest, TestHistogram) {
+  vector<double> bounds;
+  bounds.push_back(1);
+  bounds.push_back(2);
+  Metrics::Histogram* histogram = Metrics::Get().histogram(
+      "test_histogram_seconds", "A histogram.", Metrics::Label("phase", "x"),
+      bounds);
+  histogram->Observe(0.5);
+  histogram->Observe(1.5);
+  histogram->Observe(2);
+  histogram->Observe(4);
+  EXPECT_EQ(4, histogram->count());
+  EXPECT_EQ(8, histogram->sum());
+  const string text = Metrics::Get().Text();
+  EXPECT_TRUE(HasLine(text, "# TYPE test_histogram_seconds histogram"));
+  // The buckets count the observations up to their bounds.
+  EXPECT_TRUE(HasLine(text,
+      "test_histogram_seconds_bucket{phase=\"x\",le=\"1\"} 1"));
+  EXPECT_TRUE(HasLine(text,
+      "test_histogram_seconds_bucket{phase=\"x\",le=\"2\"} 3"));
+  EXPECT_TRUE(HasLine(text,
+      "test_histogram_seconds_bucket{phase=\"x\",le=\"+Inf\"} 4"));
+  EXPECT_TRUE(HasLine(text, "test_histogram_seconds_sum{phase=\"x\"} 8"));
+  EXPECT_TRUE(HasLine(text, "test_histogram_seconds_count{phase=\"x\"} 4"));
+}
+
+TEST_F(MetricsTest, TestLabel) {
+  EXPECT_EQ("layer=\"a\\\"b\\\\c\\n\"",
+      Metrics::Label("layer", "a\"b\\c\n"));
+}
+
+TEST_F(MetricsTest, TestWriteTextFile) {
+  Metrics::Get().counter("test_file_total", "Written.")->Increment();
+  string filename;
+  MakeTempFilename(&filename);
+  Metrics::Get().WriteTextFile(filename);
+  std::ifstream file(filename.c_str());
+  const string text((std::istreambuf_iterator<char>(file)),
+      std::istreambuf_iterator<char>());
+  EXPECT_EQ(Metrics::Get().Text(), text);
+  EXPECT_TRUE(HasLine(text, "test_file_total 1"));
+}
+
+TEST_F(MetricsTest, TestExporter) {
+  Metrics::Get().counter("test_served_total", "Served.")->Increment(4);
+  MetricsExporter exporter(0, "", 0);
+  ASSERT_GT(exporter.port(), 0);
+  const int client = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(client, 0);
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(exporter.port());
+  ASSERT_EQ(0, connect(client, reinterpret_cast<struct sockaddr*>(&address),
+      sizeof(address)));
+  const string request = "GET /metrics HTTP/1.0\r\n\r\n";
+  ASSERT_EQ(request.size(), send(client, request.data(), request.size(), 0));
+  string response;
+  char buffer[4096];
+  ssize_t length;
+  while ((length = recv(client, buffer, sizeof(buffer), 0)) > 0) {
+    response.append(buffer, length);
+  }
+  close(client);
+  EXPECT_EQ(0, response.find("HTTP/1.0 200 OK\r\n"));
+  EXPECT_NE(string::npos, response.find("\ntest_served_total 4\n"));
+}
+
+}  // namespace caffe
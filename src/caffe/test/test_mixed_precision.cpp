@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/mixed_precision.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/sgd_solvers.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class MixedPrecisionTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  shared_ptr<SGDSolver<Dtype> > MakeSolver(bool mixed_precision,
+      const string& extra_param, float loss_weight = 2) {
+    std::ostringstream proto;
+    proto <<
+       "base_lr: 0.1 "
+       "lr_policy: 'fixed' "
+       "momentum: 0.9 "
+       "random_seed: 1701 "
+       "mixed_precision: " << mixed_precision << " " << extra_param <<
+       "net_param { "
+       "  name: 'TestNetwork' "
+       "  layer { "
+       "    name: 'data' "
+       "    type: 'DummyData' "
+       "    dummy_data_param { "
+       "      shape { dim: 5 dim: 2 dim: 3 dim: 4 } "
+       "      shape { dim: 5 } "
+       "      data_filler { type: 'gaussian' } "
+       "      data_filler { type: 'constant' value: 3 } "
+       "    } "
+       "    top: 'data' "
+       "    top: 'label' "
+       "  } "
+       "  layer { "
+       "    name: 'innerprod1' "
+       "    type: 'InnerProduct' "
+       "    inner_product_param { "
+       "      num_output: 8 "
+       "      weight_filler { type: 'gaussian' std: 0.1 } "
+       "    } "
+       "    bottom: 'data' "
+       "    top: 'innerprod1' "
+       "  } "
+       "  layer { "
+       "    name: 'innerprod2' "
+       "    type: 'InnerProduct' "
+       "    inner_product_param { "
+       "      num_output: 10 "
+       "      weight_filler { type: 'gaussian' std: 0.1 } "
+       "    } "
+       "    bottom: 'innerprod1' "
+       "    top: 'innerprod2' "
+       "  } "
+       "  layer { "
+       "    name: 'loss' "
+       "    type: 'SoftmaxWithLoss' "
+       "    bottom: 'innerprod2' "
+       "    bottom: 'label' "
+       "    loss_weight: " << loss_weight << " "
+       "  } "
+       "} ";
+    SolverParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto.str(), &param));
+    param.set_solver_mode(Caffe::mode() == Caffe::CPU ?
+        SolverParameter_SolverMode_CPU : SolverParameter_SolverMode_GPU);
+    return shared_ptr<SGDSolver<Dtype> >(new SGDSolver<Dtype>(param));
+  }
+};
+
+TYPED_TEST_CASE(MixedPrecisionTest, TestDtypesAndDevices);
+
+TYPED_TEST(MixedPrecisionTest, TestCloseToFullPrecision) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Each solver seeds the RNG, so both see the same data.
+  shared_ptr<SGDSolver<Dtype> > solver = this->MakeSolver(false, "");
+  solver->Step(5);
+  shared_ptr<SGDSolver<Dtype> > mixed_solver =
+      this->MakeSolver(true, "loss_scale: 1024 ");
+  mixed_solver->Step(5);
+  EXPECT_EQ(5, mixed_solver->iter());
+  EXPECT_EQ(1024, mixed_solver->mixed_precision()->loss_scale());
+  const vector<Blob<Dtype>*>& params = solver->net()->learnable_params();
+  const vector<Blob<Dtype>*>& mixed_params =
+      mixed_solver->net()->learnable_params();
+  ASSERT_EQ(params.size(), mixed_params.size());
+  bool any_rounded = false;
+  for (int i = 0; i < params.size(); ++i) {
+    for (int j = 0; j < params[i]->count(); ++j) {
+      const Dtype expected = params[i]->cpu_data()[j];
+      const Dtype actual = mixed_params[i]->cpu_data()[j];
+      EXPECT_NEAR(expected, actual, 1e-2 * std::max(Dtype(1), fabs(expected)));
+      any_rounded |= (expected != actual);
+    }
+  }
+  // The forward/backward passes did run in reduced precision.
+  EXPECT_TRUE(any_rounded);
+}
+
+TYPED_TEST(MixedPrecisionTest, TestOverflowSkipsUpdate) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The scaled loss gradients are past the bfloat16 range.
+  shared_ptr<SGDSolver<Dtype> > solver =
+      this->MakeSolver(true, "loss_scale: 3e38 loss_scale_window: 10 ", 100);
+  const vector<Blob<Dtype>*>& params = solver->net()->learnable_params();
+  vector<shared_ptr<Blob<Dtype> > > initial_params;
+  for (int i = 0; i < params.size(); ++i) {
+    initial_params.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    initial_params[i]->CopyFrom(*params[i], false, true);
+  }
+  solver->Step(1);
+  EXPECT_EQ(1, solver->iter());
+  EXPECT_FLOAT_EQ(1.5e38, solver->mixed_precision()->loss_scale());
+  for (int i = 0; i < params.size(); ++i) {
+    for (int j = 0; j < params[i]->count(); ++j) {
+      EXPECT_EQ(initial_params[i]->cpu_data()[j], params[i]->cpu_data()[j]);
+    }
+  }
+}
+
+}  // namespace caffe
@@ -2446,6 +2446,223 @@ TYPED_TEST(NetTest, TestReshape) {
   EXPECT_FALSE(same_spatial_shape);
 }
 
+TYPED_TEST(NetTest, TestBlobViews) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string proto_prefix =
+      "name: 'BlobViewsNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    num: 1 channels: 2 height: 3 width: 4 "
+      "    num: 1 channels: 3 height: 3 width: 4 "
+      "    data_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "  top: 'data0' "
+      "  top: 'data1' "
+      "} "
+      "layer { "
+      "  name: 'concat' "
+      "  type: 'Concat' "
+      "  bottom: 'data0' "
+      "  bottom: 'data1' "
+      "  top: 'concat' "
+      "} ";
+  const string relu =
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'concat' "
+      "  top: 'concat' "
+      "} ";
+  // With one image, the channels are concatenated in place.
+  this->InitNetFromProtoString(proto_prefix);
+  this->net_->Forward();
+  EXPECT_TRUE(this->net_->layer_by_name("concat")->blob_views());
+  const Blob<Dtype>* data1 = this->net_->blob_by_name("data1").get();
+  EXPECT_TRUE(data1->DataViews(*this->net_->blob_by_name("concat"), 24));
+  // Unless a later layer would overwrite the bottoms through the top.
+  this->InitNetFromProtoString(proto_prefix + relu);
+  this->net_->Forward();
+  EXPECT_FALSE(this->net_->layer_by_name("concat")->blob_views());
+  data1 = this->net_->blob_by_name("data1").get();
+  EXPECT_FALSE(data1->DataViews(*this->net_->blob_by_name("concat"), 24));
+}
+
+TYPED_TEST(NetTest, TestLayouts) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string proto =
+      "name: 'LayoutNetwork' "
+      "state { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { shape { dim: 2 dim: 8 dim: 6 dim: 5 } } "
+      "} "
+      "layer { "
+      "  name: 'conv' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv' "
+      "  convolution_param { "
+      "    num_output: 16 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "    bias_filler { type: 'gaussian' std: 0.1 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'bn' "
+      "  type: 'BatchNorm' "
+      "  bottom: 'conv' "
+      "  top: 'conv' "
+      "} "
+      "layer { "
+      "  name: 'scale' "
+      "  type: 'Scale' "
+      "  bottom: 'conv' "
+      "  top: 'conv' "
+      "  scale_param { "
+      "    filler { type: 'gaussian' std: 1 } "
+      "    bias_term: true "
+      "    bias_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv' "
+      "  top: 'conv' "
+      "} "
+      "layer { "
+      "  name: 'pool' "
+      "  type: 'Pooling' "
+      "  bottom: 'conv' "
+      "  top: 'pool' "
+      "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  bottom: 'pool' "
+      "  top: 'conv2' "
+      "  convolution_param { "
+      "    num_output: 5 kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "  } "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  shared_ptr<Net<Dtype> > nchw_net = this->net_;
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(nchw_net->input_blobs()[0]);
+  // Some global statistics for the BatchNorm.
+  const vector<shared_ptr<Blob<Dtype> > >& bn_blobs =
+      nchw_net->layer_by_name("bn")->blobs();
+  filler.Fill(bn_blobs[0].get());
+  caffe_set(bn_blobs[1]->count(), Dtype(0.5), bn_blobs[1]->mutable_cpu_data());
+  bn_blobs[2]->mutable_cpu_data()[0] = 1;
+  nchw_net->Forward();
+  const BlobLayout layouts[] = { NHWC, NCHW8C, NCHW16C };
+  for (int l = 0; l < 3; ++l) {
+    this->InitNetFromProtoString(proto + "layout: " + BlobLayout_Name(
+        layouts[l]));
+    this->net_->ShareTrainedLayersWith(nchw_net.get());
+    // With Reorder layers to the layout and back to NCHW.
+    EXPECT_GT(this->net_->layers().size(), nchw_net->layers().size());
+    this->net_->input_blobs()[0]->CopyFrom(*nchw_net->input_blobs()[0]);
+    this->net_->Forward();
+    const Blob<Dtype>* expected = nchw_net->output_blobs()[0];
+    const Blob<Dtype>* output = this->net_->output_blobs()[0];
+    EXPECT_EQ(NCHW, output->layout());
+    EXPECT_EQ(this->net_->blob_by_name("conv2").get(), output);
+    ASSERT_EQ(expected->count(), output->count());
+    for (int i = 0; i < expected->count(); ++i) {
+      EXPECT_NEAR(expected->cpu_data()[i], output->cpu_data()[i], 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestLayoutsImageInput) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The 3 channels of the images fill no blocks, yet the layers after the
+  // first Convolution run in the layout.
+  const string proto =
+      "name: 'ImageLayoutNetwork' "
+      "state { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { shape { dim: 2 dim: 3 dim: 9 dim: 8 } } "
+      "} "
+      "layer { "
+      "  name: 'conv' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv' "
+      "  convolution_param { "
+      "    num_output: 16 kernel_size: 3 stride: 2 pad: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "    bias_filler { type: 'gaussian' std: 0.1 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv' "
+      "  top: 'conv' "
+      "} "
+      "layer { "
+      "  name: 'pool' "
+      "  type: 'Pooling' "
+      "  bottom: 'conv' "
+      "  top: 'pool' "
+      "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  bottom: 'pool' "
+      "  top: 'conv2' "
+      "  convolution_param { "
+      "    num_output: 16 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "  } "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  shared_ptr<Net<Dtype> > nchw_net = this->net_;
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(nchw_net->input_blobs()[0]);
+  nchw_net->Forward();
+  const BlobLayout layouts[] = { NCHW8C, NCHW16C };
+  const char* suffixes[] = { "_nchw8c", "_nchw16c" };
+  for (int l = 0; l < 2; ++l) {
+    this->InitNetFromProtoString(proto + "layout: " + BlobLayout_Name(
+        layouts[l]));
+    this->net_->ShareTrainedLayersWith(nchw_net.get());
+    // No Reorder of the images: the first Convolution reads them NCHW.
+    EXPECT_FALSE(this->net_->has_blob(string("data") + suffixes[l]));
+    this->net_->input_blobs()[0]->CopyFrom(*nchw_net->input_blobs()[0]);
+    this->net_->Forward();
+    const string blob_names[] = { "conv", "pool", "conv2" };
+    for (int i = 0; i < 3; ++i) {
+      const string name = blob_names[i] + suffixes[l];
+      ASSERT_TRUE(this->net_->has_blob(name)) << name;
+      EXPECT_EQ(layouts[l], this->net_->blob_by_name(name)->layout()) << name;
+    }
+    const Blob<Dtype>* expected = nchw_net->output_blobs()[0];
+    const Blob<Dtype>* output = this->net_->output_blobs()[0];
+    EXPECT_EQ(NCHW, output->layout());
+    EXPECT_EQ(this->net_->blob_by_name("conv2").get(), output);
+    ASSERT_EQ(expected->count(), output->count());
+    for (int i = 0; i < expected->count(); ++i) {
+      EXPECT_NEAR(expected->cpu_data()[i], output->cpu_data()[i], 1e-4);
+    }
+  }
+}
+
 TYPED_TEST(NetTest, TestSkipPropagateDown) {
   // check bottom_need_backward if propagate_down is true
   this->InitSkipPropNet(false);
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cfloat>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -6,6 +8,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/pooling_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_pooling_layer.hpp"
@@ -16,6 +19,9 @@
 
 namespace caffe {
 
+using std::max;
+using std::min;
+
 template <typename TypeParam>
 class PoolingLayerTest : public MultiDeviceTest<TypeParam> {
   typedef typename TypeParam::Dtype Dtype;
@@ -456,6 +462,115 @@ TYPED_TEST(PoolingLayerTest, TestForwardMaxTopMask) {
   this->TestForwardRectWide();
 }
 
+TYPED_TEST(PoolingLayerTest, TestForwardPhases) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_->Reshape(2, 3, 7, 9);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  // kernel, stride and pad: 2x2 and 3x3 windows, uneven and global ones.
+  const int configs[][3] = { {2, 2, 0}, {3, 2, 0}, {3, 2, 1}, {2, 1, 1},
+      {4, 3, 0}, {0, 1, 0} };
+  for (int i = 0; i < 6; ++i) {
+    for (int pool = 0; pool < 2; ++pool) {
+      for (int phase = 0; phase < 2; ++phase) {
+        LayerParameter layer_param;
+        layer_param.set_phase(phase ? TEST : TRAIN);
+        PoolingParameter* pooling_param =
+            layer_param.mutable_pooling_param();
+        const int kernel = configs[i][0];
+        const int stride = configs[i][1];
+        const int pad = configs[i][2];
+        if (kernel) {
+          pooling_param->set_kernel_size(kernel);
+          pooling_param->set_stride(stride);
+          pooling_param->set_pad(pad);
+        } else {
+          pooling_param->set_global_pooling(true);
+        }
+        pooling_param->set_pool(pool ? PoolingParameter_PoolMethod_AVE :
+            PoolingParameter_PoolMethod_MAX);
+        PoolingLayer<Dtype> layer(layer_param);
+        layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+        layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+        const int kernel_h = kernel ? kernel : 7;
+        const int kernel_w = kernel ? kernel : 9;
+        for (int n = 0; n < 2; ++n) {
+          for (int c = 0; c < 3; ++c) {
+            for (int ph = 0; ph < this->blob_top_->height(); ++ph) {
+              for (int pw = 0; pw < this->blob_top_->width(); ++pw) {
+                const int hstart = ph * stride - pad;
+                const int wstart = pw * stride - pad;
+                const int hend = min(hstart + kernel_h, 7 + pad);
+                const int wend = min(wstart + kernel_w, 9 + pad);
+                Dtype expected = pool ? 0 : -FLT_MAX;
+                for (int h = max(hstart, 0); h < min(hend, 7); ++h) {
+                  for (int w = max(wstart, 0); w < min(wend, 9); ++w) {
+                    const Dtype value =
+                        this->blob_bottom_->data_at(n, c, h, w);
+                    expected = pool ? expected + value :
+                        max(expected, value);
+                  }
+                }
+                if (pool) {
+                  expected /= (hend - hstart) * (wend - wstart);
+                }
+                EXPECT_NEAR(expected,
+                    this->blob_top_->data_at(n, c, ph, pw), 1e-5);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(PoolingLayerTest, TestForwardLayouts) {
+  typedef typename TypeParam::Dtype Dtype;
+  Blob<Dtype> bottom(2, 16, 7, 6);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&bottom);
+  vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+  const BlobLayout layouts[] = { NHWC, NCHW8C, NCHW16C };
+  for (int pool = 0; pool < 2; ++pool) {
+    LayerParameter layer_param;
+    PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+    pooling_param->set_kernel_size(3);
+    pooling_param->set_stride(2);
+    pooling_param->set_pad(1);
+    pooling_param->set_pool(pool ? PoolingParameter_PoolMethod_AVE :
+        PoolingParameter_PoolMethod_MAX);
+    PoolingLayer<Dtype> layer(layer_param);
+    layer.SetUp(bottom_vec, this->blob_top_vec_);
+    layer.Forward(bottom_vec, this->blob_top_vec_);
+    Blob<Dtype> expected;
+    expected.CopyFrom(*this->blob_top_, false, true);
+    for (int l = 0; l < 3; ++l) {
+      Blob<Dtype> blocked_bottom(bottom.shape());
+      blocked_bottom.set_layout(layouts[l]);
+      caffe_cpu_reorder(2, 16, 42, 1, blocked_bottom.layout_block(),
+          bottom.cpu_data(), blocked_bottom.mutable_cpu_data());
+      vector<Blob<Dtype>*> blocked_bottom_vec(1, &blocked_bottom);
+      PoolingLayer<Dtype> blocked_layer(layer_param);
+      blocked_layer.SetUp(blocked_bottom_vec, this->blob_top_vec_);
+      EXPECT_EQ(layouts[l], this->blob_top_->layout());
+      blocked_layer.Forward(blocked_bottom_vec, this->blob_top_vec_);
+      for (int n = 0; n < expected.num(); ++n) {
+        for (int c = 0; c < expected.channels(); ++c) {
+          for (int h = 0; h < expected.height(); ++h) {
+            for (int w = 0; w < expected.width(); ++w) {
+              EXPECT_NEAR(expected.data_at(n, c, h, w),
+                  this->blob_top_->data_at(n, c, h, w), 1e-5);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
 TYPED_TEST(PoolingLayerTest, TestGradientMax) {
   typedef typename TypeParam::Dtype Dtype;
   for (int kernel_h = 3; kernel_h <= 4; kernel_h++) {
@@ -475,6 +590,24 @@ TYPED_TEST(PoolingLayerTest, TestGradientMax) {
   }
 }
 
+TYPED_TEST(PoolingLayerTest, TestGradientMaxTestPhase) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Without the mask, which is not recorded in TEST.
+  for (int kernel = 2; kernel <= 3; kernel++) {
+    LayerParameter layer_param;
+    layer_param.set_phase(TEST);
+    PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+    pooling_param->set_kernel_size(kernel);
+    pooling_param->set_stride(2);
+    pooling_param->set_pad(1);
+    pooling_param->set_pool(PoolingParameter_PoolMethod_MAX);
+    PoolingLayer<Dtype> layer(layer_param);
+    GradientChecker<Dtype> checker(1e-4, 1e-2);
+    checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+        this->blob_top_vec_);
+  }
+}
+
 TYPED_TEST(PoolingLayerTest, TestForwardMaxPadded) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
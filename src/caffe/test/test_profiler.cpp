@@ -0,0 +1,174 @@
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/profiler.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class ProfilerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  ProfilerTest() {
+    const string proto =
+        "name: 'TestNetwork' "
+        "force_backward: true "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { shape { dim: 2 dim: 3 dim: 8 dim: 8 } } "
+        "} "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'pool' "
+        "  type: 'Pooling' "
+        "  bottom: 'conv' "
+        "  top: 'pool' "
+        "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'pool' "
+        "  top: 'ip' "
+        "  inner_product_param { "
+        "    num_output: 5 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu' "
+        "  type: 'ReLU' "
+        "  bottom: 'ip' "
+        "  top: 'ip' "
+        "} ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    net_.reset(new Net<Dtype>(param));
+  }
+
+  shared_ptr<Net<Dtype> > net_;
+};
+
+TYPED_TEST_CASE(ProfilerTest, TestDtypesAndDevices);
+
+TYPED_TEST(ProfilerTest, TestFlops) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Net<Dtype>& net = *this->net_;
+  // conv: 2 x 4 x 6 x 6 outputs of 3 x 3 x 3 products, and a bias.
+  EXPECT_EQ(2.0 * 288 * 27 + 288, Profiler<Dtype>::ForwardFlops(
+      *net.layer_by_name("conv"), net.bottom_vecs()[1], net.top_vecs()[1]));
+  // pool: 2 x 4 x 3 x 3 outputs of 2 x 2 windows.
+  EXPECT_EQ(72.0 * 4, Profiler<Dtype>::ForwardFlops(
+      *net.layer_by_name("pool"), net.bottom_vecs()[2], net.top_vecs()[2]));
+  // ip: 2 x 5 outputs of 36 products, and a bias.
+  EXPECT_EQ(2.0 * 10 * 36 + 10, Profiler<Dtype>::ForwardFlops(
+      *net.layer_by_name("ip"), net.bottom_vecs()[3], net.top_vecs()[3]));
+  EXPECT_EQ(10, Profiler<Dtype>::ForwardFlops(
+      *net.layer_by_name("relu"), net.bottom_vecs()[4], net.top_vecs()[4]));
+  EXPECT_EQ(0, Profiler<Dtype>::ForwardFlops(
+      *net.layer_by_name("data"), net.bottom_vecs()[0], net.top_vecs()[0]));
+  // ip reads its bottom and params and writes its top.
+  EXPECT_EQ((72 + 180 + 5 + 10) * sizeof(Dtype),
+      Profiler<Dtype>::ForwardBytes(*net.layer_by_name("ip"),
+          net.bottom_vecs()[3], net.top_vecs()[3]));
+}
+
+TYPED_TEST(ProfilerTest, TestRecord) {
+  typedef typename TypeParam::Dtype Dtype;
+  Net<Dtype>& net = *this->net_;
+  Profiler<Dtype> profiler(&net);
+  for (int i = 0; i < 2; ++i) {
+    net.Forward();
+    net.Backward();
+  }
+  profiler.set_enabled(false);
+  net.Forward();
+  const vector<typename Profiler<Dtype>::LayerStats>& stats =
+      profiler.stats();
+  ASSERT_EQ(net.layers().size(), stats.size());
+  for (int i = 0; i < stats.size(); ++i) {
+    EXPECT_EQ(2, stats[i].forward.calls);
+    EXPECT_EQ(net.layer_need_backward()[i] ? 2 : 0, stats[i].backward.calls);
+    EXPECT_GE(stats[i].forward.us, 0);
+    EXPECT_EQ(2 * Profiler<Dtype>::ForwardFlops(*net.layers()[i],
+        net.bottom_vecs()[i], net.top_vecs()[i]), stats[i].forward.flops);
+    EXPECT_EQ(2 * stats[i].forward.flops, stats[i].backward.flops);
+    if (profiler.hardware_counters()) {
+      EXPECT_GT(stats[i].forward.cycles, 0);
+      EXPECT_GT(stats[i].forward.instructions, 0);
+    } else {
+      EXPECT_EQ(0, stats[i].forward.cycles);
+    }
+  }
+  // The data and diff of every blob and param were touched by the passes.
+  size_t bytes = 0;
+  for (int i = 0; i < net.blobs().size(); ++i) {
+    bytes += 2 * net.blobs()[i]->count() * sizeof(Dtype);
+  }
+  for (int i = 0; i < net.params().size(); ++i) {
+    bytes += 2 * net.params()[i]->count() * sizeof(Dtype);
+  }
+  EXPECT_EQ(bytes, profiler.peak_memory());
+  profiler.Reset();
+  EXPECT_EQ(0, profiler.stats()[1].forward.calls);
+  EXPECT_EQ(0, profiler.peak_memory());
+}
+
+TYPED_TEST(ProfilerTest, TestWrite) {
+  typedef typename TypeParam::Dtype Dtype;
+  Net<Dtype>& net = *this->net_;
+  Profiler<Dtype> profiler(&net);
+  profiler.set_peak_gflops(100);
+  net.Forward();
+  net.Backward();
+  string trace_filename, csv_filename;
+  MakeTempFilename(&trace_filename);
+  MakeTempFilename(&csv_filename);
+  profiler.WriteChromeTrace(trace_filename);
+  profiler.WriteCSV(csv_filename);
+  std::ifstream trace(trace_filename.c_str());
+  const string json((std::istreambuf_iterator<char>(trace)),
+      std::istreambuf_iterator<char>());
+  EXPECT_NE(string::npos, json.find("\"traceEvents\""));
+  EXPECT_NE(string::npos, json.find("\"name\": \"conv\""));
+  EXPECT_NE(string::npos, json.find("\"type\": \"InnerProduct\""));
+  EXPECT_NE(string::npos, json.find("\"ph\": \"C\""));
+  std::ifstream csv(csv_filename.c_str());
+  string line;
+  int rows = 0;
+  std::getline(csv, line);
+  EXPECT_EQ(0, line.find("layer,type,pass,calls"));
+  while (std::getline(csv, line)) {
+    ++rows;
+  }
+  // A forward row for each layer, and a backward row for those that ran it.
+  int expected_rows = net.layers().size();
+  for (int i = 0; i < net.layers().size(); ++i) {
+    expected_rows += net.layer_need_backward()[i];
+  }
+  EXPECT_EQ(expected_rows, rows);
+}
+
+}  // namespace caffe
@@ -0,0 +1,127 @@
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
+#include "caffe/recurrent_session.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class RecurrentSessionTest : public ::testing::Test {
+ protected:
+  RecurrentSessionTest() : num_output_(5) {
+    layer_param_.mutable_recurrent_param()->set_num_output(num_output_);
+    FillerParameter* weight_filler =
+        layer_param_.mutable_recurrent_param()->mutable_weight_filler();
+    weight_filler->set_type("gaussian");
+    weight_filler->set_std(0.2);
+    FillerParameter* bias_filler =
+        layer_param_.mutable_recurrent_param()->mutable_bias_filler();
+    bias_filler->set_type("gaussian");
+    bias_filler->set_std(0.1);
+    layer_param_.set_phase(TEST);
+  }
+
+  // Runs a batch of 3 timesteps of 3 streams, which begin a sequence, through
+  // the layer, then checks that a session stepping the same streams in
+  // different ways gives the same output.
+  void TestMatchesForward(const string& type) {
+    Caffe::set_mode(Caffe::CPU);
+    const int kNumTimesteps = 3;
+    const int num = 3;
+    layer_param_.set_type(type);
+    shared_ptr<Layer<Dtype> > layer =
+        LayerRegistry<Dtype>::CreateLayer(layer_param_);
+    Blob<Dtype> x(kNumTimesteps, num, 2, 3);
+    vector<int> cont_shape(2);
+    cont_shape[0] = kNumTimesteps;
+    cont_shape[1] = num;
+    Blob<Dtype> cont(cont_shape);
+    for (int i = 0; i < cont.count(); ++i) {
+      cont.mutable_cpu_data()[i] = i >= num;
+    }
+    FillerParameter filler_param;
+    filler_param.set_min(-1);
+    filler_param.set_max(1);
+    UniformFiller<Dtype> filler(filler_param);
+    filler.Fill(&x);
+    Blob<Dtype> top;
+    vector<Blob<Dtype>*> bottom_vec;
+    bottom_vec.push_back(&x);
+    bottom_vec.push_back(&cont);
+    vector<Blob<Dtype>*> top_vec(1, &top);
+    layer->SetUp(bottom_vec, top_vec);
+    layer->Forward(bottom_vec, top_vec);
+
+    RecurrentSession<Dtype> session(layer);
+    EXPECT_EQ(6, session.input_dim());
+    vector<int> streams;
+    for (int n = 0; n < num; ++n) {
+      streams.push_back(session.Open());
+    }
+    EXPECT_EQ(num, session.num_open());
+    const Dtype kEpsilon = 1e-5;
+    // All timesteps at once, in place.
+    Blob<Dtype> y;
+    session.Step(streams, x, &y);
+    ASSERT_EQ(top.count(), y.count());
+    for (int i = 0; i < top.count(); ++i) {
+      EXPECT_NEAR(top.cpu_data()[i], y.cpu_data()[i], kEpsilon);
+    }
+    // One timestep at a time, with the streams gathered in reverse.
+    vector<int> reversed(streams.rbegin(), streams.rend());
+    for (int n = 0; n < num; ++n) {
+      session.Reset(streams[n]);
+    }
+    const int input_dim = x.count(2);
+    vector<Dtype> x_t(num * input_dim);
+    vector<Dtype> y_t(num * num_output_);
+    for (int t = 0; t < kNumTimesteps; ++t) {
+      for (int j = 0; j < num; ++j) {
+        caffe_copy(input_dim,
+            x.cpu_data() + (t * num + reversed[j]) * input_dim,
+            &x_t[j * input_dim]);
+      }
+      session.Step(reversed, 1, &x_t[0], &y_t[0]);
+      for (int j = 0; j < num; ++j) {
+        for (int d = 0; d < num_output_; ++d) {
+          EXPECT_NEAR(
+              top.cpu_data()[(t * num + reversed[j]) * num_output_ + d],
+              y_t[j * num_output_ + d], kEpsilon)
+              << "t = " << t << "; stream = " << reversed[j];
+        }
+      }
+    }
+    // A closed stream is reopened with a zero state.
+    session.Close(streams[1]);
+    EXPECT_EQ(num - 1, session.num_open());
+    EXPECT_EQ(streams[1], session.Open());
+    for (int i = 0; i < session.num_states(); ++i) {
+      for (int d = 0; d < num_output_; ++d) {
+        EXPECT_EQ(0, session.state(streams[1], i)[d]);
+      }
+    }
+  }
+
+  int num_output_;
+  LayerParameter layer_param_;
+};
+
+TYPED_TEST_CASE(RecurrentSessionTest, TestDtypes);
+
+TYPED_TEST(RecurrentSessionTest, TestLSTM) {
+  this->TestMatchesForward("LSTM");
+}
+
+TYPED_TEST(RecurrentSessionTest, TestRNN) {
+  this->TestMatchesForward("RNN");
+}
+
+}  // namespace caffe
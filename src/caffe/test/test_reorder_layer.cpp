@@ -0,0 +1,264 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/reorder_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/insert_reorders.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class ReorderLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  ReorderLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 16, 3, 5)),
+        blob_top_(new Blob<Dtype>()) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~ReorderLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(ReorderLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(ReorderLayerTest, TestForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  const BlobLayout layouts[] = { NHWC, NCHW8C, NCHW16C };
+  for (int l = 0; l < 3; ++l) {
+    LayerParameter layer_param;
+    layer_param.mutable_reorder_param()->set_layout(layouts[l]);
+    ReorderLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    EXPECT_EQ(layouts[l], this->blob_top_->layout());
+    EXPECT_EQ(this->blob_bottom_->shape(), this->blob_top_->shape());
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int n = 0; n < 2; ++n) {
+      for (int c = 0; c < 16; ++c) {
+        for (int h = 0; h < 3; ++h) {
+          for (int w = 0; w < 5; ++w) {
+            EXPECT_EQ(this->blob_bottom_->data_at(n, c, h, w),
+                this->blob_top_->data_at(n, c, h, w));
+          }
+        }
+      }
+    }
+    // And back to NCHW.
+    Blob<Dtype> nchw;
+    vector<Blob<Dtype>*> nchw_vec(1, &nchw);
+    ReorderLayer<Dtype> back_layer((LayerParameter()));
+    back_layer.SetUp(this->blob_top_vec_, nchw_vec);
+    EXPECT_EQ(NCHW, nchw.layout());
+    back_layer.Forward(this->blob_top_vec_, nchw_vec);
+    for (int i = 0; i < nchw.count(); ++i) {
+      EXPECT_EQ(this->blob_bottom_->cpu_data()[i], nchw.cpu_data()[i]);
+    }
+  }
+}
+
+TYPED_TEST(ReorderLayerTest, TestFallback) {
+  typedef typename TypeParam::Dtype Dtype;
+  // 12 channels do not fill the blocks of 8.
+  this->blob_bottom_->Reshape(2, 12, 3, 5);
+  LayerParameter layer_param;
+  layer_param.mutable_reorder_param()->set_layout(NCHW8C);
+  ReorderLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(NCHW, this->blob_top_->layout());
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_EQ(this->blob_bottom_->cpu_data()[i],
+        this->blob_top_->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(ReorderLayerTest, TestGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_reorder_param()->set_layout(NCHW8C);
+  ReorderLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+class ReorderInsertionTest : public ::testing::Test {
+ protected:
+  void RunInsertionTest(
+      const string& input_param_string, const string& output_param_string) {
+    NetParameter input_param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(
+        input_param_string, &input_param));
+    NetParameter expected_output_param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(
+        output_param_string, &expected_output_param));
+    NetParameter actual_output_param;
+    InsertReorders(input_param, &actual_output_param);
+    EXPECT_EQ(expected_output_param.DebugString(),
+        actual_output_param.DebugString());
+  }
+};
+
+TEST_F(ReorderInsertionTest, TestNoInsertion) {
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'conv' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv' "
+      "} "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv' "
+      "  top: 'conv' "
+      "} ";
+  this->RunInsertionTest(input_proto, input_proto);
+}
+
+TEST_F(ReorderInsertionTest, TestInsertion) {
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "layout: NHWC "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'conv' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv' "
+      "} "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv' "
+      "  top: 'conv' "
+      "} "
+      "layer { "
+      "  name: 'pool' "
+      "  type: 'Pooling' "
+      "  bottom: 'conv' "
+      "  top: 'pool' "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'pool' "
+      "  top: 'ip' "
+      "} ";
+  const string& expected_output_proto =
+      "name: 'TestNetwork' "
+      "layout: NHWC "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'conv' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv_nhwc' "
+      "  convolution_param { top_layout: NHWC } "
+      "} "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv_nhwc' "
+      "  top: 'conv_nhwc' "
+      "} "
+      "layer { "
+      "  name: 'pool' "
+      "  type: 'Pooling' "
+      "  bottom: 'conv_nhwc' "
+      "  top: 'pool_nhwc' "
+      "} "
+      "layer { "
+      "  name: 'pool_reorder' "
+      "  type: 'Reorder' "
+      "  bottom: 'pool_nhwc' "
+      "  top: 'pool' "
+      "  reorder_param { layout: NCHW } "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'pool' "
+      "  top: 'ip' "
+      "} ";
+  this->RunInsertionTest(input_proto, expected_output_proto);
+}
+
+TEST_F(ReorderInsertionTest, TestInsertionOutput) {
+  // The output of the net keeps its name, and one in the way is not taken.
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "layout: NCHW8C "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  top: 'conv_nchw8c' "
+      "} "
+      "layer { "
+      "  name: 'conv' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv' "
+      "} ";
+  const string& expected_output_proto =
+      "name: 'TestNetwork' "
+      "layout: NCHW8C "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  top: 'conv_nchw8c' "
+      "} "
+      "layer { "
+      "  name: 'conv' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv_nchw8c_' "
+      "  convolution_param { top_layout: NCHW8C } "
+      "} "
+      "layer { "
+      "  name: 'conv_reorder' "
+      "  type: 'Reorder' "
+      "  bottom: 'conv_nchw8c_' "
+      "  top: 'conv' "
+      "  reorder_param { layout: NCHW } "
+      "} ";
+  this->RunInsertionTest(input_proto, expected_output_proto);
+}
+
+}  // namespace caffe
@@ -0,0 +1,99 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/inference_engine.hpp"
+#include "caffe/request_batcher.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class RequestBatcherTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  RequestBatcherTest() {
+    const string proto =
+        "name: 'TestNetwork' "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { shape { dim: 1 dim: 4 } } "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'data' "
+        "  top: 'ip' "
+        "  inner_product_param { "
+        "    num_output: 3 "
+        "    weight_filler { type: 'gaussian' } "
+        "    bias_filler { type: 'gaussian' } "
+        "  } "
+        "} ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    engine_.reset(new InferenceEngine<Dtype>(param));
+  }
+
+  vector<Dtype> MakeInput(int i) {
+    vector<Dtype> input;
+    for (int j = 0; j < 4; ++j) {
+      input.push_back(Dtype(i - j) / 4);
+    }
+    return input;
+  }
+
+  shared_ptr<InferenceEngine<Dtype> > engine_;
+};
+
+TYPED_TEST_CASE(RequestBatcherTest, TestDtypesAndDevices);
+
+TYPED_TEST(RequestBatcherTest, TestBatchedResults) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int kNumRequests = 10;
+  // Long enough for all requests to queue before the last batch is due.
+  RequestBatcher<Dtype> batcher(this->engine_.get(), 4, 200000);
+  EXPECT_EQ(4, batcher.input_dim());
+  vector<shared_ptr<typename RequestBatcher<Dtype>::Future> > futures;
+  for (int i = 0; i < kNumRequests; ++i) {
+    futures.push_back(batcher.Submit(this->MakeInput(i)));
+  }
+  shared_ptr<typename InferenceEngine<Dtype>::Context> context =
+      this->engine_->CreateContext();
+  for (int i = 0; i < kNumRequests; ++i) {
+    const vector<vector<Dtype> >& outputs = futures[i]->Get();
+    EXPECT_TRUE(futures[i]->ready());
+    const vector<Dtype> input = this->MakeInput(i);
+    caffe_copy(4, &input[0], context->input_blobs()[0]->mutable_cpu_data());
+    const Blob<Dtype>* expected = context->Forward()[0];
+    ASSERT_EQ(1, outputs.size());
+    ASSERT_EQ(3, outputs[0].size());
+    for (int j = 0; j < 3; ++j) {
+      EXPECT_NEAR(expected->cpu_data()[j], outputs[0][j], 1e-5);
+    }
+  }
+  // Batches of 4, 4 and 2.
+  EXPECT_EQ(3, batcher.batches());
+  EXPECT_EQ(kNumRequests, batcher.requests());
+}
+
+TYPED_TEST(RequestBatcherTest, TestDestroyReleasesPending) {
+  typedef typename TypeParam::Dtype Dtype;
+  shared_ptr<typename RequestBatcher<Dtype>::Future> future;
+  {
+    RequestBatcher<Dtype> batcher(this->engine_.get(), 4, 10000000);
+    future = batcher.Submit(this->MakeInput(0));
+  }
+  EXPECT_TRUE(future->ready());
+  EXPECT_TRUE(future->Get().empty());
+}
+
+}  // namespace caffe
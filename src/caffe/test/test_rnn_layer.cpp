@@ -214,4 +214,142 @@ TYPED_TEST(RNNLayerTest, TestGradientNonZeroContBufferSize2WithStaticInput) {
       this->blob_top_vec_, 2);
 }
 
+TYPED_TEST(RNNLayerTest, TestFusedMatchesUnrolled) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->ReshapeBlobs(3, 2);
+  FillerParameter filler_param;
+  UniformFiller<Dtype> filler(filler_param);
+  filler.Fill(&this->blob_bottom_static_);
+  this->blob_bottom_vec_.push_back(&this->blob_bottom_static_);
+  for (int i = 0; i < this->blob_bottom_cont_.count(); ++i) {
+    this->blob_bottom_cont_.mutable_cpu_data()[i] = i != 2;
+  }
+  // The unrolled net, as the reference.
+  this->layer_param_.mutable_recurrent_param()->set_fused(false);
+  Caffe::set_random_seed(1701);
+  RNNLayer<Dtype> unrolled(this->layer_param_);
+  Blob<Dtype> top_unrolled;
+  vector<Blob<Dtype>*> top_vec(1, &top_unrolled);
+  unrolled.SetUp(this->blob_bottom_vec_, top_vec);
+  this->layer_param_.mutable_recurrent_param()->set_fused(true);
+  Caffe::set_random_seed(1701);
+  RNNLayer<Dtype> fused(this->layer_param_);
+  fused.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_EQ(unrolled.blobs().size(), fused.blobs().size());
+  // Run twice, to carry the hidden state over from the first batch.
+  const Dtype kEpsilon = 1e-5;
+  for (int pass = 0; pass < 2; ++pass) {
+    unrolled.Forward(this->blob_bottom_vec_, top_vec);
+    fused.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < this->blob_top_.count(); ++i) {
+      EXPECT_NEAR(top_unrolled.cpu_data()[i], this->blob_top_.cpu_data()[i],
+                  kEpsilon);
+    }
+  }
+  filler.Fill(&top_unrolled);
+  caffe_copy(top_unrolled.count(), top_unrolled.cpu_data(),
+             top_unrolled.mutable_cpu_diff());
+  caffe_copy(top_unrolled.count(), top_unrolled.cpu_data(),
+             this->blob_top_.mutable_cpu_diff());
+  vector<bool> propagate_down(3, true);
+  propagate_down[1] = false;
+  Blob<Dtype> bottom_diff;
+  Blob<Dtype> static_diff;
+  unrolled.Backward(top_vec, propagate_down, this->blob_bottom_vec_);
+  bottom_diff.CopyFrom(this->blob_bottom_, true, true);
+  static_diff.CopyFrom(this->blob_bottom_static_, true, true);
+  fused.Backward(this->blob_top_vec_, propagate_down, this->blob_bottom_vec_);
+  for (int i = 0; i < bottom_diff.count(); ++i) {
+    EXPECT_NEAR(bottom_diff.cpu_diff()[i], this->blob_bottom_.cpu_diff()[i],
+                kEpsilon);
+  }
+  for (int i = 0; i < static_diff.count(); ++i) {
+    EXPECT_NEAR(static_diff.cpu_diff()[i],
+                this->blob_bottom_static_.cpu_diff()[i], kEpsilon);
+  }
+  for (int j = 0; j < fused.blobs().size(); ++j) {
+    ASSERT_EQ(unrolled.blobs()[j]->count(), fused.blobs()[j]->count());
+    for (int i = 0; i < fused.blobs()[j]->count(); ++i) {
+      EXPECT_NEAR(unrolled.blobs()[j]->cpu_diff()[i],
+                  fused.blobs()[j]->cpu_diff()[i], kEpsilon)
+          << "param " << j << "; i = " << i;
+    }
+  }
+}
+
+TYPED_TEST(RNNLayerTest, TestForwardVariableLength) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Streams of 2, 4 and 0 timesteps, each beginning a sequence.
+  const int kNumTimesteps = 4;
+  const int kLengths[] = { 2, 4, 0 };
+  const int num = 3;
+  this->ReshapeBlobs(kNumTimesteps, num);
+  for (int t = 0; t < kNumTimesteps; ++t) {
+    for (int n = 0; n < num; ++n) {
+      this->blob_bottom_cont_.mutable_cpu_data()[t * num + n] =
+          t < kLengths[n] ? t > 0 : -1;
+    }
+  }
+  this->layer_param_.mutable_recurrent_param()->set_variable_length(true);
+  Caffe::set_random_seed(1701);
+  RNNLayer<Dtype> layer(this->layer_param_);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+
+  // Check against each stream alone, without padding.
+  this->layer_param_.mutable_recurrent_param()->set_variable_length(false);
+  const int dim = this->num_output_;
+  const int input_dim = this->blob_bottom_.count(2);
+  const Dtype* top_data = this->blob_top_.cpu_data();
+  const Dtype kEpsilon = 1e-5;
+  for (int n = 0; n < num; ++n) {
+    for (int t = kLengths[n]; t < kNumTimesteps; ++t) {
+      for (int d = 0; d < dim; ++d) {
+        EXPECT_EQ(0, top_data[(t * num + n) * dim + d]);
+      }
+    }
+    if (!kLengths[n]) { continue; }
+    Blob<Dtype> x(kLengths[n], 1, 3, 2);
+    vector<int> cont_shape(2, 1);
+    cont_shape[0] = kLengths[n];
+    Blob<Dtype> cont(cont_shape);
+    for (int t = 0; t < kLengths[n]; ++t) {
+      caffe_copy(input_dim,
+          this->blob_bottom_.cpu_data() + (t * num + n) * input_dim,
+          x.mutable_cpu_data() + t * input_dim);
+      cont.mutable_cpu_data()[t] = t > 0;
+    }
+    Blob<Dtype> h;
+    vector<Blob<Dtype>*> bottom_vec;
+    bottom_vec.push_back(&x);
+    bottom_vec.push_back(&cont);
+    vector<Blob<Dtype>*> top_vec(1, &h);
+    Caffe::set_random_seed(1701);
+    RNNLayer<Dtype> stream_layer(this->layer_param_);
+    stream_layer.SetUp(bottom_vec, top_vec);
+    stream_layer.Forward(bottom_vec, top_vec);
+    for (int t = 0; t < kLengths[n]; ++t) {
+      for (int d = 0; d < dim; ++d) {
+        EXPECT_NEAR(h.cpu_data()[t * dim + d],
+                    top_data[(t * num + n) * dim + d], kEpsilon)
+            << "n = " << n << "; t = " << t;
+      }
+    }
+  }
+}
+
+TYPED_TEST(RNNLayerTest, TestGradientVariableLength) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->ReshapeBlobs(3, 3);
+  // Streams of 3, 1 and 2 timesteps.
+  const Dtype kCont[] = { 0, 0, 0, 1, -1, 1, 1, -1, -1 };
+  caffe_copy(this->blob_bottom_cont_.count(), kCont,
+             this->blob_bottom_cont_.mutable_cpu_data());
+  this->layer_param_.mutable_recurrent_param()->set_variable_length(true);
+  RNNLayer<Dtype> layer(this->layer_param_);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+}
+
 }  // namespace caffe
@@ -7,6 +7,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/scale_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -381,6 +382,46 @@ TYPED_TEST(ScaleLayerTest, TestForwardScale) {
   }
 }
 
+TYPED_TEST(ScaleLayerTest, TestForwardLayouts) {
+  typedef typename TypeParam::Dtype Dtype;
+  Blob<Dtype> bottom(2, 16, 3, 4);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&bottom);
+  vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+  LayerParameter layer_param;
+  ScaleParameter* scale_param = layer_param.mutable_scale_param();
+  scale_param->mutable_filler()->set_type("gaussian");
+  scale_param->set_bias_term(true);
+  scale_param->mutable_bias_filler()->set_type("gaussian");
+  ScaleLayer<Dtype> layer(layer_param);
+  layer.SetUp(bottom_vec, this->blob_top_vec_);
+  layer.Forward(bottom_vec, this->blob_top_vec_);
+  Blob<Dtype> expected;
+  expected.CopyFrom(*this->blob_top_, false, true);
+  const BlobLayout layouts[] = { NHWC, NCHW16C };
+  for (int l = 0; l < 2; ++l) {
+    Blob<Dtype> blocked_bottom(bottom.shape());
+    blocked_bottom.set_layout(layouts[l]);
+    caffe_cpu_reorder(2, 16, 12, 1, blocked_bottom.layout_block(),
+        bottom.cpu_data(), blocked_bottom.mutable_cpu_data());
+    vector<Blob<Dtype>*> blocked_bottom_vec(1, &blocked_bottom);
+    layer.Reshape(blocked_bottom_vec, this->blob_top_vec_);
+    layer.Forward(blocked_bottom_vec, this->blob_top_vec_);
+    EXPECT_EQ(layouts[l], this->blob_top_->layout());
+    for (int n = 0; n < 2; ++n) {
+      for (int c = 0; c < 16; ++c) {
+        for (int h = 0; h < 3; ++h) {
+          for (int w = 0; w < 4; ++w) {
+            EXPECT_NEAR(expected.data_at(n, c, h, w),
+                this->blob_top_->data_at(n, c, h, w), 1e-5);
+          }
+        }
+      }
+    }
+  }
+}
+
 TYPED_TEST(ScaleLayerTest, TestForwardScaleAxis2) {
   typedef typename TypeParam::Dtype Dtype;
   this->blob_bottom_vec_.push_back(this->blob_bottom_scale_);
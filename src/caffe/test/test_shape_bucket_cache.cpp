@@ -0,0 +1,118 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/inference_engine.hpp"
+#include "caffe/shape_bucket_cache.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class ShapeBucketCacheTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  ShapeBucketCacheTest() {
+    const string proto =
+        "name: 'TestNetwork' "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { shape { dim: 1 dim: 3 dim: 8 dim: 8 } } "
+        "} "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'pool' "
+        "  type: 'Pooling' "
+        "  bottom: 'conv' "
+        "  top: 'pool' "
+        "  pooling_param { pool: AVE global_pooling: true } "
+        "} ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    engine_.reset(new InferenceEngine<Dtype>(param));
+    int small[] = {1, 3, 8, 8};
+    int large[] = {2, 3, 12, 12};
+    buckets_.push_back(vector<vector<int> >(1, vector<int>(small, small + 4)));
+    buckets_.push_back(vector<vector<int> >(1, vector<int>(large, large + 4)));
+  }
+
+  shared_ptr<InferenceEngine<Dtype> > engine_;
+  vector<vector<vector<int> > > buckets_;
+};
+
+TYPED_TEST_CASE(ShapeBucketCacheTest, TestDtypesAndDevices);
+
+TYPED_TEST(ShapeBucketCacheTest, TestFind) {
+  typedef typename TypeParam::Dtype Dtype;
+  ShapeBucketCache<Dtype> cache(this->engine_.get(), this->buckets_);
+  ASSERT_EQ(2, cache.size());
+  for (int i = 0; i < cache.size(); ++i) {
+    EXPECT_EQ(cache.bucket(i), cache.Find(this->buckets_[i][0]));
+    EXPECT_EQ(cache.bucket(i), cache.Find(this->buckets_[i]));
+    EXPECT_TRUE(this->buckets_[i][0] ==
+        cache.bucket(i)->input_blobs()[0]->shape());
+  }
+  EXPECT_NE(cache.bucket(0), cache.bucket(1));
+  vector<int> shape = this->buckets_[0][0];
+  shape[2] = 10;
+  EXPECT_TRUE(cache.Find(shape) == NULL);
+}
+
+TYPED_TEST(ShapeBucketCacheTest, TestFit) {
+  typedef typename TypeParam::Dtype Dtype;
+  ShapeBucketCache<Dtype> cache(this->engine_.get(), this->buckets_);
+  vector<vector<int> > shapes = this->buckets_[0];
+  shapes[0][2] = 7;
+  EXPECT_EQ(cache.bucket(0), cache.Fit(shapes));
+  shapes[0][2] = 10;
+  EXPECT_EQ(cache.bucket(1), cache.Fit(shapes));
+  shapes[0][0] = 3;
+  EXPECT_TRUE(cache.Fit(shapes) == NULL);
+  shapes[0].pop_back();
+  EXPECT_TRUE(cache.Fit(shapes) == NULL);
+}
+
+TYPED_TEST(ShapeBucketCacheTest, TestForwardWithoutReshape) {
+  typedef typename TypeParam::Dtype Dtype;
+  ShapeBucketCache<Dtype> cache(this->engine_.get(), this->buckets_);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  shared_ptr<typename InferenceEngine<Dtype>::Context> reference =
+      this->engine_->CreateContext();
+  for (int i = 0; i < cache.size(); ++i) {
+    typename InferenceEngine<Dtype>::Context* context = cache.bucket(i);
+    // The buffers were allocated when the bucket was planned.
+    const Dtype* conv_data = context->net()->blob_by_name("conv")->cpu_data();
+    filler.Fill(context->input_blobs()[0]);
+    const Blob<Dtype>* output = context->Forward()[0];
+    EXPECT_EQ(conv_data, context->net()->blob_by_name("conv")->cpu_data());
+    reference->input_blobs()[0]->CopyFrom(*context->input_blobs()[0], false,
+        true);
+    reference->net()->Reshape();
+    const Blob<Dtype>* expected = reference->Forward()[0];
+    ASSERT_TRUE(expected->shape() == output->shape());
+    for (int j = 0; j < expected->count(); ++j) {
+      EXPECT_NEAR(expected->cpu_data()[j], output->cpu_data()[j], 1e-5);
+    }
+  }
+}
+
+}  // namespace caffe
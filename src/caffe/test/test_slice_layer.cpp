@@ -132,6 +132,31 @@ TYPED_TEST(SliceLayerTest, TestSliceAcrossNum) {
   }
 }
 
+TYPED_TEST(SliceLayerTest, TestSliceViews) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_slice_param()->set_axis(0);
+  for (int views = 0; views < 2; ++views) {
+    SliceLayer<Dtype> layer(layer_param);
+    layer.set_blob_views(views);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_0_);
+    // Slicing the nums, the tops are contiguous in the bottom.
+    const int offset = this->blob_top_0_->count();
+    EXPECT_EQ(views, this->blob_top_1_->DataViews(*this->blob_bottom_,
+        offset));
+    EXPECT_EQ(views, this->blob_top_1_->DiffViews(*this->blob_bottom_,
+        offset));
+    this->blob_bottom_->mutable_cpu_data()[offset + 1] = 4;
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_0_);
+    EXPECT_EQ(4, this->blob_top_1_->cpu_data()[1]);
+    this->blob_top_1_->mutable_cpu_diff()[2] = 5;
+    vector<bool> propagate_down(1, true);
+    layer.Backward(this->blob_top_vec_0_, propagate_down,
+        this->blob_bottom_vec_);
+    EXPECT_EQ(5, this->blob_bottom_->cpu_diff()[offset + 2]);
+  }
+}
+
 TYPED_TEST(SliceLayerTest, TestSliceAcrossChannels) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cmath>
 #include <vector>
 
@@ -74,6 +75,47 @@ TYPED_TEST(SoftmaxLayerTest, TestForward) {
   }
 }
 
+TYPED_TEST(SoftmaxLayerTest, TestForwardLargeShapes) {
+  typedef typename TypeParam::Dtype Dtype;
+  // More positions than a block, and more channels than fit in one.
+  const int shapes[][4] = { { 2, 3, 40, 30 }, { 1, 20000, 1, 1 } };
+  for (int s = 0; s < 2; ++s) {
+    this->blob_bottom_->Reshape(shapes[s][0], shapes[s][1], shapes[s][2],
+        shapes[s][3]);
+    // Large inputs, which overflow the exp without the max subtracted.
+    FillerParameter filler_param;
+    filler_param.set_std(100);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    LayerParameter layer_param;
+    SoftmaxLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    const int channels = this->blob_bottom_->channels();
+    const int inner_num = this->blob_bottom_->count(2);
+    for (int i = 0; i < this->blob_bottom_->num(); ++i) {
+      for (int k = 0; k < inner_num; ++k) {
+        const Dtype* bottom_data = this->blob_bottom_->cpu_data() +
+            i * channels * inner_num + k;
+        const Dtype* top_data = this->blob_top_->cpu_data() +
+            i * channels * inner_num + k;
+        double max = bottom_data[0];
+        for (int j = 1; j < channels; ++j) {
+          max = std::max(max, double(bottom_data[j * inner_num]));
+        }
+        double scale = 0;
+        for (int j = 0; j < channels; ++j) {
+          scale += exp(bottom_data[j * inner_num] - max);
+        }
+        for (int j = 0; j < channels; ++j) {
+          EXPECT_NEAR(exp(bottom_data[j * inner_num] - max) / scale,
+              top_data[j * inner_num], 1e-4);
+        }
+      }
+    }
+  }
+}
+
 TYPED_TEST(SoftmaxLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cfloat>
 #include <cmath>
 #include <vector>
 
@@ -8,6 +10,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/softmax_loss_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -61,6 +64,65 @@ TYPED_TEST(SoftmaxWithLossLayerTest, TestGradient) {
       this->blob_top_vec_, 0);
 }
 
+TYPED_TEST(SoftmaxWithLossLayerTest, TestForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  SoftmaxWithLossLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // The mean of -log(softmax) at the labels over the 10 x 2 x 3 positions.
+  const Dtype* data = this->blob_bottom_data_->cpu_data();
+  const Dtype* label = this->blob_bottom_label_->cpu_data();
+  double expected_loss = 0;
+  for (int i = 0; i < 10; ++i) {
+    for (int k = 0; k < 6; ++k) {
+      double max = data[i * 30 + k];
+      for (int j = 1; j < 5; ++j) {
+        max = std::max(max, double(data[i * 30 + j * 6 + k]));
+      }
+      double sum = 0;
+      for (int j = 0; j < 5; ++j) {
+        sum += exp(data[i * 30 + j * 6 + k] - max);
+      }
+      const int label_value = static_cast<int>(label[i * 6 + k]);
+      expected_loss -= std::max(
+          data[i * 30 + label_value * 6 + k] - max - log(sum),
+          double(log(FLT_MIN)));
+    }
+  }
+  EXPECT_NEAR(expected_loss / 60, this->blob_top_loss_->cpu_data()[0], 1e-4);
+}
+
+TYPED_TEST(SoftmaxWithLossLayerTest, TestForwardBackwardTestPhase) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  SoftmaxWithLossLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype loss = this->blob_top_loss_->cpu_data()[0];
+  this->blob_top_loss_->mutable_cpu_diff()[0] = 1;
+  vector<bool> propagate_down(2, false);
+  propagate_down[0] = true;
+  layer.Backward(this->blob_top_vec_, propagate_down, this->blob_bottom_vec_);
+  Blob<Dtype> diff;
+  diff.CopyFrom(*this->blob_bottom_data_, true, true);
+  // The TEST phase computes the loss without the probabilities, and Backward
+  // computes them when it needs them.
+  layer_param.set_phase(TEST);
+  SoftmaxWithLossLayer<Dtype> test_layer(layer_param);
+  test_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  test_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_NEAR(loss, this->blob_top_loss_->cpu_data()[0], 1e-5);
+  caffe_set(diff.count(), Dtype(0),
+      this->blob_bottom_data_->mutable_cpu_diff());
+  test_layer.Backward(this->blob_top_vec_, propagate_down,
+      this->blob_bottom_vec_);
+  for (int i = 0; i < diff.count(); ++i) {
+    EXPECT_NEAR(diff.cpu_diff()[i], this->blob_bottom_data_->cpu_diff()[i],
+        1e-6);
+  }
+}
+
 TYPED_TEST(SoftmaxWithLossLayerTest, TestForwardIgnoreLabel) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -9,6 +9,7 @@
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/sgd_solvers.hpp"
 #include "caffe/solver.hpp"
+#include "caffe/solver_factory.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -106,4 +107,235 @@ TYPED_TEST(SolverTest, TestInitTrainTestNets) {
   EXPECT_TRUE(this->solver_->test_nets()[1]->has_layer("accuracy"));
 }
 
+TYPED_TEST(SolverTest, TestAsyncTestCopiesWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+     "base_lr: 0.1 "
+     "lr_policy: 'fixed' "
+     "max_iter: 4 "
+     "test_interval: 2 "
+     "test_iter: 3 "
+     "test_async: true "
+     "snapshot_after_train: false "
+     "net_param { "
+     "  name: 'TestNetwork' "
+     "  layer { "
+     "    name: 'data' "
+     "    type: 'DummyData' "
+     "    dummy_data_param { "
+     "      shape { dim: 5 dim: 2 dim: 3 dim: 4 } "
+     "      shape { dim: 5 } "
+     "      data_filler { type: 'gaussian' } "
+     "      data_filler { type: 'constant' value: 1 } "
+     "    } "
+     "    top: 'data' "
+     "    top: 'label' "
+     "  } "
+     "  layer { "
+     "    name: 'innerprod' "
+     "    type: 'InnerProduct' "
+     "    inner_product_param { "
+     "      num_output: 10 "
+     "      weight_filler { type: 'gaussian' } "
+     "    } "
+     "    bottom: 'data' "
+     "    top: 'innerprod' "
+     "  } "
+     "  layer { "
+     "    name: 'loss' "
+     "    type: 'SoftmaxWithLoss' "
+     "    bottom: 'innerprod' "
+     "    bottom: 'label' "
+     "  } "
+     "} ";
+  this->InitSolverFromProtoString(proto);
+  this->solver_->Solve();
+  // The final evaluation ran on a copy of the trained weights.
+  const vector<shared_ptr<Blob<Dtype> > >& params =
+      this->solver_->net()->layer_by_name("innerprod")->blobs();
+  const vector<shared_ptr<Blob<Dtype> > >& test_params =
+      this->solver_->test_nets()[0]->layer_by_name("innerprod")->blobs();
+  ASSERT_EQ(params.size(), test_params.size());
+  for (int i = 0; i < params.size(); ++i) {
+    ASSERT_EQ(params[i]->count(), test_params[i]->count());
+    EXPECT_NE(params[i]->cpu_data(), test_params[i]->cpu_data());
+    for (int j = 0; j < params[i]->count(); ++j) {
+      EXPECT_EQ(params[i]->cpu_data()[j], test_params[i]->cpu_data()[j]);
+    }
+  }
+}
+
+template <typename Dtype>
+class SparseUpdateTest : public ::testing::Test {
+ protected:
+  // A net of the sum of the embeddings of 4 indices of a vocabulary of 10,
+  // whose gradient does not depend on the weights.
+  shared_ptr<Solver<Dtype> > CreateSolver(const string& type,
+      float weight_decay, bool sparse_update,
+      const string& regularization_type = "L2") {
+    const string proto =
+        "base_lr: 0.1 "
+        "lr_policy: 'fixed' "
+        "random_seed: 1701 "
+        "solver_mode: CPU "
+        "snapshot_after_train: false "
+        "net_param { "
+        "  name: 'TestNetwork' "
+        "  layer { "
+        "    name: 'input' "
+        "    type: 'Input' "
+        "    top: 'index' "
+        "    input_param { shape { dim: 4 } } "
+        "  } "
+        "  layer { "
+        "    name: 'embed' "
+        "    type: 'Embed' "
+        "    bottom: 'index' "
+        "    top: 'embed' "
+        "    embed_param { "
+        "      input_dim: 10 "
+        "      num_output: 3 "
+        "      weight_filler { type: 'gaussian' } "
+        "      bias_filler { type: 'gaussian' } "
+        "    } "
+        "  } "
+        "  layer { "
+        "    name: 'loss' "
+        "    type: 'Reduction' "
+        "    bottom: 'embed' "
+        "    top: 'loss' "
+        "    loss_weight: 1 "
+        "  } "
+        "} ";
+    SolverParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    param.set_type(type);
+    param.set_weight_decay(weight_decay);
+    param.set_regularization_type(regularization_type);
+    param.set_sparse_update(sparse_update);
+    if (type == "Adam") {
+      param.set_momentum(0.9);
+    }
+    Caffe::set_mode(Caffe::CPU);
+    return shared_ptr<Solver<Dtype> >(
+        SolverRegistry<Dtype>::CreateSolver(param));
+  }
+
+  void Step(Solver<Dtype>* solver, int a, int b, int c, int d) {
+    Dtype* index = solver->net()->blob_by_name("index")->mutable_cpu_data();
+    index[0] = a;
+    index[1] = b;
+    index[2] = c;
+    index[3] = d;
+    solver->Step(1);
+  }
+
+  // Steps a solver over indices that leave most rows alone for a while, then
+  // over rows 0, 4, 6 and 9; rows 3, 5, 7 and 8 are never touched.
+  void Train(Solver<Dtype>* solver, int iters) {
+    for (int i = 0; i < iters; ++i) {
+      Step(solver, i % 3, 2 * (i % 4), 9, 9);
+    }
+    Step(solver, 0, 4, 6, 9);
+  }
+
+  // The rows the last step of Train touched, and the bias.
+  void ExpectSameRows(Solver<Dtype>* expected, Solver<Dtype>* actual) {
+    const int rows[] = { 0, 4, 6, 9 };
+    const int dim = 3;
+    const vector<Blob<Dtype>*>& expected_params =
+        expected->net()->learnable_params();
+    const vector<Blob<Dtype>*>& actual_params =
+        actual->net()->learnable_params();
+    for (int i = 0; i < 4; ++i) {
+      for (int k = rows[i] * dim; k < (rows[i] + 1) * dim; ++k) {
+        EXPECT_NEAR(expected_params[0]->cpu_data()[k],
+            actual_params[0]->cpu_data()[k], 1e-5) << "row " << rows[i];
+      }
+    }
+    for (int k = 0; k < dim; ++k) {
+      EXPECT_NEAR(expected_params[1]->cpu_data()[k],
+          actual_params[1]->cpu_data()[k], 1e-5) << "bias";
+    }
+  }
+};
+
+TYPED_TEST_CASE(SparseUpdateTest, TestDtypes);
+
+TYPED_TEST(SparseUpdateTest, TestRowSparseParams) {
+  shared_ptr<Solver<TypeParam> > solver = this->CreateSolver("SGD", 0, true);
+  const vector<Blob<TypeParam>*>& params = solver->net()->learnable_params();
+  ASSERT_EQ(2, params.size());
+  // The weights are row-sparse; the bias is not.
+  EXPECT_TRUE(params[0]->row_sparse_diff());
+  EXPECT_FALSE(params[1]->row_sparse_diff());
+  this->Step(solver.get(), 1, 1, 7, 2);
+  ASSERT_EQ(3, params[0]->diff_rows().size());
+  EXPECT_EQ(1, params[0]->diff_rows()[0]);
+  EXPECT_EQ(7, params[0]->diff_rows()[1]);
+  EXPECT_EQ(2, params[0]->diff_rows()[2]);
+  solver->net()->ClearParamDiffs();
+  EXPECT_EQ(0, params[0]->diff_rows().size());
+  EXPECT_EQ(0, params[0]->asum_diff());
+}
+
+TYPED_TEST(SparseUpdateTest, TestSGDLazyWeightDecay) {
+  // Without momentum, the weight decay a row missed is caught up exactly.
+  shared_ptr<Solver<TypeParam> > dense = this->CreateSolver("SGD", 0.5, false);
+  shared_ptr<Solver<TypeParam> > sparse = this->CreateSolver("SGD", 0.5, true);
+  shared_ptr<Solver<TypeParam> > init = this->CreateSolver("SGD", 0.5, true);
+  this->Train(dense.get(), 6);
+  this->Train(sparse.get(), 6);
+  this->ExpectSameRows(dense.get(), sparse.get());
+  // The rows never touched are left as they were.
+  const TypeParam* initial = init->net()->learnable_params()[0]->cpu_data();
+  const TypeParam* weights = sparse->net()->learnable_params()[0]->cpu_data();
+  for (int k = 3 * 3; k < 4 * 3; ++k) {
+    EXPECT_EQ(initial[k], weights[k]);
+  }
+}
+
+TYPED_TEST(SparseUpdateTest, TestSGDL1LazyWeightDecay) {
+  // A small decay, which shrinks no weight past zero.
+  shared_ptr<Solver<TypeParam> > dense =
+      this->CreateSolver("SGD", 0.01, false, "L1");
+  shared_ptr<Solver<TypeParam> > sparse =
+      this->CreateSolver("SGD", 0.01, true, "L1");
+  this->Train(dense.get(), 6);
+  this->Train(sparse.get(), 6);
+  this->ExpectSameRows(dense.get(), sparse.get());
+}
+
+TYPED_TEST(SparseUpdateTest, TestAdaGrad) {
+  // Rows without gradient keep their AdaGrad history and weights.
+  shared_ptr<Solver<TypeParam> > dense =
+      this->CreateSolver("AdaGrad", 0, false);
+  shared_ptr<Solver<TypeParam> > sparse =
+      this->CreateSolver("AdaGrad", 0, true);
+  this->Train(dense.get(), 6);
+  this->Train(sparse.get(), 6);
+  this->ExpectSameRows(dense.get(), sparse.get());
+}
+
+TYPED_TEST(SparseUpdateTest, TestAdamLazyMoments) {
+  shared_ptr<Solver<TypeParam> > dense = this->CreateSolver("Adam", 0, false);
+  shared_ptr<Solver<TypeParam> > sparse = this->CreateSolver("Adam", 0, true);
+  // Only the dense moments keep moving row 1 after the step that touched it.
+  this->Step(dense.get(), 1, 1, 7, 2);
+  this->Step(sparse.get(), 1, 1, 7, 2);
+  const TypeParam* dense_weights =
+      dense->net()->learnable_params()[0]->cpu_data();
+  const TypeParam* weights = sparse->net()->learnable_params()[0]->cpu_data();
+  const TypeParam row[] = { weights[3], weights[4], weights[5] };
+  for (int k = 3; k < 6; ++k) {
+    EXPECT_NEAR(dense_weights[k], weights[k], 1e-5);
+  }
+  this->Step(dense.get(), 0, 0, 7, 2);
+  this->Step(sparse.get(), 0, 0, 7, 2);
+  for (int k = 3; k < 6; ++k) {
+    EXPECT_EQ(row[k - 3], weights[k]);
+    EXPECT_GT(std::abs(dense_weights[k] - weights[k]), 1e-3);
+  }
+}
+
 }  // namespace caffe
@@ -0,0 +1,152 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/sparse_matrix.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class SparseMatrixTest : public ::testing::Test {
+ protected:
+  SparseMatrixTest()
+      : dense_(new Blob<Dtype>(6, 8, 1, 1)), other_(new Blob<Dtype>()),
+        result_(new Blob<Dtype>()), expected_(new Blob<Dtype>()) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(dense_);
+    // About 3/4 of the matrix is zero, with an empty row.
+    Dtype* data = dense_->mutable_cpu_data();
+    for (int i = 0; i < dense_->count(); ++i) {
+      if (i % 4 != 1 || i / 8 == 2) {
+        data[i] = 0;
+      }
+    }
+  }
+  virtual ~SparseMatrixTest() {
+    delete dense_;
+    delete other_;
+    delete result_;
+    delete expected_;
+  }
+
+  void Fill(Blob<Dtype>* blob, int rows, int cols) {
+    blob->Reshape(rows, cols, 1, 1);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob);
+  }
+
+  void ExpectNear(const Blob<Dtype>& expected, const Blob<Dtype>& actual) {
+    ASSERT_EQ(expected.count(), actual.count());
+    for (int i = 0; i < expected.count(); ++i) {
+      EXPECT_NEAR(expected.cpu_data()[i], actual.cpu_data()[i], 1e-5);
+    }
+  }
+
+  Blob<Dtype>* const dense_;
+  Blob<Dtype>* const other_;
+  Blob<Dtype>* const result_;
+  Blob<Dtype>* const expected_;
+};
+
+TYPED_TEST_CASE(SparseMatrixTest, TestDtypes);
+
+TYPED_TEST(SparseMatrixTest, TestFromDense) {
+  SparseMatrix<TypeParam> matrix;
+  matrix.FromDense(6, 8, this->dense_->cpu_data());
+  EXPECT_EQ(6, matrix.rows());
+  EXPECT_EQ(8, matrix.cols());
+  EXPECT_EQ(10, matrix.nnz());
+  EXPECT_EQ(matrix.row_ptr()[2], matrix.row_ptr()[3]);
+  Blob<TypeParam> dense(6, 8, 1, 1);
+  matrix.ToDense(dense.mutable_cpu_data());
+  this->ExpectNear(*this->dense_, dense);
+}
+
+TYPED_TEST(SparseMatrixTest, TestCsrmm) {
+  SparseMatrix<TypeParam> matrix;
+  matrix.FromDense(6, 8, this->dense_->cpu_data());
+  this->Fill(this->other_, 8, 5);
+  this->Fill(this->result_, 6, 5);
+  this->expected_->CopyFrom(*this->result_, false, true);
+  caffe_cpu_gemm<TypeParam>(CblasNoTrans, CblasNoTrans, 6, 5, 8, 2.,
+      this->dense_->cpu_data(), this->other_->cpu_data(), 0.5,
+      this->expected_->mutable_cpu_data());
+  caffe_cpu_csrmm<TypeParam>(matrix, 5, 2., this->other_->cpu_data(), 0.5,
+      this->result_->mutable_cpu_data());
+  this->ExpectNear(*this->expected_, *this->result_);
+}
+
+TYPED_TEST(SparseMatrixTest, TestGemmCsr) {
+  SparseMatrix<TypeParam> matrix;
+  matrix.FromDense(6, 8, this->dense_->cpu_data());
+  // A (3 x 6) * B (6 x 8), then A (3 x 8) * B^T (8 x 6).
+  for (int trans = 0; trans < 2; ++trans) {
+    const int K = trans ? 8 : 6;
+    const int N = trans ? 6 : 8;
+    this->Fill(this->other_, 3, K);
+    this->expected_->Reshape(3, N, 1, 1);
+    this->result_->Reshape(3, N, 1, 1);
+    caffe_cpu_gemm<TypeParam>(CblasNoTrans, trans ? CblasTrans : CblasNoTrans,
+        3, N, K, 1., this->other_->cpu_data(), this->dense_->cpu_data(), 0.,
+        this->expected_->mutable_cpu_data());
+    caffe_cpu_gemm_csr<TypeParam>(trans ? CblasTrans : CblasNoTrans, 3, 1.,
+        this->other_->cpu_data(), matrix, 0.,
+        this->result_->mutable_cpu_data());
+    this->ExpectNear(*this->expected_, *this->result_);
+  }
+}
+
+TYPED_TEST(SparseMatrixTest, TestSparseWeights) {
+  SparseWeights<TypeParam> weights;
+  weights.Init(0.7, 2);
+  EXPECT_TRUE(weights.Update(*this->dense_));
+  EXPECT_NEAR(38. / 48, weights.sparsity(), 1e-6);
+  ASSERT_EQ(3, weights.matrix(1).rows());
+  EXPECT_EQ(this->dense_->cpu_data()[3 * 8 + 1],
+      weights.matrix(1).values()[0]);
+  // A change of the weights rebuilds the sparse form.
+  caffe_set(24, TypeParam(1), this->dense_->mutable_cpu_data());
+  EXPECT_FALSE(weights.Update(*this->dense_));
+  EXPECT_NEAR(18. / 48, weights.sparsity(), 1e-6);
+  weights.Init(0, 2);
+  EXPECT_FALSE(weights.Update(*this->dense_));
+}
+
+TYPED_TEST(SparseMatrixTest, TestPruneByMagnitude) {
+  TypeParam x[] = { 0.5, -3, 0.1, 2, -0.5, 0, 1, -0.2 };
+  EXPECT_EQ(4, caffe_prune_by_magnitude(8, 0.6, x));
+  // The ties at 0.5 are pruned in order, until 4 are.
+  const TypeParam expected[] = { 0, -3, 0, 2, -0.5, 0, 1, 0 };
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_EQ(expected[i], x[i]);
+  }
+}
+
+TYPED_TEST(SparseMatrixTest, TestSparseBlobProto) {
+  BlobProto proto;
+  this->dense_->ToProto(&proto);
+  SparsifyBlobProto(&proto);
+  EXPECT_EQ(10, proto.sparse_index_size());
+  EXPECT_EQ(10, proto.data_size() + proto.double_data_size());
+  Blob<TypeParam> blob;
+  blob.FromProto(proto);
+  this->ExpectNear(*this->dense_, blob);
+  // An all-zero blob keeps one value.
+  caffe_set(this->dense_->count(), TypeParam(0),
+      this->dense_->mutable_cpu_data());
+  this->dense_->ToProto(&proto);
+  SparsifyBlobProto(&proto);
+  EXPECT_EQ(1, proto.sparse_index_size());
+  blob.FromProto(proto);
+  EXPECT_EQ(0, blob.asum_data());
+}
+
+}  // namespace caffe
@@ -0,0 +1,144 @@
+#include <boost/filesystem.hpp>
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "caffe/util/chunk_store.hpp"
+
+namespace caffe {
+
+ChunkStore::ChunkStore(const string& directory, int chunk_bytes)
+    : directory_(directory), chunk_bytes_(chunk_bytes), chunks_written_(0) {
+  CHECK_GT(chunk_bytes_, 0) << "Chunk size must be positive.";
+}
+
+string ChunkStore::ChunkKey(const char* data, size_t size) {
+  // 64-bit FNV-1a of the content; the size is part of the key as well.
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ULL;
+  }
+  char key[40];
+  snprintf(key, sizeof(key), "%016llx-%llu",
+      static_cast<unsigned long long>(hash),  // NOLINT(runtime/int)
+      static_cast<unsigned long long>(size));  // NOLINT(runtime/int)
+  return string(key);
+}
+
+string ChunkStore::ChunkPath(const string& key) const {
+  return (boost::filesystem::path(directory_) / key).string();
+}
+
+void ChunkStore::WriteChunk(const string& key, const char* data,
+    size_t size) {
+  if (known_chunks_.count(key)) { return; }
+  const string chunk_path = ChunkPath(key);
+  if (!boost::filesystem::exists(chunk_path)) {
+    // The directory is only made by writing, not by loading a snapshot.
+    boost::filesystem::create_directories(directory_);
+    CHECK(boost::filesystem::is_directory(directory_))
+        << "Cannot create chunk directory " << directory_;
+    const string temp_path = chunk_path + ".tmp";
+    FILE* f = fopen(temp_path.c_str(), "wb");
+    CHECK(f) << "Cannot open " << temp_path << " to write chunk.";
+    CHECK_EQ(fwrite(data, 1, size, f), size)
+        << "Failed to write chunk " << temp_path;
+    CHECK_EQ(fclose(f), 0) << "Failed to write chunk " << temp_path;
+    CHECK_EQ(std::rename(temp_path.c_str(), chunk_path.c_str()), 0)
+        << "Failed to rename " << temp_path << " to " << chunk_path;
+    ++chunks_written_;
+  }
+  known_chunks_.insert(key);
+}
+
+template <typename Dtype>
+void ChunkStore::Put(const Blob<Dtype>& blob, ChunkedBlobProto* proto) {
+  proto->Clear();
+  for (int i = 0; i < blob.num_axes(); ++i) {
+    proto->mutable_shape()->add_dim(blob.shape(i));
+  }
+  proto->set_double_data(sizeof(Dtype) == sizeof(double));
+  const char* data = reinterpret_cast<const char*>(blob.cpu_data());
+  const size_t total = blob.count() * sizeof(Dtype);
+  // Keep chunk boundaries on element boundaries.
+  const size_t chunk_size = std::max<size_t>(sizeof(Dtype),
+      chunk_bytes_ / sizeof(Dtype) * sizeof(Dtype));
+  for (size_t offset = 0; offset < total; offset += chunk_size) {
+    const size_t size = std::min(chunk_size, total - offset);
+    const string key = ChunkKey(data + offset, size);
+    WriteChunk(key, data + offset, size);
+    proto->add_chunk(key);
+  }
+}
+
+namespace {
+
+template <typename Stored, typename Dtype>
+void ReadChunks(const ChunkedBlobProto& proto, const string& directory,
+    Dtype* data, int count) {
+  int offset = 0;
+  vector<Stored> buffer;
+  for (int i = 0; i < proto.chunk_size(); ++i) {
+    const string chunk_path =
+        (boost::filesystem::path(directory) / proto.chunk(i)).string();
+    FILE* f = fopen(chunk_path.c_str(), "rb");
+    CHECK(f) << "Missing snapshot chunk " << chunk_path;
+    CHECK_EQ(fseek(f, 0, SEEK_END), 0);
+    const long size = ftell(f);  // NOLINT(runtime/int)
+    CHECK_EQ(fseek(f, 0, SEEK_SET), 0);
+    CHECK_EQ(size % sizeof(Stored), 0) << "Corrupt chunk " << chunk_path;
+    const int chunk_count = size / sizeof(Stored);
+    CHECK_LE(offset + chunk_count, count)
+        << "Chunks of " << chunk_path << " exceed the blob size";
+    buffer.resize(chunk_count);
+    CHECK_EQ(fread(buffer.data(), sizeof(Stored), chunk_count, f),
+        chunk_count) << "Failed to read chunk " << chunk_path;
+    fclose(f);
+    for (int j = 0; j < chunk_count; ++j) {
+      data[offset + j] = buffer[j];
+    }
+    offset += chunk_count;
+  }
+  CHECK_EQ(offset, count) << "Chunks do not cover the blob";
+}
+
+}  // namespace
+
+template <typename Dtype>
+void ChunkStore::Get(const ChunkedBlobProto& proto, Blob<Dtype>* blob,
+    bool reshape) {
+  vector<int> shape(proto.shape().dim_size());
+  for (int i = 0; i < shape.size(); ++i) {
+    shape[i] = proto.shape().dim(i);
+  }
+  if (reshape) {
+    blob->Reshape(shape);
+  } else {
+    CHECK(blob->shape() == shape) << "shape mismatch (reshape not set)";
+  }
+  if (proto.double_data()) {
+    ReadChunks<double>(proto, directory_, blob->mutable_cpu_data(),
+        blob->count());
+  } else {
+    ReadChunks<float>(proto, directory_, blob->mutable_cpu_data(),
+        blob->count());
+  }
+  for (int i = 0; i < proto.chunk_size(); ++i) {
+    known_chunks_.insert(proto.chunk(i));
+  }
+}
+
+template void ChunkStore::Put(const Blob<float>& blob,
+    ChunkedBlobProto* proto);
+template void ChunkStore::Put(const Blob<double>& blob,
+    ChunkedBlobProto* proto);
+template void ChunkStore::Get(const ChunkedBlobProto& proto,
+    Blob<float>* blob, bool reshape);
+template void ChunkStore::Get(const ChunkedBlobProto& proto,
+    Blob<double>* blob, bool reshape);
+
+}  // namespace caffe
@@ -66,6 +66,58 @@ template void im2col_cpu<double>(const double* data_im, const int channels,
     const int stride_w, const int dilation_h, const int dilation_w,
     double* data_col);
 
+template <typename Dtype>
+void im2row_blocked_cpu(const Dtype* data_im, const int channels,
+    const int block, const int height, const int width, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    Dtype* data_row) {
+  const int output_h = (height + 2 * pad_h -
+    (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+  const int output_w = (width + 2 * pad_w -
+    (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+  const int block_size = height * width * block;
+  for (int output_row = 0; output_row < output_h; ++output_row) {
+    for (int output_col = 0; output_col < output_w; ++output_col) {
+      const Dtype* block_im = data_im;
+      for (int b = channels / block; b--; block_im += block_size) {
+        for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
+          const int input_row =
+              output_row * stride_h - pad_h + kernel_row * dilation_h;
+          for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++) {
+            const int input_col =
+                output_col * stride_w - pad_w + kernel_col * dilation_w;
+            if (is_a_ge_zero_and_a_lt_b(input_row, height) &&
+                is_a_ge_zero_and_a_lt_b(input_col, width)) {
+              const Dtype* im =
+                  block_im + (input_row * width + input_col) * block;
+              for (int i = 0; i < block; ++i) {
+                data_row[i] = im[i];
+              }
+            } else {
+              for (int i = 0; i < block; ++i) {
+                data_row[i] = 0;
+              }
+            }
+            data_row += block;
+          }
+        }
+      }
+    }
+  }
+}
+
+template void im2row_blocked_cpu<float>(const float* data_im,
+    const int channels, const int block, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, float* data_row);
+template void im2row_blocked_cpu<double>(const double* data_im,
+    const int channels, const int block, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, double* data_row);
+
 template <typename Dtype>
 inline void im2col_nd_core_cpu(const Dtype* data_input, const bool im2col,
     const int num_spatial_axes, const int* im_shape, const int* col_shape,
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/insert_reorders.hpp"
+
+namespace caffe {
+
+namespace {
+
+// With cuDNN, the layers of the DEFAULT engine are those of cuDNN, which
+// only take NCHW.
+template <typename Engine>
+bool CaffeEngine(Engine engine) {
+#ifdef USE_CUDNN
+  return engine == 1;  // CAFFE
+#else
+  return engine != 2;  // CUDNN
+#endif
+}
+
+string LayoutSuffix(BlobLayout layout) {
+  string suffix = BlobLayout_Name(layout);
+  std::transform(suffix.begin(), suffix.end(), suffix.begin(), ::tolower);
+  return suffix;
+}
+
+// Names the version of blob_name in the layout, as it in NCHW, or with the
+// layout as suffix, unless that is written already or a top of the net.
+string VersionName(const string& blob_name, BlobLayout layout,
+    const std::set<string>& net_tops, const std::set<string>& written) {
+  string name = blob_name;
+  if (layout != NCHW) {
+    name += "_" + LayoutSuffix(layout);
+  }
+  while (written.count(name) || (name != blob_name && net_tops.count(name))) {
+    name += "_";
+  }
+  return name;
+}
+
+// The versions of a blob in each layout it was converted to, the first in
+// the layout its last producer wrote.
+struct BlobVersions {
+  BlobLayout layout;
+  map<BlobLayout, string> names;
+  bool consumed;
+};
+
+}  // namespace
+
+bool LayerPrefersLayout(const LayerParameter& layer_param) {
+  const string& type = layer_param.type();
+  if (type == "Convolution") {
+    const ConvolutionParameter& conv_param = layer_param.convolution_param();
+    return conv_param.group() == 1 && conv_param.axis() == 1 &&
+        !conv_param.force_nd_im2col() && CaffeEngine(conv_param.engine());
+  } else if (type == "Pooling") {
+    const PoolingParameter& pool_param = layer_param.pooling_param();
+    return pool_param.pool() != PoolingParameter_PoolMethod_STOCHASTIC &&
+        layer_param.top_size() == 1 && CaffeEngine(pool_param.engine());
+  } else if (type == "BatchNorm") {
+    // Only the global statistics, as in the TEST phase.
+    const BatchNormParameter& bn_param = layer_param.batch_norm_param();
+    return !bn_param.has_use_global_stats() || bn_param.use_global_stats();
+  } else if (type == "Scale") {
+    // Only the learned scale of each channel.
+    const ScaleParameter& scale_param = layer_param.scale_param();
+    return layer_param.bottom_size() == 1 && scale_param.axis() == 1 &&
+        scale_param.num_axes() == 1;
+  }
+  return false;
+}
+
+bool LayerTakesAnyLayout(const LayerParameter& layer_param) {
+  static const char* kTypes[] = { "AbsVal", "BNLL", "Clip", "Dropout", "ELU",
+      "Eltwise", "Exp", "Log", "Power", "ReLU", "Sigmoid", "Split", "Swish",
+      "TanH", "Threshold" };
+  const int num_types = sizeof(kTypes) / sizeof(kTypes[0]);
+  return std::find(kTypes, kTypes + num_types, layer_param.type()) !=
+      kTypes + num_types;
+}
+
+void InsertReorders(const NetParameter& param, NetParameter* param_reorder) {
+  param_reorder->CopyFrom(param);
+  param_reorder->clear_layer();
+  const BlobLayout net_layout = param.layout();
+  // The names of the tops of the net, which the inserted blobs must not take.
+  std::set<string> net_tops;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer_param = param.layer(i);
+    net_tops.insert(layer_param.top().begin(), layer_param.top().end());
+  }
+  std::set<string> written;
+  map<string, BlobVersions> blobs;
+  vector<string> blob_order;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    LayerParameter layer_param = param.layer(i);
+    // The bottoms of the net, if any, are NCHW.
+    for (int j = 0; j < layer_param.bottom_size(); ++j) {
+      const string& blob_name = layer_param.bottom(j);
+      if (!blobs.count(blob_name)) {
+        BlobVersions& versions = blobs[blob_name];
+        versions.layout = NCHW;
+        versions.names[NCHW] = blob_name;
+        versions.consumed = false;
+        written.insert(blob_name);
+      }
+    }
+    BlobLayout layout = NCHW;
+    if (LayerPrefersLayout(layer_param)) {
+      layout = net_layout;
+    } else if (LayerTakesAnyLayout(layer_param) &&
+        layer_param.bottom_size() > 0) {
+      layout = blobs[layer_param.bottom(0)].layout;
+    }
+    // Convolution unrolls its bottoms in the layout they have, so that the
+    // images at the input of the net, whose few channels fill no blocks,
+    // need no Reorder, and writes its top in the layout of the net.
+    BlobLayout bottom_layout = layout;
+    if (layer_param.type() == "Convolution" && layout != NCHW &&
+        layer_param.bottom_size() > 0) {
+      const BlobVersions& versions = blobs[layer_param.bottom(0)];
+      if (!versions.names.count(layout)) {
+        bottom_layout = versions.layout;
+      }
+      layer_param.mutable_convolution_param()->set_top_layout(layout);
+    }
+    for (int j = 0; j < layer_param.bottom_size(); ++j) {
+      BlobVersions& versions = blobs[layer_param.bottom(j)];
+      versions.consumed = true;
+      if (!versions.names.count(bottom_layout)) {
+        const string& source = versions.names[versions.layout];
+        const string name = VersionName(layer_param.bottom(j), bottom_layout,
+            net_tops, written);
+        LayerParameter* reorder_param = param_reorder->add_layer();
+        reorder_param->set_name(name + "_reorder");
+        reorder_param->set_type("Reorder");
+        reorder_param->add_bottom(source);
+        reorder_param->add_top(name);
+        reorder_param->mutable_reorder_param()->set_layout(bottom_layout);
+        written.insert(name);
+        versions.names[bottom_layout] = name;
+      }
+    }
+    for (int j = 0; j < layer_param.top_size(); ++j) {
+      const string blob_name = layer_param.top(j);
+      string name;
+      for (int k = 0; k < layer_param.bottom_size(); ++k) {
+        if (param.layer(i).bottom(k) == blob_name) {
+          // In place, on the version the layer takes.
+          name = blobs[blob_name].names[bottom_layout];
+        }
+      }
+      if (name.empty()) {
+        name = VersionName(blob_name, layout, net_tops, written);
+      }
+      if (!blobs.count(blob_name)) {
+        blob_order.push_back(blob_name);
+      }
+      BlobVersions& versions = blobs[blob_name];
+      versions.layout = layout;
+      versions.names.clear();
+      versions.names[layout] = name;
+      versions.consumed = false;
+      written.insert(name);
+      layer_param.set_top(j, name);
+    }
+    for (int j = 0; j < layer_param.bottom_size(); ++j) {
+      layer_param.set_bottom(j,
+          blobs[param.layer(i).bottom(j)].names[bottom_layout]);
+    }
+    param_reorder->add_layer()->CopyFrom(layer_param);
+  }
+  // The outputs of the net are NCHW, under their own names where free.
+  for (int i = 0; i < blob_order.size(); ++i) {
+    BlobVersions& versions = blobs[blob_order[i]];
+    if (versions.consumed || versions.names.count(NCHW)) { continue; }
+    const string name = VersionName(blob_order[i], NCHW, net_tops, written);
+    LayerParameter* reorder_param = param_reorder->add_layer();
+    reorder_param->set_name(name + "_reorder");
+    reorder_param->set_type("Reorder");
+    reorder_param->add_bottom(versions.names[versions.layout]);
+    reorder_param->add_top(name);
+    reorder_param->mutable_reorder_param()->set_layout(NCHW);
+    written.insert(name);
+  }
+}
+
+}  // namespace caffe
@@ -1,7 +1,14 @@
 #include <boost/math/special_functions/next.hpp>
 #include <boost/random.hpp>
+#include <stdint.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
 #include <limits>
+#include <utility>
+#include <vector>
 
 #include "caffe/common.hpp"
 #include "caffe/util/math_functions.hpp"
@@ -382,4 +389,231 @@ void caffe_cpu_scale<double>(const int n, const double alpha, const double *x,
   cblas_dscal(n, alpha, y, 1);
 }
 
+namespace {
+
+// bfloat16 is the upper half of an IEEE float: round the lower 16 bits away.
+inline float round_bf16(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  if ((bits & 0x7fffffffu) > 0x7f800000u) {
+    // Keep NaNs NaN once the mantissa is truncated.
+    bits |= 0x00400000u;
+  } else {
+    bits += 0x7fffu + ((bits >> 16) & 1u);
+  }
+  bits &= 0xffff0000u;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+}  // namespace
+
+template <typename Dtype>
+void caffe_cpu_round_bf16(const int n, Dtype* x) {
+  for (int i = 0; i < n; ++i) {
+    x[i] = round_bf16(static_cast<float>(x[i]));
+  }
+}
+
+template
+void caffe_cpu_round_bf16<float>(const int n, float* x);
+
+template
+void caffe_cpu_round_bf16<double>(const int n, double* x);
+
+template <typename Dtype>
+void caffe_cpu_softmax(const int outer_num, const int channels,
+    const int inner_num, const Dtype* x, Dtype* y, Dtype* lse) {
+  // The positions of a block, times the channels, are at most kCacheBlock
+  // values, so the passes after the first read them from cache.
+  const int kMaxBlock = 1024;
+  const int kCacheBlock = 16384;
+  const int block = std::min(std::min(inner_num, kMaxBlock),
+      std::max(1, kCacheBlock / channels));
+  Dtype max[kMaxBlock], sum[kMaxBlock];
+  const int dim = channels * inner_num;
+  for (int i = 0; i < outer_num; ++i) {
+    for (int k0 = 0; k0 < inner_num; k0 += block) {
+      const int n = std::min(block, inner_num - k0);
+      const Dtype* x_block = x + i * dim + k0;
+      std::copy(x_block, x_block + n, max);
+      for (int c = 1; c < channels; ++c) {
+        const Dtype* x_c = x_block + c * inner_num;
+        for (int k = 0; k < n; ++k) {
+          max[k] = std::max(max[k], x_c[k]);
+        }
+      }
+      caffe_set(n, Dtype(0), sum);
+      if (y) {
+        Dtype* y_block = y + i * dim + k0;
+        for (int c = 0; c < channels; ++c) {
+          const Dtype* x_c = x_block + c * inner_num;
+          Dtype* y_c = y_block + c * inner_num;
+          for (int k = 0; k < n; ++k) {
+            y_c[k] = std::exp(x_c[k] - max[k]);
+            sum[k] += y_c[k];
+          }
+        }
+        for (int k = 0; k < n; ++k) {
+          sum[k] = 1 / sum[k];
+        }
+        for (int c = 0; c < channels; ++c) {
+          Dtype* y_c = y_block + c * inner_num;
+          for (int k = 0; k < n; ++k) {
+            y_c[k] *= sum[k];
+          }
+        }
+        if (lse) {
+          for (int k = 0; k < n; ++k) {
+            lse[i * inner_num + k0 + k] = max[k] - std::log(sum[k]);
+          }
+        }
+      } else {
+        for (int c = 0; c < channels; ++c) {
+          const Dtype* x_c = x_block + c * inner_num;
+          for (int k = 0; k < n; ++k) {
+            sum[k] += std::exp(x_c[k] - max[k]);
+          }
+        }
+        if (lse) {
+          for (int k = 0; k < n; ++k) {
+            lse[i * inner_num + k0 + k] = max[k] + std::log(sum[k]);
+          }
+        }
+      }
+    }
+  }
+}
+
+template
+void caffe_cpu_softmax<float>(const int outer_num, const int channels,
+    const int inner_num, const float* x, float* y, float* lse);
+
+template
+void caffe_cpu_softmax<double>(const int outer_num, const int channels,
+    const int inner_num, const double* x, double* y, double* lse);
+
+template <typename Dtype>
+void caffe_cpu_top_k(const int n, const Dtype* x, const int incx, const int k,
+    vector<std::pair<Dtype, int> >* top) {
+  CHECK_GE(k, 1);
+  CHECK_LE(k, n);
+  typedef std::pair<Dtype, int> Pair;
+  std::greater<Pair> greater;
+  if (k > n / 16) {
+    // Quickselect: put the k largest first, then sort them.
+    top->resize(n);
+    for (int j = 0; j < n; ++j) {
+      (*top)[j] = Pair(x[j * incx], j);
+    }
+    if (k < n) {
+      std::nth_element(top->begin(), top->begin() + k - 1, top->end(),
+          greater);
+    }
+    std::sort(top->begin(), top->begin() + k, greater);
+    return;
+  }
+  // The min-heap of the k largest so far. A later value enters if it is at
+  // least the least of them, as its index is greater.
+  top->resize(k);
+  for (int j = 0; j < k; ++j) {
+    (*top)[j] = Pair(x[j * incx], j);
+  }
+  std::make_heap(top->begin(), top->end(), greater);
+  Dtype least = top->front().first;
+  for (int j = k; j < n; ++j) {
+    const Dtype value = x[j * incx];
+    if (value >= least) {
+      std::pop_heap(top->begin(), top->end(), greater);
+      top->back() = Pair(value, j);
+      std::push_heap(top->begin(), top->end(), greater);
+      least = top->front().first;
+    }
+  }
+  std::sort_heap(top->begin(), top->end(), greater);
+}
+
+template
+void caffe_cpu_top_k<float>(const int n, const float* x, const int incx,
+    const int k, vector<std::pair<float, int> >* top);
+
+template
+void caffe_cpu_top_k<double>(const int n, const double* x, const int incx,
+    const int k, vector<std::pair<double, int> >* top);
+
+template <typename Dtype>
+void caffe_cpu_reorder(const int num, const int channels, const int spatial,
+    const int from_block, const int to_block, const Dtype* x, Dtype* y) {
+  CHECK_EQ(channels % from_block, 0);
+  CHECK_EQ(channels % to_block, 0);
+  // A tile of the positions of every channel is read and written while it
+  // stays in cache, whichever of x and y is strided.
+  const int kTile = 64;
+  const int dim = channels * spatial;
+  for (int n = 0; n < num; ++n) {
+    const Dtype* x_n = x + n * dim;
+    Dtype* y_n = y + n * dim;
+    for (int s_begin = 0; s_begin < spatial; s_begin += kTile) {
+      const int s_end = std::min(s_begin + kTile, spatial);
+      for (int c = 0; c < channels; ++c) {
+        const Dtype* x_c = x_n + c / from_block * from_block * spatial
+            + c % from_block;
+        Dtype* y_c = y_n + c / to_block * to_block * spatial + c % to_block;
+        for (int s = s_begin; s < s_end; ++s) {
+          y_c[s * to_block] = x_c[s * from_block];
+        }
+      }
+    }
+  }
+}
+
+template
+void caffe_cpu_reorder<float>(const int num, const int channels,
+    const int spatial, const int from_block, const int to_block,
+    const float* x, float* y);
+
+template
+void caffe_cpu_reorder<double>(const int num, const int channels,
+    const int spatial, const int from_block, const int to_block,
+    const double* x, double* y);
+
+template <typename Dtype>
+void caffe_cpu_scale_channels(const int num, const int channels,
+    const int spatial, const int block, const Dtype* scale,
+    const Dtype* shift, const Dtype* x, Dtype* y) {
+  CHECK_EQ(channels % block, 0);
+  for (int n = 0; n < num; ++n) {
+    for (int c = 0; c < channels; c += block) {
+      const int offset = (n * channels + c) * spatial;
+      const Dtype* x_c = x + offset;
+      Dtype* y_c = y + offset;
+      const Dtype* scale_c = scale + c;
+      for (int s = 0; s < spatial; ++s) {
+        if (shift) {
+          const Dtype* shift_c = shift + c;
+          for (int i = 0; i < block; ++i) {
+            y_c[i] = scale_c[i] * x_c[i] + shift_c[i];
+          }
+        } else {
+          for (int i = 0; i < block; ++i) {
+            y_c[i] = scale_c[i] * x_c[i];
+          }
+        }
+        x_c += block;
+        y_c += block;
+      }
+    }
+  }
+}
+
+template
+void caffe_cpu_scale_channels<float>(const int num, const int channels,
+    const int spatial, const int block, const float* scale,
+    const float* shift, const float* x, float* y);
+
+template
+void caffe_cpu_scale_channels<double>(const int num, const int channels,
+    const int spatial, const int block, const double* scale,
+    const double* shift, const double* x, double* y);
+
 }  // namespace caffe
@@ -0,0 +1,123 @@
+#include <boost/thread.hpp>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "caffe/util/memory_tracker.hpp"
+
+namespace caffe {
+
+namespace {
+
+typedef std::pair<const SyncedMemory*, bool> Key;
+
+// The state of the tracker, created on first use and never destroyed, as
+// memory may be freed during the exit.
+struct State {
+  boost::mutex mutex;
+  map<Key, MemoryTracker::Allocation> live;
+  map<const void*, MemoryTracker::Usage> usages;
+  MemoryTracker::Usage total;
+  boost::thread_specific_ptr<const void*> owner;
+};
+
+State& state() {
+  static State* state = new State();
+  return *state;
+}
+
+void Add(MemoryTracker::Usage* usage, size_t bytes) {
+  usage->current += bytes;
+  usage->peak = std::max(usage->peak, usage->current);
+  ++usage->allocations;
+}
+
+}  // namespace
+
+bool MemoryTracker::enabled_ = false;
+
+void MemoryTracker::set_enabled(bool enabled) {
+  state();
+  enabled_ = enabled;
+}
+
+void MemoryTracker::Allocate(const SyncedMemory* memory, size_t bytes,
+    bool gpu) {
+  if (!enabled_) { return; }
+  State& s = state();
+  Allocation allocation;
+  allocation.memory = memory;
+  allocation.gpu = gpu;
+  allocation.bytes = bytes;
+  allocation.owner = s.owner.get() ? *s.owner : NULL;
+  boost::mutex::scoped_lock lock(s.mutex);
+  s.live[Key(memory, gpu)] = allocation;
+  Add(&s.usages[allocation.owner], bytes);
+  Add(&s.total, bytes);
+}
+
+void MemoryTracker::Free(const SyncedMemory* memory, bool gpu) {
+  State& s = state();
+  boost::mutex::scoped_lock lock(s.mutex);
+  // Allocations made while tracking was on are freed even once it is off.
+  map<Key, Allocation>::iterator it = s.live.find(Key(memory, gpu));
+  if (it == s.live.end()) { return; }
+  s.usages[it->second.owner].current -= it->second.bytes;
+  s.total.current -= it->second.bytes;
+  s.live.erase(it);
+}
+
+MemoryTracker::Usage MemoryTracker::usage(const void* owner) {
+  State& s = state();
+  boost::mutex::scoped_lock lock(s.mutex);
+  map<const void*, Usage>::const_iterator it = s.usages.find(owner);
+  return it == s.usages.end() ? Usage() : it->second;
+}
+
+MemoryTracker::Usage MemoryTracker::total() {
+  State& s = state();
+  boost::mutex::scoped_lock lock(s.mutex);
+  return s.total;
+}
+
+vector<MemoryTracker::Allocation> MemoryTracker::allocations() {
+  State& s = state();
+  boost::mutex::scoped_lock lock(s.mutex);
+  vector<Allocation> allocations;
+  for (map<Key, Allocation>::const_iterator it = s.live.begin();
+       it != s.live.end(); ++it) {
+    allocations.push_back(it->second);
+  }
+  return allocations;
+}
+
+void MemoryTracker::ResetPeaks() {
+  State& s = state();
+  boost::mutex::scoped_lock lock(s.mutex);
+  for (map<const void*, Usage>::iterator it = s.usages.begin();
+       it != s.usages.end(); ++it) {
+    it->second.peak = it->second.current;
+    it->second.allocations = 0;
+  }
+  s.total.peak = s.total.current;
+  s.total.allocations = 0;
+}
+
+MemoryTracker::Scope::Scope(const void* owner)
+    : active_(enabled_), previous_(NULL) {
+  if (!active_) { return; }
+  boost::thread_specific_ptr<const void*>& current = state().owner;
+  if (!current.get()) {
+    current.reset(new const void*(NULL));
+  }
+  previous_ = *current;
+  *current = owner;
+}
+
+MemoryTracker::Scope::~Scope() {
+  if (active_) {
+    *state().owner = previous_;
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,323 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "caffe/util/metrics.hpp"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0  // OS X, where SO_NOSIGPIPE is set on the socket
+#endif
+
+namespace caffe {
+
+namespace {
+
+// The bounds of the default buckets, for durations in seconds.
+const double kDefaultBounds[] = { 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+    0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60 };
+
+// The name of a sample with its labels, as name{labels}.
+string Sample(const string& name, const string& labels) {
+  return labels.empty() ? name : name + "{" + labels + "}";
+}
+
+string Join(const string& labels, const string& label) {
+  return labels.empty() ? label : labels + "," + label;
+}
+
+}  // namespace
+
+void Metrics::Counter::Increment(double value) {
+  CHECK_GE(value, 0) << "Counters only increase.";
+  boost::mutex::scoped_lock lock(*mutex_);
+  value_ += value;
+}
+
+double Metrics::Counter::value() const {
+  boost::mutex::scoped_lock lock(*mutex_);
+  return value_;
+}
+
+void Metrics::Gauge::Set(double value) {
+  boost::mutex::scoped_lock lock(*mutex_);
+  value_ = value;
+}
+
+double Metrics::Gauge::value() const {
+  boost::mutex::scoped_lock lock(*mutex_);
+  return value_;
+}
+
+Metrics::Histogram::Histogram(boost::mutex* mutex,
+    const vector<double>& bounds)
+    : mutex_(mutex), bounds_(bounds), counts_(bounds.size() + 1, 0),
+      sum_(0) {
+  for (int i = 1; i < bounds_.size(); ++i) {
+    CHECK_LT(bounds_[i - 1], bounds_[i])
+        << "The bucket bounds must increase.";
+  }
+}
+
+void Metrics::Histogram::Observe(double value) {
+  boost::mutex::scoped_lock lock(*mutex_);
+  int bucket = 0;
+  while (bucket < bounds_.size() && value > bounds_[bucket]) {
+    ++bucket;
+  }
+  ++counts_[bucket];
+  sum_ += value;
+}
+
+int Metrics::Histogram::count() const {
+  boost::mutex::scoped_lock lock(*mutex_);
+  int count = 0;
+  for (int i = 0; i < counts_.size(); ++i) {
+    count += counts_[i];
+  }
+  return count;
+}
+
+double Metrics::Histogram::sum() const {
+  boost::mutex::scoped_lock lock(*mutex_);
+  return sum_;
+}
+
+Metrics& Metrics::Get() {
+  // Never destroyed, so that threads may record during the exit.
+  static Metrics* metrics = new Metrics();
+  return *metrics;
+}
+
+Metrics::Metrics() : mutex_(new boost::mutex()) {
+}
+
+string Metrics::Label(const string& name, const string& value) {
+  string label = name + "=\"";
+  for (int i = 0; i < value.size(); ++i) {
+    if (value[i] == '\\' || value[i] == '"') {
+      label += '\\';
+      label += value[i];
+    } else if (value[i] == '\n') {
+      label += "\\n";
+    } else {
+      label += value[i];
+    }
+  }
+  return label + "\"";
+}
+
+Metrics::Family* Metrics::family(const string& name, const string& help,
+    Type type) {
+  map<string, Family>::iterator it = families_.find(name);
+  if (it == families_.end()) {
+    Family family;
+    family.type = type;
+    family.help = help;
+    it = families_.insert(std::make_pair(name, family)).first;
+  }
+  CHECK_EQ(it->second.type, type) << "Metric " << name
+      << " was registered with another type.";
+  return &it->second;
+}
+
+Metrics::Counter* Metrics::counter(const string& name, const string& help,
+    const string& labels) {
+  boost::mutex::scoped_lock lock(*mutex_);
+  shared_ptr<Counter>& counter = family(name, help, COUNTER)->counters[labels];
+  if (!counter) {
+    counter.reset(new Counter(mutex_.get()));
+  }
+  return counter.get();
+}
+
+Metrics::Gauge* Metrics::gauge(const string& name, const string& help,
+    const string& labels) {
+  boost::mutex::scoped_lock lock(*mutex_);
+  shared_ptr<Gauge>& gauge = family(name, help, GAUGE)->gauges[labels];
+  if (!gauge) {
+    gauge.reset(new Gauge(mutex_.get()));
+  }
+  return gauge.get();
+}
+
+Metrics::Histogram* Metrics::histogram(const string& name,
+    const string& help, const string& labels, const vector<double>& bounds) {
+  boost::mutex::scoped_lock lock(*mutex_);
+  shared_ptr<Histogram>& histogram =
+      family(name, help, HISTOGRAM)->histograms[labels];
+  if (!histogram) {
+    histogram.reset(new Histogram(mutex_.get(), bounds.size() ? bounds :
+        vector<double>(kDefaultBounds, kDefaultBounds +
+            sizeof(kDefaultBounds) / sizeof(kDefaultBounds[0]))));
+  }
+  return histogram.get();
+}
+
+string Metrics::Text() const {
+  boost::mutex::scoped_lock lock(*mutex_);
+  std::ostringstream out;
+  out << std::setprecision(15);
+  for (map<string, Family>::const_iterator it = families_.begin();
+       it != families_.end(); ++it) {
+    const string& name = it->first;
+    const Family& family = it->second;
+    static const char* types[] = { "counter", "gauge", "histogram" };
+    out << "# HELP " << name << " " << family.help << "\n";
+    out << "# TYPE " << name << " " << types[family.type] << "\n";
+    for (map<string, shared_ptr<Counter> >::const_iterator c =
+         family.counters.begin(); c != family.counters.end(); ++c) {
+      out << Sample(name, c->first) << " " << c->second->value_ << "\n";
+    }
+    for (map<string, shared_ptr<Gauge> >::const_iterator g =
+         family.gauges.begin(); g != family.gauges.end(); ++g) {
+      out << Sample(name, g->first) << " " << g->second->value_ << "\n";
+    }
+    for (map<string, shared_ptr<Histogram> >::const_iterator h =
+         family.histograms.begin(); h != family.histograms.end(); ++h) {
+      const Histogram& histogram = *h->second;
+      // The buckets are cumulative.
+      int count = 0;
+      for (int i = 0; i < histogram.counts_.size(); ++i) {
+        count += histogram.counts_[i];
+        std::ostringstream bound;
+        bound << std::setprecision(15);
+        if (i < histogram.bounds_.size()) {
+          bound << histogram.bounds_[i];
+        } else {
+          bound << "+Inf";
+        }
+        out << Sample(name + "_bucket",
+            Join(h->first, Label("le", bound.str()))) << " " << count
+            << "\n";
+      }
+      out << Sample(name + "_sum", h->first) << " " << histogram.sum_ << "\n";
+      out << Sample(name + "_count", h->first) << " " << count << "\n";
+    }
+  }
+  return out.str();
+}
+
+void Metrics::WriteTextFile(const string& filename) const {
+  const string temp = filename + ".tmp";
+  {
+    std::ofstream out(temp.c_str());
+    CHECK(out.is_open()) << "Failed to open " << temp;
+    out << Text();
+  }
+  CHECK_EQ(rename(temp.c_str(), filename.c_str()), 0)
+      << "Failed to replace " << filename << ": " << strerror(errno);
+}
+
+MetricsExporter::MetricsExporter(int port, const string& filename,
+    double interval, const string& address)
+    : port_(-1), filename_(filename), interval_(interval), socket_(-1) {
+  CHECK(filename_.empty() || interval_ > 0)
+      << "The metrics file needs an interval.";
+  if (port >= 0) {
+    socket_ = socket(AF_INET, SOCK_STREAM, 0);
+    CHECK_GE(socket_, 0) << "Failed to open a socket: " << strerror(errno);
+    const int reuse = 1;
+    setsockopt(socket_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#ifdef SO_NOSIGPIPE
+    setsockopt(socket_, SOL_SOCKET, SO_NOSIGPIPE, &reuse, sizeof(reuse));
+#endif
+    struct sockaddr_in socket_address;
+    memset(&socket_address, 0, sizeof(socket_address));
+    socket_address.sin_family = AF_INET;
+    CHECK_EQ(inet_pton(AF_INET, address.c_str(), &socket_address.sin_addr), 1)
+        << "Invalid IPv4 address " << address;
+    socket_address.sin_port = htons(port);
+    CHECK_EQ(bind(socket_, reinterpret_cast<struct sockaddr*>(&socket_address),
+        sizeof(socket_address)), 0) << "Failed to bind " << address << ":"
+        << port << ": " << strerror(errno);
+    CHECK_EQ(listen(socket_, 8), 0) << strerror(errno);
+    socklen_t length = sizeof(socket_address);
+    getsockname(socket_, reinterpret_cast<struct sockaddr*>(&socket_address),
+        &length);
+    port_ = ntohs(socket_address.sin_port);
+    LOG(INFO) << "Serving metrics on " << address << ":" << port_;
+  }
+  StartInternalThread();
+}
+
+MetricsExporter::~MetricsExporter() {
+  StopInternalThread();
+  if (socket_ >= 0) {
+    close(socket_);
+  }
+}
+
+void MetricsExporter::InternalThreadEntry() {
+  using boost::posix_time::microsec_clock;
+  boost::posix_time::ptime written = microsec_clock::local_time();
+  while (!must_stop()) {
+    const boost::posix_time::ptime now = microsec_clock::local_time();
+    if (!filename_.empty() &&
+        (now - written).total_milliseconds() >= interval_ * 1000) {
+      Metrics::Get().WriteTextFile(filename_);
+      written = now;
+    }
+    // Wake up often enough to stop promptly.
+    struct timeval timeout = { 0, 100000 };
+    if (socket_ < 0) {
+      select(0, NULL, NULL, NULL, &timeout);
+      continue;
+    }
+    fd_set sockets;
+    FD_ZERO(&sockets);
+    FD_SET(socket_, &sockets);
+    if (select(socket_ + 1, &sockets, NULL, NULL, &timeout) > 0) {
+      const int client = accept(socket_, NULL, NULL);
+      if (client >= 0) {
+        Serve(client);
+        close(client);
+      }
+    }
+  }
+  // Leave the file with the final values.
+  if (!filename_.empty()) {
+    Metrics::Get().WriteTextFile(filename_);
+  }
+}
+
+void MetricsExporter::Serve(int client) {
+  // The request line is all that matters; the rest of the request is left
+  // unread.
+  char request[1024];
+  const ssize_t length = recv(client, request, sizeof(request) - 1, 0);
+  if (length <= 0) { return; }
+  request[length] = '\0';
+  std::ostringstream response;
+  if (strncmp(request, "GET ", 4) == 0) {
+    const string body = Metrics::Get().Text();
+    response << "HTTP/1.0 200 OK\r\n"
+        << "Content-Type: text/plain; version=0.0.4\r\n"
+        << "Content-Length: " << body.size() << "\r\n\r\n" << body;
+  } else {
+    response << "HTTP/1.0 405 Method Not Allowed\r\n"
+        << "Content-Length: 0\r\n\r\n";
+  }
+  const string text = response.str();
+  size_t sent = 0;
+  while (sent < text.size()) {
+    const ssize_t n = send(client, text.data() + sent, text.size() - sent,
+        MSG_NOSIGNAL);
+    if (n <= 0) { break; }
+    sent += n;
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,92 @@
+#ifdef USE_PERF_EVENT
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+
+#include "caffe/util/perf_event.hpp"
+
+namespace caffe {
+
+#ifdef USE_PERF_EVENT
+namespace {
+
+int OpenCounter(uint64_t config, int group_fd) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = config;
+  attr.disabled = (group_fd < 0);
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+      PERF_FORMAT_TOTAL_TIME_RUNNING;
+  // The calling thread, on any CPU.
+  return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+}  // namespace
+#endif
+
+HardwareCounters::HardwareCounters() {
+  fds_[0] = fds_[1] = fds_[2] = -1;
+#ifdef USE_PERF_EVENT
+  const uint64_t configs[] = { PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES };
+  for (int i = 0; i < 3; ++i) {
+    fds_[i] = OpenCounter(configs[i], fds_[0]);
+    if (fds_[i] < 0) {
+      LOG(WARNING) << "Hardware counters are not available: "
+          << strerror(errno);
+      for (int j = 0; j < i; ++j) {
+        close(fds_[j]);
+        fds_[j] = -1;
+      }
+      break;
+    }
+  }
+#endif
+}
+
+HardwareCounters::~HardwareCounters() {
+#ifdef USE_PERF_EVENT
+  for (int i = 0; i < 3; ++i) {
+    if (fds_[i] >= 0) {
+      close(fds_[i]);
+    }
+  }
+#endif
+}
+
+void HardwareCounters::Start() {
+#ifdef USE_PERF_EVENT
+  if (!available()) { return; }
+  ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+HardwareCounters::Counts HardwareCounters::Stop() {
+  Counts counts = {0, 0, 0};
+#ifdef USE_PERF_EVENT
+  if (!available()) { return counts; }
+  ioctl(fds_[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  // The number of counters, the times enabled and running, then the values.
+  uint64_t data[6];
+  CHECK_EQ(read(fds_[0], data, sizeof(data)), sizeof(data));
+  CHECK_EQ(data[0], 3);
+  const double scale = data[2] > 0 ? static_cast<double>(data[1]) / data[2]
+      : 0;
+  counts.cycles = data[3] * scale;
+  counts.instructions = data[4] * scale;
+  counts.llc_misses = data[5] * scale;
+#endif
+  return counts;
+}
+
+}  // namespace caffe
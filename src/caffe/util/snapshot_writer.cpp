@@ -0,0 +1,96 @@
+#include <boost/thread.hpp>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "caffe/util/io.hpp"
+#include "caffe/util/snapshot_writer.hpp"
+
+namespace caffe {
+
+class SnapshotWriter::sync {
+ public:
+  mutable boost::mutex mutex_;
+  boost::condition_variable job_queued_;
+  boost::condition_variable job_done_;
+  shared_ptr<boost::thread> thread_;
+};
+
+SnapshotWriter::SnapshotWriter(int max_pending)
+    : max_pending_(max_pending), sync_(new sync()) {
+  CHECK_GE(max_pending_, 1) << "snapshot_max_pending must be positive.";
+  try {
+    sync_->thread_.reset(new boost::thread(&SnapshotWriter::entry, this));
+  } catch (std::exception& e) {
+    LOG(FATAL) << "Thread exception: " << e.what();
+  }
+}
+
+SnapshotWriter::~SnapshotWriter() {
+  Flush();
+  sync_->thread_->interrupt();
+  try {
+    sync_->thread_->join();
+  } catch (boost::thread_interrupted&) {
+  } catch (std::exception& e) {
+    LOG(FATAL) << "Thread exception: " << e.what();
+  }
+}
+
+void SnapshotWriter::Write(const vector<File>& files) {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (jobs_.size() >= max_pending_) {
+    LOG(INFO) << "Waiting for " << jobs_.size()
+              << " pending snapshot(s) to be written";
+    sync_->job_done_.wait(lock);
+  }
+  jobs_.push_back(files);
+  lock.unlock();
+  sync_->job_queued_.notify_one();
+}
+
+void SnapshotWriter::Flush() {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (!jobs_.empty()) {
+    sync_->job_done_.wait(lock);
+  }
+}
+
+int SnapshotWriter::pending() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return jobs_.size();
+}
+
+void SnapshotWriter::entry() {
+  try {
+    while (true) {
+      vector<File> files;
+      {
+        boost::mutex::scoped_lock lock(sync_->mutex_);
+        while (jobs_.empty()) {
+          sync_->job_queued_.wait(lock);
+        }
+        // Leave the job queued until it is on disk so Flush() and the
+        // max_pending_ bound account for the write in progress.
+        files = jobs_.front();
+      }
+      for (int i = 0; i < files.size(); ++i) {
+        const string& filename = files[i].second;
+        const string temp_filename = filename + ".tmp";
+        WriteProtoToBinaryFile(*files[i].first, temp_filename);
+        CHECK_EQ(std::rename(temp_filename.c_str(), filename.c_str()), 0)
+            << "Failed to rename " << temp_filename << " to " << filename;
+        LOG(INFO) << "Finished writing snapshot file " << filename;
+      }
+      {
+        boost::mutex::scoped_lock lock(sync_->mutex_);
+        jobs_.pop_front();
+      }
+      sync_->job_done_.notify_all();
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
+}
+
+}  // namespace caffe
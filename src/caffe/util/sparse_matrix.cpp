@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/util/sparse_matrix.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void SparseMatrix<Dtype>::FromDense(int rows, int cols, const Dtype* dense) {
+  rows_ = rows;
+  cols_ = cols;
+  int nnz = 0;
+  for (int i = 0; i < rows * cols; ++i) {
+    nnz += dense[i] != 0;
+  }
+  values_.resize(nnz);
+  col_index_.resize(nnz);
+  row_ptr_.resize(rows + 1);
+  int j = 0;
+  for (int r = 0; r < rows; ++r) {
+    row_ptr_[r] = j;
+    for (int c = 0; c < cols; ++c) {
+      if (dense[r * cols + c] != 0) {
+        values_[j] = dense[r * cols + c];
+        col_index_[j++] = c;
+      }
+    }
+  }
+  row_ptr_[rows] = j;
+}
+
+template <typename Dtype>
+void SparseMatrix<Dtype>::ToDense(Dtype* dense) const {
+  caffe_set(rows_ * cols_, Dtype(0), dense);
+  for (int r = 0; r < rows_; ++r) {
+    for (int j = row_ptr_[r]; j < row_ptr_[r + 1]; ++j) {
+      dense[r * cols_ + col_index_[j]] = values_[j];
+    }
+  }
+}
+
+template <typename Dtype>
+size_t SparseMatrix<Dtype>::bytes() const {
+  return values_.size() * sizeof(Dtype) +
+      (col_index_.size() + row_ptr_.size()) * sizeof(int);
+}
+
+template <typename Dtype>
+void SparseWeights<Dtype>::Init(float threshold, int groups) {
+  CHECK_GE(threshold, 0) << "The sparsity threshold must be non-negative.";
+  CHECK_GT(groups, 0);
+  threshold_ = threshold;
+  groups_ = groups;
+  sparse_ = false;
+  matrices_.clear();
+  memory_.reset();
+}
+
+template <typename Dtype>
+bool SparseWeights<Dtype>::Update(const Blob<Dtype>& weights) {
+  if (threshold_ == 0 || threshold_ > 1) { return false; }
+  const shared_ptr<SyncedMemory>& memory = weights.data();
+  if (memory_.lock() == memory && version_ == memory->version()) {
+    return sparse_;
+  }
+  const int count = weights.count();
+  // Weights read from a sparse BlobProto are released until they are read
+  // (see Blob::FromProto), and only restored into a buffer here, so that
+  // the sparse form alone stays in memory.
+  vector<Dtype> restored;
+  const Dtype* data;
+  if (memory->head() == SyncedMemory::UNINITIALIZED && memory->restore()) {
+    restored.resize(memory->size() / sizeof(Dtype));
+    memory->restore()(&restored[0]);
+    data = &restored[0];
+  } else {
+    data = weights.cpu_data();
+  }
+  int zeros = 0;
+  for (int i = 0; i < count; ++i) {
+    zeros += data[i] == 0;
+  }
+  sparsity_ = count ? static_cast<float>(zeros) / count : 0;
+  sparse_ = count && sparsity_ >= threshold_;
+  if (sparse_) {
+    const int rows = weights.shape(0);
+    const int cols = weights.count(1);
+    CHECK_EQ(rows % groups_, 0) << "The rows do not split into groups.";
+    const int group_rows = rows / groups_;
+    matrices_.resize(groups_);
+    for (int g = 0; g < groups_; ++g) {
+      matrices_[g].FromDense(group_rows, cols, data + g * group_rows * cols);
+    }
+  } else {
+    matrices_.clear();
+  }
+  memory_ = memory;
+  version_ = memory->version();
+  return sparse_;
+}
+
+template <typename Dtype>
+void caffe_cpu_csrmm(const SparseMatrix<Dtype>& A, const int N,
+    const Dtype alpha, const Dtype* B, const Dtype beta, Dtype* C) {
+  const Dtype* values = A.values();
+  const int* col_index = A.col_index();
+  const int* row_ptr = A.row_ptr();
+  for (int i = 0; i < A.rows(); ++i) {
+    Dtype* c = C + i * N;
+    if (beta == 0) {
+      caffe_set(N, Dtype(0), c);
+    } else if (beta != 1) {
+      caffe_scal(N, beta, c);
+    }
+    // Each nonzero adds a scaled row of B to the row of C.
+    for (int j = row_ptr[i]; j < row_ptr[i + 1]; ++j) {
+      const Dtype a = alpha * values[j];
+      const Dtype* b = B + col_index[j] * N;
+      for (int k = 0; k < N; ++k) {
+        c[k] += a * b[k];
+      }
+    }
+  }
+}
+
+template void caffe_cpu_csrmm<float>(const SparseMatrix<float>& A,
+    const int N, const float alpha, const float* B, const float beta,
+    float* C);
+template void caffe_cpu_csrmm<double>(const SparseMatrix<double>& A,
+    const int N, const double alpha, const double* B, const double beta,
+    double* C);
+
+template <typename Dtype>
+void caffe_cpu_gemm_csr(const CBLAS_TRANSPOSE TransB, const int M,
+    const Dtype alpha, const Dtype* A, const SparseMatrix<Dtype>& B,
+    const Dtype beta, Dtype* C) {
+  const Dtype* values = B.values();
+  const int* col_index = B.col_index();
+  const int* row_ptr = B.row_ptr();
+  if (TransB == CblasTrans) {
+    // Each output is the dot of a row of A with a sparse row of B.
+    const int N = B.rows();
+    const int K = B.cols();
+    for (int m = 0; m < M; ++m) {
+      const Dtype* a = A + m * K;
+      Dtype* c = C + m * N;
+      for (int n = 0; n < N; ++n) {
+        Dtype sum = 0;
+        for (int j = row_ptr[n]; j < row_ptr[n + 1]; ++j) {
+          sum += values[j] * a[col_index[j]];
+        }
+        c[n] = alpha * sum + (beta == 0 ? Dtype(0) : beta * c[n]);
+      }
+    }
+    return;
+  }
+  // Each element of A scatters a sparse row of B into the row of C.
+  const int K = B.rows();
+  const int N = B.cols();
+  for (int m = 0; m < M; ++m) {
+    Dtype* c = C + m * N;
+    if (beta == 0) {
+      caffe_set(N, Dtype(0), c);
+    } else if (beta != 1) {
+      caffe_scal(N, beta, c);
+    }
+    for (int k = 0; k < K; ++k) {
+      const Dtype a = alpha * A[m * K + k];
+      if (a == 0) { continue; }
+      for (int j = row_ptr[k]; j < row_ptr[k + 1]; ++j) {
+        c[col_index[j]] += a * values[j];
+      }
+    }
+  }
+}
+
+template void caffe_cpu_gemm_csr<float>(const CBLAS_TRANSPOSE TransB,
+    const int M, const float alpha, const float* A,
+    const SparseMatrix<float>& B, const float beta, float* C);
+template void caffe_cpu_gemm_csr<double>(const CBLAS_TRANSPOSE TransB,
+    const int M, const double alpha, const double* A,
+    const SparseMatrix<double>& B, const double beta, double* C);
+
+template <typename Dtype>
+int caffe_prune_by_magnitude(const int n, const float sparsity, Dtype* x) {
+  CHECK_GE(sparsity, 0);
+  CHECK_LE(sparsity, 1);
+  const int num_pruned = static_cast<int>(sparsity * n);
+  if (num_pruned > 0) {
+    vector<Dtype> magnitude(n);
+    for (int i = 0; i < n; ++i) {
+      magnitude[i] = std::fabs(x[i]);
+    }
+    std::nth_element(magnitude.begin(), magnitude.begin() + num_pruned - 1,
+        magnitude.end());
+    const Dtype threshold = magnitude[num_pruned - 1];
+    // Prune below the threshold, then as many at it as remain, in order.
+    int pruned = 0;
+    for (int i = 0; i < n; ++i) {
+      if (std::fabs(x[i]) < threshold) {
+        x[i] = 0;
+        ++pruned;
+      }
+    }
+    for (int i = 0; i < n && pruned < num_pruned; ++i) {
+      if (std::fabs(x[i]) == threshold) {
+        x[i] = 0;
+        ++pruned;
+      }
+    }
+  }
+  int zeros = 0;
+  for (int i = 0; i < n; ++i) {
+    zeros += x[i] == 0;
+  }
+  return zeros;
+}
+
+template int caffe_prune_by_magnitude<float>(const int n,
+    const float sparsity, float* x);
+template int caffe_prune_by_magnitude<double>(const int n,
+    const float sparsity, double* x);
+
+void SparsifyBlobProto(BlobProto* proto) {
+  if (proto->sparse_index_size() > 0) { return; }
+  const bool double_data = proto->double_data_size() > 0;
+  const int count = double_data ? proto->double_data_size() :
+      proto->data_size();
+  int nnz = 0;
+  for (int i = 0; i < count; ++i) {
+    nnz += (double_data ? proto->double_data(i) : proto->data(i)) != 0;
+  }
+  // An index takes 4 bytes; an all-zero blob keeps its first value, as an
+  // empty sparse_index means a dense blob.
+  const int value_bytes = double_data ? 8 : 4;
+  if (count == 0 || (value_bytes + 4) * nnz >= value_bytes * count) {
+    return;
+  }
+  int j = 0;
+  for (int i = 0; i < count; ++i) {
+    const double value = double_data ? proto->double_data(i) :
+        proto->data(i);
+    if (value == 0 && (nnz > 0 || i > 0)) { continue; }
+    if (double_data) {
+      proto->set_double_data(j++, value);
+    } else {
+      proto->set_data(j++, value);
+    }
+    proto->add_sparse_index(i);
+  }
+  if (double_data) {
+    proto->mutable_double_data()->Truncate(j);
+  } else {
+    proto->mutable_data()->Truncate(j);
+  }
+}
+
+INSTANTIATE_CLASS(SparseMatrix);
+INSTANTIATE_CLASS(SparseWeights);
+
+}  // namespace caffe
@@ -6,13 +6,23 @@ namespace bp = boost::python;
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
 #include <map>
 #include <string>
 #include <vector>
 
 #include "boost/algorithm/string.hpp"
+#include "boost/bind.hpp"
+#include "boost/thread.hpp"
 #include "caffe/caffe.hpp"
+#include "caffe/util/memory_tracker.hpp"
+#include "caffe/util/metrics.hpp"
 #include "caffe/util/signal_handler.h"
 
 using caffe::Blob;
@@ -48,12 +58,51 @@ DEFINE_string(weights, "",
     "separated by ','. Cannot be set simultaneously with snapshot.");
 DEFINE_int32(iterations, 50,
     "The number of iterations to run.");
+DEFINE_string(profile_trace, "",
+    "Optional; for 'time', profile the net and write the layers as a Chrome "
+    "trace (chrome://tracing) to this file.");
+DEFINE_string(profile_csv, "",
+    "Optional; for 'time', profile the net and write the time, FLOPs and "
+    "bytes of each layer as CSV to this file.");
+DEFINE_double(peak_gflops, 0,
+    "Optional; the peak GFLOP/s of the machine, to report the profiled "
+    "layers against.");
+DEFINE_double(peak_bandwidth, 0,
+    "Optional; the peak DRAM bandwidth of the machine in GB/s. With "
+    "-peak_gflops, classifies the profiled layers as memory- or "
+    "compute-bound.");
+DEFINE_bool(memory_report, false,
+    "Optional; for 'time', track the memory of the net and report it by "
+    "layer and blob after the first pass.");
+DEFINE_bool(forward_only, false,
+    "Optional; for 'time', benchmark serving instead: run the TEST phase "
+    "forward only on concurrent streams and report latency percentiles "
+    "and throughput.");
+DEFINE_string(threads, "1",
+    "Optional; for 'time -forward_only', the numbers of concurrent streams "
+    "to run, separated by ','. A single stream is always run first, as the "
+    "baseline of the scaling efficiency.");
+DEFINE_string(time_json, "",
+    "Optional; for 'time', write the time of every iteration, the average "
+    "time of each layer and the peak resident memory as JSON to this file.");
 DEFINE_string(sigint_effect, "stop",
              "Optional; action to take when a SIGINT signal is received: "
               "snapshot, stop or none.");
 DEFINE_string(sighup_effect, "snapshot",
              "Optional; action to take when a SIGHUP signal is received: "
              "snapshot, stop or none.");
+DEFINE_int32(metrics_port, 0,
+    "Optional; for 'train', serve the training metrics in the Prometheus "
+    "text format over HTTP on this port.");
+DEFINE_string(metrics_address, "127.0.0.1",
+    "Optional; the IPv4 address to serve -metrics_port on: the loopback "
+    "interface by default, or 0.0.0.0 for all interfaces.");
+DEFINE_string(metrics_file, "",
+    "Optional; for 'train', write the training metrics in the Prometheus "
+    "text format to this file, e.g. for the textfile collector of "
+    "node_exporter.");
+DEFINE_double(metrics_interval, 10,
+    "Optional; the seconds between writes of -metrics_file.");
 
 // A simple registry for caffe commands.
 typedef int (*BrewFunction)();
@@ -236,6 +285,13 @@ int train() {
     solver->Restore(FLAGS_snapshot.c_str());
   }
 
+  shared_ptr<caffe::MetricsExporter> metrics_exporter;
+  if (FLAGS_metrics_port > 0 || FLAGS_metrics_file.size()) {
+    metrics_exporter.reset(new caffe::MetricsExporter(
+        FLAGS_metrics_port > 0 ? FLAGS_metrics_port : -1, FLAGS_metrics_file,
+        FLAGS_metrics_interval, FLAGS_metrics_address));
+  }
+
   LOG(INFO) << "Starting Optimization";
   if (gpus.size() > 1) {
 #ifdef USE_NCCL
@@ -326,6 +382,113 @@ int test() {
 RegisterBrewFunction(test);
 
 
+// The peak resident memory of the process, in KB.
+static long max_rss_kb() {  // NOLINT(runtime/int)
+  struct rusage usage;
+  CHECK_EQ(getrusage(RUSAGE_SELF, &usage), 0);
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;  // in bytes on OS X
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+// Fill the input blobs of a net with synthetic data.
+static void fill_inputs(const vector<Blob<float>*>& inputs) {
+  caffe::FillerParameter filler_param;
+  caffe::GaussianFiller<float> filler(filler_param);
+  for (int i = 0; i < inputs.size(); ++i) {
+    filler.Fill(inputs[i]);
+  }
+}
+
+// Run one stream of forward passes on its own context of the engine,
+// recording the latency of each pass in ms.
+static void serve_stream(const caffe::InferenceEngine<float>* engine,
+    boost::barrier* barrier, std::vector<double>* latencies) {
+  shared_ptr<caffe::InferenceEngine<float>::Context> context =
+      engine->CreateContext();
+  fill_inputs(context->input_blobs());
+  context->Forward();
+  barrier->wait();
+  Timer timer;
+  for (int j = 0; j < FLAGS_iterations; ++j) {
+    timer.Start();
+    context->Forward();
+    latencies->push_back(timer.MicroSeconds() / 1000);
+  }
+}
+
+// Time forward passes as a server would run them: the TEST phase on
+// concurrent streams sharing the weights, for each number of streams.
+int time_forward_only() {
+  CHECK(FLAGS_phase.empty() || FLAGS_phase == "TEST")
+      << "-forward_only runs the TEST phase; got -phase " << FLAGS_phase;
+  caffe::NetParameter param;
+  caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &param);
+  vector<string> stages = get_stages_from_flags();
+  for (int i = 0; i < stages.size(); ++i) {
+    param.mutable_state()->add_stage(stages[i]);
+  }
+  param.mutable_state()->set_level(FLAGS_level);
+  caffe::InferenceEngine<float> engine(param);
+  // The examples of a pass are the num of the input, or of the first top of
+  // a net reading its own data.
+  const Blob<float>* input = engine.net().input_blobs().size() ?
+      engine.net().input_blobs()[0] : engine.net().blobs()[0].get();
+  const int batch_size = input->num();
+  vector<string> thread_flags;
+  boost::split(thread_flags, FLAGS_threads, boost::is_any_of(","));
+  // The scaling efficiency is relative to a single stream, so that is
+  // measured first.
+  if (atoi(thread_flags[0].c_str()) != 1) {
+    thread_flags.insert(thread_flags.begin(), "1");
+  }
+  LOG(INFO) << "*** Benchmark begins ***";
+  double single_throughput = 0;
+  for (int t = 0; t < thread_flags.size(); ++t) {
+    const int threads = atoi(thread_flags[t].c_str());
+    CHECK_GT(threads, 0) << "Invalid number of threads " << thread_flags[t];
+    std::vector<std::vector<double> > latencies(threads);
+    // The streams start timing together with the wall clock.
+    boost::barrier barrier(threads + 1);
+    boost::thread_group streams;
+    for (int i = 0; i < threads; ++i) {
+      streams.create_thread(boost::bind(&serve_stream, &engine, &barrier,
+          &latencies[i]));
+    }
+    barrier.wait();
+    caffe::CPUTimer wall_timer;
+    wall_timer.Start();
+    streams.join_all();
+    const double seconds = wall_timer.MicroSeconds() / 1e6;
+    std::vector<double> all;
+    for (int i = 0; i < threads; ++i) {
+      all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+    }
+    std::sort(all.begin(), all.end());
+    const double throughput = batch_size * all.size() / seconds;
+    if (t == 0) {
+      single_throughput = throughput;
+    }
+    std::ostringstream percentiles;
+    const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    const char* names[] = {"p50", "p90", "p99", "p99.9"};
+    for (int q = 0; q < 4; ++q) {
+      // The nearest-rank percentile.
+      const int rank = std::max<int>(
+          static_cast<int>(std::ceil(quantiles[q] * all.size())) - 1, 0);
+      percentiles << names[q] << " " << all[rank] << " ms, ";
+    }
+    LOG(INFO) << threads << " streams: latency " << percentiles.str()
+        << "max " << all.back() << " ms; " << throughput
+        << " examples/s; scaling efficiency "
+        << 100 * throughput / (threads * single_throughput) << "%";
+  }
+  LOG(INFO) << "*** Benchmark ends ***";
+  return 0;
+}
+
 // Time: benchmark the execution time of a model.
 int time() {
   CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to time.";
@@ -343,19 +506,29 @@ int time() {
     LOG(INFO) << "Use CPU.";
     Caffe::set_mode(Caffe::CPU);
   }
+  if (FLAGS_forward_only) {
+    return time_forward_only();
+  }
+  if (FLAGS_memory_report) {
+    caffe::MemoryTracker::set_enabled(true);
+  }
   // Instantiate the caffe net.
   Net<float> caffe_net(FLAGS_model, phase, FLAGS_level, &stages);
 
   // Do a clean forward and backward pass, so that memory allocation are done
   // and future iterations will be more stable.
   LOG(INFO) << "Performing Forward";
-  // Note that for the speed benchmark, we will assume that the network does
-  // not take any input blobs.
+  // The input blobs, if any, hold synthetic data.
+  fill_inputs(caffe_net.input_blobs());
   float initial_loss;
   caffe_net.Forward(&initial_loss);
   LOG(INFO) << "Initial loss: " << initial_loss;
   LOG(INFO) << "Performing Backward";
   caffe_net.Backward();
+  if (FLAGS_memory_report) {
+    LOG(INFO) << caffe::MemoryReport<float>(caffe_net).Text();
+    caffe::MemoryTracker::set_enabled(false);
+  }
 
   const vector<shared_ptr<Layer<float> > >& layers = caffe_net.layers();
   const vector<vector<Blob<float>*> >& bottom_vecs = caffe_net.bottom_vecs();
@@ -373,6 +546,8 @@ int time() {
   std::vector<double> backward_time_per_layer(layers.size(), 0.0);
   double forward_time = 0.0;
   double backward_time = 0.0;
+  // The forward and backward times of each iteration, in ms.
+  std::vector<double> forward_iter_times, backward_iter_times;
   for (int j = 0; j < FLAGS_iterations; ++j) {
     Timer iter_timer;
     iter_timer.Start();
@@ -382,7 +557,8 @@ int time() {
       layers[i]->Forward(bottom_vecs[i], top_vecs[i]);
       forward_time_per_layer[i] += timer.MicroSeconds();
     }
-    forward_time += forward_timer.MicroSeconds();
+    forward_iter_times.push_back(forward_timer.MicroSeconds() / 1000);
+    forward_time += forward_iter_times.back() * 1000;
     backward_timer.Start();
     for (int i = layers.size() - 1; i >= 0; --i) {
       timer.Start();
@@ -390,7 +566,8 @@ int time() {
                           bottom_vecs[i]);
       backward_time_per_layer[i] += timer.MicroSeconds();
     }
-    backward_time += backward_timer.MicroSeconds();
+    backward_iter_times.push_back(backward_timer.MicroSeconds() / 1000);
+    backward_time += backward_iter_times.back() * 1000;
     LOG(INFO) << "Iteration: " << j + 1 << " forward-backward time: "
       << iter_timer.MilliSeconds() << " ms.";
   }
@@ -413,6 +590,54 @@ int time() {
     FLAGS_iterations << " ms.";
   LOG(INFO) << "Total Time: " << total_timer.MilliSeconds() << " ms.";
   LOG(INFO) << "*** Benchmark ends ***";
+  if (FLAGS_time_json.size()) {
+    std::ofstream out(FLAGS_time_json.c_str());
+    CHECK(out.is_open()) << "Failed to open " << FLAGS_time_json;
+    out << "{\"model\": \"" << FLAGS_model << "\", \"iterations\": "
+        << FLAGS_iterations << ", \"max_rss_kb\": " << max_rss_kb();
+    const std::vector<double>* iter_times[] =
+        { &forward_iter_times, &backward_iter_times };
+    const char* passes[] = { "forward_ms", "backward_ms" };
+    for (int p = 0; p < 2; ++p) {
+      out << ", \"" << passes[p] << "\": [";
+      for (int j = 0; j < iter_times[p]->size(); ++j) {
+        out << (j ? ", " : "") << (*iter_times[p])[j];
+      }
+      out << "]";
+    }
+    out << ", \"layers\": [";
+    for (int i = 0; i < layers.size(); ++i) {
+      out << (i ? ",\n" : "\n") << "{\"name\": \""
+          << layers[i]->layer_param().name() << "\", \"type\": \""
+          << layers[i]->type() << "\", \"forward_ms\": "
+          << forward_time_per_layer[i] / 1000 / FLAGS_iterations
+          << ", \"backward_ms\": "
+          << backward_time_per_layer[i] / 1000 / FLAGS_iterations << "}";
+    }
+    out << "]}\n";
+    LOG(INFO) << "Wrote the timings to " << FLAGS_time_json;
+  }
+  if (FLAGS_profile_trace.size() || FLAGS_profile_csv.size()) {
+    // Profile whole passes of the net, apart from the benchmark as the
+    // profiler synchronizes the device around each layer.
+    caffe::Profiler<float> profiler(&caffe_net);
+    profiler.set_peak_gflops(FLAGS_peak_gflops);
+    profiler.set_peak_bandwidth(FLAGS_peak_bandwidth);
+    LOG(INFO) << "Profiling for " << FLAGS_iterations << " iterations.";
+    for (int j = 0; j < FLAGS_iterations; ++j) {
+      caffe_net.Forward();
+      caffe_net.Backward();
+    }
+    profiler.LogSummary();
+    if (FLAGS_profile_trace.size()) {
+      profiler.WriteChromeTrace(FLAGS_profile_trace);
+      LOG(INFO) << "Wrote the trace to " << FLAGS_profile_trace;
+    }
+    if (FLAGS_profile_csv.size()) {
+      profiler.WriteCSV(FLAGS_profile_csv);
+      LOG(INFO) << "Wrote the layer profile to " << FLAGS_profile_csv;
+    }
+  }
   return 0;
 }
 RegisterBrewFunction(time);
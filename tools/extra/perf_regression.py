@@ -0,0 +1,297 @@
+#!/usr/bin/env python
+"""
+Check a build of Caffe for performance regressions on reference nets.
+
+Each reference net is timed on the CPU with `caffe time`, fed by DummyData
+layers instead of its data layers so that no dataset is needed. The median
+and 95th percentile of the forward-backward time and the peak resident
+memory are compared against a JSON baseline, which also records the mean
+and variance, and the script exits with status 1 if any of them got worse by
+more than the threshold.
+
+    # record a baseline with the reference build
+    perf_regression.py --update baseline.json
+    # check another build against it
+    perf_regression.py --caffe /path/to/build/tools/caffe baseline.json
+
+Baselines only compare on the machine, and BLAS, they were recorded with.
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+from google.protobuf import text_format
+
+from caffe import layers as L, params as P, to_proto
+from caffe.proto import caffe_pb2
+
+CAFFE_ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                          '..', '..')
+DATA_TYPES = ['Data', 'ImageData', 'HDF5Data', 'WindowData', 'MemoryData',
+              'Input']
+
+
+def dummy_data_net(path, shape):
+    """Read the net at path, replacing its data layers by DummyData layers
+    that output data of the given shape, batch first, and zero labels."""
+    net = caffe_pb2.NetParameter()
+    with open(path) as f:
+        text_format.Merge(f.read(), net)
+    for layer in net.layer:
+        if layer.type not in DATA_TYPES:
+            continue
+        tops = list(layer.top)
+        include = [rule for rule in layer.include]
+        layer.Clear()
+        layer.name, layer.type = tops[0], 'DummyData'
+        layer.top.extend(tops)
+        layer.include.extend(include)
+        param = layer.dummy_data_param
+        param.shape.add().dim.extend(shape)
+        for _ in tops[1:]:
+            param.shape.add().dim.extend(shape[:1])
+        param.data_filler.add(type='gaussian', std=1)
+        for _ in tops[1:]:
+            param.data_filler.add(type='constant')
+    return net
+
+
+def dummy_data(shape):
+    return L.DummyData(shape=[dict(dim=shape), dict(dim=shape[:1])],
+                       data_filler=[dict(type='gaussian', std=1),
+                                    dict(type='constant')], ntop=2)
+
+
+def conv(bottom, nout, ks, stride=1, pad=0, group=1, relu=True, bn=False):
+    layer = L.Convolution(bottom, kernel_size=ks, stride=stride,
+                          num_output=nout, pad=pad, group=group,
+                          bias_term=not bn,
+                          weight_filler=dict(type='msra'))
+    if bn:
+        layer = L.BatchNorm(layer, in_place=True)
+        layer = L.Scale(layer, bias_term=True, in_place=True)
+    return L.ReLU(layer, in_place=True) if relu else layer
+
+
+def max_pool(bottom, ks, stride=1, pad=0):
+    return L.Pooling(bottom, pool=P.Pooling.MAX, kernel_size=ks,
+                     stride=stride, pad=pad)
+
+
+def classifier(bottom, label, nout=1000):
+    fc = L.InnerProduct(bottom, num_output=nout,
+                        weight_filler=dict(type='xavier'))
+    return to_proto(L.SoftmaxWithLoss(fc, label))
+
+
+def caffenet(batch_size):
+    data, label = dummy_data([batch_size, 3, 227, 227])
+    x = max_pool(conv(data, 96, 11, stride=4), 3, stride=2)
+    x = L.LRN(x, local_size=5, alpha=1e-4, beta=0.75)
+    x = max_pool(conv(x, 256, 5, pad=2, group=2), 3, stride=2)
+    x = L.LRN(x, local_size=5, alpha=1e-4, beta=0.75)
+    x = conv(x, 384, 3, pad=1)
+    x = conv(x, 384, 3, pad=1, group=2)
+    x = max_pool(conv(x, 256, 3, pad=1, group=2), 3, stride=2)
+    for _ in range(2):
+        x = L.InnerProduct(x, num_output=4096,
+                           weight_filler=dict(type='xavier'))
+        x = L.Dropout(L.ReLU(x, in_place=True), in_place=True)
+    return classifier(x, label)
+
+
+def inception(bottom, n1, n3r, n3, n5r, n5, npool):
+    branches = [conv(bottom, n1, 1),
+                conv(conv(bottom, n3r, 1), n3, 3, pad=1),
+                conv(conv(bottom, n5r, 1), n5, 5, pad=2),
+                conv(max_pool(bottom, 3, pad=1), npool, 1)]
+    return L.Concat(*branches)
+
+
+def googlenet(batch_size):
+    """GoogLeNet without its auxiliary classifiers."""
+    data, label = dummy_data([batch_size, 3, 224, 224])
+    x = max_pool(conv(data, 64, 7, stride=2, pad=3), 3, stride=2)
+    x = L.LRN(x, local_size=5, alpha=1e-4, beta=0.75)
+    x = conv(conv(x, 64, 1), 192, 3, pad=1)
+    x = L.LRN(x, local_size=5, alpha=1e-4, beta=0.75)
+    x = max_pool(x, 3, stride=2)
+    x = inception(x, 64, 96, 128, 16, 32, 32)
+    x = inception(x, 128, 128, 192, 32, 96, 64)
+    x = max_pool(x, 3, stride=2)
+    for config in [(192, 96, 208, 16, 48, 64), (160, 112, 224, 24, 64, 64),
+                   (128, 128, 256, 24, 64, 64), (112, 144, 288, 32, 64, 64),
+                   (256, 160, 320, 32, 128, 128)]:
+        x = inception(x, *config)
+    x = max_pool(x, 3, stride=2)
+    x = inception(x, 256, 160, 320, 32, 128, 128)
+    x = inception(x, 384, 192, 384, 48, 128, 128)
+    x = L.Pooling(x, pool=P.Pooling.AVE, global_pooling=True)
+    return classifier(L.Dropout(x, dropout_ratio=0.4, in_place=True), label)
+
+
+def resnet18(batch_size):
+    """ResNet-18, with batch normalization followed by Scale layers."""
+    data, label = dummy_data([batch_size, 3, 224, 224])
+    x = max_pool(conv(data, 64, 7, stride=2, pad=3, bn=True), 3, stride=2)
+    nin = 64
+    for stage, nout in enumerate([64, 128, 256, 512]):
+        for block in range(2):
+            stride = 2 if stage > 0 and block == 0 else 1
+            y = conv(x, nout, 3, stride=stride, pad=1, bn=True)
+            y = conv(y, nout, 3, pad=1, relu=False, bn=True)
+            if stride != 1 or nin != nout:
+                x = conv(x, nout, 1, stride=stride, relu=False, bn=True)
+            x = L.ReLU(L.Eltwise(x, y), in_place=True)
+            nin = nout
+    x = L.Pooling(x, pool=P.Pooling.AVE, global_pooling=True)
+    return classifier(x, label)
+
+
+def reference_nets(batch_size):
+    """The reference nets by name. The nets of the examples keep their own
+    batch sizes, and the ImageNet nets take batch_size."""
+    examples = os.path.join(CAFFE_ROOT, 'examples')
+    return [
+        ('lenet', dummy_data_net(
+            os.path.join(examples, 'mnist', 'lenet_train_test.prototxt'),
+            [64, 1, 28, 28])),
+        ('cifar10_full', dummy_data_net(
+            os.path.join(examples, 'cifar10',
+                         'cifar10_full_train_test.prototxt'),
+            [100, 3, 32, 32])),
+        ('caffenet', caffenet(batch_size)),
+        ('googlenet', googlenet(batch_size)),
+        ('resnet18', resnet18(batch_size)),
+    ]
+
+
+def percentile(values, q):
+    values = sorted(values)
+    index = q / 100.0 * (len(values) - 1)
+    lower = int(index)
+    upper = min(lower + 1, len(values) - 1)
+    return values[lower] + (values[upper] - values[lower]) * (index - lower)
+
+
+def statistics(timings):
+    """The statistics of the forward-backward times of a `caffe time` run."""
+    times = [f + b for f, b in zip(timings['forward_ms'],
+                                   timings['backward_ms'])]
+    mean = sum(times) / len(times)
+    return {
+        'median_ms': percentile(times, 50),
+        'p95_ms': percentile(times, 95),
+        'mean_ms': mean,
+        'variance_ms2': sum((t - mean) ** 2 for t in times) / len(times),
+        'max_rss_kb': timings['max_rss_kb'],
+    }
+
+
+def time_net(caffe, name, net, iterations, workdir):
+    model = os.path.join(workdir, name + '.prototxt')
+    output = os.path.join(workdir, name + '.json')
+    with open(model, 'w') as f:
+        f.write(str(net))
+    # Run each net in its own process so that its peak memory is its own.
+    with open(os.devnull, 'w') as devnull:
+        subprocess.check_call([caffe, 'time', '--model=' + model,
+                               '--iterations=%d' % iterations,
+                               '--time_json=' + output],
+                              stdout=devnull, stderr=devnull)
+    with open(output) as f:
+        return statistics(json.load(f))
+
+
+def compare(name, current, baseline, threshold):
+    """Print the statistics of a net against its baseline and return the
+    names of those that regressed."""
+    regressions = []
+    for key in ['median_ms', 'p95_ms', 'max_rss_kb']:
+        base = baseline.get(key)
+        change = (current[key] / base - 1) if base else 0
+        regressed = change > threshold
+        if regressed:
+            regressions.append('%s %s' % (name, key))
+        print('  %-12s %12.2f %12.2f %+8.1f%%%s' % (
+            key, base or 0, current[key], 100 * change,
+            '  REGRESSION' if regressed else ''))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Time reference nets on the CPU and compare them '
+                    'against a baseline.')
+    parser.add_argument('baseline', help='The JSON baseline file.')
+    parser.add_argument('--caffe',
+                        default=os.path.join(CAFFE_ROOT, 'build', 'tools',
+                                             'caffe'),
+                        help='The caffe binary to time the nets with.')
+    parser.add_argument('--update', action='store_true',
+                        help='Record the timings as the new baseline '
+                             'instead of comparing.')
+    parser.add_argument('--threshold', type=float, default=0.1,
+                        help='The relative increase of a statistic that '
+                             'counts as a regression.')
+    parser.add_argument('--iterations', type=int, default=20,
+                        help='The number of timed iterations of each net.')
+    parser.add_argument('--batch_size', type=int, default=8,
+                        help='The batch size of the ImageNet nets.')
+    parser.add_argument('--nets', default='',
+                        help='Time only these nets, separated by commas.')
+    args = parser.parse_args()
+
+    nets = reference_nets(args.batch_size)
+    if args.nets:
+        selected = args.nets.split(',')
+        unknown = set(selected) - set(name for name, _ in nets)
+        if unknown:
+            parser.error('unknown nets: ' + ', '.join(sorted(unknown)))
+        nets = [(name, net) for name, net in nets if name in selected]
+    baseline = {}
+    if not args.update:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+        if baseline.get('iterations') != args.iterations:
+            print('Warning: the baseline was recorded with %s iterations.' %
+                  baseline.get('iterations'))
+
+    workdir = tempfile.mkdtemp()
+    results = {'iterations': args.iterations, 'batch_size': args.batch_size,
+               'nets': {}}
+    regressions = []
+    for name, net in nets:
+        current = time_net(args.caffe, name, net, args.iterations, workdir)
+        results['nets'][name] = current
+        print('%s:' % name)
+        if args.update:
+            for key in sorted(current):
+                print('  %-12s %12.2f' % (key, current[key]))
+        elif name not in baseline['nets']:
+            print('  not in the baseline')
+        else:
+            regressions += compare(name, current, baseline['nets'][name],
+                                   args.threshold)
+
+    if args.update:
+        with open(args.baseline, 'w') as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+        print('Wrote the baseline to %s' % args.baseline)
+        return 0
+    if regressions:
+        print('Regressions beyond %.0f%%: %s' % (
+            100 * args.threshold, ', '.join(regressions)))
+        return 1
+    print('No regressions beyond %.0f%%.' % (100 * args.threshold))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
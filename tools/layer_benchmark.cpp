@@ -0,0 +1,317 @@
+// Benchmarks the forward and backward passes of single layers over a suite of
+// representative shapes, engines and thread counts, and writes the results
+// as JSON for tracking kernel performance across builds.
+// Usage:
+//    layer_benchmark [FLAGS]
+// Run with --list to see the cases; --filter selects those whose name or
+// layer type contains the given text.
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "boost/bind.hpp"
+#include "boost/thread.hpp"
+#include "google/protobuf/text_format.h"
+
+#include "caffe/caffe.hpp"
+
+using caffe::Blob;
+using caffe::Caffe;
+using caffe::Layer;
+using caffe::LayerParameter;
+using caffe::LayerRegistry;
+using caffe::Profiler;
+using caffe::shared_ptr;
+using caffe::string;
+using caffe::Timer;
+using caffe::vector;
+
+DEFINE_int32(gpu, -1,
+    "Optional; run in GPU mode on the given device ID.");
+DEFINE_int32(iterations, 20,
+    "The number of timed iterations of each pass.");
+DEFINE_int32(warmup, 3,
+    "The number of untimed iterations before timing.");
+DEFINE_string(threads, "1",
+    "The numbers of threads to run each case on, separated by ','. Each "
+    "thread runs its own instance of the layer.");
+DEFINE_string(engines, "",
+    "Optional; the engines to run layers that have them on, separated by "
+    "','. Defaults to CAFFE, and CUDNN too in GPU mode when built with it.");
+DEFINE_string(filter, "",
+    "Optional; run only the cases whose name or layer type contains this.");
+DEFINE_string(output, "",
+    "Optional; write the results as JSON to this file.");
+DEFINE_bool(list, false,
+    "List the cases and exit.");
+
+// The name of each case, its layer and the shapes of its bottoms, separated
+// by ';'. The names give the geometry of the nets the shapes come from.
+static const char* kCases[][3] = {
+  {"conv3x3_64x56", "type: 'Convolution' convolution_param { num_output: 64 "
+      "kernel_size: 3 pad: 1 }", "8,64,56,56"},
+  {"conv1x1_256x14", "type: 'Convolution' convolution_param { "
+      "num_output: 256 kernel_size: 1 }", "8,256,14,14"},
+  {"conv11x11_s4", "type: 'Convolution' convolution_param { num_output: 96 "
+      "kernel_size: 11 stride: 4 }", "8,3,227,227"},
+  {"conv3x3_g2", "type: 'Convolution' convolution_param { num_output: 256 "
+      "kernel_size: 3 pad: 1 group: 2 }", "8,256,13,13"},
+  {"ip4096x4096", "type: 'InnerProduct' inner_product_param { "
+      "num_output: 4096 }", "64,4096"},
+  {"ip4096x1000_b1", "type: 'InnerProduct' inner_product_param { "
+      "num_output: 1000 }", "1,4096"},
+  {"ip800x500", "type: 'InnerProduct' inner_product_param { "
+      "num_output: 500 }", "64,50,4,4"},
+  {"pool_max3x3_s2", "type: 'Pooling' pooling_param { pool: MAX "
+      "kernel_size: 3 stride: 2 }", "8,96,55,55"},
+  {"pool_max2x2_s2", "type: 'Pooling' pooling_param { pool: MAX "
+      "kernel_size: 2 stride: 2 }", "8,64,112,112"},
+  {"pool_ave_global", "type: 'Pooling' pooling_param { pool: AVE "
+      "global_pooling: true }", "8,2048,7,7"},
+  {"lrn_across5", "type: 'LRN' lrn_param { local_size: 5 }", "8,96,55,55"},
+  {"lrn_within3", "type: 'LRN' lrn_param { local_size: 3 "
+      "norm_region: WITHIN_CHANNEL }", "8,32,32,32"},
+  {"softmax1000", "type: 'Softmax' softmax_param { }", "64,1000"},
+  {"softmax32k", "type: 'Softmax' softmax_param { }", "64,32000"},
+  {"softmax_spatial21", "type: 'Softmax' softmax_param { }", "8,21,64,64"},
+  {"batchnorm64x56", "type: 'BatchNorm'", "8,64,56,56"},
+  {"scale64x56", "type: 'Scale' scale_param { bias_term: true }",
+      "8,64,56,56"},
+  {"eltwise_sum", "type: 'Eltwise' eltwise_param { operation: SUM }",
+      "8,256,56,56;8,256,56,56"},
+  {"eltwise_prod", "type: 'Eltwise' eltwise_param { operation: PROD }",
+      "8,256,56,56;8,256,56,56"},
+  {"relu", "type: 'ReLU' relu_param { }", "8,64,112,112"},
+  {"prelu", "type: 'PReLU'", "8,64,112,112"},
+  {"elu", "type: 'ELU'", "8,64,112,112"},
+  {"sigmoid", "type: 'Sigmoid' sigmoid_param { }", "8,64,112,112"},
+  {"tanh", "type: 'TanH' tanh_param { }", "8,64,112,112"},
+  {"dropout", "type: 'Dropout'", "8,4096"},
+};
+
+// Sets the engine of the layers that have several, returning false for the
+// others.
+template <typename Param>
+void SetEngineOf(const string& name, Param* param) {
+  typename Param::Engine engine;
+  CHECK(Param::Engine_Parse(name, &engine)) << "Unknown engine " << name;
+  param->set_engine(engine);
+}
+
+bool SetEngine(const string& name, LayerParameter* param) {
+  const string& type = param->type();
+  if (type == "Convolution") {
+    SetEngineOf(name, param->mutable_convolution_param());
+  } else if (type == "Pooling") {
+    SetEngineOf(name, param->mutable_pooling_param());
+  } else if (type == "LRN") {
+    SetEngineOf(name, param->mutable_lrn_param());
+  } else if (type == "ReLU") {
+    SetEngineOf(name, param->mutable_relu_param());
+  } else if (type == "Sigmoid") {
+    SetEngineOf(name, param->mutable_sigmoid_param());
+  } else if (type == "Softmax") {
+    SetEngineOf(name, param->mutable_softmax_param());
+  } else if (type == "TanH") {
+    SetEngineOf(name, param->mutable_tanh_param());
+  } else {
+    return false;
+  }
+  return true;
+}
+
+vector<int> ParseInts(const string& text) {
+  vector<string> fields;
+  boost::split(fields, text, boost::is_any_of(","));
+  vector<int> values;
+  for (int i = 0; i < fields.size(); ++i) {
+    values.push_back(atoi(fields[i].c_str()));
+  }
+  return values;
+}
+
+struct Result {
+  double forward_ms, backward_ms;
+};
+
+// Runs an instance of the layer on one thread, timing its passes between the
+// barriers shared by all threads of the case.
+void RunLayer(const LayerParameter& param, const vector<vector<int> >& shapes,
+    boost::barrier* barrier, double* flops, Result* result) {
+  if (FLAGS_gpu >= 0) {
+    Caffe::SetDevice(FLAGS_gpu);
+    Caffe::set_mode(Caffe::GPU);
+  } else {
+    Caffe::set_mode(Caffe::CPU);
+  }
+  shared_ptr<Layer<float> > layer = LayerRegistry<float>::CreateLayer(param);
+  vector<shared_ptr<Blob<float> > > blobs;
+  vector<Blob<float>*> bottom, top;
+  caffe::FillerParameter filler_param;
+  filler_param.set_std(0.1);
+  caffe::GaussianFiller<float> filler(filler_param);
+  for (int i = 0; i < shapes.size(); ++i) {
+    blobs.push_back(shared_ptr<Blob<float> >(new Blob<float>(shapes[i])));
+    filler.Fill(blobs.back().get());
+    bottom.push_back(blobs.back().get());
+  }
+  blobs.push_back(shared_ptr<Blob<float> >(new Blob<float>()));
+  top.push_back(blobs.back().get());
+  layer->SetUp(bottom, top);
+  for (int i = 0; i < layer->blobs().size(); ++i) {
+    filler.Fill(layer->blobs()[i].get());
+  }
+  const vector<bool> propagate_down(bottom.size(), true);
+  layer->Forward(bottom, top);
+  filler.Fill(top[0]);
+  caffe::caffe_copy(top[0]->count(), top[0]->cpu_data(),
+      top[0]->mutable_cpu_diff());
+  *flops = Profiler<float>::ForwardFlops(*layer, bottom, top);
+  for (int i = 0; i < FLAGS_warmup; ++i) {
+    layer->Forward(bottom, top);
+    layer->Backward(top, propagate_down, bottom);
+  }
+  Timer timer;
+  barrier->wait();
+  timer.Start();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    layer->Forward(bottom, top);
+  }
+  result->forward_ms = timer.MicroSeconds() / 1000 / FLAGS_iterations;
+  barrier->wait();
+  timer.Start();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    layer->Backward(top, propagate_down, bottom);
+  }
+  result->backward_ms = timer.MicroSeconds() / 1000 / FLAGS_iterations;
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Benchmark the passes of single layers over a "
+        "suite of shapes, engines and thread counts.\n"
+        "Usage:\n"
+        "    layer_benchmark [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  if (argc != 1) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/layer_benchmark");
+    return 1;
+  }
+  CHECK_GT(FLAGS_iterations, 0);
+
+  vector<string> engines;
+  if (FLAGS_engines.size()) {
+    boost::split(engines, FLAGS_engines, boost::is_any_of(","));
+  } else {
+    engines.push_back("CAFFE");
+#ifdef USE_CUDNN
+    if (FLAGS_gpu >= 0) {
+      engines.push_back("CUDNN");
+    }
+#endif
+  }
+  const vector<int> thread_counts = ParseInts(FLAGS_threads);
+  const vector<string> types = LayerRegistry<float>::LayerTypeList();
+
+  std::ostringstream json;
+  json << "{\"mode\": \"" << (FLAGS_gpu >= 0 ? "GPU" : "CPU")
+      << "\", \"iterations\": " << FLAGS_iterations << ", \"results\": [";
+  int results = 0;
+  for (int c = 0; c < sizeof(kCases) / sizeof(kCases[0]); ++c) {
+    const string name = kCases[c][0];
+    LayerParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(kCases[c][1],
+        &param)) << "Bad layer of case " << name;
+    param.set_name(name);
+    param.set_phase(caffe::TRAIN);
+    if (FLAGS_filter.size() && name.find(FLAGS_filter) == string::npos &&
+        param.type().find(FLAGS_filter) == string::npos) {
+      continue;
+    }
+    if (FLAGS_list) {
+      LOG(INFO) << name << "\t" << param.type() << "\t" << kCases[c][2];
+      continue;
+    }
+    if (std::find(types.begin(), types.end(), param.type()) == types.end()) {
+      LOG(WARNING) << "Skipping " << name << ": layer type " << param.type()
+          << " is not registered.";
+      continue;
+    }
+    vector<string> shape_texts;
+    boost::split(shape_texts, kCases[c][2], boost::is_any_of(";"));
+    vector<vector<int> > shapes;
+    for (int i = 0; i < shape_texts.size(); ++i) {
+      shapes.push_back(ParseInts(shape_texts[i]));
+    }
+    for (int e = 0; e < engines.size(); ++e) {
+      const bool has_engine = SetEngine(engines[e], &param);
+      if (!has_engine && e > 0) {
+        // The layer has a single implementation, run once.
+        break;
+      }
+      const string engine = has_engine ? engines[e] : string("-");
+      for (int t = 0; t < thread_counts.size(); ++t) {
+        const int threads = thread_counts[t];
+        CHECK_GT(threads, 0);
+        boost::barrier barrier(threads);
+        vector<double> flops(threads);
+        vector<Result> result(threads);
+        boost::thread_group group;
+        for (int i = 0; i < threads; ++i) {
+          group.create_thread(boost::bind(&RunLayer, boost::cref(param),
+              boost::cref(shapes), &barrier, &flops[i], &result[i]));
+        }
+        group.join_all();
+        // The threads ran their passes together; report the mean time of a
+        // pass and the throughput of all threads.
+        double forward_ms = 0, backward_ms = 0;
+        for (int i = 0; i < threads; ++i) {
+          forward_ms += result[i].forward_ms / threads;
+          backward_ms += result[i].backward_ms / threads;
+        }
+        const double forward_gflops = forward_ms > 0 ?
+            flops[0] * threads / forward_ms / 1e6 : 0;
+        const double backward_gflops = backward_ms > 0 ?
+            2 * flops[0] * threads / backward_ms / 1e6 : 0;
+        const double examples_per_s = forward_ms > 0 ?
+            shapes[0][0] * threads / forward_ms * 1e3 : 0;
+        LOG(INFO) << name << " (" << param.type() << ", " << engine << ", "
+            << threads << " threads): forward " << forward_ms << " ms, "
+            << forward_gflops << " GFLOP/s; backward " << backward_ms
+            << " ms, " << backward_gflops << " GFLOP/s; "
+            << examples_per_s << " examples/s";
+        json << (results++ ? ",\n" : "\n") << "{\"name\": \"" << name
+            << "\", \"type\": \"" << param.type() << "\", \"engine\": \""
+            << engine << "\", \"threads\": " << threads << ", \"bottom\": \""
+            << kCases[c][2] << "\", \"forward_ms\": " << forward_ms
+            << ", \"backward_ms\": " << backward_ms
+            << ", \"forward_gflops\": " << forward_gflops
+            << ", \"backward_gflops\": " << backward_gflops
+            << ", \"examples_per_s\": " << examples_per_s << "}";
+      }
+    }
+  }
+  json << "\n]}\n";
+  if (FLAGS_output.size()) {
+    std::ofstream out(FLAGS_output.c_str());
+    CHECK(out.is_open()) << "Failed to open " << FLAGS_output;
+    out << json.str();
+    LOG(INFO) << "Wrote " << results << " results to " << FLAGS_output;
+  }
+  return 0;
+}
@@ -0,0 +1,110 @@
+// Prunes the weights of a trained net by magnitude: in each InnerProduct and
+// Convolution layer, the given fraction of the weights smallest in magnitude
+// are zeroed, and the net is written with its blobs stored sparsely. Such
+// nets load as usual, and the layers whose sparse_threshold is set multiply
+// by the weights in compressed sparse row form on the CPU in the TEST phase.
+// Usage:
+//    prune_net [FLAGS] INPUT_CAFFEMODEL OUTPUT_CAFFEMODEL
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/io.hpp"
+#include "caffe/util/sparse_matrix.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using caffe::BlobProto;
+using caffe::LayerParameter;
+using caffe::NetParameter;
+using caffe::string;
+using caffe::vector;
+
+DEFINE_double(sparsity, 0.9,
+    "The fraction of the weights of each pruned layer to zero.");
+DEFINE_string(layers, "",
+    "Optional; the names of the layers to prune, separated by ','. "
+    "Defaults to every InnerProduct and Convolution layer.");
+DEFINE_bool(sparse_storage, true,
+    "Store the blobs of the output sparsely where that is smaller.");
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Prune the weights of a trained net by "
+        "magnitude.\n"
+        "Usage:\n"
+        "    prune_net [FLAGS] INPUT_CAFFEMODEL OUTPUT_CAFFEMODEL\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  if (argc != 3) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/prune_net");
+    return 1;
+  }
+  CHECK_GE(FLAGS_sparsity, 0);
+  CHECK_LE(FLAGS_sparsity, 1);
+  std::set<string> names;
+  if (FLAGS_layers.size()) {
+    vector<string> layers;
+    boost::split(layers, FLAGS_layers, boost::is_any_of(","));
+    names.insert(layers.begin(), layers.end());
+  }
+
+  NetParameter net;
+  caffe::ReadNetParamsFromBinaryFileOrDie(argv[1], &net);
+  const int input_bytes = net.ByteSize();
+  long long total = 0, zeros = 0;  // NOLINT(runtime/int)
+  for (int i = 0; i < net.layer_size(); ++i) {
+    LayerParameter* layer = net.mutable_layer(i);
+    const bool prune = names.size() ? names.erase(layer->name()) > 0 :
+        layer->type() == "InnerProduct" || layer->type() == "Convolution";
+    if (!prune || layer->blobs_size() == 0) { continue; }
+    // Only the weights are pruned; the biases are few.
+    BlobProto* weights = layer->mutable_blobs(0);
+    CHECK_EQ(weights->sparse_index_size(), 0) << "Layer " << layer->name()
+        << " is stored sparsely already.";
+    int count, layer_zeros;
+    if (weights->double_data_size() > 0) {
+      count = weights->double_data_size();
+      layer_zeros = caffe::caffe_prune_by_magnitude(count, FLAGS_sparsity,
+          weights->mutable_double_data()->mutable_data());
+    } else {
+      count = weights->data_size();
+      layer_zeros = caffe::caffe_prune_by_magnitude(count, FLAGS_sparsity,
+          weights->mutable_data()->mutable_data());
+    }
+    LOG(INFO) << "Pruned " << layer->name() << ": " << layer_zeros << " of "
+        << count << " weights are zero ("
+        << 100. * layer_zeros / std::max(count, 1) << "%).";
+    total += count;
+    zeros += layer_zeros;
+  }
+  for (std::set<string>::const_iterator it = names.begin();
+       it != names.end(); ++it) {
+    LOG(WARNING) << "No layer " << *it << " with weights to prune.";
+  }
+  if (FLAGS_sparse_storage) {
+    for (int i = 0; i < net.layer_size(); ++i) {
+      for (int j = 0; j < net.layer(i).blobs_size(); ++j) {
+        caffe::SparsifyBlobProto(net.mutable_layer(i)->mutable_blobs(j));
+      }
+    }
+  }
+  caffe::WriteProtoToBinaryFile(net, argv[2]);
+  LOG(INFO) << "Wrote " << argv[2] << ": " << zeros << " of " << total
+      << " pruned weights are zero; " << net.ByteSize() << " bytes, from "
+      << input_bytes << ".";
+  return 0;
+}